@@ -68,7 +68,8 @@ START_ENUM(OutputBindings)
   eSampler = 0,   // As sampler
   eStore   = 1,   // As storage
   eProfiling = 2,  //for profiling
-  eTiming = 3
+  eTiming = 3,
+  eRayCapture = 4  // Ray stream capture, see ray_stream.hpp
 END_ENUM();
 
 // Scene Data - Set 2
@@ -250,6 +251,21 @@ struct RtxState
   int estimatedEndpoint;
   int realEndpoint;
   int isFinished;
+
+  int rayCaptureStride;  // 0: off, otherwise records the rays of every n-th pixel
+};
+
+// One bounce of a captured path, written by pathtrace.glsl
+// The pixel with rayCaptureStride == n and bounce d is at index (pixel / n) * maxDepth + d
+struct RayRecord
+{
+  vec3  origin;
+  float hitT;  // INFINITY (1e32) when the ray missed
+  vec3  direction;
+  int   instanceCustomIndex;  // -1 when the ray missed
+  int   primitiveID;
+  int   depth;  // -1 for unused slots: the path ended before
+  uint  pixel;  // y * width + x
 };
 
 // Structure used for retrieving the primitive information in the closest hit
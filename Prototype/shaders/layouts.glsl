@@ -37,6 +37,7 @@
 layout(set = S_ACCEL, binding = eTlas)					uniform accelerationStructureEXT topLevelAS;
 //
 layout(set = S_OUT,   binding = eStore)					uniform image2D			resultImage;
+layout(set = S_OUT,   binding = eRayCapture, scalar)	buffer _RayCapture		{ RayRecord rayRecords[]; };
 //layout(set = S_OUT, binding = eProfiling)               buffer  Profiling       {ProfilingStats profilingStats[];};
 //
 layout(set = S_SCENE, binding = eInstData,	scalar)     buffer _InstanceInfo	{ InstanceData geoInfo[]; };
@@ -325,6 +325,33 @@ vec3 visualizeSortingKey(vec3 CubePosition, Ray r, float t, ivec3 gridSpace)
   return temperature(val);
 }
 
+//-----------------------------------------------------------------------
+// Ray stream capture: writes the bounce just traced for every rayCaptureStride-th pixel.
+// Only the first sample of the pixel is recorded, see pathtrace.rgen.
+bool captureSample = false;
+
+void captureRay(Ray r, int depth)
+{
+  if(rtxState.rayCaptureStride <= 0 || !captureSample)
+    return;
+
+  uint pixel = gl_LaunchIDEXT.y * gl_LaunchSizeEXT.x + gl_LaunchIDEXT.x;
+  if(pixel % rtxState.rayCaptureStride != 0)
+    return;
+
+  bool      missed = prd.hitT == INFINITY;
+  RayRecord record;
+  record.origin              = r.origin;
+  record.hitT                = prd.hitT;
+  record.direction           = r.direction;
+  record.instanceCustomIndex = missed ? -1 : prd.instanceCustomIndex;
+  record.primitiveID         = missed ? -1 : prd.primitiveID;
+  record.depth               = depth;
+  record.pixel               = pixel;
+
+  rayRecords[(pixel / rtxState.rayCaptureStride) * rtxState.maxDepth + depth] = record;
+}
+
 //-----------------------------------------------------------------------
 //-----------------------------------------------------------------------
 vec3 PathTrace(Ray r)
@@ -338,6 +365,7 @@ vec3 PathTrace(Ray r)
     //prd.depth = depth;
     //ClosestHitParameterized(r,depth);
     ClosestHit(r,depth);
+    captureRay(r, depth);
     if(rtxState.VisualizeSortingGrid > 0)
     {
       if(depth == 0)
@@ -0,0 +1,431 @@
+/*
+  Sorting key encoders shared by GLSL and C++
+
+  The functions in this file are compiled both by the ray generation shader (through keyCreation.glsl)
+  and by the host (key_encoder.cpp, offline tools). Every encoder is split in two steps:
+  - Quantize:   scales the inputs and returns the bit patterns the Morton code is built from
+  - Interleave: the reference bit-by-bit interleaving, exactly as the shader does it
+  The host batch encoders replace the interleaving step with BMI2 bit deposits and use these
+  reference functions to check bit-exact parity.
+
+  Positions are normalized against the scene bounding box (RtxState::SceneMin/SceneMax) before
+  they are quantized, so the Morton codes cover the scene whatever its size.
+*/
+
+
+#ifndef SORTING_KEYS_H
+#define SORTING_KEYS_H
+
+#ifdef __cplusplus
+#include <stdint.h>
+#include <glm/glm.hpp>
+#include "host_device.h"
+// GLSL built-ins used by the encoders
+using ivec3 = glm::ivec3;
+using glm::acos;
+using glm::atan;
+using glm::clamp;
+using glm::max;
+using glm::min;
+using glm::normalize;
+#define SK_INLINE inline
+#else
+#define SK_INLINE
+#endif
+
+#define SK_PI 3.14159265358979323846f
+#define SK_INFINITY 1e32f  // Same value as INFINITY in globals.glsl, hitT of a missed ray
+
+// Bit patterns the Morton code of one key is built from
+struct SortingKeyInput
+{
+  ivec3 a;  // first point (origin, or estimated endpoint)
+  ivec3 b;  // second point or direction
+};
+
+// Scene bounding box the positions are normalized against
+struct SortingKeyBounds
+{
+  vec3  sceneMin;
+  vec3  sceneSize;    // SceneMax - SceneMin, never 0
+  float sceneExtent;  // Largest component of sceneSize
+};
+
+SK_INLINE SortingKeyBounds SortingKeyMakeBounds(vec3 sceneMin, vec3 sceneMax)
+{
+  SortingKeyBounds bounds;
+  bounds.sceneMin    = sceneMin;
+  bounds.sceneSize   = max(sceneMax - sceneMin, vec3(1e-6f));
+  bounds.sceneExtent = max(max(bounds.sceneSize.x, bounds.sceneSize.y), bounds.sceneSize.z);
+  return bounds;
+}
+
+// Position in the unit cube of the scene, points outside of the scene are clamped to its faces
+SK_INLINE vec3 SortingKeyNormalize(vec3 p, SortingKeyBounds bounds)
+{
+  return clamp((p - bounds.sceneMin) / bounds.sceneSize, vec3(0.0f), vec3(1.0f));
+}
+
+// Direction mapped to [0,1]^2: azimuth and inclination
+SK_INLINE vec3 SortingKeySphericalDirection(vec3 direction)
+{
+  vec3 nd = normalize(direction);
+  vec3 b  = vec3(0);
+  b.x     = atan(nd.y, nd.x) / (2.0f * SK_PI) + 0.5f;
+  b.y     = acos(clamp(nd.z, -1.0f, 1.0f)) / SK_PI;
+  return b;
+}
+
+
+//-----------------------------------------------------------------------
+// Origin only: 21 bits per dimension
+//
+SK_INLINE SortingKeyInput SortingKeyQuantizeOrigin(vec3 origin, SortingKeyBounds bounds)
+{
+  // Point for Morton codes.
+  vec3 a  = SortingKeyNormalize(origin, bounds);
+  vec3 ia = a * 8388607.0f;  //23b/dim
+
+  SortingKeyInput q;
+  q.a = ivec3(ia);
+  q.b = ivec3(0);
+  return q;
+}
+
+SK_INLINE uint SortingKeyInterleaveOrigin(SortingKeyInput q)
+{
+  uint64_t mortonCode = 0;
+  for(int i = 22; i >= 2; --i)
+  {
+    mortonCode |= uint64_t(((q.a.x >> i) & 1)) << (3 * i - 3);  // max 63
+    mortonCode |= uint64_t(((q.a.y >> i) & 1)) << (3 * i - 4);  // max 62
+    mortonCode |= uint64_t(((q.a.z >> i) & 1)) << (3 * i - 5);  // max 61
+  }
+  mortonCode |= uint64_t((q.a.x & 1));  // max 0
+  return uint(mortonCode >> 32);
+}
+
+SK_INLINE uint SortingKeyOrigin(vec3 origin, SortingKeyBounds bounds)
+{
+  return SortingKeyInterleaveOrigin(SortingKeyQuantizeOrigin(origin, bounds));
+}
+
+
+//-----------------------------------------------------------------------
+// Reis et al. [2017]: Origin and spherical Direction
+//
+SK_INLINE SortingKeyInput SortingKeyQuantizeReis(vec3 origin, vec3 direction, SortingKeyBounds bounds)
+{
+  // Point for Morton codes.
+  vec3 a = SortingKeyNormalize(origin, bounds);
+  vec3 b = SortingKeySphericalDirection(direction);
+
+  vec3 ia = a * 255.0f;  //8b/dim
+  vec3 ib = b * 255.0f;  //8b/dim
+
+  SortingKeyInput q;
+  q.a = ivec3(ia);
+  q.b = ivec3(ib);
+  return q;
+}
+
+SK_INLINE uint SortingKeyInterleaveReis(SortingKeyInput q)
+{
+  uint64_t mortonCode = 0;
+  for(int i = 7; i >= 1; --i)
+  {
+    mortonCode |= uint64_t(((q.a.x >> i) & 1)) << (3 * i + 10);  // max 31
+    mortonCode |= uint64_t(((q.a.y >> i) & 1)) << (3 * i + 9);   // max 30
+    mortonCode |= uint64_t(((q.a.z >> i) & 1)) << (3 * i + 8);   // max 29
+  }
+  mortonCode |= uint64_t((q.a.x & 1)) << (10);  // max 10
+
+  for(int i = 7; i >= 3; --i)
+  {
+    mortonCode |= uint64_t(((q.b.x >> i) & 1)) << (2 * i - 5);  // max 9
+    mortonCode |= uint64_t(((q.b.y >> i) & 1)) << (2 * i - 6);  // max 8
+  }
+  // The code has 32 bits, all of them are kept
+  return uint(mortonCode);
+}
+
+SK_INLINE uint SortingKeyReis(vec3 origin, vec3 direction, SortingKeyBounds bounds)
+{
+  return SortingKeyInterleaveReis(SortingKeyQuantizeReis(origin, direction, bounds));
+}
+
+
+//-----------------------------------------------------------------------
+// Costa et al.: Direction-Origin
+//
+SK_INLINE SortingKeyInput SortingKeyQuantizeCosta(vec3 origin, vec3 direction, SortingKeyBounds bounds)
+{
+  // Point for Morton codes.
+  vec3 a = SortingKeyNormalize(origin, bounds);
+  vec3 b = SortingKeySphericalDirection(direction);
+
+  vec3 ia = a * 8191.0f;  //13b/dim
+  vec3 ib = b * 8191.0f;  //13b/dim
+
+  SortingKeyInput q;
+  q.a = ivec3(ia);
+  q.b = ivec3(ib);
+  return q;
+}
+
+SK_INLINE uint SortingKeyInterleaveCosta(SortingKeyInput q)
+{
+  uint64_t mortonCode = 0;
+  for(int i = 12; i >= 9; --i)
+  {
+    mortonCode |= uint64_t(((q.b.x >> i) & 1)) << (2 * i + 39);  // max 63
+    mortonCode |= uint64_t(((q.b.y >> i) & 1)) << (2 * i + 38);  // max 62
+  }
+
+  for(int i = 7; i >= 1; --i)
+  {
+    mortonCode |= uint64_t(((q.a.x >> i) & 1)) << (3 * i + 19);  // max 40
+    mortonCode |= uint64_t(((q.a.y >> i) & 1)) << (3 * i + 18);  // max 39
+    mortonCode |= uint64_t(((q.a.z >> i) & 1)) << (3 * i + 17);  // max 38
+  }
+  return uint(mortonCode >> 32);
+}
+
+SK_INLINE uint SortingKeyCosta(vec3 origin, vec3 direction, SortingKeyBounds bounds)
+{
+  return SortingKeyInterleaveCosta(SortingKeyQuantizeCosta(origin, direction, bounds));
+}
+
+
+//-----------------------------------------------------------------------
+// Aila et al.: Origin Direction interleaved
+//
+SK_INLINE SortingKeyInput SortingKeyQuantizeAila(vec3 origin, vec3 direction, SortingKeyBounds bounds)
+{
+  // Point for Morton codes.
+  vec3 a = SortingKeyNormalize(origin, bounds);
+  vec3 b = (normalize(direction) + 1.0f) * 0.5f;
+
+  vec3 ia = a * 8191.0f;  //13b/dim
+  vec3 ib = b * 8191.0f;  //13b/dim
+
+  SortingKeyInput q;
+  q.a = ivec3(ia);
+  q.b = ivec3(ib);
+  return q;
+}
+
+SK_INLINE uint SortingKeyInterleaveAila(SortingKeyInput q)
+{
+  uint64_t mortonCode = 0;
+  for(int i = 12; i >= 10; --i)
+  {
+    mortonCode |= uint64_t(((q.a.x >> i) & 1)) << (3 * i + 27);  // max 63
+    mortonCode |= uint64_t(((q.a.y >> i) & 1)) << (3 * i + 26);  // max 62
+    mortonCode |= uint64_t(((q.a.z >> i) & 1)) << (3 * i + 25);  // max 61
+  }
+
+  for(int i = 9; i >= 1; --i)
+  {
+    mortonCode |= uint64_t(((q.a.x >> i) & 1)) << (6 * i + 0);  // max 54
+    mortonCode |= uint64_t(((q.a.y >> i) & 1)) << (6 * i - 1);  // max 53
+    mortonCode |= uint64_t(((q.a.z >> i) & 1)) << (6 * i - 2);  // max 52
+  }
+
+  for(int i = 12; i >= 4; --i)
+  {
+    mortonCode |= uint64_t(((q.b.x >> i) & 1)) << (6 * i - 21);  // max 51
+    mortonCode |= uint64_t(((q.b.y >> i) & 1)) << (6 * i - 22);  // max 50
+    mortonCode |= uint64_t(((q.b.z >> i) & 1)) << (6 * i - 23);  // max 49
+  }
+  return uint(mortonCode >> 32);
+}
+
+SK_INLINE uint SortingKeyAila(vec3 origin, vec3 direction, SortingKeyBounds bounds)
+{
+  return SortingKeyInterleaveAila(SortingKeyQuantizeAila(origin, direction, bounds));
+}
+
+
+//-----------------------------------------------------------------------
+// Two points: Origin and termination point after AS traversal
+//
+SK_INLINE SortingKeyInput SortingKeyQuantizeTwoPoint(vec3 origin, vec3 direction, float rayLength, SortingKeyBounds bounds)
+{
+  vec3 a = SortingKeyNormalize(origin, bounds);
+  vec3 b = SortingKeyNormalize(origin + direction * rayLength, bounds);
+
+  vec3 ia = a * 32767.0f;  //15b/dim
+  vec3 ib = b * 32767.0f;  //15b/dim
+
+  SortingKeyInput q;
+  q.a = ivec3(ia);
+  q.b = ivec3(ib);
+  return q;
+}
+
+SK_INLINE uint SortingKeyInterleaveTwoPoint(SortingKeyInput q)
+{
+  uint64_t mortonCode = 0;
+  for(int i = 14; i >= 4; --i)
+  {
+    mortonCode |= uint64_t(((q.a.x >> i) & 1)) << (6 * i - 21);  // max 63
+    mortonCode |= uint64_t(((q.a.y >> i) & 1)) << (6 * i - 22);  // max 62
+    mortonCode |= uint64_t(((q.a.z >> i) & 1)) << (6 * i - 23);  // max 61
+  }
+
+  for(int i = 14; i >= 5; --i)
+  {
+    mortonCode |= uint64_t(((q.b.x >> i) & 1)) << (6 * i - 24);  // max 60
+    mortonCode |= uint64_t(((q.b.y >> i) & 1)) << (6 * i - 25);  // max 59
+    mortonCode |= uint64_t(((q.b.z >> i) & 1)) << (6 * i - 26);  // max 58
+  }
+
+  mortonCode |= uint64_t(q.b.x & 1);
+  return uint(mortonCode >> 32);
+}
+
+SK_INLINE uint SortingKeyTwoPoint(vec3 origin, vec3 direction, float rayLength, SortingKeyBounds bounds)
+{
+  return SortingKeyInterleaveTwoPoint(SortingKeyQuantizeTwoPoint(origin, direction, rayLength, bounds));
+}
+
+
+//-----------------------------------------------------------------------
+// Estimated endpoint, the ray length is a fixed fraction of the scene extent.
+// Like the shader, both points of the Morton code come from the estimated endpoint.
+//
+SK_INLINE SortingKeyInput SortingKeyQuantizeEndPoint(vec3 origin, vec3 direction, float estimatedRayLength, SortingKeyBounds bounds)
+{
+  vec3 b = SortingKeyNormalize(origin + estimatedRayLength * direction, bounds);
+
+  vec3 ib = b * 32767.0f;  //15b/dim
+
+  SortingKeyInput q;
+  q.a = ivec3(ib);
+  q.b = q.a;
+  return q;
+}
+
+SK_INLINE uint SortingKeyEndPointEstimationHard(vec3 origin, vec3 direction, SortingKeyBounds bounds)
+{
+  float estimatedRayLength = 0.2f * bounds.sceneExtent;  //just hardcoded estimate atm
+  return SortingKeyInterleaveTwoPoint(SortingKeyQuantizeEndPoint(origin, direction, estimatedRayLength, bounds));
+}
+
+// Ray length of the previous bounce when available, fraction of the scene extent otherwise
+SK_INLINE float SortingKeyAdaptiveRayLength(float rayLengthLastPass, float sceneExtent)
+{
+  return rayLengthLastPass == SK_INFINITY ? 0.2f * sceneExtent : 0.5f * rayLengthLastPass;
+}
+
+SK_INLINE uint SortingKeyEndPointEstimationAdaptive(vec3 origin, vec3 direction, float rayLengthLastPass, SortingKeyBounds bounds)
+{
+  float estimatedRayLength = SortingKeyAdaptiveRayLength(rayLengthLastPass, bounds.sceneExtent);
+  return SortingKeyInterleaveTwoPoint(SortingKeyQuantizeEndPoint(origin, direction, estimatedRayLength, bounds));
+}
+
+
+//-----------------------------------------------------------------------
+// Composite key of the SortingParameters, each enabled component gets its own bits.
+// From the most significant bit:  isFinished | origin | direction | endpoint
+// The key is right aligned: its total number of bits is the hint size of reorderThreadNV.
+//
+struct SortingKeyBudget
+{
+  uint origin;     // 3D Morton code of the origin
+  uint direction;  // 2D Morton code of the spherical direction
+  uint endpoint;   // 3D Morton code of the real or estimated endpoint
+  uint finished;   // 0 or 1: the path ends after this bounce
+};
+
+SK_INLINE uint SortingKeyBudgetTotal(SortingKeyBudget budget)
+{
+  return budget.origin + budget.direction + budget.endpoint + budget.finished;
+}
+
+// numCoherenceBitsTotal split over the enabled components: one bit for isFinished, the
+// others share the rest evenly, the remainder going to the first one
+SK_INLINE SortingKeyBudget SortingKeyDefaultBudget(SortingParameters parameters)
+{
+  SortingKeyBudget budget;
+  budget.origin    = 0;
+  budget.direction = 0;
+  budget.endpoint  = 0;
+  budget.finished  = 0;
+  if(parameters.noSort)
+    return budget;
+
+  uint total       = min(parameters.numCoherenceBitsTotal, 32u);
+  bool endpoint    = parameters.estimatedEndpoint || parameters.realEndpoint;
+  budget.finished  = (parameters.isFinished && total > 0) ? 1u : 0u;
+  uint left        = total - budget.finished;
+  uint numEnabled  = (parameters.rayOrigin ? 1u : 0u) + (parameters.rayDirection ? 1u : 0u) + (endpoint ? 1u : 0u);
+  if(numEnabled == 0)
+    return budget;
+
+  uint share = left / numEnabled;
+  uint extra = left - share * numEnabled;
+  if(parameters.rayOrigin)
+  {
+    budget.origin = share + extra;
+    extra         = 0;
+  }
+  if(parameters.rayDirection)
+  {
+    budget.direction = share + extra;
+    extra            = 0;
+  }
+  if(endpoint)
+    budget.endpoint = share + extra;
+  return budget;
+}
+
+// Top `bits` bits (0..32) of the 63 bit Morton code of a point of the unit cube
+SK_INLINE uint SortingKeyMortonPoint(vec3 unitPoint, uint bits)
+{
+  ivec3 q = ivec3(unitPoint * 2097151.0f);  //21b/dim
+
+  uint64_t mortonCode = 0;
+  for(int i = 20; i >= 0; --i)
+  {
+    mortonCode |= uint64_t(((q.x >> i) & 1)) << (3 * i + 2);  // max 62
+    mortonCode |= uint64_t(((q.y >> i) & 1)) << (3 * i + 1);  // max 61
+    mortonCode |= uint64_t(((q.z >> i) & 1)) << (3 * i + 0);  // max 60
+  }
+  return bits == 0u ? 0u : uint(mortonCode >> (63u - bits));
+}
+
+// Top `bits` bits (0..32) of the 32 bit Morton code of a spherical direction
+SK_INLINE uint SortingKeyMortonDirection(vec3 unitDirection, uint bits)
+{
+  ivec3 q = ivec3(unitDirection * 65535.0f);  //16b/dim
+
+  uint64_t mortonCode = 0;
+  for(int i = 15; i >= 0; --i)
+  {
+    mortonCode |= uint64_t(((q.x >> i) & 1)) << (2 * i + 1);  // max 31
+    mortonCode |= uint64_t(((q.y >> i) & 1)) << (2 * i + 0);  // max 30
+  }
+  return bits == 0u ? 0u : uint(mortonCode >> (32u - bits));
+}
+
+// `rayLength`: hitT after traversal for the real endpoint, SortingKeyAdaptiveRayLength() before it
+SK_INLINE uint SortingKeyComposite(SortingKeyBudget budget, SortingKeyBounds bounds, vec3 origin, vec3 direction, float rayLength, bool finished)
+{
+  uint64_t key = 0;
+  if(budget.finished > 0)
+    key = uint64_t(finished ? 1u : 0u);
+  if(budget.origin > 0)
+    key = (key << budget.origin) | uint64_t(SortingKeyMortonPoint(SortingKeyNormalize(origin, bounds), budget.origin));
+  if(budget.direction > 0)
+    key = (key << budget.direction) | uint64_t(SortingKeyMortonDirection(SortingKeySphericalDirection(direction), budget.direction));
+  if(budget.endpoint > 0)
+    key = (key << budget.endpoint) | uint64_t(SortingKeyMortonPoint(SortingKeyNormalize(origin + direction * rayLength, bounds), budget.endpoint));
+  return uint(key);
+}
+
+
+#undef SK_INLINE
+
+#endif  // SORTING_KEYS_H
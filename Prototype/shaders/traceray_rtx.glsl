@@ -35,6 +35,7 @@
 void ClosestHit(Ray r,int  depth)
 {
   uint rayFlags = gl_RayFlagsCullBackFacingTrianglesEXT;
+  float lastHitT = depth == 0 ? INFINITY : prd.hitT;  // estimates the endpoint before the traversal
   prd.hitT      = INFINITY;
   uint64_t start; 
   uint64_t end; 
@@ -57,13 +58,16 @@ void ClosestHit(Ray r,int  depth)
   }
   else 
   {
-
-    uint code = createSortingKeyFromSpecialization(r);
-
+    // The real endpoint is only known after the traversal, the key is built there
+    uint code = 0;
+    if(!REALENDPOINT)
+    {
+      code = createSortingKeyFromSpecialization(r, sortingKeyRayLength(false, INFINITY, lastHitT), depth);
+    }
 
     if(!AFTERASTRAVERSAL)
     {
-      reorderThreadNV(code,_sortingParameters.numCoherenceBitsTotal);
+      reorderThreadNV(code,SORTING_KEY_BITS);
     }
 
 
@@ -82,16 +86,21 @@ void ClosestHit(Ray r,int  depth)
                 INFINITY,
                 0);
 
+    if(REALENDPOINT)
+    {
+      code = createSortingKeyFromSpecialization(r, hitObjectGetRayTMaxNV(hObj), depth);
+    }
+
     if(AFTERASTRAVERSAL)
     {
       if(HITOBJECT)
       {
-        reorderThreadNV(hObj, code,_sortingParameters.numCoherenceBitsTotal );
+        reorderThreadNV(hObj, code,SORTING_KEY_BITS);
         //reorderThreadNV(hObj,code,_sortingParameters.numCoherenceBitsTotal);
       }
       else
       {
-        reorderThreadNV(code,_sortingParameters.numCoherenceBitsTotal);
+        reorderThreadNV(code,SORTING_KEY_BITS);
         //reorderThreadNV(hObj);
       }
     }
@@ -181,6 +190,7 @@ void ClosestHitPush(Ray r,int  depth)
 void ClosestHitOrigin(Ray r,int  depth)
 {
   uint rayFlags = gl_RayFlagsCullBackFacingTrianglesEXT;
+  float lastHitT = depth == 0 ? INFINITY : prd.hitT;
   prd.hitT      = INFINITY;
   uint64_t start; 
   uint64_t end; 
@@ -188,12 +198,12 @@ void ClosestHitOrigin(Ray r,int  depth)
 
 
 
-    uint code = createSortingKeyFromSpecialization(r);
+    uint code = createSortingKeyFromSpecialization(r, sortingKeyRayLength(false, INFINITY, lastHitT), depth);
 
 
     if(!AFTERASTRAVERSAL)
     {
-      reorderThreadNV(code,_sortingParameters.numCoherenceBitsTotal);
+      reorderThreadNV(code,SORTING_KEY_BITS);
     }
 
 
@@ -215,7 +225,7 @@ void ClosestHitOrigin(Ray r,int  depth)
     if(AFTERASTRAVERSAL)
     {
 
-      reorderThreadNV(code,_sortingParameters.numCoherenceBitsTotal);
+      reorderThreadNV(code,SORTING_KEY_BITS);
       //reorderThreadNV(hObj);
 
     }
@@ -312,6 +322,7 @@ void ClosestHitOrigin(Ray r,int  depth)
 void ClosestHitParameterized(Ray r,int  depth)
 {
   uint rayFlags = gl_RayFlagsCullBackFacingTrianglesEXT;
+  float lastHitT = depth == 0 ? INFINITY : prd.hitT;
   prd.hitT      = INFINITY;
   uint64_t start; 
   uint64_t end; 
@@ -343,12 +354,18 @@ void ClosestHitParameterized(Ray r,int  depth)
     uint64_t sortingStart; 
     uint64_t sortingEnd; 
 
-    uint code = createSortingKeyFromParameters(r, _sortingParameters);
+    // The real endpoint is only known after the traversal, the key is built there
+    uint code = 0;
+    if(!_sortingParameters.realEndpoint)
+    {
+      code = createSortingKeyFromParameters(r, _sortingParameters, sortingKeyRayLength(false, INFINITY, lastHitT), depth);
+    }
+    uint keyBits = SortingKeyBudgetTotal(SortingKeyDefaultBudget(_sortingParameters));
 
     if(!(_sortingParameters.sortAfterASTraversal))
     {
       sortingStart = clockRealtimeEXT();
-      reorderThreadNV(code,_sortingParameters.numCoherenceBitsTotal);
+      reorderThreadNV(code,keyBits);
       sortingEnd = clockRealtimeEXT();
       prd.sortMode = 1;
     }
@@ -370,6 +387,10 @@ void ClosestHitParameterized(Ray r,int  depth)
     end = clockRealtimeEXT();
     uint64_t duration = end -start;
     //prd.rtTiming += duration;
+    if(_sortingParameters.realEndpoint)
+    {
+      code = createSortingKeyFromParameters(r, _sortingParameters, sortingKeyRayLength(true, hitObjectGetRayTMaxNV(hObj), lastHitT), depth);
+    }
     if(_sortingParameters.sortAfterASTraversal)
     {
       if(_sortingParameters.hitObject)
@@ -382,7 +403,7 @@ void ClosestHitParameterized(Ray r,int  depth)
       }else
       {
         sortingStart = clockRealtimeEXT();
-        reorderThreadNV(code,_sortingParameters.numCoherenceBitsTotal);
+        reorderThreadNV(code,keyBits);
         //reorderThreadNV(hObj);
         sortingEnd = clockRealtimeEXT();
         prd.sortMode = 3;
@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "bandit_tuner.hpp"
+
+
+void ArmStats::add(double value)
+{
+  count++;
+  double delta = value - mean;
+  mean += delta / double(count);
+  m2 += delta * (value - mean);
+}
+
+void ArmStats::addMean(uint32_t n, double value)
+{
+  count += n;
+  restored += n;
+  mean += (value - mean) * double(n) / double(count);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+BanditTuner::BanditTuner(uint32_t numArms, uint32_t numContexts, const BanditSettings& settings)
+    : m_settings(settings)
+    , m_rng(settings.seed)
+{
+  reset(numArms, numContexts);
+}
+
+void BanditTuner::reset(uint32_t numArms, uint32_t numContexts)
+{
+  m_numArms = numArms;
+  Context empty;
+  empty.remaining = numArms;
+  // The arms of a context are allocated on its first use, most cells of a large grid never are
+  m_contexts.assign(numContexts, empty);
+}
+
+BanditTuner::Context& BanditTuner::touch(uint32_t context)
+{
+  Context& c = m_contexts[context];
+  if(c.arms.size() != m_numArms)
+    c.arms.resize(m_numArms);
+  return c;
+}
+
+double BanditTuner::standardError(const Context& context, const ArmStats& arm) const
+{
+  if(arm.count == 0)
+    return 0.0;
+  // The arms of a context share most of their noise (same view, same GPU), the pooled relative
+  // variance stands in for the one of an arm with few samples. The prior until it is known.
+  double pooled   = context.pooledDegrees >= 10.0 ? std::sqrt(context.pooledRelativeVariance) : m_settings.priorRelativeNoise;
+  double relative = std::max(double(m_settings.relativeNoiseFloor), pooled);
+  double floor    = relative * arm.mean;
+  double variance = arm.count - arm.restored > 2 ? std::max(arm.variance(), floor * floor) : floor * floor;
+  return std::sqrt(variance / double(arm.count));
+}
+
+double BanditTuner::standardError(uint32_t context, int arm) const
+{
+  if(m_contexts[context].arms.empty())
+    return 0.0;
+  return standardError(m_contexts[context], m_contexts[context].arms[arm]);
+}
+
+double BanditTuner::buildPriority(uint32_t context, int arm) const
+{
+  const Context& c = m_contexts[context];
+  if(c.arms.empty())
+    return std::numeric_limits<double>::max();
+  const ArmStats& stats = c.arms[arm];
+  if(stats.eliminated || (c.converged && arm != best(context)))
+    return -std::numeric_limits<double>::infinity();
+  if(stats.count < minSamples())
+    return std::numeric_limits<double>::max();
+  return -(stats.mean - m_settings.confidenceZ * standardError(c, stats));
+}
+
+int BanditTuner::best(uint32_t context) const
+{
+  const Context& c    = m_contexts[context];
+  int            best = -1;
+  for(uint32_t a = 0; a < uint32_t(c.arms.size()); a++)
+  {
+    const ArmStats& arm = c.arms[a];
+    if(arm.count == 0 || arm.eliminated)
+      continue;
+    if(best < 0 || arm.mean < c.arms[best].mean)
+      best = int(a);
+  }
+  return best;
+}
+
+bool BanditTuner::converged(uint32_t context) const
+{
+  return m_contexts[context].converged;
+}
+
+const ArmStats& BanditTuner::stats(uint32_t context, int arm) const
+{
+  static const ArmStats none;
+  const Context&        c = m_contexts[context];
+  return c.arms.empty() ? none : c.arms[arm];
+}
+
+bool BanditTuner::finished(uint32_t context) const
+{
+  return converged(context) || m_contexts[context].observations >= m_settings.maxObservations;
+}
+
+int BanditTuner::select(uint32_t context)
+{
+  if(m_numArms == 0)
+    return -1;
+  Context& c = touch(context);
+  if(converged(context))
+    return best(context);
+
+  // Every arm gets its minimum samples first, in random order: a training that runs out of
+  // observations has not favored the first arms
+  std::vector<int> undersampled;
+  for(uint32_t a = 0; a < m_numArms; a++)
+  {
+    if(!c.arms[a].eliminated && c.arms[a].count < minSamples())
+      undersampled.push_back(int(a));
+  }
+  if(!undersampled.empty())
+  {
+    std::uniform_int_distribution<size_t> pick(0, undersampled.size() - 1);
+    return undersampled[pick(m_rng)];
+  }
+
+  int selected = -1;
+  if(m_settings.policy == eBanditUcb1)
+  {
+    // The bonus of UCB1 scaled by the noise of the arm (UCB1-Normal): the frame times are not in
+    // [0,1] and their noise is what decides how long an arm needs to be measured
+    double logTotal = std::log(double(c.observations));
+    double lowest   = 0.0;
+    for(uint32_t a = 0; a < m_numArms; a++)
+    {
+      const ArmStats& arm = c.arms[a];
+      if(arm.eliminated)
+        continue;
+      double index = arm.mean - m_settings.explorationScale * standardError(c, arm) * std::sqrt(2.0 * logTotal);
+      if(selected < 0 || index < lowest)
+      {
+        selected = int(a);
+        lowest   = index;
+      }
+    }
+  }
+  else
+  {
+    // Top-two Thompson sampling on the gaussian posterior of the means: half of the time the
+    // challenger, the fastest arm of a draw won by another arm. Plain Thompson sampling keeps
+    // measuring the leader and takes long to separate it from the runner-up.
+    std::normal_distribution<double>       normal(0.0, 1.0);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    auto                                   draw = [&]() {
+      int    fastest = -1;
+      double lowest  = 0.0;
+      for(uint32_t a = 0; a < m_numArms; a++)
+      {
+        const ArmStats& arm = c.arms[a];
+        if(arm.eliminated)
+          continue;
+        double sample = arm.mean + standardError(c, arm) * normal(m_rng);
+        if(fastest < 0 || sample < lowest)
+        {
+          fastest = int(a);
+          lowest  = sample;
+        }
+      }
+      return fastest;
+    };
+
+    selected = draw();
+    if(c.remaining > 1 && unit(m_rng) < 0.5)
+    {
+      for(int attempt = 0; attempt < 64; attempt++)
+      {
+        int challenger = draw();
+        if(challenger != selected)
+          return challenger;
+      }
+    }
+  }
+  return selected;
+}
+
+void BanditTuner::observe(uint32_t context, int arm, double frameTimeMs)
+{
+  if(arm < 0 || uint32_t(arm) >= m_numArms || !(frameTimeMs > 0.0) || !std::isfinite(frameTimeMs))
+    return;
+  Context& c = touch(context);
+  c.arms[arm].add(frameTimeMs);
+  c.observations++;
+  updatePooledVariance(c);
+  eliminate(c);
+}
+
+void BanditTuner::restore(uint32_t context, int arm, uint32_t count, double meanFrameTimeMs)
+{
+  if(arm < 0 || uint32_t(arm) >= m_numArms || count == 0 || !(meanFrameTimeMs > 0.0) || !std::isfinite(meanFrameTimeMs))
+    return;
+  Context& c = touch(context);
+  c.arms[arm].addMean(count, meanFrameTimeMs);
+  c.observations += count;
+  eliminate(c);
+}
+
+void BanditTuner::updatePooledVariance(Context& c)
+{
+  // The restored observations have no spread, they would pass for noiseless ones
+  double sum     = 0.0;
+  double degrees = 0.0;
+  for(const ArmStats& a : c.arms)
+  {
+    uint32_t measured = a.count - a.restored;
+    if(measured < 2)
+      continue;
+    sum += a.m2 / (a.mean * a.mean);
+    degrees += double(measured - 1);
+  }
+  c.pooledRelativeVariance = degrees > 0.0 ? sum / degrees : 0.0;
+  c.pooledDegrees          = degrees;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Successive elimination: an arm goes when even its optimistic frame time is slower than the
+// pessimistic one of the best arm. Arms that close cannot all be told apart in a reasonable
+// number of windows, the tolerance ends the search once the difference no longer matters.
+//
+void BanditTuner::eliminate(Context& c)
+{
+  int    leader = -1;
+  double bound  = 0.0;
+  for(uint32_t a = 0; a < m_numArms; a++)
+  {
+    const ArmStats& arm = c.arms[a];
+    if(arm.eliminated || arm.count < minSamples())
+      continue;
+    double upper = arm.mean + m_settings.confidenceZ * standardError(c, arm);
+    if(leader < 0 || arm.mean < c.arms[leader].mean)
+    {
+      leader = int(a);
+      bound  = upper;
+    }
+  }
+  if(leader < 0)
+    return;
+
+  for(uint32_t a = 0; a < m_numArms; a++)
+  {
+    ArmStats& arm = c.arms[a];
+    if(int(a) == leader || arm.eliminated || arm.count < minSamples())
+      continue;
+    if(arm.mean - m_settings.confidenceZ * standardError(c, arm) > bound)
+    {
+      arm.eliminated = true;
+      c.remaining--;
+    }
+  }
+
+  // Converged when every arm left has its minimum samples and none of them can beat the leader
+  // by more than the tolerance
+  double tolerance = m_settings.tolerance * c.arms[leader].mean;
+  c.converged      = true;
+  for(uint32_t a = 0; a < m_numArms && c.converged; a++)
+  {
+    const ArmStats& arm = c.arms[a];
+    if(int(a) == leader || arm.eliminated)
+      continue;
+    c.converged = arm.count >= minSamples() && arm.mean - m_settings.confidenceZ * standardError(c, arm) >= bound - tolerance;
+  }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+SyntheticTimingModel::SyntheticTimingModel(uint32_t numArms, uint64_t seed, const SyntheticTimingSettings& settings)
+    : m_settings(settings)
+    , m_rng(seed)
+{
+  // Arm 0..n-1 spread over [base, base * (1 + spread)], the fastest at a random position
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  m_means.resize(numArms);
+  for(double& mean : m_means)
+    mean = settings.baseFrameTimeMs * (1.0 + settings.spread * unit(m_rng));
+  if(numArms > 0)
+  {
+    m_fastest          = int(std::uniform_int_distribution<uint32_t>(0, numArms - 1)(m_rng));
+    m_means[m_fastest] = settings.baseFrameTimeMs;
+  }
+}
+
+double SyntheticTimingModel::sample(int arm)
+{
+  std::normal_distribution<double>       noise(0.0, m_settings.relativeNoise);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  double                                 value = m_means[arm] * (1.0 + noise(m_rng));
+  if(unit(m_rng) < m_settings.spikeProbability)
+    value *= m_settings.spikeFactor;
+  return std::max(value, 1e-3);
+}
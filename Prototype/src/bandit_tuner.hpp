@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+//--------------------------------------------------------------------------------------------------
+// Multi-armed bandit tuning of the sorting parameters
+//
+// - A context is one (grid cell, cube side) of the sorting grid, an arm one candidate pipeline
+// - Each measurement window gives one observation: the mean frame time in ms, lower is better
+// - The next arm to measure is chosen by UCB1 or Thompson sampling from the mean and variance
+// - Arms whose confidence interval lies above the one of the best arm are eliminated, the context
+//   is converged when no remaining arm can be faster than the best one by more than a tolerance
+//
+// The tuner only knows arm indices, the caller maps them to SortingParameters. No Vulkan
+// dependency: SyntheticTimingModel drives it without a GPU (tools/bandit_tuner_sim.cpp).
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+
+enum BanditPolicy
+{
+  eBanditUcb1,
+  eBanditThompson,
+};
+
+struct BanditSettings
+{
+  BanditPolicy policy{eBanditUcb1};
+  float        explorationScale{1.0f};     // c of UCB1, in standard errors of the arm
+  float        confidenceZ{2.576f};        // Width of the intervals of the elimination, 2.576: 99%
+  uint32_t     minSamples{1};              // Observations of an arm before it can be eliminated or crowned, at least 1
+  float        tolerance{0.02f};           // Arms closer than this to the best, relative, are as good
+  float        relativeNoiseFloor{0.01f};  // Least standard deviation, relative to the mean
+  float        priorRelativeNoise{0.1f};   // Standard deviation assumed before the noise is measured
+  uint32_t     maxObservations{512};       // Per context, the training moves on after that many
+  uint64_t     seed{1234};
+};
+
+// Running mean and variance of the frame time of one arm (Welford)
+struct ArmStats
+{
+  uint32_t count{0};
+  uint32_t restored{0};  // Of the count, restored as a mean without their spread
+  double   mean{0.0};
+  double   m2{0.0};
+  bool     eliminated{false};
+
+  void   add(double value);
+  // `n` observations of mean `value`, their variance unknown
+  void   addMean(uint32_t n, double value);
+  // Of the measured observations
+  double variance() const { return count - restored > 1 ? m2 / double(count - restored - 1) : 0.0; }
+};
+
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+class BanditTuner
+{
+public:
+  BanditTuner() = default;
+  BanditTuner(uint32_t numArms, uint32_t numContexts, const BanditSettings& settings = {});
+
+  // Drops all observations
+  void reset(uint32_t numArms, uint32_t numContexts);
+
+  // Next arm to measure in the context, the best one once converged
+  int  select(uint32_t context);
+  void observe(uint32_t context, int arm, double frameTimeMs);
+  // `count` observations of a saved grid whose mean is `meanFrameTimeMs`. They weigh as many
+  // windows in the mean, the noise stays the pooled one of the measured arms.
+  void restore(uint32_t context, int arm, uint32_t count, double meanFrameTimeMs);
+
+  // Lowest mean frame time among the arms still in the race, -1 before the first observation
+  int  best(uint32_t context) const;
+  // No remaining arm can be faster than the best one by more than the tolerance
+  bool converged(uint32_t context) const;
+  // Converged or out of observations
+  bool finished(uint32_t context) const;
+
+  uint32_t        numArms() const { return m_numArms; }
+  uint32_t        numContexts() const { return uint32_t(m_contexts.size()); }
+  uint32_t        numObservations(uint32_t context) const { return m_contexts[context].observations; }
+  uint32_t        numRemaining(uint32_t context) const { return m_contexts[context].remaining; }
+  const ArmStats& stats(uint32_t context, int arm) const;
+  // Standard error of the mean of an arm
+  double          standardError(uint32_t context, int arm) const;
+  // How much having the pipeline of the arm ready is worth, higher first: max() for an arm without
+  // its minimum samples, select() takes those next, then by the optimistic frame time. -infinity
+  // for an arm that cannot be selected any more.
+  double          buildPriority(uint32_t context, int arm) const;
+  BanditSettings& settings() { return m_settings; }
+
+private:
+  struct Context
+  {
+    std::vector<ArmStats> arms;
+    uint32_t              observations{0};
+    uint32_t              remaining{0};  // Arms not eliminated
+    bool                  converged{false};
+    double                pooledRelativeVariance{0.0};  // Variance of frame time / mean over all arms
+    double                pooledDegrees{0.0};
+  };
+
+  // The context with its arms allocated
+  Context& touch(uint32_t context);
+  // settings().minSamples, an arm is never ranked without an observation
+  uint32_t minSamples() const { return m_settings.minSamples > 0 ? m_settings.minSamples : 1; }
+  double   standardError(const Context& context, const ArmStats& arm) const;
+
+  void updatePooledVariance(Context& context);
+  // Also updates the convergence of the context
+  void eliminate(Context& context);
+
+  BanditSettings       m_settings;
+  uint32_t             m_numArms{0};
+  std::vector<Context> m_contexts;
+  std::mt19937_64      m_rng;
+};
+
+
+//--------------------------------------------------------------------------------------------------
+// Frame times of made up pipelines: a true mean per arm, gaussian noise and rare spikes such as
+// a compositor hiccup. The fastest arm is known, which gives the regret of a tuner.
+//
+struct SyntheticTimingSettings
+{
+  double baseFrameTimeMs{8.0};   // Fastest arm
+  double spread{0.5};            // The slowest arm is (1 + spread) times slower
+  double relativeNoise{0.05};    // Standard deviation of a window, relative to the mean
+  double spikeProbability{0.02};
+  double spikeFactor{1.25};
+};
+
+class SyntheticTimingModel
+{
+public:
+  SyntheticTimingModel(uint32_t numArms, uint64_t seed, const SyntheticTimingSettings& settings = {});
+
+  double sample(int arm);
+  double meanOf(int arm) const { return m_means[arm]; }
+  int    fastestArm() const { return m_fastest; }
+
+private:
+  SyntheticTimingSettings m_settings;
+  std::vector<double>     m_means;
+  int                     m_fastest{0};
+  std::mt19937_64         m_rng;
+};
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "camera_path.hpp"
+
+
+bool CameraPath::load(const std::string& filename)
+{
+  std::ifstream in(filename);
+  if(!in)
+    return false;
+
+  std::vector<CameraKey> keys;
+  std::string            line;
+  while(std::getline(in, line))
+  {
+    if(line.empty() || line[0] == '#')
+      continue;
+    std::istringstream fields(line);
+    CameraKey          k;
+    fields >> k.eye.x >> k.eye.y >> k.eye.z >> k.center.x >> k.center.y >> k.center.z >> k.up.x >> k.up.y >> k.up.z >> k.fov;
+    if(fields.fail())
+      return false;
+    keys.push_back(k);
+  }
+  m_keys = std::move(keys);
+  return true;
+}
+
+bool CameraPath::save(const std::string& filename) const
+{
+  std::ofstream out(filename, std::ios::trunc);
+  if(!out)
+    return false;
+  out << "# eye.xyz center.xyz up.xyz fov\n";
+  out.precision(9);
+  for(const CameraKey& k : m_keys)
+    out << k.eye.x << " " << k.eye.y << " " << k.eye.z << " " << k.center.x << " " << k.center.y << " " << k.center.z
+        << " " << k.up.x << " " << k.up.y << " " << k.up.z << " " << k.fov << "\n";
+  return bool(out);
+}
+
+const CameraKey& CameraPath::keyOfFrame(uint32_t frame, uint32_t numFrames) const
+{
+  static const CameraKey kNone;
+  if(m_keys.empty())
+    return kNone;
+  if(numFrames == 0)
+    return m_keys.front();
+  size_t index = size_t(uint64_t(frame) * m_keys.size() / numFrames);
+  return m_keys[std::min(index, m_keys.size() - 1)];
+}
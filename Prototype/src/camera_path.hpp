@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+//--------------------------------------------------------------------------------------------------
+// A camera path for the benchmarks: one camera per key, replayed the same way for every
+// configuration
+//
+// - Recorded from CameraManip in the application, one key per frame while
+//   SampleExample::recordingCameraPath is set (updateFrame(), "Record camera path" in the GUI),
+//   or built from the tour of the sorting grid training (SampleExample::gridTourPath)
+// - Text file, one key per line: eye.xyz center.xyz up.xyz fov (degrees). Lines starting with #
+//   are comments.
+// - keyOfFrame() spreads the keys evenly over the measured frames: every configuration sees the
+//   whole path, whatever the number of frames
+//
+// No Vulkan dependency.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+
+struct CameraKey
+{
+  glm::vec3 eye{0.0f};
+  glm::vec3 center{0.0f, 0.0f, -1.0f};
+  glm::vec3 up{0.0f, 1.0f, 0.0f};
+  float     fov{60.0f};
+};
+
+class CameraPath
+{
+public:
+  void clear() { m_keys.clear(); }
+  void add(const CameraKey& key) { m_keys.push_back(key); }
+
+  bool load(const std::string& filename);
+  bool save(const std::string& filename) const;
+
+  bool                          empty() const { return m_keys.empty(); }
+  size_t                        size() const { return m_keys.size(); }
+  const std::vector<CameraKey>& keys() const { return m_keys; }
+
+  // Key of the measured frame `frame` of `numFrames`
+  const CameraKey& keyOfFrame(uint32_t frame, uint32_t numFrames) const;
+
+private:
+  std::vector<CameraKey> m_keys;
+};
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <algorithm>
+#include <cmath>
+
+#include "frame_stats.hpp"
+
+
+// Two-sided 95% quantile of Student's t with `df` degrees of freedom
+static double studentT95(uint32_t df)
+{
+  static const double kTable[30] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                    2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                    2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+  if(df == 0)
+    return 0.0;
+  if(df <= 30)
+    return kTable[df - 1];
+  // Within 0.5% of the exact value above 30
+  return 1.96 + 2.4 / double(df);
+}
+
+double framePercentile(const std::vector<double>& sortedMs, double p)
+{
+  if(sortedMs.empty())
+    return 0.0;
+  double rank  = std::clamp(p, 0.0, 1.0) * double(sortedMs.size() - 1);
+  size_t below = size_t(rank);
+  size_t above = std::min(below + 1, sortedMs.size() - 1);
+  double t     = rank - double(below);
+  return sortedMs[below] + (sortedMs[above] - sortedMs[below]) * t;
+}
+
+FrameStats summarizeFrameTimes(std::vector<double>& timesMs)
+{
+  FrameStats s;
+  if(timesMs.empty())
+    return s;
+
+  s.medianOfMeansMs = medianOfMeans(timesMs, 5);
+  std::sort(timesMs.begin(), timesMs.end());
+  size_t n = timesMs.size();
+  s.count  = uint32_t(n);
+  s.minMs  = timesMs.front();
+  s.maxMs  = timesMs.back();
+
+  double sum = 0.0;
+  for(double t : timesMs)
+    sum += t;
+  s.meanMs = sum / double(n);
+  double squares = 0.0;
+  for(double t : timesMs)
+    squares += (t - s.meanMs) * (t - s.meanMs);
+  s.stddevMs = n > 1 ? std::sqrt(squares / double(n - 1)) : 0.0;
+
+  s.medianMs = framePercentile(timesMs, 0.5);
+  s.p95Ms    = framePercentile(timesMs, 0.95);
+  s.p99Ms    = framePercentile(timesMs, 0.99);
+
+  double halfWidth = studentT95(uint32_t(n - 1)) * s.stddevMs / std::sqrt(double(n));
+  s.meanCiLowMs    = s.meanMs - halfWidth;
+  s.meanCiHighMs   = s.meanMs + halfWidth;
+
+  // Ranks n/2 -+ 1.96 sqrt(n)/2, 1-based
+  double spread    = 0.98 * std::sqrt(double(n));
+  size_t low       = size_t(std::max(1.0, std::floor(double(n) / 2.0 - spread)));
+  size_t high      = size_t(std::min(double(n), std::ceil(double(n) / 2.0 + 1.0 + spread)));
+  s.medianCiLowMs  = timesMs[low - 1];
+  s.medianCiHighMs = timesMs[high - 1];
+
+  s.trimmedMeanMs = trimmedMean(timesMs, 0.1);
+  double limit    = outlierThreshold(timesMs, kDefaultOutlierMads);
+  s.outliers      = uint32_t(timesMs.end() - std::upper_bound(timesMs.begin(), timesMs.end(), limit));
+  return s;
+}
+
+double trimmedMean(const std::vector<double>& sortedMs, double fraction)
+{
+  if(sortedMs.empty())
+    return 0.0;
+  size_t n    = sortedMs.size();
+  size_t trim = std::min(size_t(std::clamp(fraction, 0.0, 0.5) * double(n)), (n - 1) / 2);
+  double sum  = 0.0;
+  for(size_t i = trim; i < n - trim; i++)
+    sum += sortedMs[i];
+  return sum / double(n - 2 * trim);
+}
+
+double medianOfMeans(const std::vector<double>& timesMs, uint32_t numGroups)
+{
+  if(timesMs.empty())
+    return 0.0;
+  size_t n      = timesMs.size();
+  size_t groups = std::clamp(size_t(numGroups), size_t(1), n);
+
+  // Group g holds [g n / groups, (g + 1) n / groups)
+  std::vector<double> means(groups);
+  for(size_t g = 0; g < groups; g++)
+  {
+    size_t first = g * n / groups;
+    size_t last  = (g + 1) * n / groups;
+    double sum   = 0.0;
+    for(size_t i = first; i < last; i++)
+      sum += timesMs[i];
+    means[g] = sum / double(last - first);
+  }
+  std::sort(means.begin(), means.end());
+  return framePercentile(means, 0.5);
+}
+
+double outlierThreshold(const std::vector<double>& sortedMs, float outlierMads)
+{
+  if(sortedMs.size() < 3 || outlierMads <= 0.0f)
+    return INFINITY;
+  double              median = framePercentile(sortedMs, 0.5);
+  std::vector<double> deviations(sortedMs.size());
+  for(size_t i = 0; i < sortedMs.size(); i++)
+    deviations[i] = std::abs(sortedMs[i] - median);
+  std::sort(deviations.begin(), deviations.end());
+  double mad = framePercentile(deviations, 0.5);
+  if(mad <= 0.0)
+    return INFINITY;
+  return median + double(outlierMads) * 1.4826 * mad;
+}
+
+SteadyStateEstimate estimateSteadyState(const std::vector<double>& timesMs, const SteadyStateSettings& settings,
+                                        std::vector<double>& scratch)
+{
+  SteadyStateEstimate e;
+  if(timesMs.empty())
+    return e;
+
+  scratch.assign(timesMs.begin(), timesMs.end());
+  std::sort(scratch.begin(), scratch.end());
+  double limit = outlierThreshold(scratch, settings.outlierMads);
+
+  // The median of means needs the measured order
+  if(settings.aggregate == eAggregateMedianOfMeans)
+  {
+    scratch.clear();
+    for(double t : timesMs)
+    {
+      if(t <= limit)
+        scratch.push_back(t);
+    }
+  }
+  else
+  {
+    scratch.erase(std::upper_bound(scratch.begin(), scratch.end(), limit), scratch.end());
+  }
+  e.used     = uint32_t(scratch.size());
+  e.outliers = uint32_t(timesMs.size() - scratch.size());
+
+  switch(settings.aggregate)
+  {
+    case eAggregateMean: {
+      double sum = 0.0;
+      for(double t : scratch)
+        sum += t;
+      e.ms = sum / double(scratch.size());
+      break;
+    }
+    case eAggregateTrimmedMean:
+      e.ms = trimmedMean(scratch, settings.trimFraction);
+      break;
+    case eAggregateMedianOfMeans:
+      e.ms = medianOfMeans(scratch, settings.numGroups);
+      break;
+  }
+  return e;
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+//--------------------------------------------------------------------------------------------------
+// Summary of a series of frame times, for the benchmark reports
+//
+// - Percentiles interpolate linearly between the order statistics (p = 0.5 is the usual median)
+// - 95% confidence intervals: of the mean from Student's t, of the median from the order
+//   statistics (binomial, normal approximation). The median one makes no assumption on the
+//   distribution, frame times have a long tail.
+// - Outliers are the hitches: slower than the median by more than `outlierMads` scaled median
+//   absolute deviations (1.4826 MAD, the standard deviation of a normal distribution). Only the
+//   slow side, a frame is never faster than the GPU allows.
+// - Steady state (the tuner): the outliers removed, then the mean, a trimmed mean or the median
+//   of the means of consecutive groups
+//
+// No Vulkan dependency.
+
+#include <cstdint>
+#include <vector>
+
+
+struct FrameStats
+{
+  uint32_t count{0};
+  double   meanMs{0.0};
+  double   stddevMs{0.0};  // Sample standard deviation
+  double   minMs{0.0};
+  double   maxMs{0.0};
+  double   medianMs{0.0};
+  double   p95Ms{0.0};
+  double   p99Ms{0.0};
+  double   meanCiLowMs{0.0};  // 95% confidence intervals
+  double   meanCiHighMs{0.0};
+  double   medianCiLowMs{0.0};
+  double   medianCiHighMs{0.0};
+  double   trimmedMeanMs{0.0};    // 10% trimmed on each side
+  double   medianOfMeansMs{0.0};  // Of 5 groups in the measured order
+  uint32_t outliers{0};           // Beyond kDefaultOutlierMads
+};
+
+static constexpr float kDefaultOutlierMads = 5.0f;
+
+enum FrameAggregate
+{
+  eAggregateMean,
+  eAggregateTrimmedMean,
+  eAggregateMedianOfMeans,
+};
+
+struct SteadyStateSettings
+{
+  uint32_t       warmupFrames{8};  // Discarded after each pipeline switch
+  FrameAggregate aggregate{eAggregateMedianOfMeans};
+  float          trimFraction{0.1f};  // Of each side, eAggregateTrimmedMean
+  uint32_t       numGroups{5};        // eAggregateMedianOfMeans
+  float          outlierMads{kDefaultOutlierMads};
+};
+
+struct SteadyStateEstimate
+{
+  double   ms{0.0};
+  uint32_t used{0};      // Frames in the estimate
+  uint32_t outliers{0};  // Removed
+};
+
+// `sortedMs` in ascending order, p in [0, 1]
+double framePercentile(const std::vector<double>& sortedMs, double p);
+
+// Sorts `timesMs`
+FrameStats summarizeFrameTimes(std::vector<double>& timesMs);
+
+// `sortedMs` in ascending order, `fraction` of each side left out
+double trimmedMean(const std::vector<double>& sortedMs, double fraction);
+// `timesMs` in the measured order, split into `numGroups` consecutive groups
+double medianOfMeans(const std::vector<double>& timesMs, uint32_t numGroups);
+// Threshold of the outliers of `sortedMs`, infinite when there is no spread
+double outlierThreshold(const std::vector<double>& sortedMs, float outlierMads);
+
+// `timesMs` in the measured order, `scratch` is reused between the calls
+SteadyStateEstimate estimateSteadyState(const std::vector<double>& timesMs, const SteadyStateSettings& settings,
+                                        std::vector<double>& scratch);
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <algorithm>
+
+#include "gpu_dispatch_timer.hpp"
+
+
+bool GpuDispatchTimer::init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily, uint32_t numSlots)
+{
+  deinit();
+  m_device = device;
+
+  uint32_t count{0};
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, nullptr);
+  std::vector<VkQueueFamilyProperties> families(count);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, families.data());
+  uint32_t validBits = queueFamily < count ? families[queueFamily].timestampValidBits : 0;
+  if(validBits == 0 || numSlots == 0)
+    return false;
+  m_mask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  m_nsPerTick = properties.limits.timestampPeriod;
+
+  VkQueryPoolCreateInfo createInfo{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+  createInfo.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+  createInfo.queryCount = 2 * numSlots;
+  if(vkCreateQueryPool(m_device, &createInfo, nullptr, &m_pool) != VK_SUCCESS)
+  {
+    m_pool = VK_NULL_HANDLE;
+    return false;
+  }
+  m_slots.assign(numSlots, Slot());
+  return true;
+}
+
+void GpuDispatchTimer::deinit()
+{
+  if(m_pool != VK_NULL_HANDLE)
+    vkDestroyQueryPool(m_device, m_pool, nullptr);
+  m_pool = VK_NULL_HANDLE;
+  m_slots.clear();
+}
+
+void GpuDispatchTimer::begin(VkCommandBuffer cmdBuf, uint32_t slot, uint64_t tag)
+{
+  if(!valid() || slot >= m_slots.size())
+    return;
+  // A result that was never collected is lost
+  m_slots[slot] = {tag, m_sequence++, false};
+  vkCmdResetQueryPool(cmdBuf, m_pool, 2 * slot, 2);
+  vkCmdWriteTimestamp(cmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_pool, 2 * slot);
+}
+
+void GpuDispatchTimer::end(VkCommandBuffer cmdBuf, uint32_t slot)
+{
+  if(!valid() || slot >= m_slots.size())
+    return;
+  vkCmdWriteTimestamp(cmdBuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_pool, 2 * slot + 1);
+  m_slots[slot].recorded = true;
+}
+
+void GpuDispatchTimer::collect(std::vector<TimingSample>& samples)
+{
+  m_order.clear();
+  for(Slot& s : m_slots)
+  {
+    if(s.recorded)
+      m_order.push_back(&s);
+  }
+  std::sort(m_order.begin(), m_order.end(), [](const Slot* a, const Slot* b) { return a->sequence < b->sequence; });
+
+  for(Slot* s : m_order)
+  {
+    // Timestamp and availability of both queries
+    uint32_t slot = uint32_t(s - m_slots.data());
+    uint64_t values[4]{};
+    VkResult result = vkGetQueryPoolResults(m_device, m_pool, 2 * slot, 2, sizeof(values), values, 2 * sizeof(uint64_t),
+                                            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if((result != VK_SUCCESS && result != VK_NOT_READY) || values[1] == 0 || values[3] == 0)
+      break;
+    s->recorded = false;
+    samples.push_back({s->tag, uint64_t(double((values[2] - values[0]) & m_mask) * m_nsPerTick)});
+  }
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+//--------------------------------------------------------------------------------------------------
+// TimingSource of the ray tracing dispatch, from GPU timestamps
+//
+// - A pair of timestamps per command buffer (slot) around the dispatch, next to the "Render
+//   Section" of ProfilerVK. The profiler only keeps averages over several frames, they mix the
+//   pipelines around a switch.
+// - collect() reads the slots that are done with VK_QUERY_RESULT_WITH_AVAILABILITY_BIT, never
+//   with a wait, and stops at the first one that is not. Called once the fence of a command
+//   buffer was waited for, its slot is ready.
+// - Render thread only
+//
+
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "timing_source.hpp"
+
+
+class GpuDispatchTimer : public TimingSource
+{
+public:
+  // False when the queue family has no timestamps, begin() and end() do nothing then
+  bool init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily, uint32_t numSlots);
+  void deinit();
+  bool valid() const { return m_pool != VK_NULL_HANDLE; }
+
+  // Around the dispatch recorded in the command buffer of `slot`, outside of a render pass
+  void begin(VkCommandBuffer cmdBuf, uint32_t slot, uint64_t tag);
+  void end(VkCommandBuffer cmdBuf, uint32_t slot);
+
+  void collect(std::vector<TimingSample>& samples) override;
+
+private:
+  struct Slot
+  {
+    uint64_t tag{0};
+    uint64_t sequence{0};  // Recording order
+    bool     recorded{false};
+  };
+
+  VkDevice           m_device{VK_NULL_HANDLE};
+  VkQueryPool        m_pool{VK_NULL_HANDLE};
+  uint64_t           m_mask{0};
+  double             m_nsPerTick{1.0};
+  uint64_t           m_sequence{0};
+  std::vector<Slot>  m_slots;
+  std::vector<Slot*> m_order;  // Scratch of collect()
+};
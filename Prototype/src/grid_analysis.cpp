@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#include "frame_stats.hpp"
+#include "grid_analysis.hpp"
+#include "grid_json.hpp"
+
+
+std::string gridSourceName(const GridSource& source)
+{
+  return "ConfigId v" + std::to_string(source.configIdVersion) + (source.gpuTimed ? ", GPU time" : ", wall-clock time");
+}
+
+void GridAnalysis::addRun(const GridStatsView& run)
+{
+  const glm::ivec3& d = run.header.dimensions;
+  for(uint32_t cell = 0; cell < run.header.numCells; cell++)
+  {
+    GridSideKey key;
+    key.dimensions = d;
+    key.cell       = glm::ivec3(int(cell) % d.x, int(cell) / d.x % d.y, int(cell) / (d.x * d.y));
+    for(key.side = 0; key.side < run.header.numSides; key.side++)
+    {
+      for(uint32_t config = 0; config < run.header.numConfigs; config++)
+      {
+        const GridStatsEntry& e = run.entry(cell, key.side, config);
+        if(e.cycles == 0)
+          continue;
+        // A legacy key of a newer file is still a legacy key
+        key.source.configIdVersion = uint32_t(run.configs[config] >> 56);
+        key.source.gpuTimed        = e.frames > 0 && e.gpuMs > 0.0f;
+        double ms = key.source.gpuTimed ? double(e.gpuMs) / double(e.frames) : e.fps > 0.0f ? 1000.0 / e.fps : 0.0;
+        if(ms > 0.0)
+          m_sides[key][run.configs[config]].push_back(ms);
+      }
+    }
+  }
+  m_numRuns++;
+}
+
+void GridAnalysis::merge(const GridAnalysis& other)
+{
+  for(const auto& [key, configs] : other.m_sides)
+  {
+    GridConfigSamples& mine = m_sides[key];
+    for(const auto& [config, samples] : configs)
+    {
+      std::vector<double>& target = mine[config];
+      target.insert(target.end(), samples.begin(), samples.end());
+    }
+  }
+  m_numRuns += other.m_numRuns;
+}
+
+std::vector<GridSource> GridAnalysis::sources() const
+{
+  // The keys are ordered by source first
+  std::vector<GridSource> result;
+  for(const auto& [key, configs] : m_sides)
+  {
+    if(result.empty() || !(result.back() == key.source))
+      result.push_back(key.source);
+  }
+  return result;
+}
+
+size_t GridAnalysis::numSides(const GridSource& source) const
+{
+  size_t count = 0;
+  for(const auto& [key, configs] : m_sides)
+    count += key.source == source;
+  return count;
+}
+
+bool loadGridRun(const std::string& filename, GridStats& stats, float windowMs, std::string& error)
+{
+  if(filename.size() > 6 && filename.compare(filename.size() - 6, 6, ".kgrid") == 0)
+  {
+    GridStatsFile file;
+    if(!file.open(filename))
+    {
+      error = file.error();
+      return false;
+    }
+    const GridStatsView& view = file.view();
+    stats                     = GridStats();
+    stats.dimensions          = view.header.dimensions;
+    stats.configIdVersion     = view.header.configIdVersion;
+    stats.configs.assign(view.configs, view.configs + view.header.numConfigs);
+    stats.entries.assign(view.entries, view.entries + size_t(view.header.numCells) * view.header.numSides * view.header.numConfigs);
+    return true;
+  }
+
+  std::ifstream in(filename);
+  if(!in)
+  {
+    error = "cannot open " + filename;
+    return false;
+  }
+  nlohmann::json js = nlohmann::json::parse(in, nullptr, false);
+  if(js.is_discarded() || !gridStatsFromJson(js, stats, windowMs))
+  {
+    error = filename + " is not a sorting grid";
+    return false;
+  }
+  return true;
+}
+
+GridConfigSummary summarizeGridConfig(ConfigId config, const std::vector<double>& samplesMs)
+{
+  std::vector<double> times = samplesMs;
+  FrameStats          stats = summarizeFrameTimes(times);
+  GridConfigSummary   s;
+  s.config   = config;
+  s.runs     = stats.count;
+  s.meanMs   = stats.meanMs;
+  s.ciLowMs  = stats.meanCiLowMs;
+  s.ciHighMs = stats.meanCiHighMs;
+  return s;
+}
+
+std::vector<GridSideSummary> summarizeGridSides(const GridAnalysis& analysis, const GridSource& source)
+{
+  std::vector<GridSideSummary> result;
+  for(const auto& [key, configs] : analysis.sides())
+  {
+    if(!(key.source == source))
+      continue;
+    GridSideSummary side;
+    side.key        = key;
+    side.numConfigs = uint32_t(configs.size());
+    for(const auto& [config, samples] : configs)
+    {
+      GridConfigSummary s = summarizeGridConfig(config, samples);
+      if(side.best.runs == 0 || s.meanMs < side.best.meanMs)
+      {
+        side.runnerUp = side.best;
+        side.best     = s;
+      }
+      else if(side.runnerUp.runs == 0 || s.meanMs < side.runnerUp.meanMs)
+        side.runnerUp = s;
+    }
+    // A single run has no interval
+    side.separated = side.runnerUp.runs > 1 && side.best.runs > 1 && side.best.ciHighMs < side.runnerUp.ciLowMs;
+    result.push_back(side);
+  }
+  return result;
+}
+
+static double meanOf(const std::vector<double>& samples)
+{
+  double sum = 0.0;
+  for(double s : samples)
+    sum += s;
+  return sum / double(samples.size());
+}
+
+std::vector<GridConfigRegret> rankGridConfigs(const GridAnalysis& analysis, const GridSource& source, double minCoverage)
+{
+  std::map<ConfigId, GridConfigRegret> regrets;
+  for(const auto& [key, configs] : analysis.sides())
+  {
+    if(!(key.source == source))
+      continue;
+    ConfigId best   = 0;
+    double   bestMs = INFINITY;
+    for(const auto& [config, samples] : configs)
+    {
+      double ms = meanOf(samples);
+      if(ms < bestMs)
+      {
+        best   = config;
+        bestMs = ms;
+      }
+    }
+    for(const auto& [config, samples] : configs)
+    {
+      double            regret = meanOf(samples) / bestMs - 1.0;
+      GridConfigRegret& r      = regrets[config];
+      r.source                 = source;
+      r.config                 = config;
+      r.sides++;
+      r.best += config == best;
+      r.meanRegret += regret;
+      r.maxRegret = std::max(r.maxRegret, regret);
+    }
+  }
+
+  std::vector<GridConfigRegret> result;
+  double                        numSides = double(analysis.numSides(source));
+  for(auto& [config, r] : regrets)
+  {
+    if(double(r.sides) < minCoverage * numSides)
+      continue;
+    r.meanRegret /= double(r.sides);
+    result.push_back(r);
+  }
+  // Measured on more cube sides first among equals
+  std::sort(result.begin(), result.end(), [](const GridConfigRegret& a, const GridConfigRegret& b) {
+    return a.meanRegret != b.meanRegret ? a.meanRegret < b.meanRegret : a.sides > b.sides;
+  });
+  return result;
+}
+
+// Bits 56-63 are the version
+static constexpr uint32_t kConfigIdFeatureBits = 56;
+static constexpr uint32_t kConfigIdFlagBits    = 8;
+
+std::vector<GridBitImportance> gridBitImportance(const GridAnalysis& analysis, const GridSource& source)
+{
+  // The legacy IDs only have the sorting flags
+  uint32_t                       numBits = source.configIdVersion == 0 ? kConfigIdFlagBits : kConfigIdFeatureBits;
+  std::vector<GridBitImportance> bits(numBits);
+  for(uint32_t b = 0; b < numBits; b++)
+  {
+    bits[b].source = source;
+    bits[b].bit    = b;
+  }
+
+  for(const auto& [key, configs] : analysis.sides())
+  {
+    if(!(key.source == source))
+      continue;
+    for(uint32_t b = 0; b < numBits; b++)
+    {
+      double   sum[2]   = {0.0, 0.0};
+      uint32_t count[2] = {0, 0};
+      for(const auto& [config, samples] : configs)
+      {
+        uint32_t set = uint32_t(config >> b) & 1;
+        sum[set] += std::log(meanOf(samples));
+        count[set]++;
+      }
+      if(count[0] == 0 || count[1] == 0)
+        continue;
+      double ratio = sum[1] / double(count[1]) - sum[0] / double(count[0]);
+      bits[b].sides++;
+      bits[b].faster += ratio < 0.0;
+      bits[b].meanLogRatio += ratio;
+    }
+  }
+
+  std::vector<GridBitImportance> result;
+  for(GridBitImportance& b : bits)
+  {
+    if(b.sides == 0)
+      continue;
+    b.meanLogRatio /= double(b.sides);
+    result.push_back(b);
+  }
+  std::sort(result.begin(), result.end(), [](const GridBitImportance& a, const GridBitImportance& b) {
+    return std::abs(a.meanLogRatio) > std::abs(b.meanLogRatio);
+  });
+  return result;
+}
+
+std::string configIdBitName(uint32_t bit)
+{
+  static const char* kFlagNames[8] = {"noSort",       "afterTraversal",    "hitObject",    "rayOrigin",
+                                      "rayDirection", "estimatedEndpoint", "realEndpoint", "isFinished"};
+  struct Field
+  {
+    const char* name;
+    uint32_t    first;
+    uint32_t    count;
+  };
+  static const Field kFields[] = {{"coherenceBits", 8, 7}, {"origin", 15, 6}, {"direction", 21, 6}, {"endpoint", 27, 6},
+                                  {"finished", 33, 1},     {"mode", 34, 4},   {"anyhit", 38, 1},    {"profiling", 39, 1},
+                                  {"version", 56, 8}};
+  if(bit < 8)
+    return kFlagNames[bit];
+  for(const Field& f : kFields)
+  {
+    if(bit >= f.first && bit < f.first + f.count)
+      return f.count == 1 ? std::string(f.name) : std::string(f.name) + "[" + std::to_string(bit - f.first) + "]";
+  }
+  return "bit " + std::to_string(bit);
+}
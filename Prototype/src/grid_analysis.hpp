@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+//--------------------------------------------------------------------------------------------------
+// Statistics of the sorting grid across runs, for the offline reports (tools/grid_report.cpp)
+//
+// - A run is one saved grid (GridStats). Each measured (cell, cube side, configuration) of a run
+//   adds one sample, the mean time of a dispatch or of a frame. The cells are matched by the grid
+//   dimensions and their coordinates: a cell of another grid covers another part of the scene,
+//   runs of other dimensions are never merged.
+// - The samples are partitioned by source (GridSource): the version of the ConfigId and the
+//   time the entry was measured with. Legacy runs store wall-clock 1000/fps under flag-only IDs,
+//   version 1 runs the GPU time under full ConfigIds: neither the times nor the IDs compare, all
+//   the statistics below are of a single source.
+// - Best configuration per cube side: the lowest mean over the runs, with the 95% confidence
+//   interval of the mean (frame_stats.hpp). It is separated when its interval ends below the one
+//   of the runner-up.
+// - Regret of a configuration: its mean over the best mean of the cube side, minus 1, averaged
+//   over the cube sides it was measured on. The configuration of least regret is the one to use
+//   when a single pipeline has to do for the whole scene. A configuration measured on a few cube
+//   sides only is not ranked, its regret is not comparable.
+// - Importance of a ConfigId bit: within a cube side, the mean log time of the configurations with
+//   the bit set minus the one of those without, averaged over the cube sides that have both.
+//   Negative is faster with the bit. Bits above the sorting flags are only compared for the
+//   sources of version 1 or later, the legacy IDs do not know them.
+//
+// No Vulkan dependency.
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include "grid_stats.hpp"
+#include "pipeline_config.hpp"
+
+
+struct GridSource
+{
+  uint32_t configIdVersion{0};  // Of the ConfigId, 0 for the flag-only IDs of the legacy grids
+  bool     gpuTimed{false};     // GPU time of the dispatches, else wall-clock 1000/fps
+
+  bool operator==(const GridSource& other) const
+  {
+    return configIdVersion == other.configIdVersion && gpuTimed == other.gpuTimed;
+  }
+  bool operator<(const GridSource& other) const
+  {
+    return configIdVersion != other.configIdVersion ? configIdVersion < other.configIdVersion : gpuTimed < other.gpuTimed;
+  }
+};
+
+// "ConfigId v1, GPU time"
+std::string gridSourceName(const GridSource& source);
+
+struct GridSideKey
+{
+  GridSource source;
+  glm::ivec3 dimensions{0};  // Of the grid
+  glm::ivec3 cell{0};
+  uint32_t   side{0};
+
+  bool operator<(const GridSideKey& other) const
+  {
+    if(!(source == other.source))
+      return source < other.source;
+    for(int a = 0; a < 3; a++)
+    {
+      if(dimensions[a] != other.dimensions[a])
+        return dimensions[a] < other.dimensions[a];
+    }
+    if(cell.x != other.cell.x)
+      return cell.x < other.cell.x;
+    if(cell.y != other.cell.y)
+      return cell.y < other.cell.y;
+    if(cell.z != other.cell.z)
+      return cell.z < other.cell.z;
+    return side < other.side;
+  }
+};
+
+// Milliseconds per dispatch, one sample per run
+using GridConfigSamples = std::map<ConfigId, std::vector<double>>;
+
+class GridAnalysis
+{
+public:
+  void addRun(const GridStatsView& run);
+  // Adds the runs of `other`, the loaders merge their partial analyses
+  void merge(const GridAnalysis& other);
+
+  uint32_t                                        numRuns() const { return m_numRuns; }
+  const std::map<GridSideKey, GridConfigSamples>& sides() const { return m_sides; }
+  // Of the samples, in order
+  std::vector<GridSource> sources() const;
+  size_t                  numSides(const GridSource& source) const;
+
+private:
+  std::map<GridSideKey, GridConfigSamples> m_sides;
+  uint32_t                                 m_numRuns{0};
+};
+
+// A .kgrid file, or a JSON file of any layout of parseSavedGrid() whose rates count as windows of
+// `windowMs`
+bool loadGridRun(const std::string& filename, GridStats& stats, float windowMs, std::string& error);
+
+struct GridConfigSummary
+{
+  ConfigId config{0};
+  uint32_t runs{0};
+  double   meanMs{0.0};
+  double   ciLowMs{0.0};  // 95%, none with a single run (the mean itself)
+  double   ciHighMs{0.0};
+};
+
+struct GridSideSummary
+{
+  GridSideKey       key;
+  uint32_t          numConfigs{0};
+  GridConfigSummary best;
+  GridConfigSummary runnerUp;  // runs 0 when a single configuration was measured
+  bool              separated{false};
+};
+
+struct GridConfigRegret
+{
+  GridSource source;
+  ConfigId   config{0};
+  uint32_t   sides{0};  // Measured on
+  uint32_t   best{0};   // Sides it is the best of
+  double     meanRegret{0.0};
+  double     maxRegret{0.0};
+};
+
+struct GridBitImportance
+{
+  GridSource source;
+  uint32_t   bit{0};
+  uint32_t   sides{0};           // With configurations on both sides of the bit
+  uint32_t   faster{0};          // Sides where the bit set is faster
+  double     meanLogRatio{0.0};  // exp() - 1 is the relative change of the time
+};
+
+GridConfigSummary summarizeGridConfig(ConfigId config, const std::vector<double>& samplesMs);
+// The cube sides of `source`, in the order of the keys
+std::vector<GridSideSummary> summarizeGridSides(const GridAnalysis& analysis, const GridSource& source);
+// Least mean regret first, the configurations measured on at least `minCoverage` of the cube sides
+// of `source`
+std::vector<GridConfigRegret> rankGridConfigs(const GridAnalysis& analysis, const GridSource& source, double minCoverage = 0.25);
+// The bits compared on at least one cube side of `source`, the largest effect first
+std::vector<GridBitImportance> gridBitImportance(const GridAnalysis& analysis, const GridSource& source);
+// Field of the ConfigId layout a bit belongs to, "origin[2]" for the third bit of the origin
+std::string configIdBitName(uint32_t bit);
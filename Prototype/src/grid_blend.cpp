@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <algorithm>
+#include <cmath>
+
+#include "grid_blend.hpp"
+
+
+// Cube sides of the view direction along +x, -x, +y, -y, +z, -z (SampleExample::CubeSide)
+static const uint32_t kAxisSides[3][2] = {{3, 2}, {0, 1}, {4, 5}};
+
+uint32_t gridBlendWeights(const glm::vec3& position, const glm::ivec3& dimensions, const glm::vec3& direction,
+                          GridBlendWeight weights[24])
+{
+  // Cell centers are at integer coordinates after the shift
+  int   base[3];
+  float t[3];
+  for(int a = 0; a < 3; a++)
+  {
+    float p = std::clamp(position[a] - 0.5f, 0.0f, float(dimensions[a] - 1));
+    base[a] = std::min(int(std::floor(p)), dimensions[a] - 1);
+    t[a]    = p - float(base[a]);
+  }
+
+  float    length = std::sqrt(glm::dot(direction, direction));
+  uint32_t count  = 0;
+  for(uint32_t corner = 0; corner < 8; corner++)
+  {
+    int   cell[3];
+    float cellWeight = 1.0f;
+    for(int a = 0; a < 3; a++)
+    {
+      int upper  = (corner >> a) & 1;
+      cell[a]    = std::min(base[a] + upper, dimensions[a] - 1);
+      cellWeight *= upper ? t[a] : 1.0f - t[a];
+    }
+    if(cellWeight <= 0.0f)
+      continue;
+    uint32_t index = uint32_t((cell[2] * dimensions.y + cell[1]) * dimensions.x + cell[0]);
+    for(int a = 0; a < 3; a++)
+    {
+      float c          = length > 0.0f ? direction[a] / length : (a == 2 ? 1.0f : 0.0f);
+      float sideWeight = c * c;
+      if(sideWeight <= 0.0f)
+        continue;
+      weights[count++] = {index, kAxisSides[a][c < 0.0f], cellWeight * sideWeight};
+    }
+  }
+  return count;
+}
+
+GridBlendResult GridBlender::select(const SortingGridTable& table, const glm::vec3& position, const glm::ivec3& dimensions,
+                                    const glm::vec3& direction)
+{
+  GridBlendResult result;
+  if(table.numCells() != uint32_t(dimensions.x * dimensions.y * dimensions.z) || table.numConfigs() == 0)
+    return result;
+
+  GridBlendWeight weights[24];
+  uint32_t        numWeights = gridBlendWeights(position, dimensions, direction, weights);
+  m_slowdown.assign(table.numConfigs(), 0.0);
+  m_weight.assign(table.numConfigs(), 0.0);
+  double measuredWeight = 0.0;
+  for(uint32_t i = 0; i < numWeights; i++)
+  {
+    const GridBlendWeight& w = weights[i];
+    if(!table.measured(w.cell) || table.bestConfig(w.cell, w.side) < 0)
+      continue;
+    float fastest = table.bestFps(w.cell, w.side);
+    for(uint32_t config = 0; config < table.numConfigs(); config++)
+    {
+      float fps = table.fps(w.cell, w.side, config);
+      if(fps <= 0.0f)
+        continue;
+      m_slowdown[config] += double(w.weight) * double(fastest / fps);
+      m_weight[config] += double(w.weight);
+    }
+    measuredWeight += double(w.weight);
+    result.measured++;
+  }
+  if(result.measured == 0)
+    return result;
+
+  // Expected slowdown, infinite when the configuration is not covered enough
+  auto expected = [&](int config) {
+    return config >= 0 && m_weight[config] >= double(settings.minCoverage) * measuredWeight ?
+               m_slowdown[config] / m_weight[config] :
+               INFINITY;
+  };
+  int    best         = -1;
+  double bestSlowdown = INFINITY;
+  for(uint32_t config = 0; config < table.numConfigs(); config++)
+  {
+    double s = expected(int(config));
+    if(s < bestSlowdown)
+    {
+      best         = int(config);
+      bestSlowdown = s;
+    }
+  }
+  if(best < 0)
+    return result;
+
+  double current = m_current < int(table.numConfigs()) ? expected(m_current) : INFINITY;
+  if(best != m_current && current < INFINITY && bestSlowdown > current * (1.0 - double(settings.hysteresis)))
+  {
+    best         = m_current;
+    bestSlowdown = current;
+    result.kept  = true;
+  }
+  m_current       = best;
+  result.config   = best;
+  result.slowdown = float(bestSlowdown);
+  return result;
+}
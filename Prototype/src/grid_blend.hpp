@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+//--------------------------------------------------------------------------------------------------
+// Choice of the configuration between the cells and cube sides of the sorting grid
+//
+// The camera takes the measurements of the cells and cube sides around it instead of those of the
+// one cell and side it is in:
+// - The 8 cells whose centers surround the camera, trilinear weights. At the border of the grid
+//   the missing neighbours are the border cells again.
+// - The 3 cube sides the view direction faces, weighted by the squared cosine of the angle to
+//   their normal (the weights sum to 1)
+// - A configuration's expected slowdown is the weighted mean, over the (cell, side) it was
+//   measured on, of its time over the fastest time of that (cell, side). The ratio compares the
+//   configurations across cells of different cost. A configuration measured on less than
+//   `minCoverage` of the weight of the measured (cell, side) is not chosen.
+// - Hysteresis: the configuration chosen before is kept until another one is expected to be
+//   faster by `hysteresis`, a camera moving along a boundary does not switch back and forth
+//   (tools/grid_blend_sim.cpp counts the switches on a synthetic grid)
+//
+// No Vulkan dependency.
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include "grid_table.hpp"
+
+
+struct GridBlendSettings
+{
+  float minCoverage{0.5f};
+  float hysteresis{0.03f};  // Relative
+};
+
+struct GridBlendWeight
+{
+  uint32_t cell{0};
+  uint32_t side{0};
+  float    weight{0.0f};
+};
+
+struct GridBlendResult
+{
+  int      config{-1};      // -1 when nothing around the camera was measured
+  float    slowdown{0.0f};  // Expected, 1 is the fastest on every (cell, side)
+  uint32_t measured{0};     // (cell, side) with measurements
+  bool     kept{false};     // By the hysteresis
+};
+
+// `position` in cells, (0, 0, 0) the minimum corner of the grid, `direction` the view direction.
+// Returns the number of weights written to `weights`, at most 24.
+uint32_t gridBlendWeights(const glm::vec3& position, const glm::ivec3& dimensions, const glm::vec3& direction,
+                          GridBlendWeight weights[24]);
+
+class GridBlender
+{
+public:
+  GridBlendSettings settings;
+
+  // The configuration to use at the camera, cell order as SortingGridTable
+  GridBlendResult select(const SortingGridTable& table, const glm::vec3& position, const glm::ivec3& dimensions,
+                         const glm::vec3& direction);
+  // Forgets the configuration chosen before
+  void reset() { m_current = -1; }
+
+private:
+  int                 m_current{-1};
+  std::vector<double> m_slowdown;  // Per config, weighted sum
+  std::vector<double> m_weight;
+};
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <algorithm>
+#include <cstdio>
+#include <unordered_map>
+
+#include "grid_json.hpp"
+
+
+// A ConfigId has 16 hex digits, a legacy key is the decimal sorting flags
+static bool parseSavedKey(const nlohmann::json& key, SavedGridEntry& entry)
+{
+  if(key.is_number_unsigned() || key.is_number_integer())
+  {
+    int64_t flags = key.get<int64_t>();
+    entry.legacy  = true;
+    entry.key     = ConfigId(flags);
+    return flags >= 0 && flags < eSortingNumFlagSets;
+  }
+  if(!key.is_string())
+    return false;
+
+  std::string text = key.get<std::string>();
+  std::string hex  = text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X') ? text.substr(2) : text;
+  if(hex.size() == 16)
+  {
+    entry.legacy = false;
+    return parseConfigId(hex, entry.key);
+  }
+  if(text.empty() || text.size() > 3 || text.find_first_not_of("0123456789") != std::string::npos)
+    return false;
+  entry.legacy = true;
+  entry.key    = ConfigId(std::stoul(text));
+  return entry.key < eSortingNumFlagSets;
+}
+
+static void parseSavedSide(const nlohmann::json& value, SavedGridEntry entry, SavedGrid& grid)
+{
+  auto add = [&](const nlohmann::json& key, const nlohmann::json& fps) {
+    if(fps.is_number() && parseSavedKey(key, entry))
+    {
+      entry.fps = fps.get<float>();
+      grid.entries.push_back(entry);
+    }
+    else
+      grid.skipped++;
+  };
+
+  // Never measured
+  if(value.is_number())
+    return;
+  if(value.is_array() && value.size() == 2)
+    add(value[0], value[1]);
+  else if(value.is_object() && value.contains("FPS") && value.contains("hashcodes"))
+  {
+    const nlohmann::json& fps  = value["FPS"];
+    const nlohmann::json& keys = value["hashcodes"];
+    if(fps.is_array() && keys.is_array() && fps.size() == keys.size())
+    {
+      for(size_t i = 0; i < keys.size(); i++)
+        add(keys[i], fps[i]);
+    }
+    else
+      add(keys, fps);
+  }
+  else if(value.is_object())
+  {
+    for(auto it = value.begin(); it != value.end(); ++it)
+      add(nlohmann::json(it.key()), it.value());
+  }
+  else
+    grid.skipped++;
+}
+
+bool parseSavedGrid(const nlohmann::json& js, SavedGrid& grid)
+{
+  grid = SavedGrid();
+  const char* kDimensions = "Grid Dimensions (x,y,z)";
+  if(!js.is_object() || !js.contains(kDimensions) || !js[kDimensions].is_array() || js[kDimensions].size() != 3)
+    return false;
+  for(int i = 0; i < 3; i++)
+  {
+    if(!js[kDimensions][i].is_number())
+      return false;
+    grid.dimensions[i] = int(js[kDimensions][i].get<float>());
+  }
+
+  const nlohmann::json& cells = js.contains("Observations") ? js["Observations"] : js;
+  for(auto cell = cells.begin(); cell != cells.end(); ++cell)
+  {
+    if(cell.key() == kDimensions || cell.key() == "ConfigIdVersion")
+      continue;
+    SavedGridEntry entry;
+    char           end = 0;
+    if(sscanf(cell.key().c_str(), "(%d,%d,%d%c", &entry.cell.x, &entry.cell.y, &entry.cell.z, &end) != 4 || end != ')'
+       || !cell.value().is_object())
+    {
+      grid.skipped++;
+      continue;
+    }
+    for(uint32_t side = 0; side < 6; side++)
+    {
+      if(!cell.value().contains(kCubeSideNames[side]))
+        continue;
+      entry.side = side;
+      parseSavedSide(cell.value()[kCubeSideNames[side]], entry, grid);
+    }
+  }
+  return true;
+}
+
+static std::string savedKeyString(ConfigId id)
+{
+  return (id >> 56) == 0 ? std::to_string(id & 0xff) : configIdString(id);
+}
+
+nlohmann::json gridStatsToJson(const GridStatsView& stats)
+{
+  const glm::ivec3& d = stats.header.dimensions;
+  nlohmann::json    js;
+  js["Grid Dimensions (x,y,z)"] = {float(d.x), float(d.y), float(d.z)};
+  js["ConfigIdVersion"]         = stats.header.configIdVersion;
+  for(int x = 0; x < d.x; x++)
+  {
+    for(int y = 0; y < d.y; y++)
+    {
+      for(int z = 0; z < d.z; z++)
+      {
+        std::string name = "(" + std::to_string(x) + "," + std::to_string(y) + "," + std::to_string(z) + ")";
+        uint32_t    cell = uint32_t((z * d.y + y) * d.x + x);
+        for(uint32_t side = 0; side < kGridNumSides; side++)
+        {
+          // 1 when never measured
+          nlohmann::json value = nlohmann::json::object();
+          for(uint32_t config = 0; config < stats.header.numConfigs; config++)
+          {
+            const GridStatsEntry& entry = stats.entry(cell, side, config);
+            if(entry.cycles > 0)
+              value[savedKeyString(stats.configs[config])] = entry.fps;
+          }
+          js[name][kCubeSideNames[side]] = value.empty() ? nlohmann::json(1) : value;
+        }
+      }
+    }
+  }
+  return js;
+}
+
+bool gridStatsFromJson(const nlohmann::json& js, GridStats& stats, float windowMs)
+{
+  SavedGrid saved;
+  if(!parseSavedGrid(js, saved) || glm::any(glm::lessThan(saved.dimensions, glm::ivec3(1)))
+     || glm::any(glm::greaterThan(saved.dimensions, glm::ivec3(kMaxGridDimension))))
+    return false;
+
+  stats            = GridStats();
+  stats.dimensions = saved.dimensions;
+  std::unordered_map<ConfigId, uint32_t> index;
+  // A legacy key is its flags, a ConfigId of version 0
+  for(const SavedGridEntry& entry : saved.entries)
+  {
+    if(index.emplace(entry.key, uint32_t(stats.configs.size())).second)
+      stats.configs.push_back(entry.key);
+  }
+  stats.resize();
+
+  for(const SavedGridEntry& entry : saved.entries)
+  {
+    if(glm::any(glm::lessThan(entry.cell, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(entry.cell, stats.dimensions))
+       || !(entry.fps > 0.0f))
+      continue;
+    uint32_t        cell = uint32_t((entry.cell.z * stats.dimensions.y + entry.cell.y) * stats.dimensions.x + entry.cell.x);
+    GridStatsEntry& e    = stats.entry(cell, entry.side, index[entry.key]);
+    e.frames             = std::max(1u, uint32_t(entry.fps * windowMs / 1000.0f));
+    e.cycles             = 1;
+    e.gpuMs              = entry.legacy ? 0.0f : float(e.frames) * 1000.0f / entry.fps;
+    e.fps                = entry.fps;
+  }
+  return true;
+}
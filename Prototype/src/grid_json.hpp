@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+//--------------------------------------------------------------------------------------------------
+// The JSON files of the sorting grid (Sorting_Grid_Results/*.json), every layout SaveSortingGrid()
+// has written, and their conversion to and from GridStats
+//
+// No Vulkan dependency, shared by the application and the offline tools.
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include "grid_stats.hpp"
+#include "json.hpp"
+#include "pipeline_config.hpp"
+
+
+// Names of the cube sides in the saved grids, in CubeSide order
+inline constexpr const char* kCubeSideNames[6] = {"top", "bottom", "left", "right", "front", "back"};
+
+// One measured parameter set of a cube side in a saved grid (Sorting_Grid_Results/*.json)
+struct SavedGridEntry
+{
+  glm::ivec3 cell{0};
+  uint32_t   side{0};
+  bool       legacy{false};  // `key` is the sorting flags of the files before ConfigId, else a ConfigId
+  ConfigId   key{0};
+  float      fps{0.0f};
+};
+
+struct SavedGrid
+{
+  glm::ivec3                  dimensions{0};
+  std::vector<SavedGridEntry> entries;
+  uint32_t                    skipped{0};  // Cells, keys or values that are none of the layouts
+};
+
+// Every layout SaveSortingGrid() has written: the cells "(x,y,z)" at the top level or under
+// "Observations", per cube side all measured keys {key: fps} or {"FPS": [fps], "hashcodes": [key]},
+// only the best one [key, fps] or {"FPS": fps, "hashcodes": key}, or 1 when it was never measured. The keys are 16 hex digits
+// (configIdString()) or the decimal flags of the legacy files. False without grid dimensions.
+bool parseSavedGrid(const nlohmann::json& js, SavedGrid& grid);
+
+// The layout of SaveSortingGrid() with all measured keys, legacy configurations (ConfigId
+// version 0) keep their decimal flags
+nlohmann::json gridStatsToJson(const GridStatsView& stats);
+// Any layout of parseSavedGrid(), the configurations in the order they appear. A file only holds
+// the rates, each one counts as a window of `windowMs`. The rates of the legacy keys are wall-clock
+// frame rates, not dispatch times: their gpuMs stays 0. False for dimensions beyond
+// kMaxGridDimension.
+bool gridStatsFromJson(const nlohmann::json& js, GridStats& stats, float windowMs);
+
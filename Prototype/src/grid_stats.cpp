@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <type_traits>
+
+#include "grid_stats.hpp"
+
+
+static_assert(std::is_trivially_copyable<GridStatsHeader>::value, "The header is written as is");
+static_assert(sizeof(GridStatsEntry) == 16, "Entries are written as is");
+
+static uint64_t alignUp(uint64_t value)
+{
+  return (value + kGridStatsAlignment - 1) / kGridStatsAlignment * kGridStatsAlignment;
+}
+
+void GridStats::resize()
+{
+  entries.assign(size_t(numCells()) * kGridNumSides * configs.size(), GridStatsEntry());
+}
+
+GridStatsView GridStats::view() const
+{
+  GridStatsView view;
+  std::memcpy(view.header.magic, kGridStatsMagic, sizeof(kGridStatsMagic));
+  view.header.numConfigs      = uint32_t(configs.size());
+  view.header.numCells        = numCells();
+  view.header.dimensions      = dimensions;
+  view.header.configIdVersion = configIdVersion;
+  view.configs                = configs.data();
+  view.entries                = entries.data();
+  return view;
+}
+
+GridStats snapshotGridStats(const SortingGridTable& table, const glm::ivec3& dimensions, const std::vector<ConfigId>& configs)
+{
+  GridStats stats;
+  stats.dimensions = dimensions;
+  stats.configs    = configs;
+  stats.resize();
+  if(table.numCells() != stats.numCells() || table.numConfigs() != configs.size())
+    return stats;
+
+  table.forEachMeasured([&](uint32_t cell, uint32_t side, uint32_t config) {
+    GridStatsEntry& entry = stats.entry(cell, side, config);
+    entry.frames          = table.frames(cell, side, config);
+    entry.cycles          = table.cycles(cell, side, config);
+    entry.gpuMs           = table.gpuMs(cell, side, config);
+    entry.fps             = table.fps(cell, side, config);
+  });
+  return stats;
+}
+
+bool writeGridStats(const std::string& filename, const GridStatsView& stats, std::string& error)
+{
+  GridStatsHeader header = stats.header;
+  std::memcpy(header.magic, kGridStatsMagic, sizeof(kGridStatsMagic));
+  header.version       = kGridStatsVersion;
+  header.headerSize    = sizeof(GridStatsHeader);
+  header.entrySize     = sizeof(GridStatsEntry);
+  header.numSides      = kGridNumSides;
+  header.configsOffset = alignUp(sizeof(GridStatsHeader));
+  header.entriesOffset = alignUp(header.configsOffset + uint64_t(header.numConfigs) * sizeof(ConfigId));
+  uint64_t entryBytes  = uint64_t(header.numCells) * kGridNumSides * header.numConfigs * sizeof(GridStatsEntry);
+  header.fileSize      = header.entriesOffset + entryBytes;
+
+  // Written under another name and renamed, a reader never sees half a file
+  std::string temporary = filename + ".tmp";
+  {
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    if(!out)
+    {
+      error = "cannot write " + temporary;
+      return false;
+    }
+    static const char zeros[kGridStatsAlignment]{};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(zeros, std::streamsize(header.configsOffset - sizeof(header)));
+    out.write(reinterpret_cast<const char*>(stats.configs), std::streamsize(header.numConfigs * sizeof(ConfigId)));
+    out.write(zeros, std::streamsize(header.entriesOffset - header.configsOffset - header.numConfigs * sizeof(ConfigId)));
+    out.write(reinterpret_cast<const char*>(stats.entries), std::streamsize(entryBytes));
+    if(!out)
+    {
+      error = "cannot write " + temporary;
+      return false;
+    }
+  }
+  std::error_code code;
+  std::filesystem::rename(temporary, filename, code);
+  if(code)
+  {
+    error = "cannot rename " + temporary + ": " + code.message();
+    return false;
+  }
+  return true;
+}
+
+bool GridStatsFile::open(const std::string& filename)
+{
+  close();
+  if(!m_file.open(filename))
+    return fail("cannot open " + filename);
+  if(m_file.size() < sizeof(GridStatsHeader))
+    return fail("file too small for a grid statistics header");
+
+  GridStatsHeader& header = m_view.header;
+  std::memcpy(&header, m_file.data(), sizeof(header));
+  if(std::memcmp(header.magic, kGridStatsMagic, sizeof(kGridStatsMagic)) != 0)
+    return fail("not a grid statistics file");
+  if(header.version != kGridStatsVersion)
+    return fail("unsupported grid statistics version " + std::to_string(header.version));
+  if(header.headerSize != sizeof(GridStatsHeader) || header.entrySize != sizeof(GridStatsEntry) || header.numSides != kGridNumSides)
+    return fail("grid statistics written with a different layout");
+  if(glm::any(glm::lessThan(header.dimensions, glm::ivec3(1)))
+     || uint64_t(header.dimensions.x) * header.dimensions.y * header.dimensions.z != header.numCells)
+    return fail("grid statistics dimensions do not match the cells");
+
+  uint64_t entryBytes = uint64_t(header.numCells) * kGridNumSides * header.numConfigs * sizeof(GridStatsEntry);
+  if(header.configsOffset % kGridStatsAlignment != 0 || header.entriesOffset % kGridStatsAlignment != 0
+     || header.configsOffset < sizeof(GridStatsHeader)
+     || header.entriesOffset < header.configsOffset + uint64_t(header.numConfigs) * sizeof(ConfigId)
+     || header.fileSize != header.entriesOffset + entryBytes || m_file.size() < header.fileSize)
+    return fail("truncated or corrupted grid statistics");
+
+  m_view.configs = reinterpret_cast<const ConfigId*>(m_file.data() + header.configsOffset);
+  m_view.entries = reinterpret_cast<const GridStatsEntry*>(m_file.data() + header.entriesOffset);
+  return true;
+}
+
+void GridStatsFile::close()
+{
+  m_file.close();
+  m_view = GridStatsView();
+}
+
+bool GridStatsFile::fail(const std::string& message)
+{
+  close();
+  m_error = message;
+  return false;
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+//--------------------------------------------------------------------------------------------------
+// Binary statistics of a sorting grid (.kgrid), the saved form of SortingGridTable
+//
+// File layout, every block starting on a kGridStatsAlignment boundary:
+//   GridStatsHeader
+//   ConfigId[numConfigs]                              the configurations, in tuner arm order
+//   GridStatsEntry[numCells][numSides][numConfigs]    dense, cell = (z * dimY + y) * dimX + x
+// The reader maps the file and hands out the entries without copying. Written under another
+// name and renamed, a reader never sees half a file.
+//
+// ConfigIds of version 0 are the sorting flags of the legacy JSON files (low 8 bits), their
+// key budget and sorting mode are unknown.
+//
+// No Vulkan dependency. The conversion to and from the JSON layout of SaveSortingGrid() is in
+// grid_json.hpp.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include "grid_table.hpp"
+#include "mapped_file.hpp"
+#include "pipeline_config.hpp"
+
+
+static constexpr char     kGridStatsMagic[8]  = {'K', 'I', 'G', 'R', 'I', 'D', 'S', 'T'};
+static constexpr uint32_t kGridStatsVersion   = 1;
+static constexpr uint64_t kGridStatsAlignment = 64;
+// Largest grid dimension a saved grid may have, SampleExample::MAXGRIDSIZE
+static constexpr int kMaxGridDimension = 64;
+
+struct GridStatsEntry
+{
+  uint32_t frames{0};  // Ray tracing dispatches
+  uint32_t cycles{0};  // Measurement windows, 0 when never measured
+  float    gpuMs{0.0f};
+  float    fps{0.0f};
+};
+
+struct GridStatsHeader
+{
+  char       magic[8]{};
+  uint32_t   version{kGridStatsVersion};
+  uint32_t   headerSize{sizeof(GridStatsHeader)};
+  uint32_t   entrySize{sizeof(GridStatsEntry)};
+  uint32_t   numSides{kGridNumSides};
+  uint32_t   numConfigs{0};
+  uint32_t   numCells{0};
+  glm::ivec3 dimensions{0};
+  uint32_t   configIdVersion{kConfigIdVersion};  // Of the writer
+  uint64_t   configsOffset{0};
+  uint64_t   entriesOffset{0};
+  uint64_t   fileSize{0};
+};
+
+// The header, the configurations and the entries, in a file or in memory
+struct GridStatsView
+{
+  GridStatsHeader       header;
+  const ConfigId*       configs{nullptr};
+  const GridStatsEntry* entries{nullptr};
+
+  const GridStatsEntry& entry(uint32_t cell, uint32_t side, uint32_t config) const
+  {
+    return entries[(size_t(cell) * header.numSides + side) * header.numConfigs + config];
+  }
+};
+
+// In memory: a snapshot of the table (snapshotGridStats) or a converted JSON file
+struct GridStats
+{
+  glm::ivec3                  dimensions{0};
+  uint32_t                    configIdVersion{kConfigIdVersion};
+  std::vector<ConfigId>       configs;
+  std::vector<GridStatsEntry> entries;  // [cell][side][config]
+
+  // Empty entries for the dimensions and configurations
+  void            resize();
+  uint32_t        numCells() const { return uint32_t(dimensions.x * dimensions.y * dimensions.z); }
+  GridStatsEntry& entry(uint32_t cell, uint32_t side, uint32_t config)
+  {
+    return entries[(size_t(cell) * kGridNumSides + side) * configs.size() + config];
+  }
+  GridStatsView view() const;
+};
+
+// `configs[i]` is the configuration of the table's config i (the tuner arm)
+GridStats snapshotGridStats(const SortingGridTable& table, const glm::ivec3& dimensions, const std::vector<ConfigId>& configs);
+
+bool writeGridStats(const std::string& filename, const GridStatsView& stats, std::string& error);
+
+
+//--------------------------------------------------------------------------------------------------
+// Validates the file on open, the view points into the mapping
+//
+class GridStatsFile
+{
+public:
+  bool open(const std::string& filename);
+  void close();
+
+  const GridStatsView& view() const { return m_view; }
+  const std::string&   error() const { return m_error; }
+
+private:
+  bool fail(const std::string& message);
+
+  MappedFile    m_file;
+  GridStatsView m_view;
+  std::string   m_error;
+};
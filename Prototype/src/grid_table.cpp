@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <algorithm>
+
+#include "grid_table.hpp"
+
+
+void SortingGridTable::reset(uint32_t numCells, uint32_t numConfigs)
+{
+  m_numConfigs = numConfigs;
+  m_cellRows.assign(numCells, kNoRows);
+  m_rowCells.clear();
+  m_frames.clear();
+  m_cycles.clear();
+  m_gpuMs.clear();
+  m_fps.clear();
+  m_bestConfig.assign(size_t(numCells) * kGridNumSides, -1);
+  m_bestFps.assign(size_t(numCells) * kGridNumSides, 0.0f);
+  m_dirtyFirst = 0;
+  m_dirtyEnd   = numCells;
+}
+
+void SortingGridTable::record(uint32_t cell, uint32_t side, uint32_t config, uint32_t frames, float windowMs)
+{
+  if(cell >= numCells() || side >= kGridNumSides || config >= m_numConfigs || !(windowMs > 0.0f))
+    return;
+
+  touch(cell);
+  size_t i = column(cell, side, config);
+  m_frames[i] += frames;
+  m_cycles[i] += 1;
+  m_gpuMs[i] += windowMs;
+  m_fps[i] = float(m_frames[i]) * 1000.0f / m_gpuMs[i];
+  updateBest(cell, side, config, m_fps[i]);
+}
+
+void SortingGridTable::restore(uint32_t cell, uint32_t side, uint32_t config, uint32_t frames, uint32_t cycles, float fps)
+{
+  if(cell >= numCells() || side >= kGridNumSides || config >= m_numConfigs || frames == 0 || cycles == 0 || !(fps > 0.0f))
+    return;
+
+  touch(cell);
+  size_t i    = column(cell, side, config);
+  m_frames[i] = frames;
+  m_cycles[i] = cycles;
+  m_gpuMs[i]  = float(frames) * 1000.0f / fps;
+  m_fps[i]    = fps;
+  updateBest(cell, side, config, fps);
+}
+
+void SortingGridTable::touch(uint32_t cell)
+{
+  if(m_cellRows[cell] != kNoRows)
+    return;
+  m_cellRows[cell] = uint32_t(m_rowCells.size());
+  m_rowCells.push_back(cell);
+  size_t size = m_rowCells.size() * kGridNumSides * m_numConfigs;
+  m_frames.resize(size, 0);
+  m_cycles.resize(size, 0);
+  m_gpuMs.resize(size, 0.0f);
+  m_fps.resize(size, 0.0f);
+}
+
+//--------------------------------------------------------------------------------------------------
+// A faster config takes over. Only when the fps of the current best drops is the side scanned
+// again, the others cannot have overtaken it without being recorded.
+//
+void SortingGridTable::updateBest(uint32_t cell, uint32_t side, uint32_t config, float fps)
+{
+  size_t s    = size_t(cell) * kGridNumSides + side;
+  int    best = m_bestConfig[s];
+
+  if(best < 0 || (int(config) != best && fps > m_bestFps[s]))
+  {
+    m_bestConfig[s] = int(config);
+    m_bestFps[s]    = fps;
+    markDirty(cell);
+    return;
+  }
+  if(int(config) != best)
+    return;
+  if(fps >= m_bestFps[s])
+  {
+    m_bestFps[s] = fps;
+    return;
+  }
+
+  size_t row   = column(cell, side, 0);
+  int    found = best;
+  float  most  = fps;
+  for(uint32_t c = 0; c < m_numConfigs; c++)
+  {
+    if(m_cycles[row + c] > 0 && m_fps[row + c] > most)
+    {
+      found = int(c);
+      most  = m_fps[row + c];
+    }
+  }
+  m_bestConfig[s] = found;
+  m_bestFps[s]    = most;
+  if(found != best)
+    markDirty(cell);
+}
+
+void SortingGridTable::markDirty(uint32_t cell)
+{
+  if(m_dirtyFirst == m_dirtyEnd)
+  {
+    m_dirtyFirst = cell;
+    m_dirtyEnd   = cell + 1;
+    return;
+  }
+  m_dirtyFirst = std::min(m_dirtyFirst, cell);
+  m_dirtyEnd   = std::max(m_dirtyEnd, cell + 1);
+}
+
+bool SortingGridTable::takeDirty(uint32_t maxCells, uint32_t& first, uint32_t& count)
+{
+  if(m_dirtyFirst == m_dirtyEnd || maxCells == 0)
+    return false;
+  first = m_dirtyFirst;
+  count = std::min(maxCells, m_dirtyEnd - m_dirtyFirst);
+  m_dirtyFirst += count;
+  return true;
+}
+
+uint32_t SortingGridTable::frames(uint32_t cell, uint32_t side, uint32_t config) const
+{
+  return measured(cell) ? m_frames[column(cell, side, config)] : 0;
+}
+
+uint32_t SortingGridTable::cycles(uint32_t cell, uint32_t side, uint32_t config) const
+{
+  return measured(cell) ? m_cycles[column(cell, side, config)] : 0;
+}
+
+float SortingGridTable::gpuMs(uint32_t cell, uint32_t side, uint32_t config) const
+{
+  return measured(cell) ? m_gpuMs[column(cell, side, config)] : 0.0f;
+}
+
+float SortingGridTable::fps(uint32_t cell, uint32_t side, uint32_t config) const
+{
+  return measured(cell) ? m_fps[column(cell, side, config)] : 0.0f;
+}
+
+size_t SortingGridTable::memoryBytes() const
+{
+  return m_cellRows.size() * sizeof(uint32_t) + m_rowCells.size() * sizeof(uint32_t) + m_frames.size() * sizeof(uint32_t)
+         + m_cycles.size() * sizeof(uint32_t) + m_gpuMs.size() * sizeof(float) + m_fps.size() * sizeof(float) + m_bestConfig.size() * sizeof(int)
+         + m_bestFps.size() * sizeof(float);
+}
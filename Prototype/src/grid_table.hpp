@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+//--------------------------------------------------------------------------------------------------
+// Measurements of the sorting grid, one table for all cells
+//
+// - Indexed [cell][side][config]: cell = (z * gridY + y) * gridX + x like the shaders, side in the
+//   order of SampleExample::CubeSide, config the index of a candidate (the tuner arm)
+// - Structure of arrays: the frames, cycles, GPU time and fps columns are each contiguous
+// - A cell gets its rows on its first measurement, a large grid of which the training only
+//   visits a part does not pay for the rest
+// - The fastest config of each (cell, side) is kept up to date by record(), nothing is scanned
+//   per frame. The cells whose fastest config changed form the dirty range that goes to the GPU.
+//
+// No Vulkan dependency.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+static constexpr uint32_t kGridNumSides = 6;
+
+class SortingGridTable
+{
+public:
+  // Drops all measurements, every cell is dirty
+  void reset(uint32_t numCells, uint32_t numConfigs);
+
+  // One measurement window: `frames` ray tracing dispatches with `config` took `windowMs` of GPU
+  // time (SampleExample::doCycle), fps() is dispatches per second of GPU time over all windows
+  void record(uint32_t cell, uint32_t side, uint32_t config, uint32_t frames, float windowMs);
+  // Replaces the measurements of `config` by saved ones (SampleExample::loadSortingGrid)
+  void restore(uint32_t cell, uint32_t side, uint32_t config, uint32_t frames, uint32_t cycles, float fps);
+
+  uint32_t numCells() const { return uint32_t(m_cellRows.size()); }
+  uint32_t numConfigs() const { return m_numConfigs; }
+  uint32_t numMeasuredCells() const { return uint32_t(m_rowCells.size()); }
+  bool     measured(uint32_t cell) const { return m_cellRows[cell] != kNoRows; }
+
+  // 0 for a config that was never measured
+  uint32_t frames(uint32_t cell, uint32_t side, uint32_t config) const;
+  uint32_t cycles(uint32_t cell, uint32_t side, uint32_t config) const;
+  float    gpuMs(uint32_t cell, uint32_t side, uint32_t config) const;
+  float    fps(uint32_t cell, uint32_t side, uint32_t config) const;
+
+  // Highest fps of the side, -1 before its first measurement
+  int   bestConfig(uint32_t cell, uint32_t side) const { return m_bestConfig[cell * kGridNumSides + side]; }
+  float bestFps(uint32_t cell, uint32_t side) const { return m_bestFps[cell * kGridNumSides + side]; }
+
+  // Calls f(cell, side, config) for every measured config, in cell order
+  template <typename F>
+  void forEachMeasured(F&& f) const
+  {
+    for(uint32_t cell = 0; cell < numCells(); cell++)
+    {
+      if(!measured(cell))
+        continue;
+      size_t row = size_t(m_cellRows[cell]) * kGridNumSides;
+      for(uint32_t side = 0; side < kGridNumSides; side++)
+      {
+        for(uint32_t config = 0; config < m_numConfigs; config++)
+        {
+          if(m_cycles[(row + side) * m_numConfigs + config] > 0)
+            f(cell, side, config);
+        }
+      }
+    }
+  }
+
+  // Takes at most `maxCells` cells off the front of the dirty range, false when nothing is dirty
+  bool takeDirty(uint32_t maxCells, uint32_t& first, uint32_t& count);
+
+  // Host memory of the columns
+  size_t memoryBytes() const;
+
+private:
+  static constexpr uint32_t kNoRows = ~0u;
+
+  size_t column(uint32_t cell, uint32_t side, uint32_t config) const
+  {
+    return (size_t(m_cellRows[cell]) * kGridNumSides + side) * m_numConfigs + config;
+  }
+  // Allocates the rows of the cell on its first measurement
+  void touch(uint32_t cell);
+  void updateBest(uint32_t cell, uint32_t side, uint32_t config, float fps);
+  void markDirty(uint32_t cell);
+
+  uint32_t m_numConfigs{0};
+
+  std::vector<uint32_t> m_cellRows;  // Per cell, its block of rows in the columns or kNoRows
+  std::vector<uint32_t> m_rowCells;  // Per block, its cell
+
+  // Columns, one entry per (block, side, config)
+  std::vector<uint32_t> m_frames;
+  std::vector<uint32_t> m_cycles;
+  std::vector<float>    m_gpuMs;
+  std::vector<float>    m_fps;
+
+  // Per (cell, side)
+  std::vector<int>   m_bestConfig;
+  std::vector<float> m_bestFps;
+
+  uint32_t m_dirtyFirst{0};
+  uint32_t m_dirtyEnd{0};  // Empty when m_dirtyFirst == m_dirtyEnd
+};
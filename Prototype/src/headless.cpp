@@ -0,0 +1,338 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <algorithm>
+#include <fstream>
+
+#include "camera_path.hpp"
+#include "frame_stats.hpp"
+#include "gpu_dispatch_timer.hpp"
+#include "headless.hpp"
+#include "nvvk/commands_vk.hpp"
+#include "nvvk/profiler_vk.hpp"
+#include "rtx_pipeline.hpp"
+#include "sample_example.hpp"
+
+
+struct HeadlessResult
+{
+  SortingParameters   parameters;
+  ConfigId            id{0};
+  FrameStats          stats;
+  std::vector<double> timesMs;  // Measured frames in order
+};
+
+static void writeCsv(const std::string& filename, const std::vector<HeadlessResult>& results)
+{
+  std::ofstream out(filename, std::ios::trunc);
+  if(!out)
+  {
+    LOGE("Cannot write %s\n", filename.c_str());
+    return;
+  }
+  out << "configId,sortAfterASTraversal,noSort,hitObject,rayOrigin,rayDirection,estimatedEndpoint,realEndpoint,isFinished,"
+         "numCoherenceBits,frames,meanMs,stddevMs,medianMs,p95Ms,p99Ms,minMs,maxMs,meanCiLowMs,meanCiHighMs,medianCiLowMs,"
+         "medianCiHighMs,trimmedMeanMs,medianOfMeansMs,outliers\n";
+  for(const HeadlessResult& r : results)
+  {
+    const SortingParameters& p = r.parameters;
+    const FrameStats&        s = r.stats;
+    out << configIdString(r.id) << "," << p.sortAfterASTraversal << "," << p.noSort << "," << p.hitObject << "," << p.rayOrigin << ","
+        << p.rayDirection << "," << p.estimatedEndpoint << "," << p.realEndpoint << "," << p.isFinished << ","
+        << p.numCoherenceBitsTotal << "," << s.count << "," << s.meanMs << "," << s.stddevMs << "," << s.medianMs << ","
+        << s.p95Ms << "," << s.p99Ms << "," << s.minMs << "," << s.maxMs << "," << s.meanCiLowMs << "," << s.meanCiHighMs
+        << "," << s.medianCiLowMs << "," << s.medianCiHighMs << "," << s.trimmedMeanMs << "," << s.medianOfMeansMs << ","
+        << s.outliers << "\n";
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// The whole run: the settings to reproduce it, then per configuration the statistics and the
+// measured frame times, fastest median first
+//
+static void writeJson(const std::string& filename, const HeadlessSettings& settings, const std::string& cameraPath,
+                      size_t numCameraKeys, const std::vector<HeadlessResult>& results)
+{
+  json js;
+  js["ConfigIdVersion"] = kConfigIdVersion;
+  js["scene"]           = settings.sceneFile;
+  js["hdr"]             = settings.hdrFilename;
+  js["size"]            = {settings.size.width, settings.size.height};
+  js["warmupFrames"]    = settings.warmupFrames;
+  js["frames"]          = settings.frames;
+  js["cameraPath"]      = cameraPath;
+  js["cameraKeys"]      = numCameraKeys;
+  js["results"]         = json::array();
+  for(const HeadlessResult& r : results)
+  {
+    const SortingParameters& p = r.parameters;
+    const FrameStats&        s = r.stats;
+    json                     entry;
+    entry["configId"]         = configIdString(r.id);
+    entry["flags"]            = sortingFlags(p);
+    entry["numCoherenceBits"] = p.numCoherenceBitsTotal;
+    entry["frames"]           = s.count;
+    entry["meanMs"]           = s.meanMs;
+    entry["stddevMs"]         = s.stddevMs;
+    entry["medianMs"]         = s.medianMs;
+    entry["p95Ms"]            = s.p95Ms;
+    entry["p99Ms"]            = s.p99Ms;
+    entry["minMs"]            = s.minMs;
+    entry["maxMs"]            = s.maxMs;
+    entry["meanCi95Ms"]       = {s.meanCiLowMs, s.meanCiHighMs};
+    entry["medianCi95Ms"]     = {s.medianCiLowMs, s.medianCiHighMs};
+    entry["trimmedMeanMs"]    = s.trimmedMeanMs;
+    entry["medianOfMeansMs"]  = s.medianOfMeansMs;
+    entry["outliers"]         = s.outliers;
+    entry["timesMs"]          = r.timesMs;
+    js["results"].push_back(entry);
+  }
+
+  std::ofstream out(filename, std::ios::trunc);
+  if(!out)
+  {
+    LOGE("Cannot write %s\n", filename.c_str());
+    return;
+  }
+  out << js.dump(2);
+}
+
+//--------------------------------------------------------------------------------------------------
+// The tuner arms of -configs, all of them without. An ID of another version or of other renderer
+// settings (sorting mode, any hit, profiling, key budget) matches no arm, it is reported.
+//
+static std::vector<size_t> selectArms(RtxPipeline* rtx, const std::vector<SortingParameters>& arms, const HeadlessSettings& settings)
+{
+  std::vector<size_t> selected;
+  for(size_t arm = 0; arm < arms.size(); arm++)
+  {
+    ConfigId id = rtx->configId(arms[arm]);
+    if(settings.configIds.empty() || std::find(settings.configIds.begin(), settings.configIds.end(), id) != settings.configIds.end())
+      selected.push_back(arm);
+  }
+
+  for(ConfigId id : settings.configIds)
+  {
+    PipelineConfig config;
+    if(!decodeConfigId(id, config))
+      LOGW("Config %s: not a configuration ID of version %u, skipped\n", configIdString(id).c_str(), kConfigIdVersion);
+    else if(std::none_of(arms.begin(), arms.end(), [&](const SortingParameters& p) { return rtx->configId(p) == id; }))
+      LOGW("Config %s: not a tuner arm with the settings of this run, skipped\n", configIdString(id).c_str());
+  }
+  return selected;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Creation time of the pipeline of each configuration, full and linked
+//
+static bool runPipelineBenchmark(RtxPipeline* rtx, const std::vector<SortingParameters>& arms, const HeadlessSettings& settings)
+{
+  std::vector<SortingParameters> parameters;
+  for(size_t arm : selectArms(rtx, arms, settings))
+    parameters.push_back(arms[arm]);
+  if(parameters.empty())
+    return false;
+
+  double hitLibraryMs{0.0};
+  auto   timings = rtx->benchmarkPipelineCreation(parameters, hitLibraryMs);
+
+  double sumFull{0.0};
+  double sumLinked{0.0};
+  printf("Pipeline creation of %zu configurations, hit library once: %.3f ms%s\n", timings.size(), hitLibraryMs,
+         rtx->pipelineLibraryInUse() ? "" : " (no VK_KHR_pipeline_library, full pipelines only)");
+  printf("%16s | %9s | %9s %9s %9s | %7s\n", "configId", "full", "raygen", "link", "linked", "speedup");
+  for(const RtxPipeline::CreationTiming& t : timings)
+  {
+    double linked = t.raygenLibraryMs + t.linkMs;
+    sumFull += t.fullMs;
+    sumLinked += linked;
+    printf("%16s | %9.3f | %9.3f %9.3f %9.3f | %6.2fx\n", configIdString(rtx->configId(t.parameters)).c_str(), t.fullMs, t.raygenLibraryMs,
+           t.linkMs, linked, linked > 0.0 ? t.fullMs / linked : 0.0);
+  }
+  double n = double(timings.size());
+  printf("%16s | %9.3f | %19s %9.3f | %6.2fx\n", "mean", sumFull / n, "", sumLinked / n, sumLinked > 0.0 ? sumFull / sumLinked : 0.0);
+
+  if(!settings.csvFilename.empty())
+  {
+    std::ofstream out(settings.csvFilename, std::ios::trunc);
+    if(!out)
+    {
+      LOGE("Cannot write %s\n", settings.csvFilename.c_str());
+      return true;
+    }
+    out << "configId,fullMs,raygenLibraryMs,linkMs,hitLibraryMs\n";
+    for(const RtxPipeline::CreationTiming& t : timings)
+      out << configIdString(rtx->configId(t.parameters)) << "," << t.fullMs << "," << t.raygenLibraryMs << "," << t.linkMs << ","
+          << hitLibraryMs << "\n";
+  }
+  return true;
+}
+
+
+int runHeadless(nvvk::Context& vkctx, const HeadlessSettings& settings)
+{
+  SampleExample sample;
+  sample.supportRayQuery(vkctx.hasDeviceExtension(VK_KHR_RAY_QUERY_EXTENSION_NAME));
+  sample.supportPipelineLibrary(vkctx.hasDeviceExtension(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME));
+
+  // Same queues as the windowed application, see main.cpp
+  auto qGCT1 = vkctx.createQueue(VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT, "GCT1", 1.0f);
+  std::vector<nvvk::Queue> queues;
+  queues.push_back({vkctx.m_queueGCT.queue, vkctx.m_queueGCT.familyIndex, vkctx.m_queueGCT.queueIndex});
+  queues.push_back({qGCT1.queue, qGCT1.familyIndex, qGCT1.queueIndex});
+  queues.push_back({vkctx.m_queueC.queue, vkctx.m_queueC.familyIndex, vkctx.m_queueC.queueIndex});
+  queues.push_back({vkctx.m_queueT.queue, vkctx.m_queueT.familyIndex, vkctx.m_queueT.queueIndex});
+
+  // One slot, each frame is waited for before the next one is recorded
+  GpuDispatchTimer timer;
+  if(!timer.init(vkctx.m_device, vkctx.m_physicalDevice, vkctx.m_queueGCT.familyIndex, 1))
+  {
+    LOGE("The graphics queue has no timestamps\n");
+    return kHeadlessSkipped;
+  }
+
+  sample.setup(vkctx.m_instance, vkctx.m_device, vkctx.m_physicalDevice, queues);
+  sample.setupHeadless(settings.size);
+
+  // Synchronous loading, nothing to draw meanwhile
+  sample.loadEnvironmentHdr(settings.hdrFilename);
+  sample.loadScene(settings.sceneFile);
+  sample.createUniformBuffer();
+  sample.createDescriptorSetLayout();
+  sample.createRender(SampleExample::eRtxPipeline);
+  sample.resetFrame();
+
+  nvvk::ProfilerVK profiler;
+  profiler.init(vkctx.m_device, vkctx.m_physicalDevice, vkctx.m_queueGCT.familyIndex);
+
+  auto              rtx = dynamic_cast<RtxPipeline*>(sample.m_pRender[SampleExample::eRtxPipeline]);
+  nvvk::CommandPool cmdPool(vkctx.m_device, vkctx.m_queueGCT.familyIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+                            vkctx.m_queueGCT.queue);
+  std::vector<HeadlessResult> results;
+  std::vector<double>         times;
+  std::vector<TimingSample>   samples;
+
+  // AppBaseVk::destroy() expects a swapchain and ImGui, the render pass is the only thing it
+  // would release here
+  auto cleanup = [&]() {
+    vkDeviceWaitIdle(vkctx.m_device);
+    timer.deinit();
+    profiler.deinit();
+    sample.destroyResources();
+    vkDestroyRenderPass(vkctx.m_device, sample.getRenderPass(), nullptr);
+  };
+
+  if(settings.pipelineBenchmark)
+  {
+    bool measured = runPipelineBenchmark(rtx, sample.m_tunerArms, settings);
+    cleanup();
+    return measured ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  if(settings.prebuildPipelines)
+    sample.prebuildTunerPipelines();
+
+  // Every configuration replays the same cameras, without a path the camera of the scene stays
+  CameraPath  path;
+  std::string cameraPath = settings.cameraPathFile;
+  if(settings.gridTour)
+  {
+    path       = sample.gridTourPath();
+    cameraPath = "grid tour";
+  }
+  else if(!cameraPath.empty() && !path.load(cameraPath))
+  {
+    LOGE("Cannot read the camera path %s\n", cameraPath.c_str());
+    cleanup();
+    return EXIT_FAILURE;
+  }
+
+  for(size_t arm : selectArms(rtx, sample.m_tunerArms, settings))
+  {
+    HeadlessResult result;
+    result.parameters = sample.m_tunerArms[arm];
+    result.id         = rtx->configId(result.parameters);
+
+    PipelineStorage element = sample.tunerPipeline(int(arm));
+    if(element.pipeline == VK_NULL_HANDLE)
+    {
+      LOGE("No pipeline for %s, not measured\n", configIdString(result.id).c_str());
+      continue;
+    }
+    rtx->setNewPipeline(element);
+    // Every configuration renders the same accumulation frames
+    sample.resetFrame();
+
+    times.clear();
+    for(uint32_t frame = 0; frame < settings.warmupFrames + settings.frames; frame++)
+    {
+      // The warm-up frames see the first key
+      if(!path.empty())
+        sample.setCameraKey(frame < settings.warmupFrames ? path.keys().front() :
+                                                            path.keyOfFrame(frame - settings.warmupFrames, settings.frames));
+      sample.updateFrame();
+      profiler.beginFrame();
+      VkCommandBuffer cmdBuf = cmdPool.createCommandBuffer();
+      sample.updateUniformBuffer(cmdBuf);
+      sample.updateStorageBuffer(cmdBuf);
+      timer.begin(cmdBuf, 0, result.id);
+      sample.renderScene(cmdBuf, profiler);
+      timer.end(cmdBuf, 0);
+      profiler.endFrame();
+      cmdPool.submitAndWait(cmdBuf);
+
+      samples.clear();
+      timer.collect(samples);
+      if(frame >= settings.warmupFrames && !samples.empty())
+        times.push_back(double(samples.front().gpuNs) * 1e-6);
+    }
+
+    result.timesMs = times;
+    result.stats   = summarizeFrameTimes(times);
+    LOGI("config %s: %8.3f ms mean, %8.3f median, %8.3f p95, %8.3f p99\n", configIdString(result.id).c_str(),
+         result.stats.meanMs, result.stats.medianMs, result.stats.p95Ms, result.stats.p99Ms);
+    results.push_back(result);
+  }
+
+  std::stable_sort(results.begin(), results.end(),
+                   [](const HeadlessResult& a, const HeadlessResult& b) { return a.stats.medianMs < b.stats.medianMs; });
+  printf("%u x %u, %u frames per configuration after %u warm-up frames, camera: %s (%zu keys)\n", settings.size.width,
+         settings.size.height, settings.frames, settings.warmupFrames, cameraPath.empty() ? "scene" : cameraPath.c_str(),
+         path.size());
+  printf("%4s %16s %5s %6s %6s %6s %6s %6s %6s %6s | %9s %19s %9s %9s %9s\n", "rank", "configId", "after", "noSort", "hitObj",
+         "origin", "dir", "estEnd", "real", "fin", "median", "median 95% CI", "mean", "p95", "p99");
+  for(size_t i = 0; i < results.size(); i++)
+  {
+    const HeadlessResult&    r = results[i];
+    const SortingParameters& p = r.parameters;
+    const FrameStats&        s = r.stats;
+    printf("%4zu %16s %5d %6d %6d %6d %6d %6d %6d %6d | %9.3f [%8.3f %8.3f] %9.3f %9.3f %9.3f\n", i + 1,
+           configIdString(r.id).c_str(), p.sortAfterASTraversal, p.noSort, p.hitObject, p.rayOrigin, p.rayDirection,
+           p.estimatedEndpoint, p.realEndpoint, p.isFinished, s.medianMs, s.medianCiLowMs, s.medianCiHighMs, s.meanMs,
+           s.p95Ms, s.p99Ms);
+  }
+  if(!settings.csvFilename.empty())
+    writeCsv(settings.csvFilename, results);
+  if(!settings.jsonFilename.empty())
+    writeJson(settings.jsonFilename, settings, cameraPath, path.size(), results);
+
+  cleanup();
+  return results.empty() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
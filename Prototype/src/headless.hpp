@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+//--------------------------------------------------------------------------------------------------
+// Batch benchmarking without a window
+//
+// - No GLFW, no swapchain, no ImGui: the frames are rendered into the offscreen image of
+//   RenderOutput only and nothing is presented
+// - Each frame is submitted on its own and timed with GPU timestamps around renderScene()
+//   (GpuDispatchTimer), the time does not include presentation, vsync or the UI
+// - Every configuration renders a fixed number of warm-up frames, then the measured frames
+// - The camera replays a recorded path (-camera-path, see camera_path.hpp) or the tour of the
+//   sorting grid training (--grid-tour), the same for every configuration
+// - The report has the mean, median, p95 and p99 frame time with 95% confidence intervals, as a
+//   table, a CSV (-csv) and a JSON with the measured frame times (-json), see frame_stats.hpp
+//
+// Started with `--headless`, see main.cpp for the options. With `--pipeline-bench` the
+// configurations are not rendered, the creation time of their pipelines is measured instead:
+// as a full pipeline and linked from the pipeline libraries (RtxPipeline::benchmarkPipelineCreation).
+
+#include <string>
+#include <vector>
+
+#include "nvvk/context_vk.hpp"
+#include "pipeline_config.hpp"
+
+
+// Exit code when the device cannot run the benchmark at all (no ray tracing, e.g. a software
+// driver), to tell it apart from a failed run
+static const int kHeadlessSkipped = 77;
+
+struct HeadlessSettings
+{
+  std::string           sceneFile;
+  std::string           hdrFilename;
+  VkExtent2D            size{1280, 720};
+  uint32_t              warmupFrames{20};
+  uint32_t              frames{200};     // Measured frames per configuration
+  std::vector<ConfigId> configIds;       // RtxPipeline::configId of the configurations, all when empty
+  std::string           csvFilename;     // Per configuration results, not written when empty
+  std::string           jsonFilename;    // Settings, results and frame times, not written when empty
+  std::string           cameraPathFile;  // CameraPath::load(), the camera of the scene when empty
+  bool                  gridTour{false};  // SampleExample::gridTourPath() instead of cameraPathFile
+  bool                  pipelineBenchmark{false};
+  bool                  prebuildPipelines{false};  // All of them in parallel before the first measure
+};
+
+// Renders every configuration and prints the GPU time per frame, returns the exit code
+int runHeadless(nvvk::Context& vkctx, const HeadlessSettings& settings);
@@ -1 +1,348 @@
-#include "inference_manager.hpp"
\ No newline at end of file
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#include "inference_manager.hpp"
+#include "nvh/nvprint.hpp"
+#include "sorting_configs.hpp"
+
+using json = nlohmann::json;
+
+
+// json::value() and get() throw on a value of another type, a bad model is only rejected. The
+// fallback is used when the key is missing.
+static bool numberFromJson(const json& j, const char* key, float fallback, float& value)
+{
+  value = fallback;
+  if(!j.contains(key))
+    return true;
+  if(!j[key].is_number())
+    return false;
+  value = j[key].get<float>();
+  return true;
+}
+
+static bool integerFromJson(const json& j, const char* key, int fallback, int& value)
+{
+  value = fallback;
+  if(!j.contains(key))
+    return true;
+  if(!j[key].is_number_integer())
+    return false;
+  value = j[key].get<int>();
+  return true;
+}
+
+static bool flagFromJson(const json& j, const char* key, bool& value)
+{
+  value = false;
+  if(!j.contains(key))
+    return true;
+  if(!j[key].is_boolean())
+    return false;
+  value = j[key].get<bool>();
+  return true;
+}
+
+static bool parametersFromJson(const json& j, SortingParameters& p)
+{
+  if(!j.is_object())
+    return false;
+  p = {};
+  int  numCoherenceBits{0};
+  bool flags[8]{};
+  if(!integerFromJson(j, "numCoherenceBitsTotal", 32, numCoherenceBits) || !flagFromJson(j, "sortAfterASTraversal", flags[0])
+     || !flagFromJson(j, "noSort", flags[1]) || !flagFromJson(j, "hitObject", flags[2]) || !flagFromJson(j, "rayOrigin", flags[3])
+     || !flagFromJson(j, "rayDirection", flags[4]) || !flagFromJson(j, "estimatedEndpoint", flags[5])
+     || !flagFromJson(j, "realEndpoint", flags[6]) || !flagFromJson(j, "isFinished", flags[7]))
+    return false;
+  if(numCoherenceBits < 0 || numCoherenceBits > 32)
+    return false;
+  p.numCoherenceBitsTotal = uint(numCoherenceBits);
+  p.sortAfterASTraversal  = flags[0];
+  p.noSort                = flags[1];
+  p.hitObject             = flags[2];
+  p.rayOrigin             = flags[3];
+  p.rayDirection          = flags[4];
+  p.estimatedEndpoint     = flags[5];
+  p.realEndpoint          = flags[6];
+  p.isFinished            = flags[7];
+  // A model must not produce an illegal set
+  return sortingParametersLegal(p);
+}
+
+InferenceFeatures computeInferenceFeatures(const Inputs& inputs)
+{
+  float extent   = std::max(inputs.LargestExtent, 1e-6f);
+  float distance = glm::length(inputs.CameraTarget - inputs.CameraPosition);
+
+  InferenceFeatures f{};
+  f[eFeatureLogPrimitives]  = std::log2(float(std::max(inputs.NumberOfPrimitives, 1u))) / 20.0f;
+  f[eFeatureLogTriangles]   = std::log2(float(std::max(inputs.NumberOfTriangles, 1u))) / 30.0f;
+  f[eFeatureLogLights]      = std::log2(float(inputs.NumberOfLights) + 1.0f) / 8.0f;
+  f[eFeatureCameraDistance] = distance / extent;
+  f[eFeatureDiffuseRatio]   = inputs.DiffuseRatio;
+  f[eFeatureLogExtent]      = std::log10(extent) / 4.0f;
+  return f;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Rules from the measurements of the sorting grid on the test scenes:
+// - small scenes barely diverge, sorting costs more than it saves
+// - many instances: the hit object separates the shaders, which is what SER is for
+// - glossy scenes keep coherent directions for a few bounces, worth adding to the key
+// - few but large meshes: the divergence is in the traversal, sort before it by origin and length
+//
+InferenceResult RulePredictor::predict(const Inputs& inputs) const
+{
+  InferenceResult result;
+  SortingParameters& p = result.parameters;
+  p.numCoherenceBitsTotal = 32;
+
+  if(inputs.NumberOfTriangles < 50000 && inputs.NumberOfPrimitives < 16)
+  {
+    p.noSort          = true;
+    result.confidence = 0.7f;
+    return result;
+  }
+
+  if(inputs.NumberOfPrimitives >= 64)
+  {
+    p.sortAfterASTraversal = true;
+    p.hitObject            = true;
+    p.rayDirection         = inputs.DiffuseRatio < 0.3f;
+    // The more instances, the more the hit object dominates
+    float moreInstances = std::log2(float(inputs.NumberOfPrimitives) / 64.0f);
+    result.confidence   = std::min(0.5f + 0.05f * moreInstances, 0.9f);
+    return result;
+  }
+
+  p.sortAfterASTraversal = false;
+  p.rayOrigin            = true;
+  p.estimatedEndpoint    = true;
+  result.confidence      = 0.45f;
+  return result;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+bool DecisionTreePredictor::load(const json& model)
+{
+  std::vector<Node> nodes;
+  if(!model.contains("nodes") || !model["nodes"].is_array())
+    return false;
+
+  for(const json& n : model["nodes"])
+  {
+    Node node;
+    if(!n.is_object())
+      return false;
+    if(n.contains("parameters"))
+    {
+      if(!parametersFromJson(n["parameters"], node.parameters) || !numberFromJson(n, "confidence", 0.0f, node.confidence))
+        return false;
+      node.confidence = glm::clamp(node.confidence, 0.0f, 1.0f);
+    }
+    else
+    {
+      if(!integerFromJson(n, "feature", -1, node.feature) || !numberFromJson(n, "threshold", 0.0f, node.threshold)
+         || !integerFromJson(n, "left", -1, node.left) || !integerFromJson(n, "right", -1, node.right))
+        return false;
+      if(node.feature < 0 || node.feature >= eFeatureCount)
+        return false;
+    }
+    nodes.push_back(node);
+  }
+
+  // Children always come after their parent, which also rules out cycles
+  for(size_t i = 0; i < nodes.size(); i++)
+  {
+    const Node& n = nodes[i];
+    if(n.feature >= 0 && (n.left <= int(i) || n.right <= int(i) || n.left >= int(nodes.size()) || n.right >= int(nodes.size())))
+      return false;
+  }
+  if(nodes.empty())
+    return false;
+
+  m_nodes = std::move(nodes);
+  return true;
+}
+
+InferenceResult DecisionTreePredictor::predict(const Inputs& inputs) const
+{
+  InferenceFeatures f     = computeInferenceFeatures(inputs);
+  int               index = 0;
+  while(m_nodes[index].feature >= 0)
+  {
+    const Node& n = m_nodes[index];
+    index         = f[n.feature] < n.threshold ? n.left : n.right;
+  }
+  return {m_nodes[index].parameters, m_nodes[index].confidence};
+}
+
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+bool LinearPredictor::load(const json& model)
+{
+  std::vector<Candidate> candidates;
+  if(!model.contains("candidates") || !model["candidates"].is_array())
+    return false;
+
+  for(const json& c : model["candidates"])
+  {
+    Candidate candidate;
+    if(!c.is_object() || !c.contains("parameters") || !parametersFromJson(c["parameters"], candidate.parameters))
+      return false;
+    if(!c.contains("weights") || !c["weights"].is_array() || c["weights"].size() != eFeatureCount)
+      return false;
+    for(int i = 0; i < eFeatureCount; i++)
+    {
+      if(!c["weights"][i].is_number())
+        return false;
+      candidate.weights[i] = c["weights"][i].get<float>();
+    }
+    if(!numberFromJson(c, "bias", 0.0f, candidate.bias))
+      return false;
+    candidates.push_back(candidate);
+  }
+  if(candidates.empty())
+    return false;
+
+  m_candidates = std::move(candidates);
+  return true;
+}
+
+InferenceResult LinearPredictor::predict(const Inputs& inputs) const
+{
+  InferenceFeatures  f = computeInferenceFeatures(inputs);
+  std::vector<float> scores(m_candidates.size());
+  for(size_t c = 0; c < m_candidates.size(); c++)
+  {
+    float s = m_candidates[c].bias;
+    for(int i = 0; i < eFeatureCount; i++)
+      s += m_candidates[c].weights[i] * f[i];
+    scores[c] = s;
+  }
+
+  // Softmax, shifted by the best score to stay in range
+  size_t best = std::max_element(scores.begin(), scores.end()) - scores.begin();
+  float  sum  = 0.0f;
+  for(float s : scores)
+    sum += std::exp(s - scores[best]);
+  return {m_candidates[best].parameters, 1.0f / sum};
+}
+
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+InferenceManager::InferenceManager()
+    : m_predictor(std::make_unique<RulePredictor>())
+{
+}
+
+Inputs InferenceManager::computeInputs(const nvh::GltfScene& gltf, int numLights, const glm::vec3& eye, const glm::vec3& center)
+{
+  Inputs inputs{};
+  inputs.NumberOfPrimitives = static_cast<uint>(gltf.m_nodes.size());
+  inputs.NumberOfLights     = static_cast<uint>(std::max(numLights, 0));
+  inputs.CameraPosition     = eye;
+  inputs.CameraTarget       = center;
+
+  glm::vec3 size       = gltf.m_dimensions.size;
+  inputs.LargestExtent = std::max(std::max(size.x, size.y), size.z);
+
+  // Triangles of all instances, the diffuse ratio is weighted by them
+  double triangles        = 0.0;
+  double diffuseTriangles = 0.0;
+  for(const auto& node : gltf.m_nodes)
+  {
+    const auto& prim  = gltf.m_primMeshes[node.primMesh];
+    double      count = prim.indexCount / 3;
+    triangles += count;
+
+    if(prim.materialIndex < 0 || prim.materialIndex >= int(gltf.m_materials.size()))
+      continue;
+    const auto& mat     = gltf.m_materials[prim.materialIndex];
+    bool        diffuse = mat.metallicFactor < 0.5f && mat.roughnessFactor > 0.5f && mat.transmission.factor == 0.0f;
+    if(diffuse)
+      diffuseTriangles += count;
+  }
+  inputs.NumberOfTriangles = static_cast<uint>(std::min(triangles, double(UINT32_MAX)));
+  inputs.DiffuseRatio      = triangles > 0.0 ? float(diffuseTriangles / triangles) : 0.0f;
+  return inputs;
+}
+
+void InferenceManager::setPredictor(std::unique_ptr<KeyPredictor> predictor)
+{
+  if(predictor)
+    m_predictor = std::move(predictor);
+}
+
+bool InferenceManager::loadModel(const std::string& filename)
+{
+  std::ifstream f(filename);
+  json          model = f.is_open() ? json::parse(f, nullptr, false) : json(json::value_t::discarded);
+  if(model.is_discarded())
+  {
+    LOGE("Inference model %s cannot be read\n", filename.c_str());
+    return false;
+  }
+
+  std::string type = model.is_object() && model.contains("type") && model["type"].is_string() ? model["type"].get<std::string>() : "";
+  if(type == "tree")
+  {
+    auto tree = std::make_unique<DecisionTreePredictor>();
+    if(tree->load(model))
+    {
+      m_predictor = std::move(tree);
+      return true;
+    }
+  }
+  else if(type == "linear")
+  {
+    auto linear = std::make_unique<LinearPredictor>();
+    if(linear->load(model))
+    {
+      m_predictor = std::move(linear);
+      return true;
+    }
+  }
+  LOGE("Inference model %s is invalid (type \"%s\")\n", filename.c_str(), type.c_str());
+  return false;
+}
+
+const InferenceResult& InferenceManager::infer()
+{
+  m_result = m_predictor->predict(m_inputs);
+  const SortingParameters& p = m_result.parameters;
+  LOGI("Inference (%s): noSort %d after %d hitObject %d origin %d direction %d estimated %d real %d finished %d, %u bits, confidence %.2f\n",
+       m_predictor->name(), p.noSort, p.sortAfterASTraversal, p.hitObject, p.rayOrigin, p.rayDirection,
+       p.estimatedEndpoint, p.realEndpoint, p.isFinished, p.numCoherenceBitsTotal, m_result.confidence);
+  return m_result;
+}
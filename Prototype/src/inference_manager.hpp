@@ -1,20 +1,164 @@
-//#include "shaders/host_device.h"
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
 
-class InferenceManager
+
+#pragma once
+
+//--------------------------------------------------------------------------------------------------
+// Key inference: predicts the sorting parameters of a scene from its features
+//
+// - The features (Inputs of host_device.h) are computed from the glTF scene and the camera
+// - A predictor maps the features to a SortingParameters set and a confidence in [0,1]
+// - The sorting grid only explores other parameters when the confidence is low
+//
+// Predictors are pluggable: a hand written rule set (default), a decision tree and a linear
+// model, the last two loaded from a JSON model file.
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include "nvh/gltfscene.hpp"
+#include "shaders/host_device.h"
+#include "json.hpp"
+
+
+struct InferenceResult
+{
+  SortingParameters parameters{};
+  float             confidence{0.0f};  // 0: no idea, 1: certain
+};
+
+// Normalized view of Inputs used by the learned models, all values are roughly in [0,1]
+enum InferenceFeature
+{
+  eFeatureLogPrimitives,   // log2(NumberOfPrimitives) / 20
+  eFeatureLogTriangles,    // log2(NumberOfTriangles) / 30
+  eFeatureLogLights,       // log2(NumberOfLights + 1) / 8
+  eFeatureCameraDistance,  // |CameraTarget - CameraPosition| / LargestExtent
+  eFeatureDiffuseRatio,    // DiffuseRatio
+  eFeatureLogExtent,       // log10(LargestExtent) / 4
+  eFeatureCount
+};
+
+using InferenceFeatures = std::array<float, eFeatureCount>;
+
+InferenceFeatures computeInferenceFeatures(const Inputs& inputs);
+
+
+//--------------------------------------------------------------------------------------------------
+// Interface of all predictors
+//
+class KeyPredictor
+{
+public:
+  virtual ~KeyPredictor() = default;
+
+  virtual const char*     name() const                      = 0;
+  virtual InferenceResult predict(const Inputs& inputs) const = 0;
+};
+
+// Hand written rules, always available
+class RulePredictor : public KeyPredictor
 {
-private:
-    /* data */
 public:
-    InferenceManager(/* args */);
-    ~InferenceManager();
+  const char*     name() const override { return "Rules"; }
+  InferenceResult predict(const Inputs& inputs) const override;
+};
+
+// Binary decision tree over the features, leaves hold a parameter set
+// JSON: { "type": "tree", "nodes": [ { "feature": 1, "threshold": 0.5, "left": 1, "right": 2 },
+//                                    { "parameters": {...}, "confidence": 0.8 }, ... ] }
+class DecisionTreePredictor : public KeyPredictor
+{
+public:
+  struct Node
+  {
+    int               feature{-1};  // -1 for a leaf
+    float             threshold{0.0f};
+    int               left{-1};  // feature < threshold
+    int               right{-1};
+    SortingParameters parameters{};
+    float             confidence{0.0f};
+  };
+
+  bool            load(const nlohmann::json& model);
+  const char*     name() const override { return "Decision tree"; }
+  InferenceResult predict(const Inputs& inputs) const override;
 
-    void setSortingParameters();
+private:
+  std::vector<Node> m_nodes;
 };
 
-InferenceManager::InferenceManager(/* args */)
+// One linear score per candidate parameter set, the confidence is the softmax of the best score
+// JSON: { "type": "linear", "candidates": [ { "parameters": {...}, "weights": [...], "bias": 0.1 }, ... ] }
+class LinearPredictor : public KeyPredictor
 {
-}
+public:
+  struct Candidate
+  {
+    SortingParameters parameters{};
+    InferenceFeatures weights{};
+    float             bias{0.0f};
+  };
+
+  bool            load(const nlohmann::json& model);
+  const char*     name() const override { return "Linear"; }
+  InferenceResult predict(const Inputs& inputs) const override;
+
+private:
+  std::vector<Candidate> m_candidates;
+};
 
-InferenceManager::~InferenceManager()
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+class InferenceManager
 {
-}
+public:
+  InferenceManager();
+
+  // Features of the loaded scene seen from the camera
+  static Inputs computeInputs(const nvh::GltfScene& gltf, int numLights, const glm::vec3& eye, const glm::vec3& center);
+
+  void setInputs(const Inputs& inputs) { m_inputs = inputs; }
+  void setPredictor(std::unique_ptr<KeyPredictor> predictor);
+  // Replaces the predictor by the model of a JSON file, keeps the current one on failure
+  bool loadModel(const std::string& filename);
+
+  // Runs the predictor on the current inputs, the result is kept until the next call
+  const InferenceResult& infer();
+
+  // Low confidence predictions are refined by the exploration of the sorting grid
+  bool shouldExplore() const { return m_result.confidence < m_confidenceThreshold; }
+
+  const Inputs&          getInputs() const { return m_inputs; }
+  const InferenceResult& getResult() const { return m_result; }
+  const char*            getPredictorName() const { return m_predictor->name(); }
+  float*                 getConfidenceThreshold() { return &m_confidenceThreshold; }
+
+private:
+  std::unique_ptr<KeyPredictor> m_predictor;
+  Inputs                        m_inputs{};
+  InferenceResult               m_result{};
+  float                         m_confidenceThreshold{0.6f};
+};
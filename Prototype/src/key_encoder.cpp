@@ -0,0 +1,537 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+/*
+ *  Batch encoding of sorting keys on the CPU
+ */
+
+
+#include <array>
+#include <cassert>
+
+#include "key_encoder.hpp"
+#include "shaders/sorting_keys.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define KEY_ENCODER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC allows intrinsics anywhere, GCC and Clang need the target enabled on the function
+#if defined(KEY_ENCODER_X86) && !defined(_MSC_VER)
+#define TARGET_BMI2 __attribute__((target("bmi2")))
+#define TARGET_AVX2_BMI2 __attribute__((target("avx2,bmi2")))
+#else
+#define TARGET_BMI2
+#define TARGET_AVX2_BMI2
+#endif
+
+
+//--------------------------------------------------------------------------------------------------
+// Bit deposit layouts
+// Each field is one of the interleaving loops of sorting_keys.h: bits [lo..hi] of one component
+// go to bit `stride * i + offset` of the 64 bit Morton code. The encoders keep 32 bits of it,
+// starting at `base` (32, or 0 for Reis whose code fits in 32 bits), so the fields are clipped
+// to those and turned into a pdep mask.
+//
+namespace {
+
+struct DepositField
+{
+  int      point{0};      // 0: SortingKeyInput::a, 1: SortingKeyInput::b
+  int      component{0};  // x, y, z
+  int      shift{0};      // first source bit landing in the kept 32 bits
+  uint32_t mask{0};       // destination bits in the 32 bit key
+};
+
+struct FieldSpec
+{
+  int point, component, hi, lo, stride, offset;
+};
+
+constexpr FieldSpec field(int point, int component, int hi, int lo, int stride, int offset)
+{
+  return {point, component, hi, lo, stride, offset};
+}
+
+constexpr DepositField clip(FieldSpec s, int base)
+{
+  DepositField f{s.point, s.component, 0, 0};
+  int          first = s.hi + 1;
+  for(int i = s.hi; i >= s.lo; --i)
+  {
+    int pos = s.stride * i + s.offset;
+    if(pos >= base && pos < base + 32)
+    {
+      f.mask |= 1u << (pos - base);
+      first = i;
+    }
+  }
+  f.shift = first;
+  return f;
+}
+
+struct DepositLayout
+{
+  std::array<DepositField, 9> fields{};
+  int                         count{0};
+};
+
+template <typename... Fields>
+constexpr DepositLayout layout(int base, Fields... f)
+{
+  DepositLayout l;
+  for(FieldSpec s : {f...})
+  {
+    DepositField d = clip(s, base);
+    if(d.mask != 0)  // fields entirely in the discarded bits
+      l.fields[l.count++] = d;
+  }
+  return l;
+}
+
+enum
+{
+  A = 0,
+  B = 1,
+  X = 0,
+  Y = 1,
+  Z = 2
+};
+
+// clang-format off
+constexpr DepositLayout kOriginLayout = layout(32,
+    field(A, X, 22, 2, 3, -3), field(A, Y, 22, 2, 3, -4), field(A, Z, 22, 2, 3, -5), field(A, X, 0, 0, 1, 0));
+
+constexpr DepositLayout kReisLayout = layout(0,
+    field(A, X, 7, 1, 3, 10), field(A, Y, 7, 1, 3, 9), field(A, Z, 7, 1, 3, 8), field(A, X, 0, 0, 1, 10),
+    field(B, X, 7, 3, 2, -5), field(B, Y, 7, 3, 2, -6));
+
+constexpr DepositLayout kCostaLayout = layout(32,
+    field(B, X, 12, 9, 2, 39), field(B, Y, 12, 9, 2, 38),
+    field(A, X, 7, 1, 3, 19), field(A, Y, 7, 1, 3, 18), field(A, Z, 7, 1, 3, 17));
+
+constexpr DepositLayout kAilaLayout = layout(32,
+    field(A, X, 12, 10, 3, 27), field(A, Y, 12, 10, 3, 26), field(A, Z, 12, 10, 3, 25),
+    field(A, X, 9, 1, 6, 0), field(A, Y, 9, 1, 6, -1), field(A, Z, 9, 1, 6, -2),
+    field(B, X, 12, 4, 6, -21), field(B, Y, 12, 4, 6, -22), field(B, Z, 12, 4, 6, -23));
+
+// Also used by both endpoint estimations
+constexpr DepositLayout kTwoPointLayout = layout(32,
+    field(A, X, 14, 4, 6, -21), field(A, Y, 14, 4, 6, -22), field(A, Z, 14, 4, 6, -23),
+    field(B, X, 14, 5, 6, -24), field(B, Y, 14, 5, 6, -25), field(B, Z, 14, 5, 6, -26), field(B, X, 0, 0, 1, 0));
+// clang-format on
+
+static_assert(kReisLayout.count == 6, "The whole Reis code is kept");
+
+// Morton masks of SortingKeyMortonPoint (3 x 21 bits, x highest) and SortingKeyMortonDirection (2 x 16 bits)
+constexpr uint64_t kMortonPointMask[3]     = {0x4924924924924924ull, 0x2492492492492492ull, 0x1249249249249249ull};
+constexpr uint32_t kMortonDirectionMask[2] = {0xAAAAAAAAu, 0x55555555u};
+
+
+//--------------------------------------------------------------------------------------------------
+// Reference: the shared shader code
+//
+void encodeReference(SortingMode mode, const RayBatchView& rays, const SortingKeyBounds& bounds, uint32_t* keys)
+{
+  const glm::vec3* o = rays.origins;
+  const glm::vec3* d = rays.directions;
+  const float*     t = rays.rayLengths;
+  for(size_t i = 0; i < rays.count; i++)
+  {
+    switch(mode)
+    {
+      case eOrigin:
+        keys[i] = SortingKeyOrigin(o[i], bounds);
+        break;
+      case eReis:
+        keys[i] = SortingKeyReis(o[i], d[i], bounds);
+        break;
+      case eCosta:
+        keys[i] = SortingKeyCosta(o[i], d[i], bounds);
+        break;
+      case eAila:
+        keys[i] = SortingKeyAila(o[i], d[i], bounds);
+        break;
+      case eTwoPoint:
+        keys[i] = SortingKeyTwoPoint(o[i], d[i], t[i], bounds);
+        break;
+      case eEndPointEst:
+        keys[i] = SortingKeyEndPointEstimationHard(o[i], d[i], bounds);
+        break;
+      case eEndEstAdaptive:
+        keys[i] = SortingKeyEndPointEstimationAdaptive(o[i], d[i], t[i], bounds);
+        break;
+      default:
+        keys[i] = 0;
+    }
+  }
+}
+
+void encodeCompositeReference(const SortingKeyBudget& budget, const RayBatchView& rays, const SortingKeyBounds& bounds, uint32_t* keys)
+{
+  for(size_t i = 0; i < rays.count; i++)
+  {
+    float rayLength = rays.rayLengths ? rays.rayLengths[i] : 0.0f;
+    bool  finished  = rays.depths ? rays.depths[i] >= rays.maxDepth - 1 : false;
+    keys[i]         = SortingKeyComposite(budget, bounds, rays.origins[i], rays.directions[i], rayLength, finished);
+  }
+}
+
+
+#if defined(KEY_ENCODER_X86)
+
+//--------------------------------------------------------------------------------------------------
+// BMI2: one pdep per field instead of one shift/or per bit
+//
+template <const DepositLayout& L>
+TARGET_BMI2 inline uint32_t interleavePdep(const int* a, const int* b)
+{
+  uint32_t key = 0;
+  for(int f = 0; f < L.count; f++)
+  {
+    const DepositField& df  = L.fields[f];
+    uint32_t            src = static_cast<uint32_t>((df.point == A ? a : b)[df.component]) >> df.shift;
+    key |= _pdep_u32(src, df.mask);
+  }
+  return key;
+}
+
+template <const DepositLayout& L>
+TARGET_BMI2 inline uint32_t interleavePdep(const SortingKeyInput& q)
+{
+  const int a[3] = {q.a.x, q.a.y, q.a.z};
+  const int b[3] = {q.b.x, q.b.y, q.b.z};
+  return interleavePdep<L>(a, b);
+}
+
+template <const DepositLayout& L, typename Quantize>
+TARGET_BMI2 void encodeBmi2Loop(size_t begin, size_t end, uint32_t* keys, Quantize quantize)
+{
+  for(size_t i = begin; i < end; i++)
+    keys[i] = interleavePdep<L>(quantize(i));
+}
+
+void encodeBmi2(SortingMode mode, const RayBatchView& rays, const SortingKeyBounds& bounds, uint32_t* keys, size_t begin = 0)
+{
+  const glm::vec3* o = rays.origins;
+  const glm::vec3* d = rays.directions;
+  const float*     t = rays.rayLengths;
+  const size_t     n = rays.count;
+  switch(mode)
+  {
+    case eOrigin:
+      encodeBmi2Loop<kOriginLayout>(begin, n, keys, [&](size_t i) { return SortingKeyQuantizeOrigin(o[i], bounds); });
+      break;
+    case eReis:
+      encodeBmi2Loop<kReisLayout>(begin, n, keys, [&](size_t i) { return SortingKeyQuantizeReis(o[i], d[i], bounds); });
+      break;
+    case eCosta:
+      encodeBmi2Loop<kCostaLayout>(begin, n, keys, [&](size_t i) { return SortingKeyQuantizeCosta(o[i], d[i], bounds); });
+      break;
+    case eAila:
+      encodeBmi2Loop<kAilaLayout>(begin, n, keys, [&](size_t i) { return SortingKeyQuantizeAila(o[i], d[i], bounds); });
+      break;
+    case eTwoPoint:
+      encodeBmi2Loop<kTwoPointLayout>(begin, n, keys, [&](size_t i) { return SortingKeyQuantizeTwoPoint(o[i], d[i], t[i], bounds); });
+      break;
+    case eEndPointEst: {
+      float length = 0.2f * bounds.sceneExtent;
+      encodeBmi2Loop<kTwoPointLayout>(begin, n, keys, [&](size_t i) { return SortingKeyQuantizeEndPoint(o[i], d[i], length, bounds); });
+      break;
+    }
+    case eEndEstAdaptive:
+      encodeBmi2Loop<kTwoPointLayout>(begin, n, keys, [&](size_t i) {
+        return SortingKeyQuantizeEndPoint(o[i], d[i], SortingKeyAdaptiveRayLength(t[i], bounds.sceneExtent), bounds);
+      });
+      break;
+    default:
+      for(size_t i = begin; i < n; i++)
+        keys[i] = 0;
+  }
+}
+
+// Same quantization as SortingKeyMortonPoint/SortingKeyMortonDirection, one pdep per component
+TARGET_BMI2 inline uint32_t mortonPointPdep(glm::vec3 unitPoint, uint32_t bits)
+{
+  ivec3    q    = ivec3(unitPoint * 2097151.0f);
+  uint64_t code = _pdep_u64(uint64_t(q.x), kMortonPointMask[0]) | _pdep_u64(uint64_t(q.y), kMortonPointMask[1])
+                  | _pdep_u64(uint64_t(q.z), kMortonPointMask[2]);
+  return bits == 0 ? 0 : uint32_t(code >> (63 - bits));
+}
+
+TARGET_BMI2 inline uint32_t mortonDirectionPdep(glm::vec3 unitDirection, uint32_t bits)
+{
+  ivec3    q    = ivec3(unitDirection * 65535.0f);
+  uint64_t code = _pdep_u32(uint32_t(q.x), kMortonDirectionMask[0]) | _pdep_u32(uint32_t(q.y), kMortonDirectionMask[1]);
+  return bits == 0 ? 0 : uint32_t(code >> (32 - bits));
+}
+
+TARGET_BMI2 void encodeCompositeBmi2(const SortingKeyBudget& budget, const RayBatchView& rays, const SortingKeyBounds& bounds, uint32_t* keys)
+{
+  for(size_t i = 0; i < rays.count; i++)
+  {
+    const glm::vec3& o   = rays.origins[i];
+    const glm::vec3& d   = rays.directions[i];
+    uint64_t         key = 0;
+    if(budget.finished > 0)
+      key = rays.depths[i] >= rays.maxDepth - 1 ? 1 : 0;
+    if(budget.origin > 0)
+      key = (key << budget.origin) | mortonPointPdep(SortingKeyNormalize(o, bounds), budget.origin);
+    if(budget.direction > 0)
+      key = (key << budget.direction) | mortonDirectionPdep(SortingKeySphericalDirection(d), budget.direction);
+    if(budget.endpoint > 0)
+      key = (key << budget.endpoint) | mortonPointPdep(SortingKeyNormalize(o + d * rays.rayLengths[i], bounds), budget.endpoint);
+    keys[i] = uint32_t(key);
+  }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// AVX2: quantization of 8 rays at once for the encoders made of multiplications and additions only,
+// followed by the pdep interleaving. The operations are the same, in the same order, as the scalar
+// code, so the results are bit-exact as long as nothing gets fused into FMAs.
+//
+struct Vec8
+{
+  __m256 x, y, z;
+};
+
+TARGET_AVX2_BMI2 inline Vec8 gather8(const glm::vec3* v, size_t i)
+{
+  const __m256i idx  = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+  const float*  base = &v[i].x;
+  return {_mm256_i32gather_ps(base + 0, idx, 4), _mm256_i32gather_ps(base + 1, idx, 4), _mm256_i32gather_ps(base + 2, idx, 4)};
+}
+
+TARGET_AVX2_BMI2 inline Vec8 scale8(const Vec8& v, float s)
+{
+  const __m256 m = _mm256_set1_ps(s);
+  return {_mm256_mul_ps(v.x, m), _mm256_mul_ps(v.y, m), _mm256_mul_ps(v.z, m)};
+}
+
+// a + d * t
+TARGET_AVX2_BMI2 inline Vec8 madd8(const Vec8& a, const Vec8& d, __m256 t)
+{
+  return {_mm256_add_ps(a.x, _mm256_mul_ps(d.x, t)), _mm256_add_ps(a.y, _mm256_mul_ps(d.y, t)),
+          _mm256_add_ps(a.z, _mm256_mul_ps(d.z, t))};
+}
+
+// (normalize(d) + 1) * 0.5, with normalize(v) = v * (1 / sqrt(dot(v, v)))
+TARGET_AVX2_BMI2 inline Vec8 unitDirection8(const Vec8& d)
+{
+  const __m256 one  = _mm256_set1_ps(1.0f);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  __m256       dot  = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(d.x, d.x), _mm256_mul_ps(d.y, d.y)), _mm256_mul_ps(d.z, d.z));
+  __m256       inv  = _mm256_div_ps(one, _mm256_sqrt_ps(dot));
+  return {_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(d.x, inv), one), half),
+          _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(d.y, inv), one), half),
+          _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(d.z, inv), one), half)};
+}
+
+// clamp((p - sceneMin) / sceneSize, 0, 1), as SortingKeyNormalize
+TARGET_AVX2_BMI2 inline __m256 normalize1(__m256 p, float sceneMin, float sceneSize)
+{
+  __m256 n = _mm256_div_ps(_mm256_sub_ps(p, _mm256_set1_ps(sceneMin)), _mm256_set1_ps(sceneSize));
+  return _mm256_min_ps(_mm256_max_ps(n, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+}
+
+TARGET_AVX2_BMI2 inline Vec8 normalize8(const Vec8& p, const SortingKeyBounds& bounds)
+{
+  return {normalize1(p.x, bounds.sceneMin.x, bounds.sceneSize.x), normalize1(p.y, bounds.sceneMin.y, bounds.sceneSize.y),
+          normalize1(p.z, bounds.sceneMin.z, bounds.sceneSize.z)};
+}
+
+struct Bits8
+{
+  alignas(32) int v[3][8];
+};
+
+// ivec3(v), truncation toward zero
+TARGET_AVX2_BMI2 inline void store8(const Vec8& v, Bits8& bits)
+{
+  _mm256_store_si256(reinterpret_cast<__m256i*>(bits.v[0]), _mm256_cvttps_epi32(v.x));
+  _mm256_store_si256(reinterpret_cast<__m256i*>(bits.v[1]), _mm256_cvttps_epi32(v.y));
+  _mm256_store_si256(reinterpret_cast<__m256i*>(bits.v[2]), _mm256_cvttps_epi32(v.z));
+}
+
+template <const DepositLayout& L>
+TARGET_AVX2_BMI2 inline void interleave8(const Bits8& a, const Bits8& b, uint32_t* keys)
+{
+  for(int lane = 0; lane < 8; lane++)
+  {
+    const int pa[3] = {a.v[0][lane], a.v[1][lane], a.v[2][lane]};
+    const int pb[3] = {b.v[0][lane], b.v[1][lane], b.v[2][lane]};
+    keys[lane]      = interleavePdep<L>(pa, pb);
+  }
+}
+
+// Returns the number of rays done, the caller finishes the tail with the BMI2 path
+TARGET_AVX2_BMI2 size_t encodeAvx2(SortingMode mode, const RayBatchView& rays, const SortingKeyBounds& bounds, uint32_t* keys)
+{
+  const size_t n8 = rays.count & ~size_t(7);
+  Bits8        a, b;
+  for(size_t i = 0; i < n8; i += 8)
+  {
+    switch(mode)
+    {
+      case eOrigin: {
+        store8(scale8(normalize8(gather8(rays.origins, i), bounds), 8388607.0f), a);
+        interleave8<kOriginLayout>(a, a, keys + i);
+        break;
+      }
+      case eAila: {
+        store8(scale8(normalize8(gather8(rays.origins, i), bounds), 8191.0f), a);
+        store8(scale8(unitDirection8(gather8(rays.directions, i)), 8191.0f), b);
+        interleave8<kAilaLayout>(a, b, keys + i);
+        break;
+      }
+      case eTwoPoint: {
+        Vec8   o = gather8(rays.origins, i);
+        __m256 t = _mm256_loadu_ps(rays.rayLengths + i);
+        store8(scale8(normalize8(o, bounds), 32767.0f), a);
+        store8(scale8(normalize8(madd8(o, gather8(rays.directions, i), t), bounds), 32767.0f), b);
+        interleave8<kTwoPointLayout>(a, b, keys + i);
+        break;
+      }
+      case eEndPointEst: {
+        __m256 t = _mm256_set1_ps(0.2f * bounds.sceneExtent);
+        store8(scale8(normalize8(madd8(gather8(rays.origins, i), gather8(rays.directions, i), t), bounds), 32767.0f), b);
+        interleave8<kTwoPointLayout>(b, b, keys + i);
+        break;
+      }
+      case eEndEstAdaptive: {
+        __m256 last   = _mm256_loadu_ps(rays.rayLengths + i);
+        __m256 missed = _mm256_cmp_ps(last, _mm256_set1_ps(SK_INFINITY), _CMP_EQ_OQ);
+        __m256 t = _mm256_blendv_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), last), _mm256_set1_ps(0.2f * bounds.sceneExtent), missed);
+        store8(scale8(normalize8(madd8(gather8(rays.origins, i), gather8(rays.directions, i), t), bounds), 32767.0f), b);
+        interleave8<kTwoPointLayout>(b, b, keys + i);
+        break;
+      }
+      default:
+        return 0;  // Reis and Costa need atan/acos: scalar quantization
+    }
+  }
+  return n8;
+}
+
+#endif  // KEY_ENCODER_X86
+
+}  // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+bool KeyEncoder::hasEncoder(SortingMode mode)
+{
+  return mode >= eOrigin && mode <= eEndEstAdaptive;
+}
+
+bool KeyEncoder::isSupported(Path path)
+{
+  if(path == eAuto || path == eReference)
+    return true;
+#if defined(KEY_ENCODER_X86)
+#if defined(_MSC_VER)
+  int regs[4];
+  __cpuid(regs, 1);
+  bool osAvx = (regs[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;  // OSXSAVE and YMM state enabled
+  __cpuidex(regs, 7, 0);
+  bool bmi2 = (regs[1] & (1 << 8)) != 0;
+  bool avx2 = osAvx && (regs[1] & (1 << 5)) != 0;
+#else
+  bool bmi2 = __builtin_cpu_supports("bmi2");
+  bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+  if(path == eBmi2)
+    return bmi2;
+  return bmi2 && avx2;
+#else
+  return false;
+#endif
+}
+
+KeyEncoder::Path KeyEncoder::bestPath()
+{
+  static const Path best = isSupported(eAvx2Bmi2) ? eAvx2Bmi2 : (isSupported(eBmi2) ? eBmi2 : eReference);
+  return best;
+}
+
+const char* KeyEncoder::pathName(Path path)
+{
+  switch(path)
+  {
+    case eAuto:
+      return pathName(bestPath());
+    case eReference:
+      return "reference";
+    case eBmi2:
+      return "bmi2";
+    case eAvx2Bmi2:
+      return "avx2+bmi2";
+  }
+  return "";
+}
+
+void KeyEncoder::encode(SortingMode mode, const RayBatchView& rays, const SortingKeyBounds& bounds, uint32_t* keys, Path path)
+{
+  assert(rays.rayLengths != nullptr || (mode != eTwoPoint && mode != eEndEstAdaptive));
+  if(path == eAuto)
+    path = bestPath();
+  assert(isSupported(path));
+
+#if defined(KEY_ENCODER_X86)
+  if(path == eAvx2Bmi2)
+  {
+    size_t done = encodeAvx2(mode, rays, bounds, keys);
+    encodeBmi2(mode, rays, bounds, keys, done);
+    return;
+  }
+  if(path == eBmi2)
+  {
+    encodeBmi2(mode, rays, bounds, keys);
+    return;
+  }
+#endif
+  encodeReference(mode, rays, bounds, keys);
+}
+
+void KeyEncoder::encodeComposite(const SortingKeyBudget& budget, const RayBatchView& rays, const SortingKeyBounds& bounds, uint32_t* keys, Path path)
+{
+  assert(SortingKeyBudgetTotal(budget) <= 32);
+  assert(rays.rayLengths != nullptr || budget.endpoint == 0);
+  assert(rays.depths != nullptr || budget.finished == 0);
+  if(path == eAuto)
+    path = bestPath();
+  assert(isSupported(path));
+
+#if defined(KEY_ENCODER_X86)
+  if(path == eAvx2Bmi2 || path == eBmi2)
+  {
+    encodeCompositeBmi2(budget, rays, bounds, keys);
+    return;
+  }
+#endif
+  encodeCompositeReference(budget, rays, bounds, keys);
+}
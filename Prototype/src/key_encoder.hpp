@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+//--------------------------------------------------------------------------------------------------
+// Host side batch encoding of the sorting keys of keyCreation.glsl
+// - The reference is the shared code of shaders/sorting_keys.h, bit-by-bit as on the GPU
+// - The fast path replaces the interleaving loops by BMI2 bit deposits (pdep) and computes the
+//   linear quantization 8 rays at a time with AVX2. Selected at runtime from the CPU features.
+// - Also mirrors the composite key and its per-component bit budget, to validate the shader keys
+//
+// No Vulkan dependency: this is used by the application and by the offline tools.
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include "shaders/host_device.h"
+#include "shaders/sorting_keys.h"
+
+
+// Rays to encode, array of structures as they come from captures
+struct RayBatchView
+{
+  const glm::vec3* origins{nullptr};
+  const glm::vec3* directions{nullptr};
+  const float*     rayLengths{nullptr};  // hitT, required by eTwoPoint and eEndEstAdaptive, and the composite endpoint
+  size_t           count{0};
+  const int32_t*   depths{nullptr};  // Bounce of each ray, required by the composite isFinished
+  int              maxDepth{0};      // RtxState::maxDepth
+};
+
+class KeyEncoder
+{
+public:
+  enum Path
+  {
+    eAuto,       // Fastest path supported by this CPU
+    eReference,  // Shared shader code, bit-by-bit
+    eBmi2,       // pdep interleaving, scalar quantization
+    eAvx2Bmi2,   // pdep interleaving, AVX2 quantization where the encoder allows it
+  };
+
+  // Returns true for the sorting modes having a key encoder: eOrigin .. eEndEstAdaptive
+  static bool hasEncoder(SortingMode mode);
+  static bool isSupported(Path path);
+  static Path bestPath();
+  static const char* pathName(Path path);
+
+  // Writes one 32 bit key per ray in `keys`, positions are normalized against `bounds`
+  static void encode(SortingMode mode, const RayBatchView& rays, const SortingKeyBounds& bounds, uint32_t* keys, Path path = eAuto);
+
+  // Composite key of createSortingKeyFromSpecialization (SortingKeyComposite), the rayLengths
+  // are the lengths to the endpoint. There is no AVX2 quantization, eAvx2Bmi2 runs the BMI2 path.
+  static void encodeComposite(const SortingKeyBudget& budget, const RayBatchView& rays, const SortingKeyBounds& bounds, uint32_t* keys, Path path = eAuto);
+};
@@ -18,6 +18,7 @@
  */
 
 
+#include <sstream>
 #include <thread>
 
 #define IMGUI_DEFINE_MATH_OPERATORS
@@ -29,6 +30,7 @@
 #include "nvh/inputparser.h"
 #include "nvpsystem.hpp"
 #include "nvvk/context_vk.hpp"
+#include "headless.hpp"
 #include "sample_example.hpp"
 
 // Default search path for shaders
@@ -56,21 +58,33 @@ int main(int argc, char** argv)
   std::string sceneFile   = parser.getString("-f", "robot_toon/robot-toon.gltf");
   std::string hdrFilename = parser.getString("-e", "std_env.hdr");
 
+  // Headless batch benchmark: --headless [-width w] [-height h] [-warmup n] [-frames n]
+  //                                      [-configs id,id,...] [-csv file] [-json file]
+  //                                      [-camera-path file | --grid-tour] [--pipeline-bench]
+  //                                      [--prebuild]
+  // --prebuild also builds every pipeline of the tuner when the windowed application loads a scene
+  // -observation-log file appends every window of the windowed application's tuner to the file
+  bool headless = parser.exist("--headless");
+
   // Setup GLFW window
-  glfwSetErrorCallback(onErrorCallback);
-  if(glfwInit() == GLFW_FALSE)
+  GLFWwindow* window = nullptr;
+  if(!headless)
   {
-    return 1;
+    glfwSetErrorCallback(onErrorCallback);
+    if(glfwInit() == GLFW_FALSE)
+    {
+      return 1;
+    }
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    window = glfwCreateWindow(SAMPLE_WIDTH, SAMPLE_HEIGHT, PROJECT_NAME, nullptr, nullptr);
   }
-  glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-  GLFWwindow* window = glfwCreateWindow(SAMPLE_WIDTH, SAMPLE_HEIGHT, PROJECT_NAME, nullptr, nullptr);
 
   // Setup camera
   CameraManip.setWindowSize(SAMPLE_WIDTH, SAMPLE_HEIGHT);
   CameraManip.setLookat({2.0, 2.0, -5.0}, {-1.0, 2.0, -1.0}, {0.000, 1.000, 0.000});
 
   // Setup Vulkan
-  if(glfwVulkanSupported() == GLFW_FALSE)
+  if(!headless && glfwVulkanSupported() == GLFW_FALSE)
   {
     printf("GLFW: Vulkan Not Supported\n");
     return 1;
@@ -87,10 +101,9 @@ int main(int argc, char** argv)
       NVPSystem::exePath() + PROJECT_DOWNLOAD_RELDIRECTORY,
   };
 
-  // Vulkan required extensions
-  assert(glfwVulkanSupported() == 1);
-  uint32_t count{0};
-  auto     reqExtensions = glfwGetRequiredInstanceExtensions(&count);
+  // Vulkan required extensions, no surface without a window
+  uint32_t     count{0};
+  const char** reqExtensions = headless ? nullptr : glfwGetRequiredInstanceExtensions(&count);
 
   // Requesting Vulkan extensions and layers
   nvvk::ContextCreateInfo contextInfo(true);
@@ -98,7 +111,8 @@ int main(int argc, char** argv)
   for(uint32_t ext_id = 0; ext_id < count; ext_id++)  // Adding required extensions (surface, win32, linux, ..)
     contextInfo.addInstanceExtension(reqExtensions[ext_id]);
   contextInfo.addInstanceExtension(VK_EXT_DEBUG_UTILS_EXTENSION_NAME, true);  // Allow debug names
-  contextInfo.addDeviceExtension(VK_KHR_SWAPCHAIN_EXTENSION_NAME);            // Enabling ability to present rendering
+  if(!headless)
+    contextInfo.addDeviceExtension(VK_KHR_SWAPCHAIN_EXTENSION_NAME);  // Enabling ability to present rendering
 
   VkPhysicalDeviceShaderClockFeaturesKHR clockFeature{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_CLOCK_FEATURES_KHR};
   contextInfo.addDeviceExtension(VK_KHR_SHADER_CLOCK_EXTENSION_NAME, false, &clockFeature);
@@ -110,6 +124,7 @@ int main(int argc, char** argv)
   VkPhysicalDeviceRayQueryFeaturesKHR rayQueryFeatures{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR};
   contextInfo.addDeviceExtension(VK_KHR_RAY_QUERY_EXTENSION_NAME, true, &rayQueryFeatures);  // Optional extension
   contextInfo.addDeviceExtension(VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME);
+  contextInfo.addDeviceExtension(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME, true);  // Optional, variants relink the raygen only
   contextInfo.addDeviceExtension(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME);
 
   // Extra queues for parallel load/build
@@ -140,13 +155,55 @@ int main(int argc, char** argv)
   nvvk::Context vkctx{};
   vkctx.initInstance(contextInfo);
   auto compatibleDevices = vkctx.getCompatibleDevices(contextInfo);  // Find all compatible devices
-  assert(!compatibleDevices.empty());
+  if(compatibleDevices.empty())
+  {
+    // e.g. a software driver without ray tracing
+    LOGE("No device supports the required extensions\n");
+    vkctx.deinit();
+    return headless ? kHeadlessSkipped : 1;
+  }
   vkctx.initDevice(compatibleDevices[0], contextInfo);  // Use first compatible device
 
+  if(headless)
+  {
+    HeadlessSettings settings;
+    settings.sceneFile         = nvh::findFile(sceneFile, defaultSearchPaths, true);
+    settings.hdrFilename       = nvh::findFile(hdrFilename, defaultSearchPaths, true);
+    settings.size              = {uint32_t(parser.getInt("-width", SAMPLE_WIDTH)), uint32_t(parser.getInt("-height", SAMPLE_HEIGHT))};
+    settings.warmupFrames      = uint32_t(parser.getInt("-warmup", int(settings.warmupFrames)));
+    settings.frames            = uint32_t(parser.getInt("-frames", int(settings.frames)));
+    settings.csvFilename       = parser.getString("-csv", "");
+    settings.jsonFilename      = parser.getString("-json", "");
+    settings.cameraPathFile    = parser.getString("-camera-path", "");
+    settings.gridTour          = parser.exist("--grid-tour");
+    settings.pipelineBenchmark = parser.exist("--pipeline-bench");
+    settings.prebuildPipelines = parser.exist("--prebuild");
+    std::stringstream configs(parser.getString("-configs", ""));
+    for(std::string text; std::getline(configs, text, ',');)
+    {
+      ConfigId id;
+      if(parseConfigId(text, id))
+        settings.configIds.push_back(id);
+      else
+        LOGW("-configs: %s is not a configuration ID (16 hex digits), ignored\n", text.c_str());
+    }
+
+    int result = runHeadless(vkctx, settings);
+    vkctx.deinit();
+    return result;
+  }
+
 
   //
   SampleExample sample;
   sample.supportRayQuery(vkctx.hasDeviceExtension(VK_KHR_RAY_QUERY_EXTENSION_NAME));
+  sample.supportPipelineLibrary(vkctx.hasDeviceExtension(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME));
+  sample.prebuildPipelines = parser.exist("--prebuild");
+  if(parser.exist("-observation-log"))
+  {
+    sample.observationLogFile = parser.getString("-observation-log", sample.observationLogFile);
+    sample.setObservationLogging(true);
+  }
 
   // Window need to be opened to get the surface on which to draw
   const VkSurfaceKHR surface = sample.getVkSurface(vkctx.m_instance, window);
@@ -192,6 +249,8 @@ int main(int argc, char** argv)
     
     sample.createDescriptorSetLayout();
     sample.createRender(SampleExample::eRtxPipeline);
+    if(sample.prebuildPipelines)
+      sample.prebuildTunerPipelines();
     //sample.createUniformBufferProfiling();
     sample.resetFrame();
     sample.m_busy = false;
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <type_traits>
+
+#include "observation_log.hpp"
+
+
+static_assert(std::is_trivially_copyable<ObservationRecord>::value, "Records are written as is");
+static_assert(sizeof(ObservationRecord) == 88, "The record layout is part of the file format");
+static_assert(sizeof(ObservationLogHeader) == 32, "The header layout is part of the file format");
+
+bool ObservationLog::open(const std::string& filename)
+{
+  close();
+  m_error.clear();
+
+  // An existing log is checked and cut to whole records
+  namespace fs = std::filesystem;
+  std::error_code code;
+  uint64_t        size   = fs::exists(filename, code) ? fs::file_size(filename, code) : 0;
+  bool            exists = size > 0;
+  if(exists)
+  {
+    ObservationLogHeader header;
+    std::ifstream        in(filename, std::ios::binary);
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if(!in || std::memcmp(header.magic, kObservationLogMagic, sizeof(kObservationLogMagic)) != 0
+       || header.version != kObservationLogVersion || header.headerSize != sizeof(ObservationLogHeader)
+       || header.recordSize != sizeof(ObservationRecord))
+    {
+      m_error = filename + " is not an observation log of this version";
+      return false;
+    }
+    uint64_t whole = sizeof(header) + (size - sizeof(header)) / sizeof(ObservationRecord) * sizeof(ObservationRecord);
+    if(whole != size)
+      fs::resize_file(filename, whole, code);
+  }
+
+  m_file.open(filename, std::ios::binary | std::ios::app);
+  if(!m_file)
+  {
+    m_error = "cannot write " + filename;
+    return false;
+  }
+  if(!exists)
+  {
+    ObservationLogHeader header;
+    std::memcpy(header.magic, kObservationLogMagic, sizeof(kObservationLogMagic));
+    header.recordSize = sizeof(ObservationRecord);
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    m_file.flush();
+  }
+
+  m_filename = filename;
+  m_stopping = false;
+  m_flusher  = std::thread([this]() { flushLoop(); });
+  return true;
+}
+
+void ObservationLog::close()
+{
+  if(!m_flusher.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_wake.notify_one();
+  m_flusher.join();
+  m_file.close();
+}
+
+bool ObservationLog::append(const ObservationRecord& record)
+{
+  if(!isOpen())
+    return false;
+  if(!m_ring.push(record))
+  {
+    m_dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  // No lock: a missed wake-up only waits for the next period
+  if(m_ring.size() >= m_ring.capacity() / 2)
+    m_wake.notify_one();
+  return true;
+}
+
+void ObservationLog::flushLoop()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while(!m_stopping)
+  {
+    m_wake.wait_for(lock, std::chrono::milliseconds(kObservationFlushMs));
+    lock.unlock();
+    writeBatch();
+    lock.lock();
+  }
+  lock.unlock();
+  // Appended before close()
+  writeBatch();
+}
+
+void ObservationLog::writeBatch()
+{
+  m_batch.clear();
+  if(m_ring.popAll(m_batch) == 0)
+    return;
+  m_file.write(reinterpret_cast<const char*>(m_batch.data()), std::streamsize(m_batch.size() * sizeof(ObservationRecord)));
+  m_file.flush();
+  if(m_file)
+    m_written.fetch_add(m_batch.size(), std::memory_order_relaxed);
+  else
+    m_dropped.fetch_add(m_batch.size(), std::memory_order_relaxed);
+}
+
+bool ObservationLogReader::open(const std::string& filename)
+{
+  close();
+  if(!m_file.open(filename))
+    return fail("cannot open " + filename);
+  if(m_file.size() < sizeof(ObservationLogHeader))
+    return fail("file too small for an observation log header");
+
+  std::memcpy(&m_header, m_file.data(), sizeof(m_header));
+  if(std::memcmp(m_header.magic, kObservationLogMagic, sizeof(kObservationLogMagic)) != 0)
+    return fail("not an observation log");
+  if(m_header.version != kObservationLogVersion)
+    return fail("unsupported observation log version " + std::to_string(m_header.version));
+  if(m_header.headerSize != sizeof(ObservationLogHeader) || m_header.recordSize != sizeof(ObservationRecord))
+    return fail("observation log written with a different record layout");
+
+  // A record cut short is ignored
+  m_numRecords = (m_file.size() - sizeof(ObservationLogHeader)) / sizeof(ObservationRecord);
+  m_records    = reinterpret_cast<const ObservationRecord*>(m_file.data() + sizeof(ObservationLogHeader));
+  m_file.adviseSequential();
+  return true;
+}
+
+void ObservationLogReader::close()
+{
+  m_file.close();
+  m_records    = nullptr;
+  m_numRecords = 0;
+}
+
+bool ObservationLogReader::fail(const std::string& message)
+{
+  close();
+  m_error = message;
+  return false;
+}
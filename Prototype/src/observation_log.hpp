@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+//--------------------------------------------------------------------------------------------------
+// Append-only log of the tuner's observations (.kobs), one record per measurement window
+//
+// File layout: ObservationLogHeader, then ObservationRecord after ObservationRecord. Opening an
+// existing log of the same layout appends to it, a record cut short by a crash is dropped first.
+//
+// - append() is called by the render thread: it copies the record into a SpscRing and never
+//   waits. A full ring drops the record and counts it.
+// - A flusher thread drains the ring to the file every kObservationFlushMs, or sooner once the
+//   ring is half full
+// - ObservationLogReader maps a log for the offline tools (tools/observation_log_dump.cpp, which
+//   also round-trips made up records through both)
+//
+// No Vulkan dependency.
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include "mapped_file.hpp"
+#include "pipeline_config.hpp"
+#include "spsc_ring.hpp"
+
+
+static constexpr char     kObservationLogMagic[8] = {'K', 'I', 'O', 'B', 'S', 'L', 'O', 'G'};
+static constexpr uint32_t kObservationLogVersion  = 1;
+static constexpr uint32_t kObservationFlushMs     = 100;
+
+struct ObservationLogHeader
+{
+  char     magic[8]{};
+  uint32_t version{kObservationLogVersion};
+  uint32_t headerSize{sizeof(ObservationLogHeader)};
+  uint32_t recordSize{0};
+  uint32_t configIdVersion{kConfigIdVersion};
+  uint64_t reserved{0};
+};
+
+struct ObservationRecord
+{
+  uint64_t  timestampNs{0};  // System clock, since the Unix epoch
+  ConfigId  config{0};
+  uint64_t  gpuNs{0};       // Of the `frames` dispatches kept in the window
+  uint64_t  estimateNs{0};  // Steady state of one dispatch, what the tuner observed
+  uint32_t  cell{0};        // (z * gridY + y) * gridX + x
+  uint32_t  side{0};        // SampleExample::CubeSide
+  uint32_t  frames{0};
+  uint32_t  outliers{0};  // Dispatches left out of the estimate
+  glm::vec3 eye{0.0f};
+  glm::vec3 center{0.0f};
+  glm::vec3 up{0.0f};
+  float     fov{0.0f};
+};
+
+class ObservationLog
+{
+public:
+  explicit ObservationLog(size_t capacity = 4096)
+      : m_ring(capacity)
+  {
+  }
+  ObservationLog(const ObservationLog&) = delete;
+  ObservationLog& operator=(const ObservationLog&) = delete;
+  ~ObservationLog() { close(); }
+
+  // Creates the log or appends to it, false when the file is something else
+  bool open(const std::string& filename);
+  // Writes what is still in the ring
+  void close();
+  bool isOpen() const { return m_flusher.joinable(); }
+
+  // Render thread, never blocks. False when the log is closed or the ring is full.
+  bool append(const ObservationRecord& record);
+
+  uint64_t           written() const { return m_written.load(std::memory_order_relaxed); }
+  uint64_t           dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+  const std::string& filename() const { return m_filename; }
+  const std::string& error() const { return m_error; }
+
+private:
+  void flushLoop();
+  void writeBatch();
+
+  SpscRing<ObservationRecord>    m_ring;
+  std::vector<ObservationRecord> m_batch;  // Flusher thread
+  std::ofstream                  m_file;
+  std::string                    m_filename;
+  std::string                    m_error;
+
+  std::thread             m_flusher;
+  std::mutex              m_mutex;
+  std::condition_variable m_wake;
+  bool                    m_stopping{false};
+
+  std::atomic<uint64_t> m_written{0};
+  std::atomic<uint64_t> m_dropped{0};
+};
+
+
+//--------------------------------------------------------------------------------------------------
+// Validates the header on open, the records point into the mapping
+//
+class ObservationLogReader
+{
+public:
+  bool open(const std::string& filename);
+  void close();
+
+  const ObservationLogHeader& header() const { return m_header; }
+  size_t                      numRecords() const { return m_numRecords; }
+  const ObservationRecord*    records() const { return m_records; }
+  const std::string&          error() const { return m_error; }
+
+private:
+  bool fail(const std::string& message);
+
+  MappedFile               m_file;
+  ObservationLogHeader     m_header;
+  const ObservationRecord* m_records{nullptr};
+  size_t                   m_numRecords{0};
+  std::string              m_error;
+};
@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "nvh/nvprint.hpp"
+#include "pipeline_cache.hpp"
+
+
+static uint64_t fnv1a(const uint8_t* data, size_t size)
+{
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for(size_t i = 0; i < size; i++)
+  {
+    hash ^= data[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+void PersistentPipelineCache::init(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::string& directory)
+{
+  m_device     = device;
+  m_properties = properties;
+  m_dirty      = false;
+
+  char name[128];
+  snprintf(name, sizeof(name), "pipelines_%04x_%04x_%08x_", properties.vendorID, properties.deviceID, properties.driverVersion);
+  m_filename = directory + "/" + name;
+  for(uint8_t b : properties.pipelineCacheUUID)
+  {
+    snprintf(name, sizeof(name), "%02x", b);
+    m_filename += name;
+  }
+  m_filename += ".bin";
+}
+
+bool PersistentPipelineCache::load(std::vector<uint8_t>& data) const
+{
+  std::ifstream in(m_filename, std::ios::binary);
+  if(!in)
+    return false;
+
+  PipelineCacheFileHeader header;
+  if(!in.read(reinterpret_cast<char*>(&header), sizeof(header)))
+    return false;
+  if(memcmp(header.magic, kPipelineCacheMagic, sizeof(header.magic)) != 0 || header.version != kPipelineCacheVersion
+     || header.headerSize != sizeof(header) || header.vendorID != m_properties.vendorID
+     || header.deviceID != m_properties.deviceID || header.driverVersion != m_properties.driverVersion
+     || memcmp(header.pipelineCacheUUID, m_properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+  {
+    LOGI("Pipeline cache %s is of another device or version\n", m_filename.c_str());
+    return false;
+  }
+
+  // The size in the header sizes the allocation, it has to match the file first
+  std::error_code code;
+  uint64_t        fileSize = std::filesystem::file_size(m_filename, code);
+  if(code || header.dataSize != fileSize - sizeof(header))
+  {
+    LOGE("Pipeline cache %s is truncated or corrupted\n", m_filename.c_str());
+    return false;
+  }
+
+  data.resize(header.dataSize);
+  if(!in.read(reinterpret_cast<char*>(data.data()), std::streamsize(data.size())) || fnv1a(data.data(), data.size()) != header.checksum)
+  {
+    LOGE("Pipeline cache %s is truncated or corrupted\n", m_filename.c_str());
+    return false;
+  }
+
+  // The driver checks its own header as well, but not every driver survives garbage
+  VkPipelineCacheHeaderVersionOne vkHeader;
+  if(data.size() < sizeof(vkHeader))
+    return false;
+  memcpy(&vkHeader, data.data(), sizeof(vkHeader));
+  return vkHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE && vkHeader.vendorID == m_properties.vendorID
+         && vkHeader.deviceID == m_properties.deviceID
+         && memcmp(vkHeader.pipelineCacheUUID, m_properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+VkPipelineCache PersistentPipelineCache::create()
+{
+  std::vector<uint8_t> data;
+  bool                 valid = load(data);
+
+  VkPipelineCacheCreateInfo createInfo{VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+  createInfo.initialDataSize = valid ? data.size() : 0;
+  createInfo.pInitialData    = valid ? data.data() : nullptr;
+
+  VkPipelineCache cache{VK_NULL_HANDLE};
+  if(vkCreatePipelineCache(m_device, &createInfo, nullptr, &cache) != VK_SUCCESS && valid)
+  {
+    // Rejected by the driver, start over
+    createInfo.initialDataSize = 0;
+    createInfo.pInitialData    = nullptr;
+    vkCreatePipelineCache(m_device, &createInfo, nullptr, &cache);
+    valid = false;
+  }
+  if(valid)
+    LOGI("Pipeline cache: %zu KB from %s\n", data.size() / 1024, m_filename.c_str());
+  return cache;
+}
+
+void PersistentPipelineCache::save(VkPipelineCache cache)
+{
+  if(!m_dirty || cache == VK_NULL_HANDLE)
+    return;
+
+  // Another run may have added its own variants since this cache was loaded
+  std::vector<uint8_t> data;
+  if(load(data))
+  {
+    VkPipelineCacheCreateInfo createInfo{VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+    createInfo.initialDataSize = data.size();
+    createInfo.pInitialData    = data.data();
+    VkPipelineCache onDisk{VK_NULL_HANDLE};
+    if(vkCreatePipelineCache(m_device, &createInfo, nullptr, &onDisk) == VK_SUCCESS)
+    {
+      vkMergePipelineCaches(m_device, cache, 1, &onDisk);
+      vkDestroyPipelineCache(m_device, onDisk, nullptr);
+    }
+  }
+
+  size_t size{0};
+  vkGetPipelineCacheData(m_device, cache, &size, nullptr);
+  data.resize(size);
+  if(vkGetPipelineCacheData(m_device, cache, &size, data.data()) != VK_SUCCESS)
+    return;
+  data.resize(size);
+
+  PipelineCacheFileHeader header;
+  memcpy(header.magic, kPipelineCacheMagic, sizeof(header.magic));
+  header.vendorID      = m_properties.vendorID;
+  header.deviceID      = m_properties.deviceID;
+  header.driverVersion = m_properties.driverVersion;
+  memcpy(header.pipelineCacheUUID, m_properties.pipelineCacheUUID, VK_UUID_SIZE);
+  header.dataSize = data.size();
+  header.checksum = fnv1a(data.data(), data.size());
+
+  std::error_code error;
+  std::filesystem::create_directories(std::filesystem::path(m_filename).parent_path(), error);
+  std::string temporary = m_filename + ".tmp";
+  {
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+    if(!out)
+    {
+      LOGE("Cannot write %s\n", temporary.c_str());
+      return;
+    }
+  }
+  std::filesystem::rename(temporary, m_filename, error);
+  if(error)
+  {
+    LOGE("Cannot replace %s: %s\n", m_filename.c_str(), error.message().c_str());
+    return;
+  }
+  m_dirty = false;
+  LOGI("Pipeline cache: %zu KB to %s\n", data.size() / 1024, m_filename.c_str());
+}
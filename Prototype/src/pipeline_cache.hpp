@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+//--------------------------------------------------------------------------------------------------
+// VkPipelineCache kept on disk between runs
+//
+// - One file per device and driver: pipelines_<vendor>_<device>_<driver>_<pipelineCacheUUID>.bin
+// - PipelineCacheFileHeader in front of the data of vkGetPipelineCacheData. A file of another
+//   device or driver, truncated or with a wrong checksum is ignored: the cache starts empty and
+//   the next save replaces the file.
+// - save() first merges what another run wrote in the meantime, then replaces the file with a
+//   rename, a crash never leaves half a file behind
+//
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+
+static constexpr char     kPipelineCacheMagic[8] = {'K', 'I', 'P', 'L', 'C', 'A', 'C', 'H'};
+static constexpr uint32_t kPipelineCacheVersion  = 1;
+
+struct PipelineCacheFileHeader
+{
+  char     magic[8]{};
+  uint32_t version{kPipelineCacheVersion};
+  uint32_t headerSize{sizeof(PipelineCacheFileHeader)};
+  uint32_t vendorID{0};
+  uint32_t deviceID{0};
+  uint32_t driverVersion{0};
+  uint8_t  pipelineCacheUUID[VK_UUID_SIZE]{};
+  uint32_t _pad0{0};
+  uint64_t dataSize{0};
+  uint64_t checksum{0};  // FNV-1a of the data
+};
+
+class PersistentPipelineCache
+{
+public:
+  void init(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::string& directory);
+
+  // New VkPipelineCache with the content of the file, empty without a valid file
+  VkPipelineCache create();
+  // Pipelines were created with the cache since the last save, from any thread
+  void markDirty() { m_dirty = true; }
+  // Writes the cache when dirty, merged with the current file
+  void save(VkPipelineCache cache);
+
+  const std::string& filename() const { return m_filename; }
+
+private:
+  // Validated content of the file, false when there is none
+  bool load(std::vector<uint8_t>& data) const;
+
+  VkDevice                   m_device{VK_NULL_HANDLE};
+  VkPhysicalDeviceProperties m_properties{};
+  std::string                m_filename;
+  std::atomic<bool>          m_dirty{false};
+};
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+//--------------------------------------------------------------------------------------------------
+// Canonical 64-bit identifier of a ray tracing pipeline configuration
+//
+// Everything that changes the compiled pipeline or its performance, packed without loss:
+//
+//   bits  0- 7  SortingFlagBits, only eSortingNoSort when noSort (the other flags do not matter)
+//   bits  8-14  numCoherenceBitsTotal, 0 when noSort
+//   bits 15-20  key bits of the origin         (SortingKeyBudget, specialization constants 12-15),
+//               the budget fields are 0 when noSort
+//   bits 21-26  key bits of the direction
+//   bits 27-32  key bits of the endpoint
+//   bit  33     key bit of the finished flag
+//   bits 34-37  sorting mode                   (specialization constant 0)
+//   bit  38     any hit shader in the hit group
+//   bit  39     profiling                      (specialization constant 1)
+//   bits 40-55  0
+//   bits 56-63  kConfigIdVersion
+//
+// decodeConfigId(encodeConfigId(c)) == c for every canonical configuration. The ID keys the
+// pipeline pool, the grid statistics and the result files, written as 16 hex digits.
+// Bump kConfigIdVersion when the layout or the meaning of a field changes.
+//
+// No Vulkan dependency.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "shaders/sorting_keys.h"
+#include "sorting_configs.hpp"
+
+
+using ConfigId = uint64_t;
+
+static constexpr uint32_t kConfigIdVersion = 1;
+
+struct PipelineConfig
+{
+  SortingParameters parameters{};
+  SortingKeyBudget  budget{};
+  uint32_t          sortingMode{0};
+  bool              anyhit{false};
+  bool              profiling{false};
+};
+
+// The flags of a configuration as the ID keeps them
+constexpr uint32_t canonicalSortingFlags(const SortingParameters& p)
+{
+  return p.noSort ? uint32_t(eSortingNoSort) : sortingFlags(p);
+}
+
+constexpr ConfigId encodeConfigId(const PipelineConfig& c)
+{
+  // Without sorting no key is built, the coherence bits and the budget do not matter either
+  bool     noSort = c.parameters.noSort;
+  ConfigId key    = noSort ? 0 :
+                             ConfigId(c.parameters.numCoherenceBitsTotal & 0x7f) << 8 | ConfigId(c.budget.origin & 0x3f) << 15
+                              | ConfigId(c.budget.direction & 0x3f) << 21 | ConfigId(c.budget.endpoint & 0x3f) << 27
+                              | ConfigId(c.budget.finished & 0x1) << 33;
+  return ConfigId(canonicalSortingFlags(c.parameters)) | key | ConfigId(c.sortingMode & 0xf) << 34
+         | ConfigId(c.anyhit) << 38 | ConfigId(c.profiling) << 39 | ConfigId(kConfigIdVersion) << 56;
+}
+
+// False for another version or bits that no configuration sets
+constexpr bool decodeConfigId(ConfigId id, PipelineConfig& c)
+{
+  if((id >> 56) != kConfigIdVersion || ((id >> 40) & 0xffff) != 0)
+    return false;
+  uint32_t flags = uint32_t(id & 0xff);
+  if((flags & eSortingNoSort) && (flags != eSortingNoSort || ((id >> 8) & 0x3ffffff) != 0))
+    return false;
+
+  c.parameters         = sortingParameters(flags, uint32_t(id >> 8) & 0x7f);
+  c.budget.origin      = uint32_t(id >> 15) & 0x3f;
+  c.budget.direction   = uint32_t(id >> 21) & 0x3f;
+  c.budget.endpoint    = uint32_t(id >> 27) & 0x3f;
+  c.budget.finished    = uint32_t(id >> 33) & 0x1;
+  c.sortingMode        = uint32_t(id >> 34) & 0xf;
+  c.anyhit             = (id >> 38) & 0x1;
+  c.profiling          = (id >> 39) & 0x1;
+  return true;
+}
+
+inline std::string configIdString(ConfigId id)
+{
+  char text[17];
+  snprintf(text, sizeof(text), "%016llx", (unsigned long long)id);
+  return text;
+}
+
+// 16 hex digits as written by configIdString(), a leading 0x is accepted
+inline bool parseConfigId(const std::string& text, ConfigId& id)
+{
+  const char* begin = text.c_str();
+  if(text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X'))
+    begin += 2;
+  if(*begin == '\0')
+    return false;
+  char* end = nullptr;
+  id        = std::strtoull(begin, &end, 16);
+  return *end == '\0';
+}
@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+//--------------------------------------------------------------------------------------------------
+// Pipelines built in the background by a few worker threads
+//
+// - A request is a key chosen by the caller (the tuner arm), a priority and the job building it.
+//   The workers take the pending request with the highest priority first, requesting a key again
+//   only updates its priority.
+// - The ready queue is bounded: a worker does not start a job while the finished and running jobs
+//   fill it, a frame that does not poll never piles up pipelines
+// - poll() never blocks, the render thread takes at most what is ready
+// - cancel() drops the pending requests and waits for the running jobs, e.g. before the pipeline
+//   layout is destroyed on a scene reload. The results it drops are handed back to be destroyed.
+// - Idle workers sleep on a condition variable, nothing spins
+//
+// No Vulkan dependency, `Result` is whatever a job builds (RtxPipeline: CompiledPipeline).
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+template <class Result>
+class PipelineFactory
+{
+public:
+  using Job = std::function<Result()>;
+
+  struct Stats
+  {
+    uint32_t pending{0};
+    uint32_t building{0};
+    uint32_t ready{0};
+    uint64_t built{0};      // Since start()
+    uint64_t cancelled{0};  // Requests and results dropped by cancel()
+  };
+
+  PipelineFactory() = default;
+  PipelineFactory(const PipelineFactory&) = delete;
+  PipelineFactory& operator=(const PipelineFactory&) = delete;
+  // The results still queued are lost, cancel() first to destroy them
+  ~PipelineFactory() { stop(); }
+
+  void start(uint32_t numWorkers, uint32_t readyCapacity)
+  {
+    stop();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = false;
+    m_capacity = std::max(readyCapacity, 1u);
+    m_built    = 0;
+    for(uint32_t i = 0; i < std::max(numWorkers, 1u); i++)
+      m_workers.emplace_back([this]() { work(); });
+  }
+
+  void stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopping = true;
+      m_pending.clear();
+    }
+    m_wake.notify_all();
+    for(std::thread& worker : m_workers)
+      worker.join();
+    m_workers.clear();
+  }
+
+  // False when the key is already being built or ready, a pending key gets the new priority
+  bool request(int key, double priority, Job job)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if(std::find(m_buildingKeys.begin(), m_buildingKeys.end(), key) != m_buildingKeys.end())
+        return false;
+      for(const Ready& ready : m_ready)
+        if(ready.key == key)
+          return false;
+      for(Request& pending : m_pending)
+      {
+        if(pending.key == key)
+        {
+          pending.priority = priority;
+          return false;
+        }
+      }
+      m_pending.push_back({key, priority, std::move(job)});
+    }
+    m_wake.notify_one();
+    return true;
+  }
+
+  // A finished build, false when none is ready
+  bool poll(int& key, Result& result)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if(m_ready.empty())
+        return false;
+      key    = m_ready.front().key;
+      result = std::move(m_ready.front().result);
+      m_ready.pop_front();
+    }
+    // A slot of the ready queue is free again
+    m_wake.notify_one();
+    return true;
+  }
+
+  // Drops the pending requests and waits for the running jobs, `dropped` receives every result
+  // that was not polled
+  void cancel(std::vector<Result>& dropped)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cancelled += m_pending.size();
+    m_pending.clear();
+    m_idle.wait(lock, [this]() { return m_buildingKeys.empty(); });
+    m_cancelled += m_ready.size();
+    for(Ready& ready : m_ready)
+      dropped.push_back(std::move(ready.result));
+    m_ready.clear();
+  }
+
+  bool contains(int key)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto                        same = [key](const auto& entry) { return entry.key == key; };
+    return std::any_of(m_pending.begin(), m_pending.end(), same) || std::any_of(m_ready.begin(), m_ready.end(), same)
+           || std::find(m_buildingKeys.begin(), m_buildingKeys.end(), key) != m_buildingKeys.end();
+  }
+
+  Stats stats()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats                       s;
+    s.pending   = uint32_t(m_pending.size());
+    s.building  = uint32_t(m_buildingKeys.size());
+    s.ready     = uint32_t(m_ready.size());
+    s.built     = m_built;
+    s.cancelled = m_cancelled;
+    return s;
+  }
+
+private:
+  struct Request
+  {
+    int    key;
+    double priority;
+    Job    job;
+  };
+  struct Ready
+  {
+    int    key;
+    Result result;
+  };
+
+  void work()
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(true)
+    {
+      m_wake.wait(lock, [this]() {
+        return m_stopping || (!m_pending.empty() && m_ready.size() + m_buildingKeys.size() < m_capacity);
+      });
+      if(m_stopping)
+        return;
+
+      auto next = std::max_element(m_pending.begin(), m_pending.end(),
+                                   [](const Request& a, const Request& b) { return a.priority < b.priority; });
+      Request request = std::move(*next);
+      m_pending.erase(next);
+      m_buildingKeys.push_back(request.key);
+
+      lock.unlock();
+      Result result = request.job();
+      lock.lock();
+
+      m_buildingKeys.erase(std::find(m_buildingKeys.begin(), m_buildingKeys.end(), request.key));
+      m_ready.push_back({request.key, std::move(result)});
+      m_built++;
+      m_idle.notify_all();
+    }
+  }
+
+  std::mutex               m_mutex;
+  std::condition_variable  m_wake;  // Pending work and a free slot, or stop
+  std::condition_variable  m_idle;  // A job finished
+  std::vector<std::thread> m_workers;
+  std::vector<Request>     m_pending;  // A few dozen at most, one per tuner arm
+  std::vector<int>         m_buildingKeys;
+  std::deque<Ready>        m_ready;
+  uint32_t                 m_capacity{4};
+  bool                     m_stopping{false};
+  uint64_t                 m_built{0};
+  uint64_t                 m_cancelled{0};
+};
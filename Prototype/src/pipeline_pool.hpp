@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+//--------------------------------------------------------------------------------------------------
+// Built pipelines by config key, within a memory budget
+//
+// - One element per key: a variant that is already built is found instead of built again
+// - Over the budget the least recently used elements are evicted, except the protected keys (the
+//   best config of the grid cells), the one in use and the one just inserted (the caller is about
+//   to bind it). The pool may stay over budget when everything left is protected.
+// - Evicted elements are handed back to the caller, who knows when the GPU is done with them
+// - Not thread safe, the render thread owns it
+//
+// No Vulkan dependency, `Element` is what is kept per key (RtxPipeline: PipelineStorage).
+
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+
+template <class Element>
+class PipelinePool
+{
+public:
+  struct Stats
+  {
+    uint32_t entries{0};
+    uint32_t protectedEntries{0};
+    uint64_t bytes{0};
+    uint64_t budget{0};
+    uint64_t hits{0};
+    uint64_t misses{0};
+    uint64_t evictions{0};
+
+    double hitRate() const { return hits + misses > 0 ? double(hits) / double(hits + misses) : 0.0; }
+  };
+
+  void     setBudget(uint64_t bytes) { m_budget = bytes; }
+  uint64_t budget() const { return m_budget; }
+
+  // The element of the key, now the most recently used. nullptr when it is not in the pool.
+  const Element* find(uint64_t key)
+  {
+    auto it = m_entries.find(key);
+    if(it == m_entries.end())
+    {
+      m_misses++;
+      return nullptr;
+    }
+    m_hits++;
+    m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+    return &it->second.element;
+  }
+
+  // Neither counted nor refreshed
+  bool contains(uint64_t key) const { return m_entries.count(key) != 0; }
+
+  // Takes the element, `evicted` receives what goes to stay within the budget (and an element
+  // the key already had). The new element itself is never evicted here.
+  void insert(uint64_t key, const Element& element, uint64_t bytes, std::vector<Element>& evicted)
+  {
+    auto it = m_entries.find(key);
+    if(it != m_entries.end())
+    {
+      evicted.push_back(it->second.element);
+      m_bytes -= it->second.bytes;
+      m_lru.erase(it->second.lru);
+      m_entries.erase(it);
+    }
+    m_lru.push_front(key);
+    m_entries[key] = {element, bytes, m_lru.begin()};
+    m_bytes += bytes;
+    evictOverBudget(evicted, key);
+  }
+
+  // Replaces the protected keys, they may not be in the pool (yet)
+  void setProtected(const std::vector<uint64_t>& keys) { m_protected = std::unordered_set<uint64_t>(keys.begin(), keys.end()); }
+  // The key bound for rendering, never evicted
+  void setInUse(uint64_t key) { m_inUse = key; }
+
+  // `keep` stays as well, the pool may remain over budget for it
+  void evictOverBudget(std::vector<Element>& evicted, uint64_t keep = ~0ull)
+  {
+    auto it = m_lru.end();
+    while(m_bytes > m_budget && it != m_lru.begin())
+    {
+      --it;
+      uint64_t key = *it;
+      if(key == keep || key == m_inUse || m_protected.count(key) != 0)
+        continue;
+      auto entry = m_entries.find(key);
+      evicted.push_back(entry->second.element);
+      m_bytes -= entry->second.bytes;
+      m_entries.erase(entry);
+      it = m_lru.erase(it);
+      m_evictions++;
+    }
+  }
+
+  // The least recently used element that may go, within the budget or not. False when every
+  // element is protected or in use.
+  bool evictLeastRecent(std::vector<Element>& evicted)
+  {
+    for(auto it = m_lru.rbegin(); it != m_lru.rend(); ++it)
+    {
+      uint64_t key = *it;
+      if(key == m_inUse || m_protected.count(key) != 0)
+        continue;
+      auto entry = m_entries.find(key);
+      evicted.push_back(entry->second.element);
+      m_bytes -= entry->second.bytes;
+      m_entries.erase(entry);
+      m_lru.erase(std::next(it).base());
+      m_evictions++;
+      return true;
+    }
+    return false;
+  }
+
+  // Everything goes to `all`, the statistics are kept
+  void clear(std::vector<Element>& all)
+  {
+    for(auto& entry : m_entries)
+      all.push_back(entry.second.element);
+    m_entries.clear();
+    m_lru.clear();
+    m_bytes = 0;
+  }
+
+  Stats stats() const
+  {
+    Stats s;
+    s.entries = uint32_t(m_entries.size());
+    for(uint64_t key : m_protected)
+      s.protectedEntries += uint32_t(m_entries.count(key));
+    s.bytes     = m_bytes;
+    s.budget    = m_budget;
+    s.hits      = m_hits;
+    s.misses    = m_misses;
+    s.evictions = m_evictions;
+    return s;
+  }
+
+private:
+  struct Entry
+  {
+    Element                       element;
+    uint64_t                      bytes{0};
+    std::list<uint64_t>::iterator lru;
+  };
+
+  std::unordered_map<uint64_t, Entry> m_entries;
+  std::list<uint64_t>                 m_lru;  // Most recently used first
+  std::unordered_set<uint64_t>        m_protected;
+  uint64_t                            m_inUse{~0ull};
+  uint64_t                            m_budget{~0ull};
+  uint64_t                            m_bytes{0};
+  uint64_t                            m_hits{0};
+  uint64_t                            m_misses{0};
+  uint64_t                            m_evictions{0};
+};
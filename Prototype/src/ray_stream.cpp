@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <cstring>
+#include <type_traits>
+
+#include "ray_stream.hpp"
+
+
+static_assert(std::is_trivially_copyable<RayStreamHeader>::value, "The header is written as is");
+static_assert(std::is_trivially_copyable<RayRecord>::value, "Records are written as is");
+static_assert(sizeof(RayRecord) == 44, "RayRecord must match the scalar layout of the shader");
+static_assert(sizeof(RayStreamHeader) <= kRayStreamAlignment, "The header must fit in the first block");
+
+static uint64_t alignUp(uint64_t value)
+{
+  return (value + kRayStreamAlignment - 1) & ~(kRayStreamAlignment - 1);
+}
+
+static uint64_t chunkBytes(uint32_t numRecords)
+{
+  return alignUp(sizeof(RayStreamChunk) + uint64_t(numRecords) * sizeof(RayRecord));
+}
+
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+bool RayStreamWriter::open(const std::string& filename, const RayStreamHeader& header, uint32_t chunkRecords)
+{
+  close();
+  m_file.open(filename, std::ios::binary | std::ios::trunc);
+  if(!m_file)
+    return false;
+
+  m_header = header;
+  std::memcpy(m_header.magic, kRayStreamMagic, sizeof(kRayStreamMagic));
+  m_header.version    = kRayStreamVersion;
+  m_header.headerSize = sizeof(RayStreamHeader);
+  m_header.recordSize = sizeof(RayRecord);
+  m_header.numRecords = 0;
+  m_header.numChunks  = 0;
+  m_chunkRecords      = chunkRecords > 0 ? chunkRecords : 1;
+  m_pending.clear();
+  m_pending.reserve(m_chunkRecords + size_t(std::max(1, m_header.state.maxDepth)));
+
+  // Placeholder, rewritten with the counts on close
+  std::vector<char> block(kRayStreamAlignment, 0);
+  std::memcpy(block.data(), &m_header, sizeof(m_header));
+  m_file.write(block.data(), block.size());
+  return bool(m_file);
+}
+
+void RayStreamWriter::append(const RayRecord* records, size_t count)
+{
+  for(size_t i = 0; i < count; i++)
+  {
+    // Chunks only end before the first bounce of a path
+    if(m_pending.size() >= m_chunkRecords && records[i].depth == 0)
+      flushChunk();
+    m_pending.push_back(records[i]);
+  }
+}
+
+void RayStreamWriter::flushChunk()
+{
+  if(m_pending.empty())
+    return;
+
+  RayStreamChunk chunk;
+  chunk.numRecords  = uint32_t(m_pending.size());
+  chunk.firstRecord = m_header.numRecords;
+
+  uint64_t used = sizeof(chunk) + m_pending.size() * sizeof(RayRecord);
+  m_file.write(reinterpret_cast<const char*>(&chunk), sizeof(chunk));
+  m_file.write(reinterpret_cast<const char*>(m_pending.data()), m_pending.size() * sizeof(RayRecord));
+  static const char zeros[kRayStreamAlignment]{};
+  m_file.write(zeros, chunkBytes(chunk.numRecords) - used);
+
+  m_header.numRecords += chunk.numRecords;
+  m_header.numChunks++;
+  m_pending.clear();
+}
+
+bool RayStreamWriter::close()
+{
+  if(!m_file.is_open())
+    return false;
+
+  flushChunk();
+  m_file.seekp(0);
+  m_file.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+  bool ok = bool(m_file);
+  m_file.close();
+  return ok;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+bool RayStreamReader::fail(const std::string& message)
+{
+  m_error = message;
+  m_file.close();
+  m_chunks.clear();
+  return false;
+}
+
+bool RayStreamReader::open(const std::string& filename)
+{
+  close();
+  if(!m_file.open(filename))
+    return fail("cannot open " + filename);
+  if(m_file.size() < kRayStreamAlignment)
+    return fail("file too small for a ray stream header");
+
+  std::memcpy(&m_header, m_file.data(), sizeof(m_header));
+  if(std::memcmp(m_header.magic, kRayStreamMagic, sizeof(kRayStreamMagic)) != 0)
+    return fail("not a ray stream");
+  if(m_header.version != kRayStreamVersion)
+    return fail("unsupported ray stream version " + std::to_string(m_header.version));
+  if(m_header.headerSize != sizeof(RayStreamHeader) || m_header.recordSize != sizeof(RayRecord))
+    return fail("ray stream written with a different RayRecord or RtxState layout");
+
+  // Every chunk takes at least chunkBytes(0) and every record its size, a corrupted count must not
+  // size the index
+  uint64_t payload = m_file.size() - kRayStreamAlignment;
+  if(m_header.numChunks > payload / chunkBytes(0) || m_header.numRecords > payload / sizeof(RayRecord))
+    return fail("corrupted ray stream, more chunks or records than the file holds");
+
+  // Index the chunks, checking that each one is complete
+  uint64_t offset = kRayStreamAlignment;
+  uint64_t first  = 0;
+  m_chunks.reserve(size_t(m_header.numChunks));
+  for(uint64_t c = 0; c < m_header.numChunks; c++)
+  {
+    if(offset + sizeof(RayStreamChunk) > m_file.size())
+      return fail("truncated ray stream, chunk " + std::to_string(c) + " is missing");
+
+    RayStreamChunk chunk;
+    std::memcpy(&chunk, m_file.data() + offset, sizeof(chunk));
+    if(chunk.magic != kRayStreamChunkMagic || chunk.firstRecord != first
+       || offset + sizeof(chunk) + uint64_t(chunk.numRecords) * sizeof(RayRecord) > m_file.size())
+      return fail("corrupted ray stream, chunk " + std::to_string(c));
+
+    RayStreamChunkView view;
+    view.records     = reinterpret_cast<const RayRecord*>(m_file.data() + offset + sizeof(chunk));
+    view.numRecords  = chunk.numRecords;
+    view.firstRecord = chunk.firstRecord;
+    m_chunks.push_back(view);
+
+    first += chunk.numRecords;
+    offset += chunkBytes(chunk.numRecords);
+  }
+  if(first != m_header.numRecords)
+    return fail("ray stream record count does not match its chunks");
+
+  m_file.adviseSequential();
+  return true;
+}
+
+void RayStreamReader::close()
+{
+  m_file.close();
+  m_chunks.clear();
+  m_header = {};
+  m_error.clear();
+}
+
+
+size_t compactRayRecords(const RayRecord* slots, size_t numSlots, std::vector<RayRecord>& records)
+{
+  size_t before = records.size();
+  for(size_t i = 0; i < numSlots; i++)
+  {
+    if(slots[i].depth >= 0)
+      records.push_back(slots[i]);
+  }
+  return records.size() - before;
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+//--------------------------------------------------------------------------------------------------
+// Binary ray stream: the bounces of the captured pixels of one frame
+//
+// File layout, every block starting on a kRayStreamAlignment boundary:
+//   RayStreamHeader
+//   RayStreamChunk + RayRecord[numRecords]
+//   RayStreamChunk + RayRecord[numRecords]
+//   ...
+// The records of a path are consecutive and never split over two chunks, so a chunk can be
+// processed on its own. The reader maps the file and hands out chunks without copying.
+//
+// No Vulkan dependency: this is used by the application and by the offline tools.
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include "shaders/host_device.h"
+#include "mapped_file.hpp"
+
+
+static constexpr char     kRayStreamMagic[8]  = {'K', 'I', 'R', 'A', 'Y', 'S', 'T', 'R'};
+static constexpr uint32_t kRayStreamVersion   = 1;
+static constexpr uint32_t kRayStreamChunkMagic = 0x4b4e4843;  // "CHNK"
+static constexpr uint64_t kRayStreamAlignment = 4096;
+
+struct RayStreamHeader
+{
+  char     magic[8]{};
+  uint32_t version{kRayStreamVersion};
+  uint32_t headerSize{sizeof(RayStreamHeader)};
+  uint32_t recordSize{sizeof(RayRecord)};
+  uint32_t captureStride{1};  // RtxState::rayCaptureStride of the capture
+  uint64_t numRecords{0};
+  uint64_t numChunks{0};
+  uint32_t width{0};  // Frame size
+  uint32_t height{0};
+  glm::vec3   sceneMin{0.0f};
+  glm::vec3   sceneMax{0.0f};
+  SceneCamera camera{};
+  RtxState    state{};
+};
+
+struct RayStreamChunk
+{
+  uint32_t magic{kRayStreamChunkMagic};
+  uint32_t numRecords{0};
+  uint64_t firstRecord{0};  // Index of the first record in the whole stream
+};
+
+struct RayStreamChunkView
+{
+  const RayRecord* records{nullptr};
+  uint32_t         numRecords{0};
+  uint64_t         firstRecord{0};
+};
+
+
+//--------------------------------------------------------------------------------------------------
+// Writes records as they come, in chunks of about `chunkRecords`
+//
+class RayStreamWriter
+{
+public:
+  ~RayStreamWriter() { close(); }
+
+  // Counts and magic of `header` are filled by the writer
+  bool open(const std::string& filename, const RayStreamHeader& header, uint32_t chunkRecords = 1 << 16);
+  // Records must come path by path, depth 0 first
+  void append(const RayRecord* records, size_t count);
+  // Writes the last chunk and the final header
+  bool close();
+
+private:
+  void flushChunk();
+
+  std::ofstream          m_file;
+  RayStreamHeader        m_header;
+  std::vector<RayRecord> m_pending;
+  uint32_t               m_chunkRecords{0};
+};
+
+
+//--------------------------------------------------------------------------------------------------
+// Validates the file on open and indexes the chunks
+//
+class RayStreamReader
+{
+public:
+  bool open(const std::string& filename);
+  void close();
+
+  const RayStreamHeader& header() const { return m_header; }
+  size_t                 numChunks() const { return m_chunks.size(); }
+  RayStreamChunkView     chunk(size_t index) const { return m_chunks[index]; }
+  const std::string&     error() const { return m_error; }
+
+private:
+  bool fail(const std::string& message);
+
+  MappedFile                      m_file;
+  RayStreamHeader                 m_header;
+  std::vector<RayStreamChunkView> m_chunks;
+  std::string                     m_error;
+};
+
+
+// Keeps only the used slots of a capture buffer (depth >= 0), in path order
+size_t compactRayRecords(const RayRecord* slots, size_t numSlots, std::vector<RayRecord>& records);
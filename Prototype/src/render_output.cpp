@@ -53,6 +53,8 @@ void RenderOutput::destroy()
   m_pAlloc->destroy(m_offscreenColor);
   m_pAlloc->destroy(m_profilingBuffer);
   m_pAlloc->destroy(m_timingBuffer);
+  m_pAlloc->destroy(m_rayCaptureBuffer);
+  m_pAlloc->destroy(m_rayCaptureReadback);
 
   vkDestroyPipeline(m_device, m_postPipeline, nullptr);
   vkDestroyPipelineLayout(m_device, m_postPipelineLayout, nullptr);
@@ -65,6 +67,7 @@ void RenderOutput::create(const VkExtent2D& size, const VkRenderPass& renderPass
   MilliTimer timer;
   LOGI("Create Offscreen");
   createTimingBuffer(); //create the TimingData UniformBuffer
+  createRayCaptureBuffer(1);  // Placeholder until a capture is requested
   createProfilingBuffer(size);
   createOffscreenRender(size);
   createPostPipeline(renderPass);
@@ -190,6 +193,8 @@ void RenderOutput::createPostDescriptor()
                    VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR});
   bind.addBinding({OutputBindings::eTiming, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
                    VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR});
+  bind.addBinding({OutputBindings::eRayCapture, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                   VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR});
 
   m_postDescSetLayout = bind.createLayout(m_device);
   m_postDescPool      = bind.createPool(m_device);
@@ -198,10 +203,12 @@ void RenderOutput::createPostDescriptor()
   std::vector<VkWriteDescriptorSet> writes;
   VkDescriptorBufferInfo            profilingDesc{m_profilingBuffer.buffer, 0, VK_WHOLE_SIZE};
   VkDescriptorBufferInfo            timingDesc{m_timingBuffer.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo            rayCaptureDesc{m_rayCaptureBuffer.buffer, 0, VK_WHOLE_SIZE};
   writes.emplace_back(bind.makeWrite(m_postDescSet, OutputBindings::eSampler, &m_offscreenColor.descriptor));  // This is use by the tonemapper
   writes.emplace_back(bind.makeWrite(m_postDescSet, OutputBindings::eStore, &m_offscreenColor.descriptor));  // This will be used by the ray trace to write the image
   writes.emplace_back(bind.makeWrite(m_postDescSet, OutputBindings::eProfiling,&profilingDesc));  // This will be used by the ray trace to store Profiling Data
   writes.emplace_back(bind.makeWrite(m_postDescSet, OutputBindings::eTiming,&timingDesc));
+  writes.emplace_back(bind.makeWrite(m_postDescSet, OutputBindings::eRayCapture, &rayCaptureDesc));
   vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 }
 
@@ -241,4 +248,88 @@ void RenderOutput::createTimingBuffer()
   m_timingBuffer = m_pAlloc->createBuffer(sizeof(TimingData), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);                               
   NAME_VK(m_timingBuffer.buffer);
-}
\ No newline at end of file
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Ray stream capture
+// - One RayRecord slot per bounce of each captured pixel, see RtxState::rayCaptureStride
+// - The device buffer is cleared to 0xFF before the frame: unused slots read as depth -1
+// - The caller must make sure the buffer is not in use when resizing it
+//
+void RenderOutput::createRayCaptureBuffer(VkDeviceSize numSlots)
+{
+  m_pAlloc->destroy(m_rayCaptureBuffer);
+  m_pAlloc->destroy(m_rayCaptureReadback);
+
+  m_rayCaptureSlots    = std::max<VkDeviceSize>(numSlots, 1);
+  VkDeviceSize size    = m_rayCaptureSlots * sizeof(RayRecord);
+  m_rayCaptureBuffer   = m_pAlloc->createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  m_rayCaptureReadback = m_pAlloc->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+  NAME_VK(m_rayCaptureBuffer.buffer);
+  NAME_VK(m_rayCaptureReadback.buffer);
+
+  if(m_postDescSet != VK_NULL_HANDLE)
+    updateRayCaptureDescriptor();
+}
+
+void RenderOutput::updateRayCaptureDescriptor()
+{
+  VkDescriptorBufferInfo rayCaptureDesc{m_rayCaptureBuffer.buffer, 0, VK_WHOLE_SIZE};
+  VkWriteDescriptorSet   write{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+  write.dstSet          = m_postDescSet;
+  write.dstBinding      = OutputBindings::eRayCapture;
+  write.descriptorCount = 1;
+  write.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  write.pBufferInfo     = &rayCaptureDesc;
+  vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+}
+
+void RenderOutput::cmdBeginRayCapture(VkCommandBuffer cmdBuf)
+{
+  vkCmdFillBuffer(cmdBuf, m_rayCaptureBuffer.buffer, 0, VK_WHOLE_SIZE, 0xFFFFFFFF);
+
+  VkBufferMemoryBarrier barrier{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+  barrier.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask       = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer              = m_rayCaptureBuffer.buffer;
+  barrier.size                = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
+                       nullptr, 1, &barrier, 0, nullptr);
+}
+
+void RenderOutput::cmdEndRayCapture(VkCommandBuffer cmdBuf)
+{
+  VkBufferMemoryBarrier barrier{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+  barrier.srcAccessMask       = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask       = VK_ACCESS_TRANSFER_READ_BIT;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer              = m_rayCaptureBuffer.buffer;
+  barrier.size                = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+  VkBufferCopy region{0, 0, m_rayCaptureSlots * sizeof(RayRecord)};
+  vkCmdCopyBuffer(cmdBuf, m_rayCaptureBuffer.buffer, m_rayCaptureReadback.buffer, 1, &region);
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  barrier.buffer        = m_rayCaptureReadback.buffer;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+const RayRecord* RenderOutput::mapRayCapture()
+{
+  return static_cast<const RayRecord*>(m_pAlloc->map(m_rayCaptureReadback));
+}
+
+void RenderOutput::unmapRayCapture()
+{
+  m_pAlloc->unmap(m_rayCaptureReadback);
+}
@@ -62,12 +62,21 @@ public:
   nvvk::Buffer          getTimingBuffer() { return m_timingBuffer; }
   void*                 getProfilingData();
 
+  // Ray stream capture, see ray_stream.hpp
+  void             createRayCaptureBuffer(VkDeviceSize numSlots);
+  void             cmdBeginRayCapture(VkCommandBuffer cmdBuf);
+  void             cmdEndRayCapture(VkCommandBuffer cmdBuf);
+  const RayRecord* mapRayCapture();
+  void             unmapRayCapture();
+  VkDeviceSize     getRayCaptureSlots() const { return m_rayCaptureSlots; }
+
 private:
   void createOffscreenRender(const VkExtent2D& size);
   void createPostPipeline(const VkRenderPass& renderPass);
   void createPostDescriptor();
   void createProfilingBuffer(const VkExtent2D& size);
   void createTimingBuffer();
+  void updateRayCaptureDescriptor();
 
   VkDescriptorPool      m_postDescPool{VK_NULL_HANDLE};
   VkDescriptorSetLayout m_postDescSetLayout{VK_NULL_HANDLE};
@@ -77,6 +86,9 @@ private:
   nvvk::Texture         m_offscreenColor;
   nvvk::Buffer          m_profilingBuffer;
   nvvk::Buffer          m_timingBuffer; //UniformBuffer
+  nvvk::Buffer          m_rayCaptureBuffer;    // Written by the ray generation
+  nvvk::Buffer          m_rayCaptureReadback;  // Host copy of m_rayCaptureBuffer
+  VkDeviceSize          m_rayCaptureSlots{0};
   //VkFormat m_offscreenColorFormat{VkFormat::eR16G16B16A16Sfloat};  // Darkening the scene over 5000 iterations
   VkFormat m_offscreenColorFormat{VK_FORMAT_R32G32B32A32_SFLOAT};
   VkFormat m_offscreenDepthFormat{VK_FORMAT_X8_D24_UNORM_PACK32};  // Will be replaced by best supported format
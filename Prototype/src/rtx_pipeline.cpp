@@ -24,10 +24,12 @@
 
 
 
+#include <algorithm>
 #include <thread>
 
 #include "nvh/alignment.hpp"
 #include "nvh/fileoperations.hpp"
+#include "nvpsystem.hpp"
 #include "nvvk/shaders_vk.hpp"
 #include "rtx_pipeline.hpp"
 #include "scene.hpp"
@@ -47,9 +49,6 @@
 #include <iostream>
 #include <fstream>
 
-//Macros
-#define CHECK_BIT(var,pos) ((var) & (1<<(pos)))
-
 void task()
 {
 
@@ -76,7 +75,12 @@ void RtxPipeline::setup(const VkDevice& device, const VkPhysicalDevice& physical
   properties.pNext = &m_rtProperties;
   vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
 
+  m_persistentCache.init(device, properties.properties, NVPSystem::exePath() + "cache");
+  m_spirvCache.setDirectory(NVPSystem::exePath() + "cache/spirv");
   createPipelineCache();
+  m_factory.start(2, 4);
+  m_pool.setBudget(256ull << 20);
+  m_sbtArena.setup(device, physicalDevice, allocator, m_rtProperties);
 
   m_sbtWrapper.setup(device, familyIndex, allocator, m_rtProperties);
   m_sbtWrapper_async.setup(device, familyIndex, allocator, m_rtProperties);
@@ -94,8 +98,10 @@ void RtxPipeline::setup(const VkDevice& device, const VkPhysicalDevice& physical
 
 void RtxPipeline::destroy()
 {
-
+  cancelPipelineBuilds();
   destroyAsyncPipelineBuffer();
+  destroyLibraries();
+  m_sbtArena.destroy();
   m_sbtWrapper.destroy();
 
   vkDestroyPipeline(m_device, m_rtPipeline, nullptr);
@@ -111,6 +117,10 @@ void RtxPipeline::destroy()
   
   vkDestroyPipeline(m_device, m_rtPipeline_async, nullptr);
   vkDestroyPipelineLayout(m_device, m_rtPipelineLayout_async, nullptr);
+  m_persistentCache.save(m_PipelineCache);
+  for(auto& module : m_shaderModules)
+    vkDestroyShaderModule(m_device, module.second, nullptr);
+  m_shaderModules.clear();
   vkDestroyPipelineCache(m_device,m_PipelineCache,nullptr);
   m_PipelineCache = VK_NULL_HANDLE;
 
@@ -139,10 +149,21 @@ void RtxPipeline::create(const VkExtent2D& size, const std::vector<VkDescriptorS
 
 
     
+  // reloadRender() creates again without destroy(), the layout goes away and with it every
+  // pipeline built on it. The caller waited for the device.
+  cancelPipelineBuilds();
+  m_pool.clear(m_evictedPipelines);
+  retireEvictedPipelines();
+  releaseRetiredPipelines();
+  destroyLibraries();
   createPipelineLayout(rtDescSetLayouts,m_rtPipelineLayout);
+  // Raygen, miss, shadow miss and hit group, see hitLibraryInfo()
+  if(!m_sbtArena.valid())
+    m_sbtArena.create(2, m_nbHit, kSbtArenaSlots);
 
   activeElement = createPipeline(m_SERParameters);
   activeElement.parameters = m_SERParameters;
+  m_pool.setInUse(configId(m_SERParameters));
 
     
     
@@ -177,69 +198,149 @@ void RtxPipeline::createPipelineLayout(const std::vector<VkDescriptorSetLayout>&
 //
 PipelineStorage RtxPipeline::createPipeline(SortingParameters parameters)
 {
+  if(const PipelineStorage* built = m_pool.find(configId(parameters)))
+    return *built;
+  return finishPipeline(compilePipeline(pipelineBuild(parameters)));
+}
 
-  SBTWrapper newWrapper;
-  newWrapper.setup(m_device,m_queueIndex,m_pAlloc,m_rtProperties);
+RtxPipeline::PipelineBuild RtxPipeline::pipelineBuild(const SortingParameters& parameters) const
+{
+  PipelineBuild build;
+  build.parameters = parameters;
+  build.config     = pipelineConfig(parameters);
+  build.configId   = encodeConfigId(build.config);
+  build.layout     = m_rtPipelineLayout;
+  return build;
+}
 
-  enum StageIndices
+//--------------------------------------------------------------------------------------------------
+// The pipeline object of a variant, on any thread
+//
+CompiledPipeline RtxPipeline::compilePipeline(const PipelineBuild& build)
+{
+  nvvk::Specialization            specialization;
+  ConfigId                        key    = build.configId;
+  VkPipelineShaderStageCreateInfo raygen = raygenStage(build, specialization);
+
+  CompiledPipeline compiled;
+  compiled.parameters = build.parameters;
+  compiled.configId   = build.configId;
+  if(m_usePipelineLibrary)
   {
-    eRaygen,
-    eMiss,
-    eMiss2,
-    eClosestHit,
-    eAnyHit,
-    eShaderGroupCount
-  };
-
-
-  // All stages
-  std::array<VkPipelineShaderStageCreateInfo, eShaderGroupCount> stages{};
-  VkPipelineShaderStageCreateInfo stage{VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
-  stage.pName = "main";  // All the same entry point
-
-  // Raygen
-  //shaderc::SpvCompilationResult compresult = CompileShader("pathtrace.rgen",shaderc_raygen_shader);
-  //result3 = CompileShader("pathtrace.rgen",shaderc_raygen_shader);
-
-  int hashCode = hashParameters(parameters);
+    // The libraries are created outside of the lock, a variant built twice at the same time
+    // keeps the first one
+    bool       anyhit = build.config.anyhit;
+    VkPipeline hitLibrary{VK_NULL_HANDLE};
+    VkPipeline raygenLibrary{VK_NULL_HANDLE};
+    {
+      std::lock_guard<std::mutex> lock(m_libraryMutex);
+      hitLibrary = m_hitLibraries[anyhit];
+      auto it    = m_raygenLibraries.find(key);
+      if(it != m_raygenLibraries.end())
+        raygenLibrary = it->second;
+    }
+    if(hitLibrary == VK_NULL_HANDLE)
+    {
+      VkPipeline created = createHitLibrary(anyhit, build.layout, m_PipelineCache);
+      std::lock_guard<std::mutex> lock(m_libraryMutex);
+      if(m_hitLibraries[anyhit] == VK_NULL_HANDLE)
+        m_hitLibraries[anyhit] = created;
+      else
+        vkDestroyPipeline(m_device, created, nullptr);
+      hitLibrary = m_hitLibraries[anyhit];
+    }
+    if(raygenLibrary == VK_NULL_HANDLE)
+    {
+      VkPipeline created = createRaygenLibrary(raygen, build.layout, m_PipelineCache);
+      std::lock_guard<std::mutex> lock(m_libraryMutex);
+      auto inserted = m_raygenLibraries.emplace(key, created);
+      if(!inserted.second)
+        vkDestroyPipeline(m_device, created, nullptr);
+      raygenLibrary = inserted.first->second;
+    }
+    compiled.pipeline = linkPipeline(raygenLibrary, hitLibrary, build.layout, m_PipelineCache);
+  }
+  else
+  {
+    compiled.pipeline = createFullPipeline(raygen, build.config.anyhit, build.layout, m_PipelineCache);
+  }
+  // The shader modules belong to m_shaderModules, they are reused by the next variant
 
-  bool foundOne = false;
+  return compiled;
+}
 
-  VkShaderModule module;
-  if(!madeOne)
+//--------------------------------------------------------------------------------------------------
+// The group handles of a compiled pipeline go to its slot of the SBT arena, on the render thread:
+// the slots are not shared with the workers. Full and linked pipelines have the same groups.
+// Without a slot the pipeline cannot be bound: it is destroyed, the element returned has no
+// pipeline and the caller keeps the current one.
+//
+PipelineStorage RtxPipeline::finishPipeline(const CompiledPipeline& compiled)
+{
+  PipelineStorage element;
+  element.pipeline   = compiled.pipeline;
+  element.parameters = compiled.parameters;
+  element.sbtSlot    = m_sbtArena.write(element.pipeline);
+  if(element.sbtSlot == SbtArena::kNoSlot)
   {
-    result3 = CompileShader("pathtrace.rgen",shaderc_raygen_shader);
-    hitshader = CompileShader("pathtrace.rchit",shaderc_closesthit_shader);
-    madeOne = true;
-    printf("made a new one\n");
+    // Every slot is taken by the pool or not yet released: the least recently used variant goes
+    // now, the device has to be idle to reuse its slot
+    LOGW("SBT arena full (%u slots), evicting a pipeline\n", m_sbtArena.capacity());
+    m_pool.evictLeastRecent(m_evictedPipelines);
+    retireEvictedPipelines();
+    MilliTimer timer;
+    vkDeviceWaitIdle(m_device);
+    m_retireStats.deviceWaits++;
+    m_retireStats.deviceWaitMs += timer.elapsed();
+    releaseRetiredPipelines();
+    element.sbtSlot = m_sbtArena.write(element.pipeline);
+    if(element.sbtSlot == SbtArena::kNoSlot)
+    {
+      LOGE("No SBT slot for the pipeline %s, every pipeline in the pool is protected\n",
+           configIdString(compiled.configId).c_str());
+      vkDestroyPipeline(m_device, compiled.pipeline, nullptr);
+      return PipelineStorage();
+    }
   }
-  module = glslCompiler.createModule(m_device,result3);
-  
 
-  //shaderc::SpvCompilationResult compresult2 = CompileShader("pathtrace.rgen",shaderc_raygen_shader);
-  //module = glslCompiler.createModule(m_device,results[0]);
-  //module = nvvk::createShaderModule(m_device, rgen.data(), sizeof(rgen));
-  stage.module    = module;
-  stage.stage     = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
-  stages[eRaygen] = stage;
+  uint64_t bytes = m_pipelineBytesEstimate + m_sbtArena.slotSize();
+  m_pool.insert(compiled.configId, element, bytes, m_evictedPipelines);
+  retireEvictedPipelines();
+  return element;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Raygen shader with the specialization constants of the SortingParameters and the key budget.
+// Only this stage differs between the variants.
+//
+VkPipelineShaderStageCreateInfo RtxPipeline::raygenStage(const PipelineBuild& build, nvvk::Specialization& specialization)
+{
+  // The budget is part of the specialization, not of the parameters
+  const SortingParameters& parameters = build.parameters;
+  const SortingKeyBudget&  budget     = build.config.budget;
+  ConfigId                 key        = build.configId;
 
+  VkPipelineShaderStageCreateInfo stage{VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+  stage.pName  = "main";
+  stage.module = CompileAndCreateShaderModule("pathtrace.rgen", shaderc_raygen_shader);
+  stage.stage  = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
 
   //add specializations
-  nvvk::Specialization specialization;
-  for(int i= 0; i < hashedParameterizations.size(); i++)
+  std::lock_guard<std::mutex> lock(m_libraryMutex);
+  bool                        foundOne = false;
+  for(int i = 0; i < hashedParameterizations.size(); i++)
   {
-    if(hashedParameterizations[i]==hashCode)
+    if(hashedParameterizations[i] == key)
     {
       specialization = storedSpecializations[i];
-      stage.module    = module;
-      foundOne = true;
+      foundOne       = true;
       break;
     }
   }
   if(!foundOne)
   {
-    specialization.add(0,m_sortingMode);
-    specialization.add(1,m_enableProfiling);
+    specialization.add(0,int(build.config.sortingMode));
+    specialization.add(1,build.config.profiling);
     //Add Sorting parameters as specialization constants
     specialization.add(2,parameters.noSort); //No Sorting
     specialization.add(3,parameters.hitObject); //HitObject
@@ -249,94 +350,209 @@ PipelineStorage RtxPipeline::createPipeline(SortingParameters parameters)
     specialization.add(7,parameters.realEndpoint); //RealEndpoint
     specialization.add(8,parameters.sortAfterASTraversal); //AfterASTraversal
     specialization.add(9,parameters.isFinished); //isFinished
+    specialization.add(12,budget.origin); //ORIGIN_BITS
+    specialization.add(13,budget.direction); //DIRECTION_BITS
+    specialization.add(14,budget.endpoint); //ENDPOINT_BITS
+    specialization.add(15,budget.finished); //FINISHED_BITS
 
     storedSpecializations.emplace_back(specialization);
-    hashedParameterizations.emplace_back(hashCode);
+    hashedParameterizations.emplace_back(key);
   }
-  
-  stages[eRaygen].pSpecializationInfo = specialization.getSpecialization();
-  
 
+  stage.pSpecializationInfo = specialization.getSpecialization();
+  return stage;
+}
 
-  // Miss
-  stage.module  = CompileAndCreateShaderModule("pathtrace.rmiss",shaderc_miss_shader);
-  stage.stage   = VK_SHADER_STAGE_MISS_BIT_KHR;
-  stages[eMiss] = stage;
+//--------------------------------------------------------------------------------------------------
+// Today's path: every stage compiled into one pipeline
+//
+VkPipeline RtxPipeline::createFullPipeline(const VkPipelineShaderStageCreateInfo& raygen, bool anyhit, VkPipelineLayout layout, VkPipelineCache cache)
+{
+  // The raygen first, then the stages and groups of the hit library with their indices shifted
+  LibraryInfo hit;
+  hitLibraryInfo(anyhit, layout, hit);
 
-  // The second miss shader is invoked when a shadow ray misses the geometry. It simply indicates that no occlusion has been found
-  stage.module   = CompileAndCreateShaderModule("pathtraceShadow.rmiss",shaderc_miss_shader);
-  stage.stage    = VK_SHADER_STAGE_MISS_BIT_KHR;
-  stages[eMiss2] = stage;
+  std::vector<VkPipelineShaderStageCreateInfo> stages{raygen};
+  stages.insert(stages.end(), hit.stages.begin(), hit.stages.end());
 
-  // Hit Group - Closest Hit
-  stage.module        =glslCompiler.createModule(m_device,hitshader);// CompileAndCreateShaderModule("pathtrace.rchit",shaderc_closesthit_shader);
-  stage.stage         = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
-  stages[eClosestHit] = stage;
+  std::vector<VkRayTracingShaderGroupCreateInfoKHR> groups;
+  VkRayTracingShaderGroupCreateInfoKHR              group{VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR};
+  group.type               = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR;
+  group.generalShader      = 0;
+  group.closestHitShader   = VK_SHADER_UNUSED_KHR;
+  group.anyHitShader       = VK_SHADER_UNUSED_KHR;
+  group.intersectionShader = VK_SHADER_UNUSED_KHR;
+  groups.push_back(group);
+  for(VkRayTracingShaderGroupCreateInfoKHR g : hit.groups)
+  {
+    for(uint32_t* index : {&g.generalShader, &g.closestHitShader, &g.anyHitShader, &g.intersectionShader})
+      if(*index != VK_SHADER_UNUSED_KHR)
+        (*index)++;
+    groups.push_back(g);
+  }
+
+  // --- Pipeline ---
+  // Assemble the shader stages and recursion depth info into the ray tracing pipeline
+  VkRayTracingPipelineCreateInfoKHR createInfo{VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_KHR};
+  createInfo.stageCount = static_cast<uint32_t>(stages.size());  // Stages are shaders
+  createInfo.pStages    = stages.data();
+
+  createInfo.groupCount = static_cast<uint32_t>(groups.size());  // 1-raygen, n-miss, n-(hit[+anyhit+intersect])
+  createInfo.pGroups    = groups.data();
+
+  createInfo.maxPipelineRayRecursionDepth = 2;  // Ray depth
+  createInfo.layout                       = layout;
+
+  return createRayTracingPipeline(createInfo, cache);
+}
+
+//--------------------------------------------------------------------------------------------------
+// The payloads and hit attributes of every library and of the linked pipeline must agree.
+// PtPayload is 256 bytes with the std430 alignment of its vec3 and mat4x3 members, the hit
+// attributes are the barycentrics (vec2).
+//
+static const VkRayTracingPipelineInterfaceCreateInfoKHR kLibraryInterface{
+    VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_INTERFACE_CREATE_INFO_KHR, nullptr, 256, 2 * sizeof(float)};
+
+void RtxPipeline::raygenLibraryInfo(const VkPipelineShaderStageCreateInfo& raygen, VkPipelineLayout layout, LibraryInfo& info)
+{
+  info.stages = {raygen};
+
+  VkRayTracingShaderGroupCreateInfoKHR group{VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR};
+  group.type               = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR;
+  group.generalShader      = 0;
+  group.closestHitShader   = VK_SHADER_UNUSED_KHR;
+  group.anyHitShader       = VK_SHADER_UNUSED_KHR;
+  group.intersectionShader = VK_SHADER_UNUSED_KHR;
+  info.groups              = {group};
+
+  info.createInfo.flags                        = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR;
+  info.createInfo.stageCount                   = static_cast<uint32_t>(info.stages.size());
+  info.createInfo.pStages                      = info.stages.data();
+  info.createInfo.groupCount                   = static_cast<uint32_t>(info.groups.size());
+  info.createInfo.pGroups                      = info.groups.data();
+  info.createInfo.maxPipelineRayRecursionDepth = 2;
+  info.createInfo.pLibraryInterface            = &kLibraryInterface;
+  info.createInfo.layout                       = layout;
+}
+
+void RtxPipeline::hitLibraryInfo(bool anyhit, VkPipelineLayout layout, LibraryInfo& info)
+{
+  enum StageIndices
+  {
+    eMiss,
+    eMiss2,
+    eClosestHit,
+    eAnyHit,
+    eShaderGroupCount
+  };
 
-  // Hit Group - Any Hit
-  stage.module    = CompileAndCreateShaderModule("pathtrace.rahit",shaderc_anyhit_shader);
-  stage.stage     = VK_SHADER_STAGE_ANY_HIT_BIT_KHR;
-  stages[eAnyHit] = stage;
+  // The second miss shader is invoked when a shadow ray misses the geometry. It simply indicates that no occlusion has been found
+  static const struct
+  {
+    const char*           filename;
+    shaderc_shader_kind   kind;
+    VkShaderStageFlagBits stage;
+  } kStages[eShaderGroupCount] = {
+      {"pathtrace.rmiss", shaderc_miss_shader, VK_SHADER_STAGE_MISS_BIT_KHR},
+      {"pathtraceShadow.rmiss", shaderc_miss_shader, VK_SHADER_STAGE_MISS_BIT_KHR},
+      {"pathtrace.rchit", shaderc_closesthit_shader, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR},
+      {"pathtrace.rahit", shaderc_anyhit_shader, VK_SHADER_STAGE_ANY_HIT_BIT_KHR},
+  };
 
+  // All stages
+  info.stages.assign(eShaderGroupCount, {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO});
+  for(int i = 0; i < eShaderGroupCount; i++)
+  {
+    info.stages[i].pName  = "main";  // All the same entry point
+    info.stages[i].stage  = kStages[i].stage;
+    info.stages[i].module = CompileAndCreateShaderModule(kStages[i].filename, kStages[i].kind);
+  }
 
   // Shader groups
-  std::vector<VkRayTracingShaderGroupCreateInfoKHR> groups;
-  VkRayTracingShaderGroupCreateInfoKHR              group{VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR};
+  info.groups.clear();
+  VkRayTracingShaderGroupCreateInfoKHR group{VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR};
   group.anyHitShader       = VK_SHADER_UNUSED_KHR;
   group.closestHitShader   = VK_SHADER_UNUSED_KHR;
   group.generalShader      = VK_SHADER_UNUSED_KHR;
   group.intersectionShader = VK_SHADER_UNUSED_KHR;
 
-  // Raygen
-  group.type          = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR;
-  group.generalShader = eRaygen;
-  groups.push_back(group);
-
   // Miss
   group.type          = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR;
   group.generalShader = eMiss;
-  groups.push_back(group);
+  info.groups.push_back(group);
 
   // Shadow Miss
   group.type          = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR;
   group.generalShader = eMiss2;
-  groups.push_back(group);
+  info.groups.push_back(group);
 
   // closest hit shader
   group.type             = VK_RAY_TRACING_SHADER_GROUP_TYPE_TRIANGLES_HIT_GROUP_KHR;
   group.generalShader    = VK_SHADER_UNUSED_KHR;
   group.closestHitShader = eClosestHit;
-  if(m_enableAnyhit)
+  if(anyhit)
     group.anyHitShader = eAnyHit;
-  groups.push_back(group);
+  info.groups.push_back(group);
+
+  info.createInfo.flags                        = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR;
+  info.createInfo.stageCount                   = static_cast<uint32_t>(info.stages.size());
+  info.createInfo.pStages                      = info.stages.data();
+  info.createInfo.groupCount                   = static_cast<uint32_t>(info.groups.size());
+  info.createInfo.pGroups                      = info.groups.data();
+  info.createInfo.maxPipelineRayRecursionDepth = 2;
+  info.createInfo.pLibraryInterface            = &kLibraryInterface;
+  info.createInfo.layout                       = layout;
+}
 
-  // --- Pipeline ---
-  // Assemble the shader stages and recursion depth info into the ray tracing pipeline
-  VkRayTracingPipelineCreateInfoKHR rayPipelineInfo{VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_KHR};
-  m_createInfo.stageCount = static_cast<uint32_t>(stages.size());  // Stages are shaders
-  m_createInfo.pStages    = stages.data();
+VkPipeline RtxPipeline::createRaygenLibrary(const VkPipelineShaderStageCreateInfo& raygen, VkPipelineLayout layout, VkPipelineCache cache)
+{
+  LibraryInfo info;
+  raygenLibraryInfo(raygen, layout, info);
+  return createRayTracingPipeline(info.createInfo, cache);
+}
 
-  m_createInfo.groupCount = static_cast<uint32_t>(groups.size());  // 1-raygen, n-miss, n-(hit[+anyhit+intersect])
-  m_createInfo.pGroups    = groups.data();
+VkPipeline RtxPipeline::createHitLibrary(bool anyhit, VkPipelineLayout layout, VkPipelineCache cache)
+{
+  LibraryInfo info;
+  hitLibraryInfo(anyhit, layout, info);
+  return createRayTracingPipeline(info.createInfo, cache);
+}
 
-  m_createInfo.maxPipelineRayRecursionDepth = 2;  // Ray depth
-  m_createInfo.layout                       = m_rtPipelineLayout;
+//--------------------------------------------------------------------------------------------------
+// Variant linked from its raygen library and the hit library. The groups keep the order of the
+// full pipeline: raygen, miss, shadow miss, hit.
+//
+VkPipeline RtxPipeline::linkPipeline(VkPipeline raygenLibrary, VkPipeline hitLibrary, VkPipelineLayout layout, VkPipelineCache cache)
+{
+  VkPipeline                     libraries[] = {raygenLibrary, hitLibrary};
+  VkPipelineLibraryCreateInfoKHR libraryInfo{VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR};
+  libraryInfo.libraryCount = 2;
+  libraryInfo.pLibraries   = libraries;
+
+  VkRayTracingPipelineCreateInfoKHR createInfo{VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_KHR};
+  createInfo.pLibraryInfo                 = &libraryInfo;
+  createInfo.pLibraryInterface            = &kLibraryInterface;
+  createInfo.maxPipelineRayRecursionDepth = 2;
+  createInfo.layout                       = layout;
+
+  return createRayTracingPipeline(createInfo, cache);
+}
 
+VkPipeline RtxPipeline::createRayTracingPipeline(const VkRayTracingPipelineCreateInfoKHR& createInfo, VkPipelineCache cache)
+{
   // Create a deferred operation (compiling in parallel)
-  bool                   useDeferred{true};
   VkResult               result;
   VkDeferredOperationKHR deferredOp{VK_NULL_HANDLE};
-  if(useDeferred)
-  {
-    result = vkCreateDeferredOperationKHR(m_device, nullptr, &deferredOp);
-    assert(result == VK_SUCCESS);
-  }
-  //vkCreateRayTracingPipelinesKHR(m_device, deferredOp,m_PipelineCache, 1, &m_createInfo, nullptr, &pipeline);
-  VkPipeline newPipeline{VK_NULL_HANDLE};
-  vkCreateRayTracingPipelinesKHR(m_device, deferredOp,m_PipelineCache, 1, &m_createInfo, nullptr, &newPipeline);
+  result = vkCreateDeferredOperationKHR(m_device, nullptr, &deferredOp);
+  assert(result == VK_SUCCESS);
 
+  VkPipeline newPipeline{VK_NULL_HANDLE};
+  result = vkCreateRayTracingPipelinesKHR(m_device, deferredOp, cache, 1, &createInfo, nullptr, &newPipeline);
+  if(cache != VK_NULL_HANDLE)
+    m_persistentCache.markDirty();
 
-  if(useDeferred)
+  if(result == VK_OPERATION_DEFERRED_KHR)
   {
     // Query the maximum amount of concurrency and clamp to the desired maximum
     uint32_t maxThreads{8};
@@ -359,26 +575,80 @@ PipelineStorage RtxPipeline::createPipeline(SortingParameters parameters)
 
     // deferred operation is now complete.  'result' indicates success or failure
     result = vkGetDeferredOperationResultKHR(m_device, deferredOp);
-    assert(result == VK_SUCCESS);
-    vkDestroyDeferredOperationKHR(m_device, deferredOp, nullptr);
   }
-  //storedPipelines.emplace_back(newPipeline);
+  else if(result == VK_OPERATION_NOT_DEFERRED_KHR)
+  {
+    result = VK_SUCCESS;  // Completed on this thread
+  }
+  if(result != VK_SUCCESS)
+    LOGE("Ray tracing pipeline creation failed (%d)\n", int(result));
+  assert(result == VK_SUCCESS);
+  vkDestroyDeferredOperationKHR(m_device, deferredOp, nullptr);
+  return newPipeline;
+}
 
-  newWrapper.create(newPipeline,m_createInfo);
-  //wrappers[0].create(pipelines[activePipeline],m_createInfo);
+void RtxPipeline::destroyLibraries()
+{
+  std::lock_guard<std::mutex> lock(m_libraryMutex);
+  for(auto& library : m_raygenLibraries)
+    vkDestroyPipeline(m_device, library.second, nullptr);
+  m_raygenLibraries.clear();
+  for(VkPipeline& library : m_hitLibraries)
+  {
+    vkDestroyPipeline(m_device, library, nullptr);
+    library = VK_NULL_HANDLE;
+  }
+}
 
-  PipelineStorage newStorageElement;
-  newStorageElement.pipeline = newPipeline;
-  newStorageElement.sbt = newWrapper;
-  storage.emplace_back(newStorageElement);
+//--------------------------------------------------------------------------------------------------
+// Creation time of each variant both ways. The pipeline cache is not used, it would hide the
+// compilation; the shader modules are created before, the GLSL compilation is in neither time.
+//
+std::vector<RtxPipeline::CreationTiming> RtxPipeline::benchmarkPipelineCreation(const std::vector<SortingParameters>& parameters,
+                                                                              double& hitLibraryMs)
+{
+  std::vector<CreationTiming> timings;
+  LibraryInfo                 warmup;
+  hitLibraryInfo(m_enableAnyhit, m_rtPipelineLayout, warmup);
 
+  MilliTimer timer;
+  VkPipeline hitLibrary{VK_NULL_HANDLE};
+  hitLibraryMs = 0.0;
+  if(m_usePipelineLibrary)
+  {
+    hitLibrary   = createHitLibrary(m_enableAnyhit, m_rtPipelineLayout, VK_NULL_HANDLE);
+    hitLibraryMs = timer.elapsed();
+  }
 
-  //storedSBTs.emplace_back(newWrapper);
-  // --- Clean up ---
-  for(auto& s : stages)
-    vkDestroyShaderModule(m_device, s.module, nullptr);
+  for(const SortingParameters& p : parameters)
+  {
+    CreationTiming                  timing;
+    nvvk::Specialization            specialization;
+    PipelineBuild                   build  = pipelineBuild(p);
+    VkPipelineShaderStageCreateInfo raygen = raygenStage(build, specialization);
+    timing.parameters                      = p;
+
+    timer.reset();
+    VkPipeline full = createFullPipeline(raygen, build.config.anyhit, build.layout, VK_NULL_HANDLE);
+    timing.fullMs   = timer.elapsed();
+    vkDestroyPipeline(m_device, full, nullptr);
+
+    if(m_usePipelineLibrary)
+    {
+      timer.reset();
+      VkPipeline raygenLibrary = createRaygenLibrary(raygen, build.layout, VK_NULL_HANDLE);
+      timing.raygenLibraryMs   = timer.elapsed();
+      timer.reset();
+      VkPipeline linked = linkPipeline(raygenLibrary, hitLibrary, build.layout, VK_NULL_HANDLE);
+      timing.linkMs     = timer.elapsed();
+      vkDestroyPipeline(m_device, linked, nullptr);
+      vkDestroyPipeline(m_device, raygenLibrary, nullptr);
+    }
+    timings.push_back(timing);
+  }
 
-  return newStorageElement;
+  vkDestroyPipeline(m_device, hitLibrary, nullptr);
+  return timings;
 }
 
 
@@ -389,6 +659,8 @@ void RtxPipeline::run(const VkCommandBuffer& cmdBuf, const VkExtent2D& size, nvv
 {
   LABEL_SCOPE_VK(cmdBuf);
 
+  // Without resizable BAR, the records of the pipelines added since the last frame
+  m_sbtArena.upload(cmdBuf);
 
   vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, activeElement.pipeline);
   vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_rtPipelineLayout, 0,
@@ -398,7 +670,7 @@ void RtxPipeline::run(const VkCommandBuffer& cmdBuf, const VkExtent2D& size, nvv
                      0, sizeof(RtxState), &m_state);
 
 
-  auto& regions = activeElement.sbt.getRegions();
+  auto regions = m_sbtArena.regions(activeElement.sbtSlot);
   
   vkCmdTraceRaysKHR(cmdBuf, &regions[0], &regions[1], &regions[2], &regions[3], size.width, size.height, 1);
 }
@@ -408,6 +680,8 @@ void RtxPipeline::run(const VkCommandBuffer& cmdBuf, const VkExtent2D& size, nvv
 //
 void RtxPipeline::useAnyHit(bool enable)
 {
+  // The queued builds have the old setting
+  cancelPipelineBuilds();
   m_enableAnyhit = enable;
   createPipeline(m_SERParameters);
 }
@@ -423,8 +697,24 @@ void RtxPipeline::setupGLSLCompiler()
   {
     glslCompiler.addInclude(path);
   }
-  glslCompiler.options()->SetTargetSpirv(shaderc_spirv_version_1_4);
-  glslCompiler.options()->SetTargetEnvironment(shaderc_target_env_vulkan,shaderc_env_version_vulkan_1_3);
+  // Set on the options from m_compileOptions only, so the SPIR-V keys see every option
+  m_compileOptions                          = SpirvCompileOptions();
+  m_compileOptions.targetSpirv              = shaderc_spirv_version_1_4;
+  m_compileOptions.targetEnvironment        = shaderc_target_env_vulkan;
+  m_compileOptions.targetEnvironmentVersion = shaderc_env_version_vulkan_1_3;
+  m_compileOptions.optimizationLevel        = shaderc_optimization_level_zero;
+  m_compileOptions.generateDebugInfo        = false;
+
+  shaderc::CompileOptions* options = glslCompiler.options();
+  options->SetTargetSpirv(shaderc_spirv_version(m_compileOptions.targetSpirv));
+  options->SetTargetEnvironment(shaderc_target_env(m_compileOptions.targetEnvironment), m_compileOptions.targetEnvironmentVersion);
+  options->SetOptimizationLevel(shaderc_optimization_level(m_compileOptions.optimizationLevel));
+  if(m_compileOptions.generateDebugInfo)
+    options->SetGenerateDebugInfo();
+  for(const auto& macro : m_compileOptions.macros)
+    options->AddMacroDefinition(macro.first, macro.second);
+  m_compileSignature  = m_compileOptions.signature();
+  m_shaderSearchPaths = defaultSearchPaths;
 
 }
 
@@ -441,34 +731,73 @@ shaderc::SpvCompilationResult RtxPipeline::CompileShader(std::string filename, s
     rgen.emplace_back(pCode[i]);
   }
 
-
-  //rgen.assign(pCode,pCode+compilationSize);
-  std::ofstream myfile;
-  myfile.open("example.txt");
-  myfile.write(reinterpret_cast<const char*>(pCode),compilationSize);
-  myfile.close();
   return compResult;
 }
 
 VkShaderModule RtxPipeline::CompileAndCreateShaderModule(std::string filename, shaderc_shader_kind shadertype)
 {
+  SpirvKey              key;
+  std::vector<uint32_t> spirv = CompileSpirv(filename, shadertype, key);
+  if(spirv.empty())
+    return VK_NULL_HANDLE;
+
+  std::lock_guard<std::mutex> lock(m_shaderModulesMutex);
+  VkShaderModule&             module = m_shaderModules[key.hex()];
+  if(module == VK_NULL_HANDLE)
+    module = nvvk::createShaderModule(m_device, spirv.data(), spirv.size() * sizeof(uint32_t));
+  return module;
+}
 
-  shaderc::SpvCompilationResult compResult = glslCompiler.compileFile(filename,shadertype);
+//--------------------------------------------------------------------------------------------------
+// Only the preprocessor runs for a shader that was compiled before, in this run or an earlier one
+//
+std::vector<uint32_t> RtxPipeline::CompileSpirv(const std::string& filename, shaderc_shader_kind shadertype, SpirvKey& key)
+{
+  std::string path = nvh::findFile(filename, m_shaderSearchPaths, true);
+  if(path.empty())
+    return {};
+  std::string source = nvh::loadFile(path, false);
+
+  std::lock_guard<std::mutex> lock(m_compilerMutex);
+  glslCompiler.options()->SetIncluder(std::make_unique<nvvkhl::GlslIncluder>(m_shaderSearchPaths));
+  shaderc::PreprocessedSourceCompilationResult preprocessed =
+      glslCompiler.PreprocessGlsl(source, shadertype, path.c_str(), *glslCompiler.options());
+  if(preprocessed.GetCompilationStatus() != shaderc_compilation_status_success)
+  {
+    LOGE("%s\n", preprocessed.GetErrorMessage().c_str());
+    return {};
+  }
+  std::string preprocessedSource(preprocessed.begin(), preprocessed.end());
+  key = makeSpirvKey(preprocessedSource, m_compileSignature, uint32_t(shadertype), "main");
 
-  VkShaderModule resultModule = glslCompiler.createModule(m_device,compResult);
+  std::vector<uint32_t> spirv;
+  if(m_spirvCache.find(key, spirv))
+    return spirv;
 
-  return resultModule;
+  // The source that was hashed, a file changed since the preprocessing cannot end up under this key
+  shaderc::SpvCompilationResult compResult = glslCompiler.CompileGlslToSpv(preprocessedSource.data(), preprocessedSource.size(), shadertype,
+                                                                           path.c_str(), "main", *glslCompiler.options());
+  if(compResult.GetCompilationStatus() != shaderc_compilation_status_success)
+  {
+    LOGE("%s\n", compResult.GetErrorMessage().c_str());
+    return {};
+  }
+  spirv.assign(compResult.cbegin(), compResult.cend());
+  m_spirvCache.store(key, spirv);
+  return spirv;
 }
 
 
 void RtxPipeline::setSortingMode(int index)
 {
+  cancelPipelineBuilds();
   m_sortingMode = index;
   createPipeline(m_SERParameters);
 }
 
 void RtxPipeline::enableProfiling(bool enable)
 {
+  cancelPipelineBuilds();
   m_enableProfiling = enable;
   createPipeline(m_SERParameters);
 }
@@ -479,54 +808,43 @@ void RtxPipeline::setPipeline(int index)
   m_rtPipeline = m_cachedRtPipelines[index];
 }
 
-int RtxPipeline::hashParameters(SortingParameters parameters)
+//--------------------------------------------------------------------------------------------------
+// Custom budgets keep only the components enabled by the parameters and never exceed 32 bits
+//
+SortingKeyBudget RtxPipeline::keyBudget(const SortingParameters& parameters) const
 {
-  int result = 0;
-  if(parameters.noSort)
+  if(!m_customKeyBudget || parameters.noSort)
+    return SortingKeyDefaultBudget(parameters);
+
+  SortingKeyBudget budget;
+  budget.origin    = parameters.rayOrigin ? m_keyBudget.origin : 0;
+  budget.direction = parameters.rayDirection ? m_keyBudget.direction : 0;
+  budget.endpoint  = parameters.estimatedEndpoint || parameters.realEndpoint ? m_keyBudget.endpoint : 0;
+  budget.finished  = parameters.isFinished ? std::min(m_keyBudget.finished, 1u) : 0;
+
+  // Trimmed from the end of the key: endpoint first, origin last
+  uint* components[] = {&budget.endpoint, &budget.direction, &budget.origin};
+  for(uint* c : components)
   {
-    result |= 1;
-    return result;
+    uint total = SortingKeyBudgetTotal(budget);
+    if(total > 32)
+      *c -= std::min(*c, total - 32);
   }
-
-  result |= parameters.sortAfterASTraversal ? 2: 0;
-  result |= parameters.hitObject ? 4: 0;
-  result |= parameters.rayOrigin ? 8: 0;
-  result |= parameters.rayDirection ? 16: 0;
-  result |= parameters.estimatedEndpoint ? 32: 0;
-  result |= parameters.realEndpoint ? 64: 0;
-  result |= parameters.isFinished ? 128: 0;
-
-  return result;
-}
-
-SortingParameters RtxPipeline::rebuildFromhash(int hashCode)
-{
-  SortingParameters result;
-  result.numCoherenceBitsTotal = 32;
-  result.noSort = CHECK_BIT(hashCode,0);
-  result.sortAfterASTraversal = CHECK_BIT(hashCode,1);
-  result.hitObject = CHECK_BIT(hashCode,2);
-  result.rayOrigin = CHECK_BIT(hashCode,3);
-  result.rayDirection = CHECK_BIT(hashCode,4);
-  result.estimatedEndpoint = CHECK_BIT(hashCode,5);
-  result.realEndpoint = CHECK_BIT(hashCode,6);
-  result.isFinished = CHECK_BIT(hashCode,7);
-
-  return result;
+  return budget;
 }
 
 shaderc::SpvCompilationResult* RtxPipeline::getRayGenShaderObject()
 {
 shaderc::SpvCompilationResult* result;
 
-int hashCode = hashParameters(m_SERParameters);
+ConfigId id = configId(m_SERParameters);
 
 if(raygenShaders.size() > 0)
 {
 
   for (int i =0; i < raygenShaders.size();i++)
   {
-    if(hashCode == raygenShaders[i].hashcode)
+    if(id == raygenShaders[i].configId)
     {
       result = raygenShaders[i].compResult;
       return result;
@@ -534,7 +852,7 @@ if(raygenShaders.size() > 0)
   }
 }
 RtxPipeline::ShaderObject newObject;
-newObject.hashcode = hashCode;
+newObject.configId = id;
 shaderc::SpvCompilationResult compResult = CompileShader("pathtrace.rgen",shaderc_raygen_shader);
 newObject.compResult = &compResult;
 raygenShaders.emplace_back(newObject);
@@ -544,88 +862,165 @@ return newObject.compResult;
 
 void RtxPipeline::createPipelineCache()
 {
-
-  VkPipelineCacheCreateInfo createInfo{VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
-  createInfo.pNext = nullptr;
-  createInfo.initialDataSize = 0;
-  createInfo.flags = 0;
-
-  VkResult result = vkCreatePipelineCache(m_device,&createInfo,nullptr,&m_PipelineCache);
-  if(result == VK_SUCCESS)
-  {
-    printf("Success\n");
-  }
+  m_PipelineCache = m_persistentCache.create();
 
 }
 
-void RtxPipeline::fillPipelineBuffer()
+PipelineStorage RtxPipeline::buildPipeline(const SortingParameters& parameters)
 {
- 
- if(PrebuildPipelineBuffer.size()<5)
- {
   MilliTimer timer;
   LOGI("Create RtxPipeline:");
-  //create the new parameters
-  //SortingParameters newSortingParameters = morphSortingParameters(mostRecentParameters);
-  SortingParameters newSortingParameters = createSortingParameters1();
-  mostRecentParameters = newSortingParameters;
-  //create new pipeline
-  PipelineStorage newElement = createPipeline(newSortingParameters);
-  newElement.parameters = newSortingParameters;
-  PrebuildPipelineBuffer.emplace_back(newElement);    
+  PipelineStorage element = createPipeline(parameters);
+  element.parameters      = parameters;
   timer.print();
- }
+  return element;
+}
+
+//--------------------------------------------------------------------------------------------------
+// A plain rebind, the next run() binds it. The previous pipeline stays in the pool.
+//
+void RtxPipeline::setNewPipeline(PipelineStorage newPipelineElement)
+{
+  // A failed build, the current pipeline stays
+  if(newPipelineElement.pipeline == VK_NULL_HANDLE)
+    return;
+  m_retireStats.switches++;
+  activeElement = newPipelineElement;
+  m_SERParameters = activeElement.parameters;
+  m_pool.setInUse(configId(activeElement.parameters));
+}
 
- 
+PipelineConfig RtxPipeline::pipelineConfig(const SortingParameters& parameters) const
+{
+  PipelineConfig config;
+  config.parameters  = parameters;
+  config.budget      = keyBudget(parameters);
+  config.sortingMode = uint32_t(m_sortingMode);
+  config.anyhit      = m_enableAnyhit;
+  config.profiling   = m_enableProfiling;
+  return config;
+}
 
+const PipelineStorage* RtxPipeline::findPipeline(const SortingParameters& parameters)
+{
+  return m_pool.find(configId(parameters));
 }
 
+bool RtxPipeline::hasPipeline(const SortingParameters& parameters)
+{
+  return m_pool.contains(configId(parameters));
+}
 
-void RtxPipeline::setNewPipeline()
+void RtxPipeline::setProtectedPipelines(const std::vector<SortingParameters>& parameters)
 {
+  std::vector<ConfigId> keys;
+  for(const SortingParameters& p : parameters)
+    keys.push_back(configId(p));
+  m_pool.setProtected(keys);
+}
 
-  activeElement = PrebuildPipelineBuffer[0];
-  m_SERParameters = activeElement.parameters;
-  PrebuildPipelineBuffer.erase(PrebuildPipelineBuffer.begin());
+void RtxPipeline::setPipelineBudget(uint64_t bytes)
+{
+  m_pool.setBudget(bytes);
+  m_pool.evictOverBudget(m_evictedPipelines);
+  retireEvictedPipelines();
+}
 
+void RtxPipeline::reservePipelines(uint32_t count)
+{
+  uint64_t bytes = uint64_t(count) * (m_pipelineBytesEstimate + m_sbtArena.slotSize());
+  if(bytes > m_pool.budget())
+  {
+    LOGI("Pipeline memory raised to %.1f MB for %u pipelines\n", double(bytes) / double(1 << 20), count);
+    m_pool.setBudget(bytes);
+  }
 }
 
+//--------------------------------------------------------------------------------------------------
+// The evicted pipelines may still be used by the frames in flight: each one waits in the retire
+// queue for the fence of the frame that was recorded when it was evicted
+//
+void RtxPipeline::retireEvictedPipelines()
+{
+  for(const PipelineStorage& element : m_evictedPipelines)
+    m_retiredPipelines.push_back({element, m_currentFrame});
+  m_retireStats.retired += m_evictedPipelines.size();
+  m_evictedPipelines.clear();
+}
 
-void RtxPipeline::setNewPipeline(PipelineStorage newPipelineElement)
+void RtxPipeline::beginFrame(uint64_t frame, uint64_t completedFrame)
 {
-  activeElement = newPipelineElement;
-  m_SERParameters = activeElement.parameters;
-  //PrebuildPipelineBuffer.erase(PrebuildPipelineBuffer.begin());
+  m_currentFrame = frame;
+  // Tagged in frame order
+  while(!m_retiredPipelines.empty() && m_retiredPipelines.front().frame <= completedFrame)
+  {
+    destroyPipeline(m_retiredPipelines.front().element);
+    m_retiredPipelines.pop_front();
+    m_retireStats.released++;
+  }
 }
-void RtxPipeline::activateAsyncPipelineCreation()
+
+void RtxPipeline::releaseRetiredPipelines()
 {
-    std::thread([&,this]() 
-    {
-    while(useAsyncPipelineCreation)
+  for(RetiredPipeline& retired : m_retiredPipelines)
+    destroyPipeline(retired.element);
+  m_retireStats.released += m_retiredPipelines.size();
+  m_retiredPipelines.clear();
+}
+
+void RtxPipeline::destroyPipeline(PipelineStorage& element)
+{
+  vkDestroyPipeline(m_device, element.pipeline, nullptr);
+  m_sbtArena.release(element.sbtSlot);
+  element = PipelineStorage();
+}
+
+RtxPipeline::RetireStats RtxPipeline::retireStats() const
+{
+  RetireStats stats = m_retireStats;
+  stats.queued      = uint32_t(m_retiredPipelines.size());
+  return stats;
+}
+
+bool RtxPipeline::requestPipeline(int key, double priority, const SortingParameters& parameters)
+{
+  return m_factory.request(key, priority, [this, build = pipelineBuild(parameters)]() { return compilePipeline(build); });
+}
+
+bool RtxPipeline::pollPipeline(int& key, PipelineStorage& element)
+{
+  CompiledPipeline compiled;
+  while(m_factory.poll(key, compiled))
+  {
+    // Started before a setting changed (e.g. the key budget), never bound
+    if(compiled.configId != configId(compiled.parameters))
     {
-      if(m_rtPipelineLayout == VK_NULL_HANDLE)
-      {
-        //printf("still null\n");
-      }
-      else {
-        fillPipelineBuffer();
-      }
+      vkDestroyPipeline(m_device, compiled.pipeline, nullptr);
+      continue;
     }
-  }).detach();
-  
-
-  //std::thread t1(buildStuff,m_rtPipelineLayout);
+    element = finishPipeline(compiled);
+    return true;
+  }
+  return false;
+}
 
+//--------------------------------------------------------------------------------------------------
+// The running builds use the pipeline layout and the libraries, they end before those are destroyed
+//
+void RtxPipeline::cancelPipelineBuilds()
+{
+  std::vector<CompiledPipeline> dropped;
+  m_factory.cancel(dropped);
+  for(CompiledPipeline& compiled : dropped)
+    vkDestroyPipeline(m_device, compiled.pipeline, nullptr);
 }
 
 void RtxPipeline::destroyAsyncPipelineBuffer()
 {
   
-  for(PipelineStorage element : storage)
-  {
-    vkDestroyPipeline(m_device,element.pipeline,nullptr);
-    element.sbt.destroy();
-  }
+  m_pool.clear(m_evictedPipelines);
+  retireEvictedPipelines();
+  releaseRetiredPipelines();
 
   for(AsyncPipeline asyncPipeline : asyncPipelineBuffer)
   {
@@ -633,6 +1028,5 @@ void RtxPipeline::destroyAsyncPipelineBuffer()
   }
   asyncPipelineBuffer = std::vector<AsyncPipeline>();
 
-storage = std::vector<PipelineStorage>();
   //pipelineCreateInfoBuffer = std::vector<VkRayTracingPipelineCreateInfoKHR>();
 }
\ No newline at end of file
@@ -20,7 +20,10 @@
 
 #pragma once
 
+#include <deque>
 #include <future>
+#include <mutex>
+#include <unordered_map>
 
 #include "nvvk/resourceallocator_vk.hpp"
 #include "nvvk/debug_util_vk.hpp"
@@ -29,8 +32,15 @@
 #include "nvvk/profiler_vk.hpp"
 #include "nvvk/specialization.hpp"
 
+#include "pipeline_cache.hpp"
+#include "pipeline_config.hpp"
+#include "pipeline_factory.hpp"
+#include "pipeline_pool.hpp"
 #include "renderer.h"
+#include "sbt_arena.hpp"
+#include "spirv_cache.hpp"
 #include "shaders/host_device.h"
+#include "shaders/sorting_keys.h"
 #include "nvvkhl/glsl_compiler.hpp"
 
 using nvvk::SBTWrapper;
@@ -40,9 +50,17 @@ const int NUM_PIPELINES_IN_BUFFER = 2;
   struct PipelineStorage
   {
     VkPipeline pipeline{VK_NULL_HANDLE};
-    SBTWrapper sbt;
+    uint32_t   sbtSlot{SbtArena::kNoSlot};  // Of RtxPipeline::sbtArena()
     SortingParameters parameters;
   };
+
+  // Pipeline object without its SBT, what the background builds produce
+  struct CompiledPipeline
+  {
+    VkPipeline        pipeline{VK_NULL_HANDLE};
+    SortingParameters parameters;
+    ConfigId          configId{0};  // Of the settings it was built with
+  };
 /*
 
 Creating the RtCore renderer 
@@ -69,14 +87,79 @@ public:
   int* getSortingMode() {return &m_sortingMode;};
   int* getNumCoherenceBits() {return &m_numCoherenceBits;};
   void enableProfiling(bool enable);
-  int hashParameters(SortingParameters parameters);
-  SortingParameters rebuildFromhash(int hashCode);
 
   const std::string name() override { return std::string("Rtx"); }
   bool     m_enableProfiling{false};
-  void setNewPipeline();
+  // Ignores an element without pipeline, the current one stays
   void setNewPipeline(PipelineStorage newPipelineElement);
-  std::vector<PipelineStorage> PrebuildPipelineBuffer;
+  // Builds the pipeline of a parameter set, the caller owns it. No pipeline when the SBT arena has
+  // no slot left for it.
+  PipelineStorage buildPipeline(const SortingParameters& parameters);
+
+  // Background builds on the workers of m_factory, `key` is chosen by the caller. False when the
+  // key is already queued, its priority is updated then (higher first).
+  bool requestPipeline(int key, double priority, const SortingParameters& parameters);
+  // A pipeline built in the background, completed with its SBT. Never blocks, false when none is
+  // ready. Call it from the render thread. A pipeline built with settings changed since is
+  // destroyed instead. `element` has no pipeline when the SBT arena had no slot left for it.
+  bool pollPipeline(int& key, PipelineStorage& element);
+  PipelineFactory<CompiledPipeline>::Stats factoryStats() { return m_factory.stats(); }
+
+  // Everything a variant of the parameters depends on with the current renderer settings, see
+  // pipeline_config.hpp. The ID keys the pool, the grid statistics and the result files.
+  PipelineConfig pipelineConfig(const SortingParameters& parameters) const;
+  ConfigId       configId(const SortingParameters& parameters) const { return encodeConfigId(pipelineConfig(parameters)); }
+
+  // Every built variant is in the pool, createPipeline() returns the one of the pool when there is.
+  // Over the budget the least recently used ones are evicted, except the protected ones (the best
+  // of the grid cells) and the active one. Do not keep a PipelineStorage across frames, find it.
+  const PipelineStorage* findPipeline(const SortingParameters& parameters);
+  bool                   hasPipeline(const SortingParameters& parameters);
+  void                   setProtectedPipelines(const std::vector<SortingParameters>& parameters);
+  void                   setPipelineBudget(uint64_t bytes);
+  // Raises the budget to hold `count` pipelines with their SBT slots, never lowers it
+  void                   reservePipelines(uint32_t count);
+  PipelinePool<PipelineStorage>::Stats pipelinePoolStats() const { return m_pool.stats(); }
+
+  // Evicted pipelines are retired with the index of the frame being recorded and destroyed once
+  // that frame is done: switching pipelines never waits for the device. `frame` is being
+  // recorded, every frame up to `completedFrame` is done on the GPU.
+  void beginFrame(uint64_t frame, uint64_t completedFrame);
+  // Destroys all the retired pipelines at once, only when the device is idle
+  void releaseRetiredPipelines();
+  struct RetireStats
+  {
+    uint64_t switches{0};     // setNewPipeline()
+    uint64_t retired{0};      // Evicted from the pool
+    uint64_t released{0};     // Destroyed
+    uint32_t queued{0};       // Waiting for their frame
+    uint64_t deviceWaits{0};  // The pool had to wait for the device (full SBT arena)
+    double   deviceWaitMs{0.0};
+  };
+  RetireStats retireStats() const;
+  // Driver memory of a pipeline, not known to the application. Its slot of the SBT arena is
+  // counted as well.
+  uint64_t m_pipelineBytesEstimate{2ull << 20};
+  // The SBT of every variant, run() traces with the slot of the active one
+  const SbtArena& sbtArena() const { return m_sbtArena; }
+
+  // VK_KHR_pipeline_library: the stages that do not depend on the SortingParameters (both miss
+  // shaders, closest hit, any hit) are compiled once into a library, a variant only compiles its
+  // raygen library and links both. Without the extension every variant is a full pipeline.
+  void usePipelineLibrary(bool enable) { m_usePipelineLibrary = enable; }
+  bool pipelineLibraryInUse() const { return m_usePipelineLibrary; }
+
+  // Creation time of a variant as a full pipeline and linked from the libraries, in ms
+  struct CreationTiming
+  {
+    SortingParameters parameters;
+    double            fullMs{0.0};
+    double            raygenLibraryMs{0.0};
+    double            linkMs{0.0};
+  };
+  // Creates every parameter set both ways without the pipeline cache, nothing is kept.
+  // `hitLibraryMs` is the one-time cost of the shared library.
+  std::vector<CreationTiming> benchmarkPipelineCreation(const std::vector<SortingParameters>& parameters, double& hitLibraryMs);
 
   SortingParameters m_SERParameters{
     32,     //numCoherenceBitsTotal: 0-32 Zero meaning No sorting
@@ -91,13 +174,15 @@ public:
     false,  //whether or not the path is finished after this bounce
   };
 
-  SortingParameters mostRecentParameters = m_SERParameters;
+  // Bits of each component of the specialized sorting key (constants 12-15 of pathtrace.rgen)
+  // By default the key bits are split evenly, see SortingKeyDefaultBudget
+  bool             m_customKeyBudget{false};
+  SortingKeyBudget m_keyBudget{11, 10, 10, 1};
+  SortingKeyBudget keyBudget(const SortingParameters& parameters) const;
 
   PipelineStorage activeElement;
 std::vector<VkPipeline> m_cachedRtPipelines;
-  void activateAsyncPipelineCreation();
   void destroyAsyncPipelineBuffer();
-  bool useAsyncPipelineCreation = false;
 
   bool visualizeSortingGrid{false};
   float displayCubeSize{1.0};
@@ -108,7 +193,39 @@ private:
 
 
   PipelineStorage createPipeline(SortingParameters parameters);
+  // Everything a build reads, taken on the render thread when it is requested: the workers never
+  // read the renderer settings the GUI changes meanwhile
+  struct PipelineBuild
+  {
+    SortingParameters parameters;
+    PipelineConfig    config;
+    ConfigId          configId{0};
+    VkPipelineLayout  layout{VK_NULL_HANDLE};
+  };
+  PipelineBuild pipelineBuild(const SortingParameters& parameters) const;
+  // Thread safe, the slow part of createPipeline()
+  CompiledPipeline compilePipeline(const PipelineBuild& build);
+  // Render thread only, no pipeline without an SBT slot
+  PipelineStorage finishPipeline(const CompiledPipeline& compiled);
   void createPipeline_async();
+  // Stages and groups of a pipeline library, the create info points into them
+  struct LibraryInfo
+  {
+    std::vector<VkPipelineShaderStageCreateInfo>      stages;
+    std::vector<VkRayTracingShaderGroupCreateInfoKHR> groups;
+    VkRayTracingPipelineCreateInfoKHR                 createInfo{VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_KHR};
+  };
+  void raygenLibraryInfo(const VkPipelineShaderStageCreateInfo& raygen, VkPipelineLayout layout, LibraryInfo& info);
+  void hitLibraryInfo(bool anyhit, VkPipelineLayout layout, LibraryInfo& info);
+  // The raygen stage of a variant, `specialization` has to outlive the stage
+  VkPipelineShaderStageCreateInfo raygenStage(const PipelineBuild& build, nvvk::Specialization& specialization);
+  VkPipeline createFullPipeline(const VkPipelineShaderStageCreateInfo& raygen, bool anyhit, VkPipelineLayout layout, VkPipelineCache cache);
+  VkPipeline createRaygenLibrary(const VkPipelineShaderStageCreateInfo& raygen, VkPipelineLayout layout, VkPipelineCache cache);
+  VkPipeline createHitLibrary(bool anyhit, VkPipelineLayout layout, VkPipelineCache cache);
+  VkPipeline linkPipeline(VkPipeline raygenLibrary, VkPipeline hitLibrary, VkPipelineLayout layout, VkPipelineCache cache);
+  // Creation through a deferred operation joined by several threads
+  VkPipeline createRayTracingPipeline(const VkRayTracingPipelineCreateInfoKHR& createInfo, VkPipelineCache cache);
+  void       destroyLibraries();
   void createPipelineLayout(const std::vector<VkDescriptorSetLayout>& rtDescSetLayouts,VkPipelineLayout& pipelineLayout);
   void createPipelineLayout_async(const std::vector<VkDescriptorSetLayout>& rtDescSetLayouts);
 
@@ -117,7 +234,9 @@ private:
   bool     m_enableAnyhit{true};
   int      m_sortingMode{0};
   int      m_numCoherenceBits{32};
-  VkPipelineCache m_PipelineCache;
+  VkPipelineCache m_PipelineCache{VK_NULL_HANDLE};
+  // Loaded from and saved to disk, the variants are compiled once per machine
+  PersistentPipelineCache m_persistentCache;
   void createPipelineCache();
 
 
@@ -140,7 +259,7 @@ private:
 
   struct ShaderObject
   {
-    int hashcode; // represents parameterization of this shader Object
+    ConfigId configId; // represents parameterization of this shader Object
     shaderc::SpvCompilationResult *compResult;
   };
   std::vector<ShaderObject> raygenShaders;
@@ -152,22 +271,43 @@ private:
   shaderc::SpvCompilationResult missshader;
   std::vector<shaderc::SpvCompilationResult> results;
   std::vector<nvvk::Specialization> storedSpecializations;
-  std::vector<int> hashedParameterizations;
+  std::vector<ConfigId> hashedParameterizations;  // configId()
   bool madeOne = false;
   bool creatingPipeline = false;
 
+  // Pipeline libraries, see usePipelineLibrary(). Kept until destroy(), the linked pipelines
+  // of m_pool are created from them.
+  bool       m_usePipelineLibrary{false};
+  VkPipeline m_hitLibraries[2]{VK_NULL_HANDLE, VK_NULL_HANDLE};  // Without and with any hit
+  std::unordered_map<ConfigId, VkPipeline> m_raygenLibraries;     // By configId()
+  std::mutex m_libraryMutex;
+
+  // Two workers: each pipeline creation already runs on several threads (deferred operation)
+  PipelineFactory<CompiledPipeline> m_factory;
+  void                              cancelPipelineBuilds();
+
   
 private:
   //nvvkhl::GlslIncluder glslIncluder;
   nvvkhl::GlslCompiler glslCompiler;
+  std::mutex           m_compilerMutex;  // The options and the includer of glslCompiler are shared
   std::unique_ptr<shaderc::CompileOptions> glslCompileOptions;
   void setupGLSLCompiler();
+  // Module of a shader file, compiled once per content (m_spirvCache) and kept until destroy()
   VkShaderModule CompileAndCreateShaderModule(std::string filename, shaderc_shader_kind shadertype);
+  std::vector<uint32_t> CompileSpirv(const std::string& filename, shaderc_shader_kind shadertype, SpirvKey& key);
   shaderc::SpvCompilationResult CompileShader(std::string filename, shaderc_shader_kind shadertype);
   shaderc::SpvCompilationResult *getRayGenShaderObject();
 
   std::vector<uint32_t> rgen;
 
+  std::vector<std::string> m_shaderSearchPaths;
+  SpirvCompileOptions      m_compileOptions;    // Applied to glslCompiler by setupGLSLCompiler()
+  std::string              m_compileSignature;  // m_compileOptions.signature(), part of the SPIR-V keys
+  SpirvCache               m_spirvCache;
+  std::unordered_map<std::string, VkShaderModule> m_shaderModules;  // By SpirvKey::hex()
+  std::mutex               m_shaderModulesMutex;
+
 
   bool m_busy = false;
   bool requiresNewPipeline = true;
@@ -182,19 +322,17 @@ private:
   {
     VkPipeline pipeline;
     VkRayTracingPipelineCreateInfoKHR createInfo;
-    int hashCode;
+    ConfigId configId;
   };
 
   std::vector<AsyncPipeline> asyncPipelineBuffer;
 
-  void fillPipelineBuffer();
   void buildPipeline();
   
   
 
   VkRayTracingPipelineCreateInfoKHR* asyncPipelineCreateInfo;
 
-  VkRayTracingPipelineCreateInfoKHR m_createInfo{VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_KHR};
   
   
   VkPipeline pipelines[NUM_PIPELINES_IN_BUFFER] = {{VK_NULL_HANDLE},{VK_NULL_HANDLE}};
@@ -204,9 +342,22 @@ private:
 
 
 
-  //std::vector<VkPipeline> storedPipelines;
-  //std::vector<SBTWrapper> storedSBTs;
-  std::vector<PipelineStorage> storage;
+  PipelinePool<PipelineStorage> m_pool;
+  SbtArena                      m_sbtArena;
+  // More than the pool holds within its default budget, a full arena evicts from the pool
+  static constexpr uint32_t kSbtArenaSlots = 1024;
+  static_assert(kSbtArenaSlots >= kNumSortingConfigs, "Every configuration of the table can be prebuilt");
+  std::vector<PipelineStorage>  m_evictedPipelines;  // Scratch of the pool, retired right away
+  struct RetiredPipeline
+  {
+    PipelineStorage element;
+    uint64_t        frame{0};  // Last frame that may use it
+  };
+  std::deque<RetiredPipeline> m_retiredPipelines;  // Oldest first
+  uint64_t                    m_currentFrame{0};
+  RetireStats                 m_retireStats;
+  void                        retireEvictedPipelines();
+  void                        destroyPipeline(PipelineStorage& element);
 
 
   
@@ -25,10 +25,12 @@
 #include <glm/glm.hpp>
 
 #include <filesystem>
+#include <chrono>
 #include <thread>
 #include <iostream>
 #include <algorithm>
 #include <limits>
+#include <map>
 #include <fstream>
 
 
@@ -42,6 +44,7 @@
 #include "tools.hpp"
 
 #include "sorting_grid.hpp"
+#include "ray_stream.hpp"
 
 #include "nvml_monitor.hpp"
 
@@ -89,6 +92,7 @@ void SampleExample::setup(const VkInstance&               instance,
   {
     r->setup(m_device, physicalDevice, queues[eTransfer].familyIndex, &m_alloc);
   }
+  dynamic_cast<RtxPipeline*>(m_pRender[eRtxPipeline])->usePipelineLibrary(m_supportPipelineLibrary);
 
   std::vector<ProfilingStats> stats;
   for(int i = 0; i < eNumSortModes;i++)
@@ -102,6 +106,8 @@ void SampleExample::setup(const VkInstance&               instance,
   rng = rng2;
 
   createStorageBuffer();
+  if(!m_dispatchTimer.init(m_device, physicalDevice, queues[eGCT0].familyIndex, kMaxFramesInFlight))
+    LOGW("No timestamps on the graphics queue, the tuner gets no measurement\n");
 
 
   buildSortingGrid();
@@ -119,9 +125,26 @@ void SampleExample::loadScene(const std::string& filename)
 
   // The picker is the helper to return information from a ray hit under the mouse cursor
   m_picker.setTlas(m_accelStruct.getTlas());
+  inferSortingParameters();
   resetFrame();
 }
 
+//--------------------------------------------------------------------------------------------------
+// Predicting the sorting parameters from the scene and the camera, before the pipeline is created
+//
+void SampleExample::inferSortingParameters()
+{
+  glm::vec3 eye, center, up;
+  CameraManip.getLookat(eye, center, up);
+  m_inference.setInputs(InferenceManager::computeInputs(m_scene.getScene(), m_scene.getCamera().nbLights, eye, center));
+  const InferenceResult& result = m_inference.infer();
+
+  auto rtx = dynamic_cast<RtxPipeline*>(m_pRender[eRtxPipeline]);
+  if(rtx != nullptr)
+    rtx->m_SERParameters = result.parameters;
+  m_hasInferredParameters = false;
+}
+
 //--------------------------------------------------------------------------------------------------
 // Loading an HDR image and creating the importance sampling acceleration structure
 //
@@ -135,34 +158,182 @@ void SampleExample::loadEnvironmentHdr(const std::string& hdrFilename)
   m_rtxState.fireflyClampThreshold = m_skydome.getIntegral() * 4.f;  // magic
 }
 
-void SampleExample::loadSortingGrid(const std::string& jsonFilename)
+void SampleExample::loadSortingGrid(const std::string& filename)
 {
+  MilliTimer timer;
+  if(std::filesystem::path(filename).extension() == ".kgrid")
+  {
+    GridStatsFile file;
+    if(!file.open(filename))
+    {
+      LOGE("%s: %s\n", filename.c_str(), file.error().c_str());
+      return;
+    }
+    restoreSortingGrid(file.view());
+  }
+  else
+  {
+    std::ifstream f(filename);
+    json          js = json::parse(f, nullptr, false);
+    GridStats     stats;
+    if(js.is_discarded() || !gridStatsFromJson(js, stats, timePerCycle))
+    {
+      LOGE("%s is not a sorting grid\n", filename.c_str());
+      return;
+    }
+    restoreSortingGrid(stats.view());
+  }
+  LOGI("Sorting grid %s loaded in %.1f ms\n", filename.c_str(), timer.elapsed());
+}
 
-std::ifstream f(jsonFilename);
-json j = json::parse(f);
-grid_x = j["Grid Dimensions (x,y,z)"][0];
-grid_y = j["Grid Dimensions (x,y,z)"][1];
-grid_z = j["Grid Dimensions (x,y,z)"][2];
-buildSortingGrid();
-m_gui->gridX = grid_x;
-m_gui->gridY = grid_y;
-m_gui->gridZ = grid_z;
-
-
+void SampleExample::restoreSortingGrid(const GridStatsView& stats)
+{
+  // buildSortingGrid() would clamp them, the cells of the file have to match the table and the tuner
+  const glm::ivec3& d = stats.header.dimensions;
+  if(glm::any(glm::lessThan(d, glm::ivec3(1))) || glm::any(glm::greaterThan(d, glm::ivec3(MAXGRIDSIZE)))
+     || stats.header.numSides != kGridNumSides)
+  {
+    LOGE("Sorting grid %d x %d x %d not restored: at most %d cells per axis\n", d.x, d.y, d.z, MAXGRIDSIZE);
+    return;
+  }
+  grid_x = stats.header.dimensions.x;
+  grid_y = stats.header.dimensions.y;
+  grid_z = stats.header.dimensions.z;
+  buildSortingGrid();
+  m_gui->gridX = grid_x;
+  m_gui->gridY = grid_y;
+  m_gui->gridZ = grid_z;
+
+  // Arm of each configuration of the file, by its flags and coherence bits: an ID of other
+  // settings (key budget, sorting mode) falls back to the arm of the same parameters. A legacy one
+  // (version 0) has no coherence bits and measured the wall-clock frame rate, it is not restored.
+  auto armKey = [](const SortingParameters& p) {
+    return canonicalSortingFlags(p) | (p.noSort ? 0u : p.numCoherenceBitsTotal) << 8;
+  };
+  auto                              rtx = dynamic_cast<RtxPipeline*>(m_pRender[eRtxPipeline]);
+  std::unordered_map<ConfigId, int> armOfId;
+  std::unordered_map<uint32_t, int> armOfParameters;
+  for(size_t a = 0; a < m_tunerArms.size(); a++)
+  {
+    armOfId[rtx->configId(m_tunerArms[a])]  = int(a);
+    armOfParameters[armKey(m_tunerArms[a])] = int(a);
+  }
+  uint32_t         remapped = 0;
+  std::vector<int> armOfConfig(stats.header.numConfigs, -1);
+  for(uint32_t c = 0; c < stats.header.numConfigs; c++)
+  {
+    ConfigId       id    = stats.configs[c];
+    auto           exact = armOfId.find(id);
+    PipelineConfig config;
+    if(exact != armOfId.end())
+      armOfConfig[c] = exact->second;
+    else if((id >> 56) != 0 && decodeConfigId(id, config))
+    {
+      auto arm = armOfParameters.find(armKey(config.parameters));
+      if(arm != armOfParameters.end())
+      {
+        armOfConfig[c] = arm->second;
+        remapped++;
+      }
+    }
+  }
 
-for(int i = 0; i < grid.gridDimensions.x; i++)
+  // Configurations of other settings may share an arm, their windows add up
+  struct RestoredArm
+  {
+    uint32_t frames{0};
+    uint32_t cycles{0};
+    double   gpuMs{0.0};
+  };
+  uint32_t restored = 0;
+  uint32_t legacy   = 0;
+  uint32_t unknown  = 0;
+  uint32_t known    = 0;
+  for(uint32_t cell = 0; cell < stats.header.numCells; cell++)
   {
-    for(int j = 0; j < grid.gridDimensions.y; j++)
+    for(uint32_t side = 0; side < kGridNumSides; side++)
     {
-      for(int k = 0; k < grid.gridDimensions.z; k++)
+      std::map<int, RestoredArm> arms;
+      for(uint32_t c = 0; c < stats.header.numConfigs; c++)
       {
-        std::string s1 = "(" + std::to_string(i) + "," + std::to_string(j) + "," + std::to_string(k) + ")";
-        //auto k = j[s1];
+        const GridStatsEntry& entry = stats.entry(cell, side, c);
+        if(entry.cycles == 0)
+          continue;
+        if((stats.configs[c] >> 56) == 0 || entry.frames == 0 || !(entry.gpuMs > 0.0f))
+        {
+          legacy++;
+          continue;
+        }
+        if(armOfConfig[c] < 0)
+        {
+          unknown++;
+          continue;
+        }
+        RestoredArm& arm = arms[armOfConfig[c]];
+        arm.frames += entry.frames;
+        arm.cycles += entry.cycles;
+        arm.gpuMs += entry.gpuMs;
+        restored++;
       }
+      if(arms.empty())
+        continue;
+
+      // Each window of the file counts as one observation of the tuner
+      uint32_t context = cell * kGridNumSides + side;
+      for(const auto& [arm, sum] : arms)
+      {
+        gridTable.restore(cell, side, uint32_t(arm), sum.frames, sum.cycles, float(double(sum.frames) * 1000.0 / sum.gpuMs));
+        m_tuner.restore(context, arm, sum.cycles, sum.gpuMs / double(sum.frames));
+      }
+      // Known when the restored windows single out the best pipeline: more than one of them, and
+      // every other restored arm eliminated. A lone sample, or a lone arm, still leaves the side to
+      // exploration.
+      int  best      = m_tuner.best(context);
+      bool separated = arms.size() > 1 && best >= 0 && m_tuner.stats(context, best).count > 1;
+      for(const auto& [arm, sum] : arms)
+        separated = separated && (arm == best || m_tuner.stats(context, arm).eliminated);
+      m_knownSides[context] = separated;
+      known += separated ? 1 : 0;
     }
   }
+  LOGI("Sorting grid %d x %d x %d: %u measurements restored, %u configurations of other settings, %u legacy, %u unknown, "
+       "%u cube sides known\n",
+       grid_x, grid_y, grid_z, restored, remapped, legacy, unknown, known);
 
+  protectBestPipelines();
+  if(restored > 0)
+  {
+    requestBestPipelines();
+    useBestParameters = true;
+  }
+}
 
+//--------------------------------------------------------------------------------------------------
+// Queues the best pipeline of every measured cube side that is not built yet, the ones that are
+// best on more sides first. Built in the background, collected with the tuner's.
+//
+void SampleExample::requestBestPipelines()
+{
+  auto                  rtx = dynamic_cast<RtxPipeline*>(m_pRender[eRtxPipeline]);
+  std::vector<uint32_t> sides(m_tunerArms.size(), 0);
+  for(uint32_t cell = 0; cell < gridTable.numCells(); cell++)
+  {
+    if(!gridTable.measured(cell))
+      continue;
+    for(uint32_t side = 0; side < kGridNumSides; side++)
+    {
+      int best = gridTable.bestConfig(cell, side);
+      if(best >= 0)
+        sides[best]++;
+    }
+  }
+  uint32_t requested = 0;
+  for(size_t a = 0; a < m_tunerArms.size(); a++)
+  {
+    if(sides[a] > 0 && !rtx->hasPipeline(m_tunerArms[a]) && rtx->requestPipeline(int(a), double(sides[a]), m_tunerArms[a]))
+      requested++;
+  }
+  LOGI("Building the best pipelines of the grid: %u in the background\n", requested);
 }
 //--------------------------------------------------------------------------------------------------
 // Loading asset in a separate thread
@@ -198,6 +369,10 @@ void SampleExample::loadAssets(const char* filename)
 
       m_pRender[m_rndMethod]->create(
           m_size, {m_accelStruct.getDescLayout(), m_offscreen.getDescLayout(), m_scene.getDescLayout(), m_descSetLayout}, &m_scene);
+      if(auto rtx = dynamic_cast<RtxPipeline*>(m_pRender[m_rndMethod]))
+        setInferredParameters(rtx->activeElement.parameters);
+      if(prebuildPipelines)
+        prebuildTunerPipelines();
     }
 
     if(extension == ".hdr")  //|| extension == ".exr")
@@ -206,7 +381,7 @@ void SampleExample::loadAssets(const char* filename)
       loadEnvironmentHdr(sfile);
       updateHdrDescriptors();
     }
-    if(extension == ".json")
+    if(extension == ".json" || extension == ".kgrid")
     {
       m_busyReasonText = "Loading Sorting Grid ";
       loadSortingGrid(sfile);
@@ -252,9 +427,25 @@ void SampleExample::updateFrame()
     refCamMatrix = m;
     fov          = f;
   }
+  if(recordingCameraPath)
+    m_recordedCameraPath.add(cameraKey());
 
   if(m_rtxState.frame < m_maxFrames)
     m_rtxState.frame++;
+
+  // prepareFrame() waited for the fence of this command buffer: the frame last recorded in it
+  // is done, and every frame before it
+  uint32_t commandBuffer = getCurFrame();
+  if(commandBuffer >= m_frameOfCommandBuffer.size())
+    m_frameOfCommandBuffer.resize(commandBuffer + 1, 0);
+  uint64_t completedFrame = m_frameOfCommandBuffer[commandBuffer];
+  m_frameOfCommandBuffer[commandBuffer] = ++m_frameIndex;
+  m_dispatchSamples.clear();
+  m_dispatchTimer.collect(m_dispatchSamples);
+  // While loading, the loading thread owns the pipelines and nothing is traced
+  auto rtx = dynamic_cast<RtxPipeline*>(m_pRender[eRtxPipeline]);
+  if(rtx != nullptr && !m_busy)
+    rtx->beginFrame(m_frameIndex, completedFrame);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -271,90 +462,10 @@ void SampleExample::createStorageBuffer()
                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
   NAME_VK(m_GridSortingKeyBuffer.buffer);
 }
-GridCube SampleExample::determineBestTimesCube(GridSpace* currentGrid)
-{
-  GridCube cube;
-
-  float fastestTime = std::numeric_limits<float>::min();
-  int fastestHash = 0;
-  std::vector<TimingObject>* cubeSideTimingsUP = &getCubeSideElements(CubeSide::CubeUp,currentGrid)->storedElements;
-  for(TimingObject timing : *cubeSideTimingsUP)
-    {
-    if(timing.fps > fastestTime)
-      {
-      fastestTime = timing.fps;
-      fastestHash =timing.hashCode;
-      }
-  }
-  cube.up = fastestHash;
-
-  fastestTime = std::numeric_limits<float>::min();
-  fastestHash = 0;
-  std::vector<TimingObject>* cubeSideTimingsDOWN = &getCubeSideElements(CubeSide::CubeDown,currentGrid)->storedElements;
-  for(TimingObject timing : *cubeSideTimingsDOWN)
-  {
-    if(timing.fps > fastestTime)
-    {
-      fastestTime = timing.fps;
-      fastestHash =timing.hashCode;
-    }
-  }
-  cube.down = fastestHash;
-
-  fastestTime = std::numeric_limits<float>::min();
-  fastestHash = 0;
-  std::vector<TimingObject>* cubeSideTimingsRight = &getCubeSideElements(CubeSide::CubeRight,currentGrid)->storedElements;
-  for(TimingObject timing : *cubeSideTimingsRight)
-  {
-    if(timing.fps > fastestTime)
-    {
-      fastestTime = timing.fps;
-      fastestHash =timing.hashCode;
-    }
-  }
-  cube.right = fastestHash;
-
-  fastestTime = std::numeric_limits<float>::min();
-  fastestHash = 0;
-  std::vector<TimingObject>* cubeSideTimingsLeft = &getCubeSideElements(CubeSide::CubeLeft,currentGrid)->storedElements;
-  for(TimingObject timing : *cubeSideTimingsLeft)
-  {
-    if(timing.fps > fastestTime)
-    {
-      fastestTime = timing.fps;
-      fastestHash =timing.hashCode;
-    }
-  }
-  cube.left = fastestHash;
-
-  fastestTime = std::numeric_limits<float>::min();
-  fastestHash = 0;
-  std::vector<TimingObject>* cubeSideTimingsFront = &getCubeSideElements(CubeSide::CubeFront,currentGrid)->storedElements;
-  for(TimingObject timing : *cubeSideTimingsFront)
-  {
-    if(timing.fps > fastestTime)
-    {
-      fastestTime = timing.fps;
-      fastestHash =timing.hashCode;
-    }
-  }
-  cube.front = fastestHash;
-
-  fastestTime = std::numeric_limits<float>::min();
-  fastestHash = 0;
-  std::vector<TimingObject>* cubeSideTimingsback = &getCubeSideElements(CubeSide::CubeBack,currentGrid)->storedElements;
-  for(TimingObject timing : *cubeSideTimingsback)
-  {
-    if(timing.fps > fastestTime)
-    {
-      fastestTime = timing.fps;
-      fastestHash =timing.hashCode;
-    }
-  }
-  cube.back = fastestHash;
-
-  return cube;
-}
+//--------------------------------------------------------------------------------------------------
+// Uploads the best keys of the cells whose fastest parameters changed, at most 64 KB per frame
+// (the limit of vkCmdUpdateBuffer). A new grid takes a few frames to be cleared on a large grid.
+//
 void SampleExample::updateStorageBuffer(const VkCommandBuffer& cmdBuf)
 {
   if(m_busy)
@@ -362,32 +473,31 @@ void SampleExample::updateStorageBuffer(const VkCommandBuffer& cmdBuf)
 
   LABEL_SCOPE_VK(cmdBuf);
 
+  if(!m_gui->VisualizeSortingGrid)
+    return;
 
-  //upddate best keys data
-if(m_gui->VisualizeSortingGrid)
-{
-  for(int i = 0; i < grid_x;i++)
+  uint32_t first, count;
+  if(!gridTable.takeDirty(65536 / sizeof(GridCube), first, count))
+    return;
+
+  for(uint32_t cell = first; cell < first + count; cell++)
   {
-    for(int j = 0; j < grid_y;j++)
+    // The shader shows the sorting flags of the best config
+    int hashes[6];
+    for(uint32_t side = 0; side < kGridNumSides; side++)
     {
-      for(int k = 0; k < grid_z;k++)
-      {
-        //determine index in buffer, densely packed
-        int index = k*(grid_y*grid_x) + j*grid_x + i;
-        
-        //determine best Key seen yet for each gridspace and viewing direction
-
-
-
-        bestKeys[index] = determineBestTimesCube(&grid.gridSpaces[k][j][i]);
-      }
+      int config   = gridTable.bestConfig(cell, side);
+      hashes[side] = config < 0 ? 0 : int(canonicalSortingFlags(m_tunerArms[config]));
     }
+    GridCube& cube = bestKeys[cell];
+    cube.up        = hashes[CubeUp];
+    cube.down      = hashes[CubeDown];
+    cube.left      = hashes[CubeLeft];
+    cube.right     = hashes[CubeRight];
+    cube.front     = hashes[CubeFront];
+    cube.back      = hashes[CubeBack];
   }
-
-  
-  vkCmdUpdateBuffer(cmdBuf,m_GridSortingKeyBuffer.buffer,0,sizeof(GridCube[1000]),&bestKeys);
-}
-
+  vkCmdUpdateBuffer(cmdBuf, m_GridSortingKeyBuffer.buffer, first * sizeof(GridCube), count * sizeof(GridCube), &bestKeys[first]);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -466,6 +576,10 @@ void SampleExample::destroyResources()
   m_alloc.destroy(m_sunAndSkyBuffer);
   m_alloc.destroy(m_sortingParametersBuffer);
   m_alloc.destroy(m_GridSortingKeyBuffer);
+  m_dispatchTimer.deinit();
+  if(m_gridSave.valid())
+    m_gridSave.wait();
+  m_observationLog.close();
 
   // Descriptors
   vkDestroyDescriptorPool(m_device, m_descPool, nullptr);
@@ -536,6 +650,8 @@ void SampleExample::createRender(RndMethod method)
 
   m_pRender[m_rndMethod]->create(
       m_size, {m_accelStruct.getDescLayout(), m_offscreen.getDescLayout(), m_scene.getDescLayout(), m_descSetLayout}, &m_scene);
+  if(auto rtx = dynamic_cast<RtxPipeline*>(m_pRender[m_rndMethod]))
+    setInferredParameters(rtx->activeElement.parameters);
 }
 
 void SampleExample::rebuildRender()
@@ -544,7 +660,6 @@ void SampleExample::rebuildRender()
   m_pRender[m_rndMethod]->destroy();
   m_pRender[m_rndMethod]->create(
       m_size, {m_accelStruct.getDescLayout(), m_offscreen.getDescLayout(), m_scene.getDescLayout(), m_descSetLayout}, &m_scene);
-
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -560,7 +675,6 @@ void SampleExample::reloadRender()
   //m_pRender[m_rndMethod]->destroy();
   m_pRender[m_rndMethod]->create(
       m_size, {m_accelStruct.getDescLayout(), m_offscreen.getDescLayout(), m_scene.getDescLayout(), m_descSetLayout}, &m_scene);
-
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -573,6 +687,16 @@ void SampleExample::setRenderRegion(const VkRect2D& size)
   m_renderRegion = size;
 }
 
+void SampleExample::setupHeadless(const VkExtent2D& size)
+{
+  m_size = size;
+  // Only for the creation of the post pipeline, nothing is presented
+  createRenderPass();
+  createOffscreenRender();
+  setRenderRegion({{0, 0}, size});
+  CameraManip.setWindowSize(int(size.width), int(size.height));
+}
+
 //////////////////////////////////////////////////////////////////////////
 // Post ray tracing
 //////////////////////////////////////////////////////////////////////////
@@ -629,6 +753,10 @@ void SampleExample::renderScene(const VkCommandBuffer& cmdBuf, nvvk::ProfilerVK&
 
   LABEL_SCOPE_VK(cmdBuf);
 
+  // The frame holding the ray capture is done: prepareFrame() waited on its fence
+  if(m_rayCapture.pending && m_rayCapture.frameInFlight == int(getCurFrame()))
+    finishRayCapture();
+
   auto sec = profiler.timeRecurring("Render", cmdBuf);
 
   // We are done rendering
@@ -722,27 +850,45 @@ glm::vec3 clippedCameraPos = glm::vec3(glm::min(glm::max(cameraPos.x,m_rtxState.
   int gridSpaceZ = glm::floor(relativeCamPosition.z / gridSizes.z);
 
   currentGridSpace = glm::vec3(gridSpaceX,gridSpaceY,gridSpaceZ);
+  m_gridPosition   = relativeCamPosition / gridSizes;
 }
+m_viewDirection = cameraInterest;
 auto rtx = dynamic_cast<RtxPipeline*>(m_pRender[m_rndMethod]);
 if(useBestParameters)
 {
-
-  CubeSideStorage* cubeSide = getCubeSideElements(currentLookDirection,&grid.gridSpaces[currentGridSpace.z][currentGridSpace.y][currentGridSpace.x]);
-  PipelineStorage bestPipeline = cubeSide->bestPipeline;
-  int hash1 = rtx->hashParameters(bestPipeline.parameters);
-  int hash2 = rtx->hashParameters(rtx->m_SERParameters);
+  // the best pipelines of a loaded grid finish in the background
+  collectTunerPipelines();
+  PipelineStorage bestPipeline = bestGridPipeline();
+  ConfigId bestId   = rtx->configId(bestPipeline.parameters);
+  ConfigId activeId = rtx->configId(rtx->m_SERParameters);
   
   if(bestPipeline.pipeline !=VK_NULL_HANDLE)
   {
-    if(hash1 != hash2)
+    if(bestId != activeId)
     {
-      vkDeviceWaitIdle(m_device);
-      rtx->setNewPipeline(bestPipeline);
+      switchPipeline(bestPipeline);
     }
 
   }
   
 }
+  bool captureRays = m_rayCapture.pending && m_rayCapture.frameInFlight < 0;
+  if(captureRays && m_rtxState.maxDepth > m_rayCapture.maxDepth)
+  {
+    // The buffer was sized for the depth of the request
+    LOGW("Ray capture cancelled, the maximum depth changed since the request\n");
+    m_rayCapture.pending = false;
+    captureRays          = false;
+  }
+  if(captureRays)
+  {
+    m_offscreen.cmdBeginRayCapture(cmdBuf);
+    m_rtxState.rayCaptureStride = m_rayCapture.stride;
+    // The frame recorded, in case something moved since the request
+    m_rayCapture.camera = m_scene.getCamera();
+    m_rayCapture.state  = m_rtxState;
+  }
+
   // State is the push constant structure
   m_pRender[m_rndMethod]->setPushContants(m_rtxState);
   // Running the renderer
@@ -750,10 +896,19 @@ if(useBestParameters)
 
   
   auto render_ID = profiler.beginSection("Render Section",cmdBuf);
+  m_dispatchTimer.begin(cmdBuf, getCurFrame(), tunerDispatchTag());
   m_pRender[m_rndMethod]->run(cmdBuf, render_size, profiler,
                               {m_accelStruct.getDescSet(), m_offscreen.getDescSet(), m_scene.getDescSet(), m_descSet});
+  m_dispatchTimer.end(cmdBuf, getCurFrame());
   profiler.endSection(render_ID,cmdBuf);
 
+  if(captureRays)
+  {
+    m_offscreen.cmdEndRayCapture(cmdBuf);
+    m_rtxState.rayCaptureStride = 0;
+    m_rayCapture.frameInFlight  = int(getCurFrame());
+  }
+
 
 
 
@@ -903,57 +1058,15 @@ void SampleExample::onMouseButton(int button, int action, int mods)
   }
 }
 
-bool parametersLegalCheck(SortingParameters parameters)
-{ 
-  //both th information for the actua ray endpoint or the hitobject sorting only exist after Ray traversal has been performed
-  //So a parameter set that uses them before Ray traversal would be illegal
-  // we also disqualify estimated Endpoint information with either setting, sicne they are redundant
-  if((parameters.realEndpoint || parameters.hitObject) && (parameters.estimatedEndpoint || (!parameters.sortAfterASTraversal)))
-  {
-    return false;
-  }
-  // we  disqualify estimated Endpoint information being used after ray traversal, since that would be redundant
-  if(parameters.estimatedEndpoint && parameters.sortAfterASTraversal)
-  {
-    return false;
-  }
-  if(parameters.noSort &&(parameters.hitObject))
-  {
-    return false;
-  }
-  return true;
-}
+// A random entry of kSortingConfigs
 SortingParameters SampleExample::createSortingParameters()
 {
-  SortingParameters result;
-  bool isLegal = false;
-  std::uniform_int_distribution<std::mt19937::result_type> dist32(1,32);
-  std::uniform_int_distribution<std::mt19937::result_type> distBool(0,1);
-
-  while(!isLegal)
-  {
-
-    //random number of coherence Bits
-    result.numCoherenceBitsTotal = dist32(rng);
-    result.sortAfterASTraversal = distBool(rng);
-    result.estimatedEndpoint = distBool(rng);
-    result.realEndpoint = distBool(rng);
-    result.noSort = distBool(rng);
-    result.hitObject = distBool(rng);
-    result.rayDirection = distBool(rng);
-    result.rayOrigin =  distBool(rng);
-    result.isFinished = distBool(rng);
-
-
-
-    isLegal = parametersLegalCheck(result);
-  }
-  return result;
+  std::uniform_int_distribution<uint32_t> dist(0, kNumSortingConfigs - 1);
+  return kSortingConfigs[dist(rng)].parameters();
 }
 
 void SampleExample::beginSortingGridTraining()
 {
-  constantGridlearningSpeed = 1.0f;
   trainingDirectionIndex = 0;
   trainingPosition = glm::vec3(0,0,0);
 
@@ -992,11 +1105,17 @@ void SampleExample::iterateTrainingPosition()
 }
 void SampleExample::doCycle()
 {
-  //timer
+  collectTunerPipelines();
+  m_tunerWindow.add(m_dispatchSamples);
+
+  //timer, the window measures the dispatches of the context and arm it starts with
+  //the first ones of a new pipeline are warm-up, a rebind of the same arm is none
   if(framesThisCycle == 0)
   {
     framesThisCycle++;
-
+    uint64_t tag      = tunerDispatchTag();
+    bool     switched = uint32_t(tag) != uint32_t(m_tunerWindow.tag());
+    m_tunerWindow.begin(tag, switched ? m_steadyState.warmupFrames : 0);
     return;
   }
  timeRemaining -= ImGui::GetIO().DeltaTime * 1000;
@@ -1004,75 +1123,49 @@ void SampleExample::doCycle()
 
  if(timeRemaining < 0.0)
  {
-
-
-  printf(std::to_string(framesThisCycle).c_str());
-  printf("\n");
   timeRemaining = timePerCycle;
   auto rtx = dynamic_cast<RtxPipeline*>(m_pRender[m_rndMethod]);
-  int hashCode = rtx->hashParameters(rtx->m_SERParameters);
-  bool foundOne = false;
-  bool foundOne2 = false;
-
-   //currentGrid = &sortingGrid[currentGridSpace.z][currentGridSpace.y][currentGridSpace.x];
-  GridSpace* currentGrid = &grid.gridSpaces[currentGridSpace.z][currentGridSpace.y][currentGridSpace.x];
-  
-  CubeSideStorage* cubeSide = getCubeSideElements(currentLookDirection,currentGrid);
-  std::vector<TimingObject>* observedData = &cubeSide->storedElements;
-  
 
-  for(int i = 0; i < observedData->size(); i++)
+  //GPU time of the ray tracing dispatches of the window: no UI, tonemapping, present or CPU stall
+  uint32_t measuredContext = uint32_t(m_tunerWindow.tag() >> 32);
+  int      measuredArm     = int(uint32_t(m_tunerWindow.tag()));
+  if(measuredArm >= 0 && m_tunerWindow.count() > 0)
   {
-    TimingObject* object = &observedData->at(i);
-    if(hashCode == object->hashCode)
+    //steady state: no warm-up, no hitch of a compile on another thread
+    m_lastEstimate = m_tunerWindow.estimate(m_steadyState);
+    //raw counts of the cube side, written to the JSON results
+    gridTable.record(measuredContext / kGridNumSides, measuredContext % kGridNumSides, uint32_t(measuredArm),
+                     m_lastEstimate.used, float(m_lastEstimate.ms * m_lastEstimate.used));
+    //the tuner decides which pipeline is the best, from the mean and variance of all windows
+    m_tuner.observe(measuredContext, measuredArm, m_lastEstimate.ms);
+    if(logObservations && rtx != nullptr)
     {
-      object->frames += framesThisCycle;
-      object->totalCycles += 1;
-      object->fps = object->frames*1000/(timePerCycle * object->totalCycles);
-
-      int bestPipelineParameterHash = rtx->hashParameters(cubeSide->bestPipeline.parameters);
-      
-
-      // when current parameters and the ones of the best pipeline are identical, update best pipeline timing
-      if(hashCode == bestPipelineParameterHash)
-      {
-        cubeSide->bestpipelineFPS = object->fps;
-      }
-      else {
-        //if they are different test if current parameters are faster, update bestPipeline if they are
-        if(object->fps > cubeSide->bestpipelineFPS)
-          {
-            cubeSide->bestpipelineFPS = object->fps;
-            cubeSide->bestPipeline = rtx->activeElement;
-          }
-      }
-
-      foundOne2 = true;
-      break;
+      ObservationRecord record;
+      CameraKey         camera = cameraKey();
+      record.timestampNs = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                        std::chrono::system_clock::now().time_since_epoch())
+                                        .count());
+      record.config      = rtx->configId(m_tunerArms[measuredArm]);
+      record.gpuNs       = uint64_t(m_tunerWindow.sumMs() * 1e6);
+      record.estimateNs  = uint64_t(m_lastEstimate.ms * 1e6);
+      record.cell        = measuredContext / kGridNumSides;
+      record.side        = measuredContext % kGridNumSides;
+      record.frames      = m_tunerWindow.count();
+      record.outliers    = m_lastEstimate.outliers;
+      record.eye         = camera.eye;
+      record.center      = camera.center;
+      record.up          = camera.up;
+      record.fov         = camera.fov;
+      m_observationLog.append(record);
     }
+    protectBestPipelines();
   }
-  if(!foundOne2)
-  {
-    TimingObject newTiming;
-    newTiming.hashCode = hashCode;
-    newTiming.frames = framesThisCycle;
-    newTiming.fps = framesThisCycle*1000/timePerCycle;
-    newTiming.totalCycles = 1;
-    observedData->emplace_back(newTiming);
-
-    if(newTiming.fps > cubeSide->bestpipelineFPS)
-      {
-        cubeSide->bestpipelineFPS = newTiming.fps;
-        cubeSide->bestPipeline = rtx->activeElement;
-        
-      }
-  }
-  int minNumberTestedConfigs = 5;
-  int numTestedConfigs = observedData->size();
-  float randValue = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
-  float val = glm::max(numTestedConfigs-minNumberTestedConfigs,0) / 5;
 
-  if(performAutomaticTraining && val > randValue)
+  uint32_t context = tunerContext();
+  int arm = tunerArm(rtx->m_SERParameters);
+
+  //the training moves on once the cube side is converged or out of windows
+  if(performAutomaticTraining && m_tuner.finished(context))
   {
     if(trainingDirectionIndex == 0)
     {
@@ -1085,368 +1178,407 @@ void SampleExample::doCycle()
     {
       trainingDirectionIndex = 0;
     }
-    //glm::vec3 newCameraDirection = CameraManip.getCenter();
     CameraManip.setLookat(newCameraPosition,newCameraDirection,CameraManip.getUp());
   }
 
   framesThisCycle = 0;
-  float r = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
-  
-  //with probability 1-epsilon, or no pipeline is porea
-  float epsilon = useConstantGridLearning ? constantGridlearningSpeed : currentGrid->adaptiveGridLearningRate;
-  if(r > epsilon || rtx->PrebuildPipelineBuffer.empty())
-  {
-
 
-      printf("exploit\n");
-      if(currentGrid->bestPipeline.pipeline != VK_NULL_HANDLE)
+  // a confident inference is trusted, the grid only explores while training or when the inference is unsure
+  // a cube side of a loaded grid is known, it starts at its best pipeline
+  bool known      = context < m_knownSides.size() && m_knownSides[context];
+  bool mayExplore = performAutomaticTraining || (m_inference.shouldExplore() && !known);
+  if(!mayExplore || m_tuner.converged(context))
+  {
+      PipelineStorage bestPipeline = bestGridPipeline();
+      if(bestPipeline.pipeline != VK_NULL_HANDLE)
       {
-        rtx->setNewPipeline(currentGrid->bestPipeline);
-        printf("chose faster one\n");
+        switchPipeline(bestPipeline);
+      }
+      else if(const PipelineStorage* inferred = m_hasInferredParameters ? rtx->findPipeline(m_inferredParameters) : nullptr)
+      {
+        switchPipeline(*inferred);
       }
-
-
-
   }
-  //otherwise explore
+  //otherwise measure the arm chosen by the tuner
   else {
-      vkDeviceWaitIdle(m_device);
-      rtx->setNewPipeline();
-      printf("explore\n");
-      if(!useConstantGridLearning)
+      int next = m_tuner.select(context);
+      if(buildPipelinesInBackground && next >= 0 && !rtx->hasPipeline(m_tunerArms[next]))
       {
-        currentGrid->adaptiveGridLearningRate -= currentGrid->adaptiveGridLearningRate/10.0f;
-        currentGrid->adaptiveGridLearningRate = glm::max(currentGrid->adaptiveGridLearningRate,0.1f);
+        requestTunerPipelines(context, next);
+        next = readyTunerArm(context);
+      }
+      if(next >= 0 && next != arm)
+      {
+        switchPipeline(tunerPipeline(next));
       }
   }
  }
 
 }
 
-
-void SampleExample::buildSortingGrid()
+//--------------------------------------------------------------------------------------------------
+// One tuner context per cell and cube side, the arms are all the legal parameter sets
+//
+void SampleExample::setObservationLogging(bool enable)
 {
-  std::vector<std::vector<std::vector<GridSpace>>> newSortingGrid;
-  //newSortingGrid.resize(grid_y,std::vector<GridSpace>(grid_x));
-  newSortingGrid.resize(grid_z,std::vector<std::vector<GridSpace> >(grid_y,std::vector<GridSpace>(grid_x)));
-  sortingGrid = newSortingGrid;
-  grid.gridSpaces = newSortingGrid;
-  grid.gridDimensions = glm::vec3(grid_x,grid_y,grid_z);
-  printf("build new Grid with dimension %d , %d \n",grid_y,grid_x);
+  logObservations = false;
+  if(!enable)
+  {
+    m_observationLog.close();
+    return;
+  }
+  if(!m_observationLog.open(observationLogFile))
+  {
+    LOGE("Observation log: %s\n", m_observationLog.error().c_str());
+    return;
+  }
+  logObservations = true;
+  LOGI("Observation log: appending to %s\n", observationLogFile.c_str());
 }
 
-#include <ctime>
-
-//int SampleExample::getCubeSideHash()
+void SampleExample::resetTuner()
+{
+  if(m_tunerArms.empty())
+    m_tunerArms = allSortingParameters();
+  m_tuner.reset(uint32_t(m_tunerArms.size()), uint32_t(grid_x * grid_y * grid_z * 6));
+  m_knownSides.assign(m_tuner.numContexts(), false);
+  m_gridBlender.reset();
+}
 
-json SampleExample::fillJsonWithAllResults(json js)
+uint32_t SampleExample::tunerContext() const
 {
-  CubeSideStorage* cubeside= getCubeSideElements(CubeUp,&grid.gridSpaces[0][0][0]);
-for(int i = 0; i < grid.gridDimensions.x; i++)
-  {
-    for(int j = 0; j < grid.gridDimensions.y; j++)
-    {
-      for(int k = 0; k < grid.gridDimensions.z; k++)
-      {
-        std::string s1 = "(" + std::to_string(i) + "," + std::to_string(j) + "," + std::to_string(k) + ")";
-        //CubeSideStorage* cubeside= getCubeSideElements(CubeBack,&grid.gridSpaces[k][j][i]);
-        CubeSideStorage* cubeside= getCubeSideElements(CubeUp,&grid.gridSpaces[k][j][i]);
+  return gridCell(currentGridSpace) * kGridNumSides + uint32_t(currentLookDirection);
+}
 
-        if(cubeside->storedElements.empty())
-        {
-          js[s1]["top"] = 1;
-        } else {
-          std::vector<int> hashcodes;
-          std::vector<float> times;
-          for(TimingObject timing : cubeside->storedElements)
-          {
-            //hashcodes.emplace_back(timing.hashCode);
-            //times.emplace_back(timing.fps);
+uint64_t SampleExample::tunerDispatchTag()
+{
+  auto rtx = dynamic_cast<RtxPipeline*>(m_pRender[eRtxPipeline]);
+  int  arm = rtx != nullptr && m_rndMethod == eRtxPipeline ? tunerArm(rtx->m_SERParameters) : -1;
+  return uint64_t(tunerContext()) << 32 | uint32_t(arm);
+}
 
+// Same order as the shaders index m_GridSortingKeyBuffer
+uint32_t SampleExample::gridCell(const glm::ivec3& gridSpace) const
+{
+  return (uint32_t(gridSpace.z) * grid_y + uint32_t(gridSpace.y)) * grid_x + uint32_t(gridSpace.x);
+}
 
-            js[s1]["top"][std::to_string(timing.hashCode)] = timing.fps;
-          }
-          //js[s1]["top"]["hashcodes"] = hashcodes;
-          //js[s1]["top"]["FPS"] = times;
-        }
+//--------------------------------------------------------------------------------------------------
+// The fastest parameters blended around the camera, or the tuner's best arm of the cube side, or
+// the fastest measured parameters before it has one
+//
+PipelineStorage SampleExample::bestGridPipeline()
+{
+  int best = -1;
+  if(blendGridCells)
+  {
+    m_lastBlend = m_gridBlender.select(gridTable, m_gridPosition, glm::ivec3(grid_x, grid_y, grid_z), m_viewDirection);
+    best        = m_lastBlend.config;
+  }
+  if(best < 0)
+    best = m_tuner.best(tunerContext());
+  if(best < 0)
+    best = gridTable.bestConfig(gridCell(currentGridSpace), uint32_t(currentLookDirection));
+  if(best < 0)
+    return PipelineStorage();
+  auto rtx = dynamic_cast<RtxPipeline*>(m_pRender[eRtxPipeline]);
+  if(const PipelineStorage* built = rtx->findPipeline(m_tunerArms[best]))
+    return *built;
+  // e.g. after a reload, the best one is built again in the background
+  if(buildPipelinesInBackground)
+    rtx->requestPipeline(best, std::numeric_limits<double>::infinity(), m_tunerArms[best]);
+  return PipelineStorage();
+}
 
-        cubeside= getCubeSideElements(CubeDown,&grid.gridSpaces[k][j][i]);
+//--------------------------------------------------------------------------------------------------
+// The pool never evicts the best parameters of a measured cube side nor the inferred ones
+//
+void SampleExample::protectBestPipelines()
+{
+  auto              rtx = dynamic_cast<RtxPipeline*>(m_pRender[eRtxPipeline]);
+  std::vector<bool> best(m_tunerArms.size(), false);
+  for(uint32_t cell = 0; cell < gridTable.numCells(); cell++)
+  {
+    if(!gridTable.measured(cell))
+      continue;
+    for(uint32_t side = 0; side < kGridNumSides; side++)
+    {
+      uint32_t context = cell * kGridNumSides + side;
+      int      config  = context < m_tuner.numContexts() ? m_tuner.best(context) : -1;
+      if(config < 0)
+        config = gridTable.bestConfig(cell, side);
+      if(config >= 0 && size_t(config) < best.size())
+        best[config] = true;
+    }
+  }
 
-        if(cubeside->storedElements.empty())
-        {
-          js[s1]["bottom"] = 1;
-        } else {
-          for(TimingObject timing : cubeside->storedElements)
-          {
-            
-            js[s1]["bottom"][std::to_string(timing.hashCode)] = timing.fps;
-          }
-        }
+  std::vector<SortingParameters> keep;
+  for(size_t a = 0; a < best.size(); a++)
+    if(best[a])
+      keep.push_back(m_tunerArms[a]);
+  if(m_hasInferredParameters)
+    keep.push_back(m_inferredParameters);
+  rtx->setProtectedPipelines(keep);
+}
 
-          cubeside= getCubeSideElements(CubeLeft,&grid.gridSpaces[k][j][i]);
+void SampleExample::setInferredParameters(const SortingParameters& parameters)
+{
+  m_inferredParameters    = parameters;
+  m_hasInferredParameters = true;
+  protectBestPipelines();
+}
 
-          if(cubeside->storedElements.empty())
-          {
-            js[s1]["left"] = 1;
-          }
-          else {
-            for(TimingObject timing : cubeside->storedElements)
-            {
-              
-              js[s1]["left"][std::to_string(timing.hashCode)] = timing.fps;
-            }
-          }
+//--------------------------------------------------------------------------------------------------
+// Every arm without a pipeline is queued by its value to the tuner, the selected one first.
+// Eliminated arms are not built.
+//
+void SampleExample::requestTunerPipelines(uint32_t context, int selected)
+{
+  auto rtx = dynamic_cast<RtxPipeline*>(m_pRender[eRtxPipeline]);
+  for(size_t a = 0; a < m_tunerArms.size(); a++)
+  {
+    if(rtx->hasPipeline(m_tunerArms[a]))
+      continue;
+    double priority = int(a) == selected ? std::numeric_limits<double>::infinity() : m_tuner.buildPriority(context, int(a));
+    if(priority > -std::numeric_limits<double>::infinity())
+      rtx->requestPipeline(int(a), priority, m_tunerArms[a]);
+  }
+}
 
-          cubeside= getCubeSideElements(CubeRight,&grid.gridSpaces[k][j][i]);
+// Once per frame, the SBT of a finished pipeline is the only work on the render thread. The
+// pipelines go to the pool of the renderer.
+void SampleExample::collectTunerPipelines()
+{
+  auto rtx = dynamic_cast<RtxPipeline*>(m_pRender[eRtxPipeline]);
+  int             arm;
+  PipelineStorage element;
+  while(rtx->pollPipeline(arm, element))
+  {
+  }
+}
 
-          if(cubeside->storedElements.empty())
-          {
-            js[s1]["right"] = 1;
-          }
-          else {
-            for(TimingObject timing : cubeside->storedElements)
-            {
-              
-              js[s1]["right"][std::to_string(timing.hashCode)] = timing.fps;
-            }
-          }
+// The built arm the tuner values most, -1 when none is built
+int SampleExample::readyTunerArm(uint32_t context)
+{
+  auto   rtx     = dynamic_cast<RtxPipeline*>(m_pRender[eRtxPipeline]);
+  int    ready   = -1;
+  double highest = -std::numeric_limits<double>::infinity();
+  for(size_t a = 0; a < m_tunerArms.size(); a++)
+  {
+    if(!rtx->hasPipeline(m_tunerArms[a]))
+      continue;
+    double priority = m_tuner.buildPriority(context, int(a));
+    if(priority > highest)
+    {
+      ready   = int(a);
+      highest = priority;
+    }
+  }
+  return ready;
+}
 
-          cubeside= getCubeSideElements(CubeFront,&grid.gridSpaces[k][j][i]);
+int SampleExample::tunerArm(const SortingParameters& parameters)
+{
+  auto rtx = dynamic_cast<RtxPipeline*>(m_pRender[eRtxPipeline]);
+  ConfigId id  = rtx->configId(parameters);
+  for(size_t i = 0; i < m_tunerArms.size(); i++)
+  {
+    if(rtx->configId(m_tunerArms[i]) == id)
+      return int(i);
+  }
+  return -1;
+}
 
-          if(cubeside->storedElements.empty())
-          {
-            js[s1]["front"] = 1;
-          }
-          else {
-            for(TimingObject timing : cubeside->storedElements)
-            {
-              
-              js[s1]["front"][std::to_string(timing.hashCode)] = timing.fps;
-            }
-          }
+//--------------------------------------------------------------------------------------------------
+// Builds the pipeline of every tuner arm (all of kSortingConfigs) in parallel on the workers of
+// RtxPipeline, the pool is made large enough to keep them all: the exploration then only finds
+// them in the pool. Blocks, for the loading thread and the headless mode, the progress goes to the
+// busy window and the log.
+//
+void SampleExample::prebuildTunerPipelines()
+{
+  auto rtx = dynamic_cast<RtxPipeline*>(m_pRender[eRtxPipeline]);
+  if(rtx == nullptr || m_tunerArms.empty())
+    return;
 
+  MilliTimer timer;
+  uint32_t   total = uint32_t(m_tunerArms.size());
+  uint32_t   built  = 0;
+  uint32_t   failed = 0;
+  rtx->reservePipelines(total);
+  for(uint32_t a = 0; a < total; a++)
+  {
+    if(rtx->hasPipeline(m_tunerArms[a]))
+      built++;
+    else
+      rtx->requestPipeline(int(a), -double(a), m_tunerArms[a]);  // In table order
+  }
 
-          cubeside= getCubeSideElements(CubeBack,&grid.gridSpaces[k][j][i]);
-          if(cubeside->storedElements.empty())
-          {
-            js[s1]["back"] = 1;
-          }
-          else {
-            
-            for(TimingObject timing : cubeside->storedElements)
-            {
-              
-              js[s1]["back"][std::to_string(timing.hashCode)] = timing.fps;
-              //js["Observations"][s1]["back"] = {}
-            }
-          }
+  int             arm;
+  PipelineStorage element;
+  while(true)
+  {
+    if(rtx->pollPipeline(arm, element))
+    {
+      if(element.pipeline == VK_NULL_HANDLE)
+      {
+        failed++;
+        continue;
       }
+      built++;
+      m_busyReasonText = "Building pipelines " + std::to_string(std::min(built, total)) + "/" + std::to_string(total) + " ";
+      if(built % 8 == 0 || built == total)
+        LOGI("Pipelines: %u of %u built\n", std::min(built, total), total);
+      continue;
     }
+    auto stats = rtx->factoryStats();
+    if(stats.pending + stats.building + stats.ready == 0)
+      break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
   }
+  if(failed > 0)
+    LOGE("Prebuild: %u of %u pipelines without an SBT slot\n", failed, total);
+  LOGI("Prebuilt %u pipelines in %.1f ms\n", total - failed, timer.elapsed());
+}
 
-  return js;
+void SampleExample::switchPipeline(const PipelineStorage& element)
+{
+  // A failed build, the current pipeline stays
+  if(element.pipeline == VK_NULL_HANDLE)
+    return;
+  if(waitIdleOnPipelineSwitch)
+  {
+    MilliTimer timer;
+    vkDeviceWaitIdle(m_device);
+    m_switchWaits++;
+    m_switchWaitMs += timer.elapsed();
+  }
+  auto rtx = dynamic_cast<RtxPipeline*>(m_pRender[eRtxPipeline]);
+  rtx->setNewPipeline(element);
 }
 
+PipelineStorage SampleExample::tunerPipeline(int arm)
+{
+  auto rtx = dynamic_cast<RtxPipeline*>(m_pRender[eRtxPipeline]);
+  if(const PipelineStorage* built = rtx->findPipeline(m_tunerArms[arm]))
+    return *built;
+  return rtx->buildPipeline(m_tunerArms[arm]);
+}
+
+
+void SampleExample::buildSortingGrid()
+{
+  // m_GridSortingKeyBuffer holds MAXGRIDSIZE^3 cells
+  grid_x = glm::clamp(grid_x, 1, MAXGRIDSIZE);
+  grid_y = glm::clamp(grid_y, 1, MAXGRIDSIZE);
+  grid_z = glm::clamp(grid_z, 1, MAXGRIDSIZE);
+  resetTuner();
+  uint32_t numCells = uint32_t(grid_x * grid_y * grid_z);
+  gridTable.reset(numCells, uint32_t(m_tunerArms.size()));
+  bestKeys.assign(numCells, GridCube{});
+  printf("build new Grid with dimension %d , %d , %d \n",grid_x,grid_y,grid_z);
+}
+
+#include <ctime>
+
+//int SampleExample::getCubeSideHash()
+
 json SampleExample::fillJsonWithBestResult(json js)
 {
-  std::string s1 = "(" + std::to_string(0) + "," + std::to_string(0) + "," + std::to_string(0) + ")";
-  CubeSideStorage* cubeside= getCubeSideElements(CubeUp,&grid.gridSpaces[0][0][0]);
-for(int i = 0; i < grid.gridDimensions.x; i++)
+  auto rtx = dynamic_cast<RtxPipeline*>(m_pRender[eRtxPipeline]);
+  for(int i = 0; i < grid_x; i++)
   {
-    for(int j = 0; j < grid.gridDimensions.y; j++)
+    for(int j = 0; j < grid_y; j++)
     {
-      for(int k = 0; k < grid.gridDimensions.z; k++)
+      for(int k = 0; k < grid_z; k++)
       {
         std::string s1 = "(" + std::to_string(i) + "," + std::to_string(j) + "," + std::to_string(k) + ")";
-        //CubeSideStorage* cubeside= getCubeSideElements(CubeBack,&grid.gridSpaces[k][j][i]);
-        CubeSideStorage* cubeside= getCubeSideElements(CubeUp,&grid.gridSpaces[k][j][i]);
-
-        if(cubeside->storedElements.empty())
+        uint32_t    cell = gridCell(glm::ivec3(i, j, k));
+        for(uint32_t side = 0; side < kGridNumSides; side++)
         {
-          js["Observations"][s1]["top"] = 1;
-        } else {
-          float fastestTime = std::numeric_limits<float>::min();
-          int fastestParameters = 0;
-          for(TimingObject timing : cubeside->storedElements)
+          int best = gridTable.bestConfig(cell, side);
+          if(best < 0)
           {
-            if(timing.fps > fastestTime)
-            {
-              fastestTime = timing.fps;
-              fastestParameters = timing.hashCode;
-            }
+            js["Observations"][s1][kCubeSideNames[side]] = 1;
+            continue;
           }
-          js["Observations"][s1]["top"] = {fastestParameters,fastestTime};
+          js["Observations"][s1][kCubeSideNames[side]] = {configIdString(rtx->configId(m_tunerArms[best])), gridTable.bestFps(cell, side)};
         }
-
-        cubeside= getCubeSideElements(CubeDown,&grid.gridSpaces[k][j][i]);
-
-        if(cubeside->storedElements.empty())
-        {
-          js["Observations"][s1]["bottom"] = 1;
-        } else {
-          float fastestTime = std::numeric_limits<float>::min();
-          int fastestParameters = 0;
-          for(TimingObject timing : cubeside->storedElements)
-          {
-            if(timing.fps > fastestTime)
-            {
-              fastestTime = timing.fps;
-              fastestParameters = timing.hashCode;
-            }
-          }
-          js["Observations"][s1]["bottom"] = {fastestParameters,fastestTime};
-        }
-
-          cubeside= getCubeSideElements(CubeLeft,&grid.gridSpaces[k][j][i]);
-
-          if(cubeside->storedElements.empty())
-          {
-            js["Observations"][s1]["left"] = 1;
-          }
-          else {
-            float fastestTime = std::numeric_limits<float>::min();
-            int fastestParameters = 0;
-            for(TimingObject timing : cubeside->storedElements)
-            {
-              if(timing.fps > fastestTime)
-              {
-                fastestTime = timing.fps;
-                fastestParameters = timing.hashCode;
-              }
-            }
-            js["Observations"][s1]["left"] = {fastestParameters,fastestTime};
-          }
-
-          cubeside= getCubeSideElements(CubeRight,&grid.gridSpaces[k][j][i]);
-
-          if(cubeside->storedElements.empty())
-          {
-            js["Observations"][s1]["right"] = 1;
-          }
-          else {
-            float fastestTime = std::numeric_limits<float>::min();
-            int fastestParameters = 0;
-            for(TimingObject timing : cubeside->storedElements)
-            {
-              if(timing.fps > fastestTime)
-              {
-                fastestTime = timing.fps;
-                fastestParameters = timing.hashCode;
-              }
-            }
-            js["Observations"][s1]["right"] = {fastestParameters,fastestTime};
-          }
-
-          cubeside= getCubeSideElements(CubeFront,&grid.gridSpaces[k][j][i]);
-
-          if(cubeside->storedElements.empty())
-          {
-            js["Observations"][s1]["front"] = 1;
-          }
-          else {
-            float fastestTime = std::numeric_limits<float>::min();
-            int fastestParameters = 0;
-            for(TimingObject timing : cubeside->storedElements)
-            {
-              if(timing.fps > fastestTime)
-              {
-                fastestTime = timing.fps;
-                fastestParameters = timing.hashCode;
-              }
-            }
-            js["Observations"][s1]["front"] = {fastestParameters,fastestTime};
-          }
-
-
-          cubeside= getCubeSideElements(CubeBack,&grid.gridSpaces[k][j][i]);
-          if(cubeside->storedElements.empty())
-          {
-            js["Observations"][s1]["back"] = 1;
-          }
-          else {
-            float fastestTime = std::numeric_limits<float>::min();
-            int fastestParameters = 0;
-            for(TimingObject timing : cubeside->storedElements)
-            {
-              if(timing.fps > fastestTime)
-              {
-                fastestTime = timing.fps;
-                fastestParameters = timing.hashCode;
-              }
-            }
-            js["Observations"][s1]["back"] = {fastestParameters,fastestTime};
-          }
       }
     }
   }
 
   return js;
 }
+//--------------------------------------------------------------------------------------------------
+// Copy of the table on the render thread (only the measured cells), written by another one: the
+// binary statistics (grid_stats.hpp) and the JSON layout of the earlier versions, named by the time
+// to the millisecond. A name already taken gets a sequence number.
+//
 void SampleExample::SaveSortingGrid()
 {
+  if(m_gridSave.valid() && m_gridSave.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+  {
+    LOGW("The previous sorting grid is still being saved\n");
+    return;
+  }
 
-
-  json j2;
-  j2["Grid Dimensions (x,y,z)"] = {grid.gridDimensions.x,grid.gridDimensions.y,grid.gridDimensions.z};
-
-  j2 = fillJsonWithAllResults(j2);
-  std::string s = j2.dump(4);
-
-  time_t timestamp = time(&timestamp);
-  struct tm * datetime = localtime(&timestamp);
-  //printf("%2d_%2d__%2d_%2d_%2d\n",datetime->tm_mday,datetime->tm_mon,datetime->tm_hour,datetime->tm_min,datetime->tm_sec);
-
-  char buffer [80];
-  strftime(buffer,80,"%d_%m-%H_%M_%S",datetime);
-  //printf(buffer);
-  std::string begin = "C:/Users/Frederik/Key_Inference_For_SER/Sorting_Grid_Results/";
-  std::string filename = std::string(buffer);
-  std::string end = ".json";
-  std::string fullFileName =begin + filename + end;
-  std::fstream fs;
-  std::ofstream outstream;
-
-  outstream.open(fullFileName, std::fstream::out | std::fstream::app);
-
-  outstream << s;
-
-  outstream.close();
-  
-  printf("saved to file\n");
-  printf("with File name: ");
-  printf(fullFileName.c_str());
-  
+  auto                  rtx = dynamic_cast<RtxPipeline*>(m_pRender[eRtxPipeline]);
+  std::vector<ConfigId> configs;
+  for(const SortingParameters& arm : m_tunerArms)
+    configs.push_back(rtx->configId(arm));
+
+  auto   now       = std::chrono::system_clock::now();
+  time_t timestamp = std::chrono::system_clock::to_time_t(now);
+  int    ms        = int(std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000);
+  char   buffer[80];
+  size_t length = strftime(buffer, sizeof(buffer), "%d_%m-%H_%M_%S", localtime(&timestamp));
+  snprintf(buffer + length, sizeof(buffer) - length, "_%03d", ms);
+  // The previous save has finished, its files exist
+  auto taken = [](const std::string& name) {
+    std::error_code code;
+    return std::filesystem::exists(name + ".kgrid", code) || std::filesystem::exists(name + ".json", code);
+  };
+  std::string base = (std::filesystem::path(gridResultsDirectory) / buffer).string();
+  std::string name = base;
+  for(int sequence = 1; taken(name); sequence++)
+    name = base + "_" + std::to_string(sequence);
+
+  glm::ivec3 dimensions(grid_x, grid_y, grid_z);
+  m_gridSave = std::async(std::launch::async, [table = gridTable, dimensions, configs = std::move(configs), name,
+                                               directory = gridResultsDirectory]() {
+    MilliTimer      timer;
+    GridStats       stats = snapshotGridStats(table, dimensions, configs);
+    std::error_code code;
+    std::filesystem::create_directories(directory, code);
+
+    std::string error;
+    if(!writeGridStats(name + ".kgrid", stats.view(), error))
+      LOGE("%s\n", error.c_str());
+
+    std::string   temporary = name + ".json.tmp";
+    std::ofstream out(temporary, std::ios::trunc);
+    out << gridStatsToJson(stats.view()).dump(4);
+    out.close();
+    if(!out)
+    {
+      LOGE("Cannot write %s\n", temporary.c_str());
+      return;
+    }
+    std::filesystem::rename(temporary, name + ".json", code);
+    if(code)
+    {
+      LOGE("Cannot rename %s to %s.json: %s\n", temporary.c_str(), name.c_str(), code.message().c_str());
+      std::filesystem::remove(temporary, code);
+      return;
+    }
+    LOGI("Sorting grid saved to %s.kgrid and .json in %.1f ms\n", name.c_str(), timer.elapsed());
+  });
 }
 
 
 
 
-//CubeSideStorage SampleExa
-
-CubeSideStorage* SampleExample::getCubeSideElements(CubeSide side,GridSpace* currentGrid)
-{
-  if(side == CubeSide::CubeBack)
-  {
-    return &currentGrid->cube.backElements;
-  } else if(side == CubeSide::CubeDown)
-  {
-    return &currentGrid->cube.downElements;
-  } else if(side == CubeSide::CubeFront)
-  {
-    return &currentGrid->cube.frontElements;
-  } else if(side == CubeSide::CubeLeft)
-  {
-    return &currentGrid->cube.leftElements;
-  } else if(side == CubeSide::CubeRight)
-  {
-    return &currentGrid->cube.rightElements;
-  } else//Cube up
-  {
-    return &currentGrid->cube.upElements;
-  }
-}
-
-
 glm::vec3 SampleExample::calculateGridSpaceCenter(glm::vec3 gridspace)
 {
   glm::vec3 result{0.0,0.0,0.0};
@@ -1462,4 +1594,103 @@ glm::vec3 SampleExample::calculateGridSpaceCenter(glm::vec3 gridspace)
   result += stepX * 0.5f + stepY* 0.5f + stepZ * 0.5f;
 
   return result;
-}
\ No newline at end of file
+}
+
+CameraPath SampleExample::gridTourPath()
+{
+  CameraPath path;
+  CameraKey  key;
+  key.up  = CameraManip.getUp();
+  key.fov = CameraManip.getFov();
+  // Same order as beginSortingGridTraining() and iterateTrainingPosition()
+  for(int x = 0; x < grid_x; x++)
+    for(int y = 0; y < grid_y; y++)
+      for(int z = 0; z < grid_z; z++)
+        for(const glm::vec3& direction : lookDirections)
+        {
+          key.eye    = calculateGridSpaceCenter(glm::vec3(x, y, z));
+          key.center = key.eye + direction;
+          path.add(key);
+        }
+  return path;
+}
+
+CameraKey SampleExample::cameraKey() const
+{
+  CameraKey key;
+  CameraManip.getLookat(key.eye, key.center, key.up);
+  key.fov = CameraManip.getFov();
+  return key;
+}
+
+void SampleExample::setCameraKey(const CameraKey& key)
+{
+  CameraManip.setCamera({key.eye, key.center, key.up, key.fov}, true);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Ray stream capture
+// - Every stride-th pixel of the next frame records its bounces, see captureRay() in pathtrace.glsl
+// - The records are read back once the frame is done and written with RayStreamWriter
+//
+void SampleExample::requestRayCapture(const std::string& filename, uint32_t numPixels)
+{
+  if(m_rndMethod != eRtxPipeline)
+  {
+    LOGW("Ray capture is only supported by the RTX pipeline\n");
+    return;
+  }
+
+  uint32_t numFramePixels = std::max(1u, m_renderRegion.extent.width * m_renderRegion.extent.height);
+  m_rayCapture.filename      = filename;
+  m_rayCapture.stride        = int(std::max(1u, numFramePixels / std::max(1u, numPixels)));
+  m_rayCapture.maxDepth      = m_rtxState.maxDepth;
+  m_rayCapture.frameInFlight = -1;
+  m_rayCapture.pending       = true;
+  m_rayCapture.camera        = m_scene.getCamera();
+  m_rayCapture.state         = m_rtxState;
+
+  VkDeviceSize numSlots = VkDeviceSize((numFramePixels + m_rayCapture.stride - 1) / m_rayCapture.stride) * m_rayCapture.maxDepth;
+
+  vkDeviceWaitIdle(m_device);  // Resizing the buffer used by the frames in flight
+  m_offscreen.createRayCaptureBuffer(numSlots);
+}
+
+void SampleExample::finishRayCapture()
+{
+  MilliTimer timer;
+  const RayRecord*       slots = m_offscreen.mapRayCapture();
+  std::vector<RayRecord> records;
+  compactRayRecords(slots, size_t(m_offscreen.getRayCaptureSlots()), records);
+  m_offscreen.unmapRayCapture();
+
+  RayStreamHeader header;
+  header.captureStride = uint32_t(m_rayCapture.stride);
+  header.width         = uint32_t(m_rayCapture.state.size.x);
+  header.height        = uint32_t(m_rayCapture.state.size.y);
+  header.sceneMin      = m_scene.getScene().m_dimensions.min;
+  header.sceneMax      = m_scene.getScene().m_dimensions.max;
+  header.camera        = m_rayCapture.camera;
+  header.state         = m_rayCapture.state;
+
+  RayStreamWriter writer;
+  if(writer.open(m_rayCapture.filename, header))
+  {
+    writer.append(records.data(), records.size());
+    writer.close();
+    LOGI("Captured %zu rays to %s\n", records.size(), m_rayCapture.filename.c_str());
+    timer.print();
+  }
+  else
+  {
+    LOGE("Cannot write the ray capture %s\n", m_rayCapture.filename.c_str());
+  }
+
+  m_rayCapture.pending       = false;
+  m_rayCapture.frameInFlight = -1;
+
+  // Release the capture memory, still bound by the frames in flight
+  vkDeviceWaitIdle(m_device);
+  m_offscreen.createRayCaptureBuffer(1);
+}
@@ -19,6 +19,7 @@
 
 
 #pragma once
+#include <future>
 #include <random>
 #include "hdr_sampling.hpp"
 #include "nvvk/gizmos_vk.hpp"
@@ -73,6 +74,13 @@ typedef nvvk::ResourceAllocatorDedicated Allocator;
 #include "queue.hpp"
 #include "nvvk/stagingmemorymanager_vk.hpp"
 #include "sorting_grid.hpp"
+#include "inference_manager.hpp"
+#include "bandit_tuner.hpp"
+#include "grid_table.hpp"
+#include "grid_blend.hpp"
+#include "camera_path.hpp"
+#include "gpu_dispatch_timer.hpp"
+#include "observation_log.hpp"
 
 class SampleGUI;
 
@@ -147,6 +155,9 @@ public:
   // It is possible that ray query isn't supported (ex. Titan)
   void supportRayQuery(bool support) { m_supportRayQuery = support; }
   bool m_supportRayQuery{true};
+  // VK_KHR_pipeline_library, see RtxPipeline::usePipelineLibrary()
+  void supportPipelineLibrary(bool support) { m_supportPipelineLibrary = support; }
+  bool m_supportPipelineLibrary{false};
 
   // All renderers
   std::array<Renderer*, eNone> m_pRender{nullptr, nullptr};
@@ -167,13 +178,12 @@ public:
   nvvk::Buffer m_profilingBuffer;
   nvvk::Buffer m_sortingParametersBuffer; //UniformBuffers that contains the parameters chosen by User or the Classificator for SER
   nvvk::Buffer m_GridSortingKeyBuffer;
-  const int MAXGRIDSIZE = 10;
+  const int MAXGRIDSIZE = 64;
 
-  GridCube bestKeys[10*10*10];
+  // Fastest hash per cell and cube side, uploaded to m_GridSortingKeyBuffer for the visualization
+  std::vector<GridCube> bestKeys;
 
   int bestSortMode = eNoSorting;
-  int DELAY_FRAMES = 4;
-  uint recoveredFrame[5] = {0,0,0,0,0};
   uint64_t recovered_time = 0;
   double avg_full_time = 0.0;
   TimingData latest_timeData;
@@ -196,6 +206,9 @@ public:
   VkRect2D m_renderRegion{};
   void     setRenderRegion(const VkRect2D& size);
 
+  // Size of the rendering without a window (headless.cpp), in place of the swapchain
+  void setupHeadless(const VkExtent2D& size);
+
   // #Post
   void createOffscreenRender();
   void drawPost(VkCommandBuffer cmdBuf);
@@ -237,7 +250,8 @@ public:
       0,  //rayDirection;
       0,  // estimatedEndpoint;
       0,  // realEndpoint;
-      0  // isFinished;
+      0,  // isFinished;
+      0   // rayCaptureStride;
             
   };
 
@@ -285,16 +299,12 @@ public:
   bool activateParametertesting = false;
 
 
-
-  std::vector<TimingObject> inferenceMeasurements;
-
-float constantGridlearningSpeed = 0.2f;
-bool useConstantGridLearning = true;
-
 bool performAutomaticTraining{false};
 bool GridWhite = false;
-Grid grid;
+// Frames and fps of every parameter set per cell and cube side, the configs are the tuner arms
+SortingGridTable gridTable;
 void buildSortingGrid();
+uint32_t gridCell(const glm::ivec3& gridSpace) const;
 
 int trainingDirectionIndex = 0;
 glm::vec3 trainingPosition = glm::vec3(0,0,0);
@@ -309,25 +319,118 @@ glm::ivec3 currentGridSpace;
 
 
 
-
-std::vector<std::vector<std::vector<GridSpace>>> sortingGrid;
-
 json fillJsonWithBestResult(json j);
-json fillJsonWithAllResults(json j);
+// Writes <gridResultsDirectory>/<time to the ms>.kgrid and .json on another thread
 void SaveSortingGrid();
+std::string       gridResultsDirectory{"Sorting_Grid_Results"};
+std::future<void> m_gridSave;
 
 
 
 bool waitingOnPipeline = false;
 
-CubeSideStorage* getCubeSideElements(CubeSide side,GridSpace* currentGrid);
-CubeSideStorage* getCubeSideStorage(GridSpace* currentGrid);
-
-GridCube determineBestTimesCube(GridSpace* currentGrid);
+// Pipeline of the fastest parameters of the current cell and cube side, a null pipeline when none is known
+PipelineStorage bestGridPipeline();
+// While blendGridCells the fastest parameters are blended from the cells and cube sides around
+// the camera, with hysteresis (grid_blend.hpp). renderScene() keeps the camera's position in
+// cells and its view direction.
+bool            blendGridCells{true};
+GridBlender     m_gridBlender;
+GridBlendResult m_lastBlend;
+glm::vec3       m_gridPosition{0.0f};
+glm::vec3       m_viewDirection{0.0f, 0.0f, 1.0f};
 
 int getCubeSideHash(vec3 CubeCoords, CubeSide side);
 
 glm::vec3 calculateGridSpaceCenter(glm::vec3 gridSpace);
 
-void loadSortingGrid(const std::string& jsonFilename);
+// Restores the measurements of a saved grid (Sorting_Grid_Results/*.kgrid or *.json) into
+// gridTable and the tuner, legacy flag keys map to the arm of the same flags. The cube sides it
+// knows are not explored again outside of the training, their best pipelines are built in the
+// background.
+void loadSortingGrid(const std::string& filename);
+void restoreSortingGrid(const GridStatsView& stats);
+std::vector<bool> m_knownSides;  // Per tuner context, the grid of loadSortingGrid() singles out its best pipeline
+void requestBestPipelines();
+
+// Camera paths of the benchmark, see camera_path.hpp. The grid tour visits the cells and look
+// directions in the order of the training. While recordingCameraPath every frame adds the camera
+// to m_recordedCameraPath.
+CameraPath gridTourPath();
+CameraKey  cameraKey() const;
+void       setCameraKey(const CameraKey& key);
+bool       recordingCameraPath{false};
+CameraPath m_recordedCameraPath;
+
+// Ray stream capture of the next frame, written to `filename` once the GPU is done with it
+void requestRayCapture(const std::string& filename, uint32_t numPixels);
+void finishRayCapture();
+
+struct RayCaptureRequest
+{
+  std::string filename;
+  int         stride{0};          // RtxState::rayCaptureStride of the capture
+  int         maxDepth{0};        // Bounces per pixel the buffer holds
+  int         frameInFlight{-1};  // Frame that recorded the capture, -1 before recording
+  bool        pending{false};
+  // Of the captured frame, the camera and the state move on before the frame is read back
+  SceneCamera camera{};
+  RtxState    state{};
+} m_rayCapture;
+
+// Sorting parameters predicted for the loaded scene, the renderer starts with them
+void inferSortingParameters();
+InferenceManager m_inference;
+SortingParameters m_inferredParameters{};
+bool              m_hasInferredParameters{false};
+void              setInferredParameters(const SortingParameters& parameters);
+
+// Search of the fastest parameters per grid cell and cube side, one context per (cell, side)
+// The arms are allSortingParameters(), every flag set with every number of coherence bits (the
+// key budget depends on it). Their pipelines are built on first use and kept in the pool of
+// RtxPipeline
+void     resetTuner();
+uint32_t tunerContext() const;
+// Context and arm of the dispatch being recorded, the arm -1 when it is none
+uint64_t tunerDispatchTag();
+// GPU time of each ray tracing dispatch, the tuner's objective. The samples of the frames done
+// are collected by updateFrame(), one timestamp slot per command buffer.
+static constexpr uint32_t kMaxFramesInFlight = 8;
+GpuDispatchTimer          m_dispatchTimer;
+std::vector<TimingSample> m_dispatchSamples;
+DispatchWindow            m_tunerWindow;
+// Warm-up discarded after a switch, hitches left out, aggregate of the rest (frame_stats.hpp)
+SteadyStateSettings       m_steadyState;
+SteadyStateEstimate       m_lastEstimate;
+// Every window the tuner observes, appended to observationLogFile while logObservations
+// (observation_log.hpp). The render thread only copies the record into a ring.
+ObservationLog m_observationLog;
+std::string    observationLogFile{"observations.kobs"};
+bool           logObservations{false};
+void           setObservationLogging(bool enable);
+int      tunerArm(const SortingParameters& parameters);
+PipelineStorage tunerPipeline(int arm);
+// Background builds of the arms the tuner wants next, by RtxPipeline's factory. The exploration
+// measures a built arm meanwhile, the frame never waits for a pipeline.
+bool buildPipelinesInBackground{true};
+void requestTunerPipelines(uint32_t context, int selected);
+void collectTunerPipelines();
+int  readyTunerArm(uint32_t context);
+void protectBestPipelines();
+// Every arm is built when a scene is loaded, nothing is compiled during the exploration
+bool prebuildPipelines{false};
+void prebuildTunerPipelines();
+BanditTuner                    m_tuner;
+std::vector<SortingParameters> m_tunerArms;
+
+// Pipeline switches are plain rebinds, RtxPipeline destroys the evicted pipelines once their
+// frame is done. waitIdleOnPipelineSwitch brings back the device wait of each switch, to measure
+// the stall it costs.
+void     switchPipeline(const PipelineStorage& element);
+bool     waitIdleOnPipelineSwitch{false};
+uint64_t m_switchWaits{0};
+double   m_switchWaitMs{0.0};
+// Frames recorded since the start, the frame last recorded in each command buffer of getCurFrame()
+uint64_t              m_frameIndex{0};
+std::vector<uint64_t> m_frameOfCommandBuffer;
 };
@@ -106,7 +106,8 @@ void SampleGUI::render(nvvk::ProfilerVK& profiler)
     _se->setRenderRegion(VkRect2D{{}, _se->getSize()});
   }
 
-  if(_se->activateParametertesting || _se->performAutomaticTraining)
+  // The loading thread owns the pipelines meanwhile
+  if(!_se->m_busy && (_se->activateParametertesting || _se->performAutomaticTraining))
   {
     _se->doCycle();
   }
@@ -307,7 +308,7 @@ bool SampleGUI::guiSortingGrid()
   bool changed{false};
   auto  Normal = ImGuiH::Control::Flags::Normal;
 
-  if(GuiH::Slider("Grid X", "", &gridX, nullptr, Normal, 1, 10) || GuiH::Slider("Grid Y", "", &gridY, nullptr, Normal, 1, 10) || GuiH::Slider("Grid Z", "", &gridZ, nullptr, Normal, 1, _se->MAXGRIDSIZE))
+  if(GuiH::Slider("Grid X", "", &gridX, nullptr, Normal, 1, _se->MAXGRIDSIZE) || GuiH::Slider("Grid Y", "", &gridY, nullptr, Normal, 1, _se->MAXGRIDSIZE) || GuiH::Slider("Grid Z", "", &gridZ, nullptr, Normal, 1, _se->MAXGRIDSIZE))
   {
     if(!_se->performAutomaticTraining)
     {
@@ -325,40 +326,114 @@ bool SampleGUI::guiSortingGrid()
     }
 
   }
+  ImGui::Text("Measured cells: %u / %u (%.1f MB)", _se->gridTable.numMeasuredCells(), _se->gridTable.numCells(),
+              _se->gridTable.memoryBytes() / (1024.0 * 1024.0));
   ImGui::Text(("Current Grid Position [x,y,z]: ("+  std::to_string(_se->currentGridSpace.x) + "," +  std::to_string(_se->currentGridSpace.y)  + "," +  std::to_string(_se->currentGridSpace.z) + ")").c_str());
 
-  GuiH::Checkbox("Use Constant Grid Learning Speed","",&_se->useConstantGridLearning);
-  if(_se->useConstantGridLearning)
+  BanditSettings& tuner = _se->m_tuner.settings();
+  static const std::vector<std::string> policies{"UCB1", "Thompson sampling"};
+  int policy = tuner.policy;
+  if(GuiH::Selection("Tuner policy", "Choice of the next parameters to measure", &policy, nullptr, Normal, policies))
   {
-    GuiH::Slider("Constant Learning Speed","",&_se->constantGridlearningSpeed,nullptr,Normal,0.01f,1.0f,nullptr);
-  } else 
+    tuner.policy = BanditPolicy(policy);
+  }
+  GuiH::Slider("Tuner exploration","UCB1 bonus in standard errors",&tuner.explorationScale,nullptr,Normal,0.0f,4.0f,nullptr);
+  GuiH::Slider("Tuner confidence z","Width of the intervals that eliminate parameters",&tuner.confidenceZ,nullptr,Normal,1.0f,4.0f,nullptr);
+  GuiH::Slider("Tuner tolerance","Parameters that close to the best are as good",&tuner.tolerance,nullptr,Normal,0.0f,0.1f,nullptr);
+  if(_se->m_tuner.numContexts() > 0)
   {
-    float currentAdaptiveLearningRate = _se->grid.gridSpaces[_se->currentGridSpace.z][_se->currentGridSpace.y][_se->currentGridSpace.x].adaptiveGridLearningRate;
-  
-    ImGui::Text(("Current Grid Cell learning Rate: "+ std::to_string(currentAdaptiveLearningRate)).c_str());
+    uint32_t context = _se->tunerContext();
+    int      best    = _se->m_tuner.best(context);
+    ImGui::Text("Cube side: %u windows, %u of %u parameters left%s", _se->m_tuner.numObservations(context),
+                _se->m_tuner.numRemaining(context), _se->m_tuner.numArms(), _se->m_tuner.converged(context) ? ", converged" : "");
+    if(best >= 0)
+    {
+      const ArmStats& stats = _se->m_tuner.stats(context, best);
+      ImGui::Text("Best: %.3f ms +- %.3f over %u windows", stats.mean, _se->m_tuner.standardError(context, best), stats.count);
+    }
+    ImGui::Text("GPU dispatch timing%s: %u in this window, %llu dropped after switches, %llu warm-up", _se->m_dispatchTimer.valid() ? "" : " unavailable",
+                _se->m_tunerWindow.count(), (unsigned long long)_se->m_tunerWindow.dropped(),
+                (unsigned long long)_se->m_tunerWindow.discarded());
+    ImGui::Text("Last window: %.3f ms over %u dispatches, %u hitches left out", _se->m_lastEstimate.ms,
+                _se->m_lastEstimate.used, _se->m_lastEstimate.outliers);
+  }
+  SteadyStateSettings& steady = _se->m_steadyState;
+  GuiH::Slider("Warm-up dispatches","Discarded after each pipeline switch",&steady.warmupFrames,nullptr,Normal,0u,32u);
+  static const std::vector<std::string> aggregates{"Mean", "Trimmed mean", "Median of means"};
+  int aggregate = steady.aggregate;
+  if(GuiH::Selection("Window aggregate", "Estimate of a window, after the hitches are left out", &aggregate, nullptr, Normal, aggregates))
+  {
+    steady.aggregate = FrameAggregate(aggregate);
+  }
+  GuiH::Slider("Hitch threshold","Dispatches slower than the median by this many deviations (MAD) are left out, 0 keeps all",&steady.outlierMads,nullptr,Normal,0.0f,10.0f,nullptr);
+  bool logObservations = _se->logObservations;
+  if(GuiH::Checkbox("Log observations", "Appends every window of the tuner to observations.kobs, -observation-log", &logObservations))
+  {
+    _se->setObservationLogging(logObservations);
+  }
+  if(_se->m_observationLog.isOpen())
+  {
+    ImGui::Text("Observation log: %llu written, %llu dropped", (unsigned long long)_se->m_observationLog.written(),
+                (unsigned long long)_se->m_observationLog.dropped());
+  }
+  if(GuiH::button("reset tuner","forget all measurements",""))
+  {
+    _se->resetTuner();
   }
   auto rtx = dynamic_cast<RtxPipeline*>(_se->m_pRender[_se->m_rndMethod]);
 
-  if(GuiH::Checkbox("Activate Async Pipeline Creation","",&rtx->useAsyncPipelineCreation))
+  GuiH::Checkbox("Build pipelines in the background","The tuner measures a built pipeline while the one it wants is compiled",&_se->buildPipelinesInBackground);
+  GuiH::Checkbox("Build all pipelines when loading", "Every configuration is built in parallel with the next scene, --prebuild",
+                 &_se->prebuildPipelines);
+  if(rtx)
   {
-    if(rtx->useAsyncPipelineCreation)
+    auto factory = rtx->factoryStats();
+    ImGui::Text("Pipeline builds: %u queued, %u building, %u ready, %llu built", factory.pending, factory.building,
+                factory.ready, (unsigned long long)factory.built);
+    pipelineBudgetMB = int(rtx->pipelinePoolStats().budget >> 20);  // the prebuild may raise it
+    if(GuiH::Slider("Pipeline memory (MB)", "Least recently used pipelines over it are destroyed, the best of each cube side are kept",
+                    &pipelineBudgetMB, nullptr, Normal, 16, 4096))
     {
-      rtx->activateAsyncPipelineCreation();
-    } else {
-      //rtx->destroyAsyncPipelineBuffer();
+      rtx->setPipelineBudget(uint64_t(pipelineBudgetMB) << 20);
     }
+    auto pool = rtx->pipelinePoolStats();
+    ImGui::Text("Pipelines: %u kept (%u protected), %.1f MB, %.0f%% hits, %llu evicted", pool.entries,
+                pool.protectedEntries, double(pool.bytes) / double(1 << 20), 100.0 * pool.hitRate(),
+                (unsigned long long)pool.evictions);
+    GuiH::Checkbox("Wait for the device on pipeline switches", "The stall every switch used to cost, to compare the frame times",
+                   &_se->waitIdleOnPipelineSwitch);
+    auto retire = rtx->retireStats();
+    ImGui::Text("Pipeline switches: %llu, %llu device waits (%.2f ms each)", (unsigned long long)retire.switches,
+                (unsigned long long)(_se->m_switchWaits + retire.deviceWaits),
+                _se->m_switchWaits + retire.deviceWaits > 0 ?
+                    (_se->m_switchWaitMs + retire.deviceWaitMs) / double(_se->m_switchWaits + retire.deviceWaits) :
+                    0.0);
+    ImGui::Text("Retired pipelines: %u waiting for their frame, %llu destroyed", retire.queued,
+                (unsigned long long)retire.released);
+    const SbtArena& sbt = rtx->sbtArena();
+    ImGui::Text("Shader binding table: %u of %u slots, %llu bytes each, %s", sbt.numUsed(), sbt.capacity(),
+                (unsigned long long)sbt.slotSize(), sbt.staged() ? "staged" : "mapped");
   }
   //printf("Current Grid Position [x,y]: (%d , %d)\n", _se->currentGridSpace.x,_se->currentGridSpace.y);
 
-  if(GuiH::button("save SortingGrid to File","save",""))
+  if(GuiH::button("save SortingGrid to File","save","Writes Sorting_Grid_Results/<time>.kgrid and .json in the background"))
   {
     _se->SaveSortingGrid();
   }
-  if(GuiH::button("NewAsyncPipeline","useNewPipeline",""))
+  GuiH::Slider("Captured pixels", "Pixels of the next frame recorded by the ray capture", &rayCapturePixels, nullptr, Normal, 1024, 1 << 22);
+  if(GuiH::button("capture Rays to File","capture","Writes the bounces of the captured pixels to ray_stream.krs"))
   {
-    vkDeviceWaitIdle(_se->m_device);
-    rtx->setNewPipeline();
-    //rtx->setNewPipeline_WithoutDestroying();
+    _se->requestRayCapture("ray_stream.krs", uint32_t(rayCapturePixels));
+  }
+  if(GuiH::Checkbox("Record camera path", "Every frame adds the camera, camera_path.txt is written when unchecked, see --headless -camera-path",
+                    &_se->recordingCameraPath))
+  {
+    if(_se->recordingCameraPath)
+      _se->m_recordedCameraPath.clear();
+    else if(_se->m_recordedCameraPath.save("camera_path.txt"))
+      LOGI("Camera path of %zu frames written to camera_path.txt\n", _se->m_recordedCameraPath.size());
+    else
+      LOGE("Cannot write camera_path.txt\n");
   }
   ImGui::Text("%d",_se->currentLookDirection);
   if(GuiH::Checkbox("Visualize Sorting method","",&VisualizeSortingGrid))
@@ -399,6 +474,20 @@ bool SampleGUI::guiSortingGrid()
     ImGui::Text(("realEndpoint: "+ std::to_string(rtx->m_SERParameters.realEndpoint)).c_str());
     ImGui::Text(("isFinished: "+ std::to_string(rtx->m_SERParameters.isFinished)).c_str());
 
+    SortingKeyBudget budget = rtx->keyBudget(rtx->m_SERParameters);
+    ImGui::Text("Key bits: origin %u direction %u endpoint %u finished %u", budget.origin, budget.direction,
+                budget.endpoint, budget.finished);
+    bool budgetChanged = GuiH::Checkbox("custom key bit budget","",&rtx->m_customKeyBudget);
+    if(rtx->m_customKeyBudget)
+    {
+      budgetChanged |= GuiH::Slider("origin bits","",&rtx->m_keyBudget.origin,nullptr,Normal,0u,32u);
+      budgetChanged |= GuiH::Slider("direction bits","",&rtx->m_keyBudget.direction,nullptr,Normal,0u,32u);
+      budgetChanged |= GuiH::Slider("endpoint bits","",&rtx->m_keyBudget.endpoint,nullptr,Normal,0u,32u);
+      budgetChanged |= GuiH::Slider("finished bits","",&rtx->m_keyBudget.finished,nullptr,Normal,0u,1u);
+    }
+    if(budgetChanged)
+      _se->reloadRender();
+
 
   if( GuiH::Checkbox("perform automatic training","",&_se->performAutomaticTraining))
   {
@@ -413,11 +502,31 @@ bool SampleGUI::guiSortingGrid()
   if(!_se->performAutomaticTraining)
   {
     GuiH::Checkbox("activate Inference","",&(_se->activateParametertesting));
+    if(_se->activateParametertesting)
+    {
+      const InferenceResult& inferred = _se->m_inference.getResult();
+      ImGui::Text("Inferred by %s, confidence %.2f", _se->m_inference.getPredictorName(), inferred.confidence);
+      ImGui::Text("%s", _se->m_inference.shouldExplore() ? "Low confidence: exploring" : "Confident: no exploration");
+      GuiH::Slider("explore below confidence","",_se->m_inference.getConfidenceThreshold(),nullptr,Normal,0.0f,1.0f,nullptr);
+    }
   }
   if(!(_se->activateParametertesting ||_se->performAutomaticTraining))
   {
     GuiH::Checkbox("always use best Parameters found","",&(_se->useBestParameters));
   }
+  GuiH::Checkbox("Blend neighbouring cells", "The best parameters from the 8 cells and 3 cube sides around the camera",
+                 &_se->blendGridCells);
+  if(_se->blendGridCells)
+  {
+    GuiH::Slider("Switch margin", "Another parameter set has to be expected this much faster to replace the current one",
+                 &_se->m_gridBlender.settings.hysteresis, nullptr, Normal, 0.0f, 0.2f, nullptr);
+    const GridBlendResult& blend = _se->m_lastBlend;
+    if(blend.config >= 0)
+      ImGui::Text("Blended: %.1f%% over the fastest, %u measured cube sides%s", 100.0 * (blend.slowdown - 1.0f),
+                  blend.measured, blend.kept ? ", kept" : "");
+    else
+      ImGui::Text("Blended: nothing measured around the camera");
+  }
   
   return changed;
 }
@@ -875,6 +984,17 @@ void SampleGUI::menuBar()
         _se->loadAssets(openFilename("HDR Files\0*.hdr\0\0").c_str());
       if(ImGui::MenuItem("Load Sorting Grid"))
         _se->loadAssets(openFilename("Json Files\0*.json\0\0").c_str());
+      if(ImGui::MenuItem("Load Inference Model"))
+      {
+        std::string modelFile = openFilename("Json Files\0*.json\0\0");
+        if(!modelFile.empty() && _se->m_inference.loadModel(modelFile))
+        {
+          _se->inferSortingParameters();
+          _se->reloadRender();
+          if(auto rtx = dynamic_cast<RtxPipeline*>(_se->m_pRender[_se->m_rndMethod]))
+            _se->setInferredParameters(rtx->activeElement.parameters);
+        }
+      }
       ImGui::Separator();
       if(ImGui::MenuItem("Quit", "ESC"))
         glfwSetWindowShouldClose(_se->m_window, 1);
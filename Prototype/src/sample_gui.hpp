@@ -40,6 +40,8 @@ public:
   int gridX{2};
   int gridY{2};
   int gridZ{2};
+  int rayCapturePixels{1 << 16};
+  int pipelineBudgetMB{256};
 private:
   bool guiCamera();
   bool guiRayTracing();
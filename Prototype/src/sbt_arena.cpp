@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <cstring>
+
+#include "nvh/alignment.hpp"
+#include "nvh/nvprint.hpp"
+#include "nvvk/buffers_vk.hpp"
+#include "sbt_arena.hpp"
+
+
+void SbtArena::setup(VkDevice                                               device,
+                     VkPhysicalDevice                                       physicalDevice,
+                     nvvk::ResourceAllocator*                               allocator,
+                     const VkPhysicalDeviceRayTracingPipelinePropertiesKHR& properties)
+{
+  m_device     = device;
+  m_pAlloc     = allocator;
+  m_properties = properties;
+
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+  const VkMemoryPropertyFlags wanted =
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  m_hostVisibleDeviceLocal = false;
+  for(uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+    m_hostVisibleDeviceLocal |= (memoryProperties.memoryTypes[i].propertyFlags & wanted) == wanted;
+}
+
+void SbtArena::create(uint32_t numMiss, uint32_t numHit, uint32_t capacity)
+{
+  destroy();
+  m_numMiss  = numMiss;
+  m_numHit   = numHit;
+  m_capacity = capacity;
+
+  // Same layout as nvvk::SBTWrapper, the raygen region is a single record
+  VkDeviceSize base = m_properties.shaderGroupBaseAlignment;
+  m_handleStride    = nvh::align_up(m_properties.shaderGroupHandleSize, m_properties.shaderGroupHandleAlignment);
+  m_raygenSize      = nvh::align_up(m_handleStride, base);
+  m_missSize        = nvh::align_up(m_handleStride * numMiss, base);
+  m_hitSize         = nvh::align_up(m_handleStride * numHit, base);
+  m_slotSize        = m_raygenSize + m_missSize + m_hitSize;
+
+  // One base alignment more, the first slot is aligned within the buffer
+  VkDeviceSize       size  = m_slotSize * capacity + base;
+  VkBufferUsageFlags usage = VK_BUFFER_USAGE_SHADER_BINDING_TABLE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+  if(m_hostVisibleDeviceLocal)
+  {
+    m_buffer = m_pAlloc->createBuffer(size, usage,
+                                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                                          | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  }
+  else
+  {
+    m_buffer  = m_pAlloc->createBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_staging = m_pAlloc->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  }
+  VkDeviceAddress address = nvvk::getBufferDeviceAddress(m_device, m_buffer.buffer);
+  m_address               = nvh::align_up(address, base);
+  m_offset                = m_address - address;
+  m_mapped                = static_cast<uint8_t*>(m_pAlloc->map(staged() ? m_staging : m_buffer)) + m_offset;
+
+  m_free.resize(capacity);
+  for(uint32_t i = 0; i < capacity; i++)
+    m_free[i] = capacity - 1 - i;
+  m_handles.resize(size_t(1 + numMiss + numHit) * m_properties.shaderGroupHandleSize);
+}
+
+void SbtArena::destroy()
+{
+  if(!valid())
+    return;
+  if(staged())
+  {
+    m_pAlloc->unmap(m_staging);
+    m_pAlloc->destroy(m_staging);
+  }
+  else
+  {
+    m_pAlloc->unmap(m_buffer);
+  }
+  m_pAlloc->destroy(m_buffer);
+  m_buffer   = nvvk::Buffer();
+  m_staging  = nvvk::Buffer();
+  m_mapped   = nullptr;
+  m_offset   = 0;
+  m_address  = 0;
+  m_capacity = 0;
+  m_free.clear();
+  m_pending.clear();
+}
+
+uint32_t SbtArena::write(VkPipeline pipeline)
+{
+  if(m_free.empty())
+    return kNoSlot;
+
+  uint32_t numGroups = 1 + m_numMiss + m_numHit;
+  if(vkGetRayTracingShaderGroupHandlesKHR(m_device, pipeline, 0, numGroups, m_handles.size(), m_handles.data()) != VK_SUCCESS)
+  {
+    LOGE("Cannot get the shader group handles\n");
+    return kNoSlot;
+  }
+
+  uint32_t slot = m_free.back();
+  m_free.pop_back();
+
+  uint32_t handleSize = m_properties.shaderGroupHandleSize;
+  uint8_t* record     = m_mapped + m_slotSize * slot;
+  memcpy(record, m_handles.data(), handleSize);
+  for(uint32_t i = 0; i < m_numMiss; i++)
+    memcpy(record + m_raygenSize + m_handleStride * i, m_handles.data() + size_t(1 + i) * handleSize, handleSize);
+  for(uint32_t i = 0; i < m_numHit; i++)
+    memcpy(record + m_raygenSize + m_missSize + m_handleStride * i,
+           m_handles.data() + size_t(1 + m_numMiss + i) * handleSize, handleSize);
+  if(staged())
+    m_pending.push_back(slot);
+  return slot;
+}
+
+void SbtArena::release(uint32_t slot)
+{
+  if(slot < m_capacity)
+    m_free.push_back(slot);
+}
+
+void SbtArena::upload(VkCommandBuffer cmdBuf)
+{
+  if(m_pending.empty())
+    return;
+
+  std::vector<VkBufferCopy> copies;
+  copies.reserve(m_pending.size());
+  for(uint32_t slot : m_pending)
+  {
+    VkDeviceSize offset = m_offset + m_slotSize * slot;
+    copies.push_back({offset, offset, m_slotSize});
+  }
+  m_pending.clear();
+  vkCmdCopyBuffer(cmdBuf, m_staging.buffer, m_buffer.buffer, uint32_t(copies.size()), copies.data());
+
+  VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0, 1, &barrier,
+                       0, nullptr, 0, nullptr);
+}
+
+std::array<VkStridedDeviceAddressRegionKHR, 4> SbtArena::regions(uint32_t slot) const
+{
+  std::array<VkStridedDeviceAddressRegionKHR, 4> regions{};
+  if(slot >= m_capacity)
+    return regions;
+
+  VkDeviceAddress address = m_address + m_slotSize * slot;
+  regions[0]              = {address, m_raygenSize, m_raygenSize};
+  regions[1]              = {address + m_raygenSize, m_handleStride, m_missSize};
+  regions[2]              = {address + m_raygenSize + m_missSize, m_handleStride, m_hitSize};
+  return regions;
+}
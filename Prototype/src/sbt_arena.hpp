@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+//--------------------------------------------------------------------------------------------------
+// One shader binding table buffer shared by all pipeline variants
+//
+// - The variants have the same groups: one raygen, `numMiss` miss and `numHit` hit groups, in
+//   that order. Every variant gets a slot of the same size, the slot index is its stable offset.
+// - The buffer is device local, the raygen reads it every ray. When the device has device local
+//   host visible memory (resizable BAR) it stays mapped: writing the group handles of a new variant
+//   is a memcpy, no staging buffer, no command buffer, no allocation. Otherwise the handles go to
+//   a mapped staging buffer, upload() records the copies of the slots written since.
+// - A released slot is reused by the next write(). Release it only when the GPU is done with
+//   the pipeline, like the pipeline itself.
+// - Render thread only
+//
+
+#include <array>
+#include <vector>
+
+#include "nvvk/resourceallocator_vk.hpp"
+
+
+class SbtArena
+{
+public:
+  static constexpr uint32_t kNoSlot = ~0u;
+
+  void setup(VkDevice                                               device,
+             VkPhysicalDevice                                       physicalDevice,
+             nvvk::ResourceAllocator*                               allocator,
+             const VkPhysicalDeviceRayTracingPipelinePropertiesKHR& properties);
+  void create(uint32_t numMiss, uint32_t numHit, uint32_t capacity);
+  void destroy();
+  bool valid() const { return m_buffer.buffer != VK_NULL_HANDLE; }
+
+  // Copies the group handles of the pipeline to a free slot, kNoSlot when the arena is full
+  uint32_t write(VkPipeline pipeline);
+  void     release(uint32_t slot);
+  // Copies the slots written since the last call to the device local buffer, nothing when it is
+  // mapped. Before the trace rays reading them, outside of a render pass.
+  void upload(VkCommandBuffer cmdBuf);
+  bool staged() const { return m_staging.buffer != VK_NULL_HANDLE; }
+
+  // Raygen, miss, hit and callable regions of vkCmdTraceRaysKHR
+  std::array<VkStridedDeviceAddressRegionKHR, 4> regions(uint32_t slot) const;
+
+  VkDeviceSize slotSize() const { return m_slotSize; }
+  uint32_t     capacity() const { return m_capacity; }
+  uint32_t     numUsed() const { return m_capacity - uint32_t(m_free.size()); }
+
+private:
+  VkDevice                                        m_device{VK_NULL_HANDLE};
+  bool                                            m_hostVisibleDeviceLocal{false};
+  nvvk::ResourceAllocator*                        m_pAlloc{nullptr};
+  VkPhysicalDeviceRayTracingPipelinePropertiesKHR m_properties{};
+
+  uint32_t     m_numMiss{0};
+  uint32_t     m_numHit{0};
+  uint32_t     m_capacity{0};
+  VkDeviceSize m_handleStride{0};  // Handle size aligned to the handle alignment
+  VkDeviceSize m_raygenSize{0};    // The region sizes are aligned to the base alignment
+  VkDeviceSize m_missSize{0};
+  VkDeviceSize m_hitSize{0};
+  VkDeviceSize m_slotSize{0};
+
+  nvvk::Buffer          m_buffer;
+  nvvk::Buffer          m_staging;           // Without resizable BAR only, same layout as m_buffer
+  uint8_t*              m_mapped{nullptr};   // First slot, aligned like the device address
+  VkDeviceSize          m_offset{0};         // Of the first slot in the buffers
+  VkDeviceAddress       m_address{0};        // Of the first slot
+  std::vector<uint32_t> m_free;              // Lowest slot last
+  std::vector<uint32_t> m_pending;           // Written to m_staging, not uploaded yet
+  std::vector<uint8_t>  m_handles;           // Scratch of write()
+};
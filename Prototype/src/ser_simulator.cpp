@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "ser_simulator.hpp"
+#include "key_encoder.hpp"
+
+
+void SerRayBatch::resize(size_t n)
+{
+  origins.resize(n);
+  directions.resize(n);
+  hitT.resize(n);
+  prevHitT.resize(n);
+  instanceCustomIndex.resize(n);
+  depth.resize(n);
+}
+
+
+SerSimulator::SerSimulator(SerSettings settings)
+    : m_settings(std::move(settings))
+{
+  m_settings.warpSize = std::max(1u, m_settings.warpSize);
+}
+
+int32_t SerSimulator::materialOf(int32_t instance) const
+{
+  if(instance < 0 || m_settings.instanceMaterials.empty())
+    return instance;
+  if(size_t(instance) >= m_settings.instanceMaterials.size())
+    return -2;  // Unknown, counted as a material of its own
+  return std::max(0, m_settings.instanceMaterials[instance]);  // Same default as shade_state.glsl
+}
+
+//--------------------------------------------------------------------------------------------------
+// Composite key of createSortingKeyFromSpecialization, with the default bit budget of the parameters.
+// The real endpoint is only legal after traversal, so it uses the hit distance of the ray; the
+// estimated endpoint uses the hit distance of the previous bounce.
+//
+void SerSimulator::computeKeys(const SerRayBatch& rays, const SortingParameters& parameters, std::vector<uint32_t>& keys) const
+{
+  const size_t n = rays.size();
+  keys.assign(n, 0);
+
+  SortingKeyBudget budget = SortingKeyDefaultBudget(parameters);
+  if(SortingKeyBudgetTotal(budget) == 0)
+    return;
+
+  std::vector<float> lengths;
+  if(budget.endpoint > 0)
+  {
+    lengths.resize(n);
+    for(size_t i = 0; i < n; i++)
+      lengths[i] = parameters.realEndpoint ? rays.hitT[i] : SortingKeyAdaptiveRayLength(rays.prevHitT[i], m_settings.bounds.sceneExtent);
+  }
+
+  RayBatchView view{rays.origins.data(), rays.directions.data(), lengths.empty() ? nullptr : lengths.data(), n};
+  view.depths   = rays.depth.data();
+  view.maxDepth = m_settings.maxDepth;
+  KeyEncoder::encodeComposite(budget, view, m_settings.bounds, keys.data());
+}
+
+void SerSimulator::reorder(const SerRayBatch& rays, const SortingParameters& parameters, std::vector<uint32_t>& order) const
+{
+  const size_t n = rays.size();
+  order.resize(n);
+  for(size_t i = 0; i < n; i++)
+    order[i] = uint32_t(i);
+
+  if(parameters.noSort)
+    return;
+
+  // reorderThreadNV(hObj, key, bits): grouped by the shader the hit object invokes first, then by
+  // the key. All instances share one hit group in this renderer, so that is hit versus miss.
+  bool     byHitObject = parameters.sortAfterASTraversal && parameters.hitObject;
+  uint32_t bits        = SortingKeyBudgetTotal(SortingKeyDefaultBudget(parameters));
+  if(!byHitObject && bits == 0)
+    return;
+
+  std::vector<uint32_t> keys;
+  computeKeys(rays, parameters, keys);
+  uint32_t mask = bits >= 32 ? ~0u : (1u << bits) - 1;
+
+  // Stable sort: the index keeps the launch order of equal keys
+  std::vector<std::pair<uint64_t, uint32_t>> sortable(n);
+  for(size_t i = 0; i < n; i++)
+  {
+    uint64_t group = byHitObject && rays.instanceCustomIndex[i] >= 0 ? 1 : 0;
+    sortable[i]    = {(group << 32) | (keys[i] & mask), uint32_t(i)};
+  }
+
+  size_t window = m_settings.reorderWindow == 0 ? n : m_settings.reorderWindow;
+  for(size_t begin = 0; begin < n; begin += window)
+  {
+    auto first = sortable.begin() + begin;
+    std::sort(first, first + std::min(window, n - begin));
+  }
+
+  for(size_t i = 0; i < n; i++)
+    order[i] = sortable[i].second;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+SerReport SerSimulator::simulate(const SerRayBatch& rays, const SortingParameters& parameters, bool keepWarps) const
+{
+  SerReport report;
+  report.parameters = parameters;
+
+  std::vector<uint32_t> order;
+  reorder(rays, parameters, order);
+
+  const size_t         n        = order.size();
+  const uint32_t       warpSize = m_settings.warpSize;
+  std::vector<int32_t> instances, materials;
+  instances.reserve(warpSize);
+  materials.reserve(warpSize);
+
+  double sumInstances = 0, sumMaterials = 0, sumPaths = 0;
+  size_t mixed = 0;
+  for(size_t begin = 0; begin < n; begin += warpSize)
+  {
+    SerWarpStats warp;
+    bool         anyHit = false, anyMiss = false;
+    instances.clear();
+    materials.clear();
+
+    size_t end = std::min(n, begin + warpSize);
+    for(size_t lane = begin; lane < end; lane++)
+    {
+      int32_t instance = rays.instanceCustomIndex[order[lane]];
+      if(instance < 0)
+      {
+        anyMiss = true;
+        continue;
+      }
+      anyHit = true;
+      if(std::find(instances.begin(), instances.end(), instance) == instances.end())
+        instances.push_back(instance);
+      int32_t material = materialOf(instance);
+      if(std::find(materials.begin(), materials.end(), material) == materials.end())
+        materials.push_back(material);
+    }
+
+    warp.lanes             = uint32_t(end - begin);
+    warp.distinctInstances = uint32_t(instances.size());
+    warp.distinctMaterials = uint32_t(materials.size());
+    warp.mixedHitMiss      = anyHit && anyMiss;
+
+    sumInstances += warp.distinctInstances;
+    sumMaterials += warp.distinctMaterials;
+    sumPaths += warp.distinctMaterials + (anyMiss ? 1 : 0);
+    mixed += warp.mixedHitMiss ? 1 : 0;
+    report.numWarps++;
+    if(keepWarps)
+      report.warps.push_back(warp);
+  }
+
+  if(report.numWarps > 0)
+  {
+    double numWarps          = double(report.numWarps);
+    report.meanInstances     = sumInstances / numWarps;
+    report.meanMaterials     = sumMaterials / numWarps;
+    report.mixedHitMissRatio = double(mixed) / numWarps;
+    report.score             = sumPaths / numWarps;
+  }
+  return report;
+}
+
+std::vector<SerReport> SerSimulator::rank(const SerRayBatch& rays, const std::vector<SortingParameters>& candidates, uint32_t numThreads) const
+{
+  std::vector<SerReport> reports(candidates.size());
+
+  if(numThreads == 0)
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  numThreads = std::min<uint32_t>(numThreads, uint32_t(candidates.size()));
+
+  std::atomic<size_t>      next{0};
+  std::vector<std::thread> workers;
+  for(uint32_t t = 0; t < numThreads; t++)
+  {
+    workers.emplace_back([&]() {
+      for(size_t i = next++; i < candidates.size(); i = next++)
+        reports[i] = simulate(rays, candidates[i]);
+    });
+  }
+  for(auto& w : workers)
+    w.join();
+
+  std::stable_sort(reports.begin(), reports.end(), [](const SerReport& a, const SerReport& b) { return a.score < b.score; });
+  return reports;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+//--------------------------------------------------------------------------------------------------
+// CPU simulation of Shader Execution Reordering
+// - Builds the composite key of createSortingKeyFromSpecialization (keyCreation.glsl) for each ray
+// - Emulates reorderThreadNV: stable sort on the bits of the key budget
+// - Cuts the reordered rays in warps and measures how many different shading paths each warp
+//   executes: instances, materials and hit versus miss
+//
+// This ranks SortingParameters by coherence without a GPU. It does not model the cost of the
+// reordering itself, which the FPS measurements of the sorting grid capture.
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include "shaders/host_device.h"
+#include "shaders/sorting_keys.h"
+
+
+// Rays of one bounce with their hit results, structure of arrays
+struct SerRayBatch
+{
+  std::vector<glm::vec3> origins;
+  std::vector<glm::vec3> directions;
+  std::vector<float>     hitT;                 // Distance to the hit, INFINITY (1e32) for a miss
+  std::vector<float>     prevHitT;             // prd.hitT when the key is built: hitT of the previous bounce
+  std::vector<int32_t>   instanceCustomIndex;  // Instance hit, -1 for a miss
+  std::vector<int32_t>   depth;                // Bounce of the path
+
+  size_t size() const { return origins.size(); }
+  void   resize(size_t n);
+};
+
+struct SerSettings
+{
+  SortingKeyBounds bounds{glm::vec3(0.0f), glm::vec3(1.0f), 1.0f};  // sceneBounds() of keyCreation.glsl
+  int              maxDepth{5};                                       // RtxState::maxDepth, used by isFinished
+  uint32_t         warpSize{32};
+  // Rays reordered together. The hardware only reorders within a subset of the launch, 0 sorts the whole batch.
+  size_t reorderWindow{0};
+  // Material of each instanceCustomIndex (GltfPrimMesh::materialIndex), empty: one material per instance
+  std::vector<int32_t> instanceMaterials;
+};
+
+struct SerWarpStats
+{
+  uint32_t lanes{0};
+  uint32_t distinctInstances{0};  // Misses excluded
+  uint32_t distinctMaterials{0};  // Misses excluded
+  bool     mixedHitMiss{false};
+};
+
+struct SerReport
+{
+  SortingParameters parameters{};
+  size_t            numWarps{0};
+  double            meanInstances{0};      // Distinct instances per warp
+  double            meanMaterials{0};      // Distinct materials per warp
+  double            mixedHitMissRatio{0};  // Fraction of warps with both hits and misses
+  double            score{0};              // Distinct shading paths per warp (materials + miss), lower is better
+  std::vector<SerWarpStats> warps;         // Filled on request only
+};
+
+class SerSimulator
+{
+public:
+  explicit SerSimulator(SerSettings settings);
+
+  // Key of each ray as built by createSortingKeyFromSpecialization
+  void computeKeys(const SerRayBatch& rays, const SortingParameters& parameters, std::vector<uint32_t>& keys) const;
+  // Ray indices in the order the warps execute them after reorderThreadNV
+  void reorder(const SerRayBatch& rays, const SortingParameters& parameters, std::vector<uint32_t>& order) const;
+
+  SerReport simulate(const SerRayBatch& rays, const SortingParameters& parameters, bool keepWarps = false) const;
+
+  // Simulates every candidate on `numThreads` threads (0: all cores), returns the reports by increasing score
+  std::vector<SerReport> rank(const SerRayBatch&                    rays,
+                              const std::vector<SortingParameters>& candidates,
+                              uint32_t                              numThreads = 0) const;
+
+private:
+  int32_t materialOf(int32_t instance) const;
+
+  SerSettings m_settings;
+};
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+//--------------------------------------------------------------------------------------------------
+// The legal SortingParameters, from one rule set
+//
+// - A configuration is 8 flag bits (SortingFlagBits) and a number of coherence bits
+// - sortingFlagsLegal() is the only legality rule, the application, the inference and the tools
+//   all use it
+// - kSortingConfigs is every legal and distinct flag set times kSortingCoherenceBits, built at
+//   compile time in flag order. Distinct: without sorting the other flags and the coherence bits
+//   do not matter, the noSort flag alone is kept once, with zero coherence bits.
+//
+// No Vulkan dependency.
+
+#include <array>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include "shaders/host_device.h"
+
+
+enum SortingFlagBits : uint32_t
+{
+  eSortingNoSort            = 1 << 0,
+  eSortingAfterTraversal    = 1 << 1,
+  eSortingHitObject         = 1 << 2,
+  eSortingRayOrigin         = 1 << 3,
+  eSortingRayDirection      = 1 << 4,
+  eSortingEstimatedEndpoint = 1 << 5,
+  eSortingRealEndpoint      = 1 << 6,
+  eSortingIsFinished        = 1 << 7,
+  eSortingNumFlagSets       = 1 << 8,
+};
+
+// Coherence bit counts of the table
+static constexpr std::array<uint32_t, 4> kSortingCoherenceBits = {8, 16, 24, 32};
+
+constexpr bool sortingFlagsLegal(uint32_t flags)
+{
+  bool afterTraversal = flags & eSortingAfterTraversal;
+  bool estimated      = flags & eSortingEstimatedEndpoint;
+  // The hit object and the real endpoint only exist after the traversal, the estimated endpoint
+  // is redundant with either of them
+  if((flags & (eSortingRealEndpoint | eSortingHitObject)) && (estimated || !afterTraversal))
+    return false;
+  // The estimated endpoint is redundant after the traversal
+  if(estimated && afterTraversal)
+    return false;
+  if((flags & eSortingNoSort) && (flags & eSortingHitObject))
+    return false;
+  // Something has to go into the key
+  return (flags & ~eSortingAfterTraversal) != 0;
+}
+
+// One flag set per distinct specialization
+constexpr bool sortingFlagsDistinct(uint32_t flags)
+{
+  return sortingFlagsLegal(flags) && (!(flags & eSortingNoSort) || flags == eSortingNoSort);
+}
+
+constexpr uint32_t sortingFlags(const SortingParameters& p)
+{
+  return (p.noSort ? uint32_t(eSortingNoSort) : 0u) | (p.sortAfterASTraversal ? uint32_t(eSortingAfterTraversal) : 0u)
+         | (p.hitObject ? uint32_t(eSortingHitObject) : 0u) | (p.rayOrigin ? uint32_t(eSortingRayOrigin) : 0u)
+         | (p.rayDirection ? uint32_t(eSortingRayDirection) : 0u)
+         | (p.estimatedEndpoint ? uint32_t(eSortingEstimatedEndpoint) : 0u)
+         | (p.realEndpoint ? uint32_t(eSortingRealEndpoint) : 0u) | (p.isFinished ? uint32_t(eSortingIsFinished) : 0u);
+}
+
+constexpr SortingParameters sortingParameters(uint32_t flags, uint32_t numCoherenceBits)
+{
+  SortingParameters p{};
+  p.numCoherenceBitsTotal = numCoherenceBits;
+  p.noSort                = flags & eSortingNoSort;
+  p.sortAfterASTraversal  = flags & eSortingAfterTraversal;
+  p.hitObject             = flags & eSortingHitObject;
+  p.rayOrigin             = flags & eSortingRayOrigin;
+  p.rayDirection          = flags & eSortingRayDirection;
+  p.estimatedEndpoint     = flags & eSortingEstimatedEndpoint;
+  p.realEndpoint          = flags & eSortingRealEndpoint;
+  p.isFinished            = flags & eSortingIsFinished;
+  return p;
+}
+
+constexpr bool sortingParametersLegal(const SortingParameters& p)
+{
+  return sortingFlagsLegal(sortingFlags(p));
+}
+
+struct SortingConfig
+{
+  uint8_t flags{0};
+  uint8_t numCoherenceBits{0};
+
+  constexpr SortingParameters parameters() const { return sortingParameters(flags, numCoherenceBits); }
+};
+
+constexpr uint32_t countDistinctSortingFlags()
+{
+  uint32_t count = 0;
+  for(uint32_t flags = 0; flags < eSortingNumFlagSets; flags++)
+    count += sortingFlagsDistinct(flags) ? 1 : 0;
+  return count;
+}
+
+static constexpr uint32_t kNumSortingFlagSets = countDistinctSortingFlags();
+// The noSort flag set has a single configuration
+static constexpr uint32_t kNumSortingConfigs = (kNumSortingFlagSets - 1) * uint32_t(kSortingCoherenceBits.size()) + 1;
+
+// Flag set major: the configurations of one flag set are next to each other
+constexpr std::array<SortingConfig, kNumSortingConfigs> makeSortingConfigs()
+{
+  std::array<SortingConfig, kNumSortingConfigs> configs{};
+  uint32_t                                      i = 0;
+  for(uint32_t flags = 0; flags < eSortingNumFlagSets; flags++)
+  {
+    if(!sortingFlagsDistinct(flags))
+      continue;
+    if(flags == eSortingNoSort)
+    {
+      configs[i++] = {uint8_t(flags), 0};
+      continue;
+    }
+    for(uint32_t bits : kSortingCoherenceBits)
+      configs[i++] = {uint8_t(flags), uint8_t(bits)};
+  }
+  return configs;
+}
+
+static constexpr std::array<SortingConfig, kNumSortingConfigs> kSortingConfigs = makeSortingConfigs();
+
+static_assert(kNumSortingFlagSets == 47, "The legality rules changed, the tuner arms and the stored results depend on them");
@@ -1,67 +1,43 @@
 #include "sorting_grid.hpp"
 #include <random>
 #include <fstream>
+#include <cstdio>
+#include <algorithm>
 
 using json = nlohmann::json;
 
-bool parametersLegalCheck1(SortingParameters parameters)
-{ 
-  //both th information for the actua ray endpoint or the hitobject sorting only exist after Ray traversal has been performed
-  //So a parameter set that uses them before Ray traversal would be illegal
-  // we also disqualify estimated Endpoint information with either setting, sicne they are redundant
-  if((parameters.realEndpoint || parameters.hitObject) && (parameters.estimatedEndpoint || (!parameters.sortAfterASTraversal)))
-  {
-    return false;
-  }
-  // we  disqualify estimated Endpoint information being used after ray traversal, since that would be redundant
-  if(parameters.estimatedEndpoint && parameters.sortAfterASTraversal)
-  {
-    return false;
-  }
-  if(parameters.noSort &&(parameters.hitObject))
-  {
-    return false;
-  }
-  if(!(parameters.noSort || parameters.hitObject ||parameters.estimatedEndpoint || parameters.isFinished ||parameters.rayDirection || parameters.rayOrigin || parameters.rayOrigin || parameters.realEndpoint))
+std::vector<SortingParameters> enumerateSortingParameters(uint32_t numCoherenceBits)
+{
+  std::vector<SortingParameters> result;
+  for(uint32_t i = 0; i < kNumSortingConfigs; i++)
   {
-    return false;
+    // Flag set major, the first configuration of each flag set
+    if(i == 0 || kSortingConfigs[i].flags != kSortingConfigs[i - 1].flags)
+      result.push_back(sortingParameters(kSortingConfigs[i].flags, numCoherenceBits));
   }
-  
-  return true;
+  return result;
 }
-SortingParameters createSortingParameters1()
-{
-  std::random_device device;
-  std::mt19937 e2(device());
-  SortingParameters result;
-  bool isLegal = false;
-  std::uniform_int_distribution<std::mt19937::result_type> dist32(1,32);
-  std::uniform_int_distribution<std::mt19937::result_type> distBool(0,1);
-
-  while(!isLegal)
-  {
-
-    //random number of coherence Bits
-
-    
-    result.numCoherenceBitsTotal = 32;
-    result.sortAfterASTraversal = distBool(e2);
-    result.estimatedEndpoint = distBool(e2);
-    result.realEndpoint = distBool(e2);
-    result.noSort = distBool(e2);
-    result.hitObject = distBool(e2);
-    result.rayDirection = distBool(e2);
-    result.rayOrigin =  distBool(e2);
-    result.isFinished = distBool(e2);
-    
-    
-    
 
+std::vector<SortingParameters> allSortingParameters()
+{
+  std::vector<SortingParameters> result;
+  result.reserve(kNumSortingConfigs);
+  for(const SortingConfig& config : kSortingConfigs)
+    result.push_back(config.parameters());
+  return result;
+}
 
+// Seeded once, a std::random_device per call is slow and may block
+static std::mt19937& sortingRandomEngine()
+{
+  static std::mt19937 engine{std::random_device{}()};
+  return engine;
+}
 
-    isLegal = parametersLegalCheck1(result);
-  }
-  return result;
+SortingParameters createSortingParameters1()
+{
+  std::uniform_int_distribution<uint32_t> dist(0, kNumSortingConfigs - 1);
+  return kSortingConfigs[dist(sortingRandomEngine())].parameters();
 }
 
 
@@ -70,8 +46,7 @@ SortingParameters morphSortingParameters(SortingParameters parameters)
 {
   SortingParameters result;
 
-  std::random_device device;
-  std::mt19937 e2(device());
+  std::mt19937& e2 = sortingRandomEngine();
   bool isLegal = false;
   std::uniform_int_distribution<std::mt19937::result_type> dist32(1,32);
   std::uniform_int_distribution<std::mt19937::result_type> distBool(0,1);
@@ -132,7 +107,7 @@ SortingParameters morphSortingParameters(SortingParameters parameters)
 
   
 
-    isLegal = parametersLegalCheck1(result);
+    isLegal = sortingParametersLegal(result);
   }
   return result; 
 
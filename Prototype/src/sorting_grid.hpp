@@ -1,53 +1,15 @@
 #pragma once
 #include <vector>
 #include <random>
-#include <limits>
 #include "glm/glm.hpp"
 #include "shaders/host_device.h"
 #include "rtx_pipeline.hpp"
+#include "sorting_configs.hpp"
+#include "pipeline_config.hpp"
+#include "grid_json.hpp"
 #include <unordered_map>
 #include "json.hpp"
 
-  struct TimingObject
-  {
-    int hashCode;
-    int frames;
-    float fps;
-    int totalCycles;
-  };
-
-  struct CubeSideStorage
-  {
-    std::vector<TimingObject> storedElements;
-    PipelineStorage bestPipeline;
-    float bestpipelineFPS = 0.0f;
-  };
-  struct TimingCube
-  {
-    CubeSideStorage upElements;
-    CubeSideStorage downElements;
-    CubeSideStorage leftElements;
-    CubeSideStorage rightElements;
-    CubeSideStorage frontElements;
-    CubeSideStorage backElements;
-  };
-
-
-  struct GridSpace
-{
-  TimingCube cube;
-  float adaptiveGridLearningRate = 1.0f;
-  GridCube bestKeyCube;
-  float BestPipelineFPS = std::numeric_limits<float>::min();
-  PipelineStorage bestPipeline;
-};
-
-struct Grid
-{
-  std::vector<std::vector<std::vector<GridSpace>>> gridSpaces;
-  glm::vec3 gridDimensions;
-};
-
 //SortingParameters mostRecentParameters;
 
 
@@ -86,9 +48,12 @@ SortingGrid1::~SortingGrid1()
 
 */
 
+// A random entry of kSortingConfigs
 SortingParameters createSortingParameters1();
 SortingParameters morphSortingParameters(SortingParameters parameters);
-bool parametersLegalCheck1(SortingParameters parameters);
+// The distinct flag sets of kSortingConfigs with one number of coherence bits, in hash order
+std::vector<SortingParameters> enumerateSortingParameters(uint32_t numCoherenceBits = 32);
+// Every entry of kSortingConfigs, flag sets times coherence bits, in table order
+std::vector<SortingParameters> allSortingParameters();
 
 void storeSortingGrid1();
-
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#include "spirv_cache.hpp"
+
+
+static const uint32_t kSpirvMagic = 0x07230203;
+
+std::string SpirvKey::hex() const
+{
+  char text[33];
+  snprintf(text, sizeof(text), "%016llx%016llx", (unsigned long long)a, (unsigned long long)b);
+  return text;
+}
+
+//--------------------------------------------------------------------------------------------------
+// 128 bits from two unrelated 64-bit hashes: FNV-1a and a multiply-xorshift over the same bytes.
+// Not cryptographic, a collision between two shaders of this project is not a concern.
+//
+namespace {
+struct KeyHasher
+{
+  uint64_t fnv{0xcbf29ce484222325ull};
+  uint64_t mix{0x243f6a8885a308d3ull};
+
+  void add(const void* data, size_t size)
+  {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for(size_t i = 0; i < size; i++)
+    {
+      fnv = (fnv ^ bytes[i]) * 0x100000001b3ull;
+      mix = (mix + bytes[i]) * 0x9e3779b97f4a7c15ull;
+      mix ^= mix >> 29;
+    }
+  }
+  void add(const std::string& text)
+  {
+    // The length separates the fields
+    uint64_t size = text.size();
+    add(&size, sizeof(size));
+    add(text.data(), text.size());
+  }
+};
+}  // namespace
+
+std::string SpirvCompileOptions::signature() const
+{
+  std::string signature = "spirv " + std::to_string(targetSpirv) + ", env " + std::to_string(targetEnvironment) + " "
+                          + std::to_string(targetEnvironmentVersion) + ", optimization " + std::to_string(optimizationLevel)
+                          + (generateDebugInfo ? ", debug info" : "");
+  for(const auto& macro : macros)
+    signature += ", -D" + macro.first + "=" + macro.second;
+  return signature;
+}
+
+SpirvKey makeSpirvKey(const std::string& preprocessedSource, const std::string& options, uint32_t stage, const std::string& entryPoint)
+{
+  KeyHasher hasher;
+  hasher.add(&kSpirvCacheVersion, sizeof(kSpirvCacheVersion));
+  hasher.add(options);
+  hasher.add(&stage, sizeof(stage));
+  hasher.add(entryPoint);
+  hasher.add(preprocessedSource);
+  return {hasher.fnv, hasher.mix};
+}
+
+
+void SpirvCache::setDirectory(const std::string& directory)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_directory = directory;
+}
+
+bool SpirvCache::find(const SpirvKey& key, std::vector<uint32_t>& spirv)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto                        it = m_memory.find(key);
+  if(it != m_memory.end())
+  {
+    spirv = it->second;
+    m_hits++;
+    return true;
+  }
+
+  if(!m_directory.empty())
+  {
+    std::ifstream in(filename(key), std::ios::binary | std::ios::ate);
+    if(in)
+    {
+      std::streamsize size = in.tellg();
+      in.seekg(0);
+      if(size >= std::streamsize(sizeof(uint32_t)) && size % sizeof(uint32_t) == 0)
+      {
+        spirv.resize(size_t(size) / sizeof(uint32_t));
+        if(in.read(reinterpret_cast<char*>(spirv.data()), size) && spirv[0] == kSpirvMagic)
+        {
+          m_memory[key] = spirv;
+          m_hits++;
+          m_diskHits++;
+          return true;
+        }
+      }
+    }
+  }
+
+  m_misses++;
+  return false;
+}
+
+void SpirvCache::store(const SpirvKey& key, const std::vector<uint32_t>& spirv)
+{
+  if(spirv.empty() || spirv[0] != kSpirvMagic)
+    return;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_memory[key] = spirv;
+  if(m_directory.empty())
+    return;
+
+  // Written under another name and renamed, a reader never sees half a module
+  std::error_code error;
+  std::filesystem::create_directories(m_directory, error);
+  std::string name      = filename(key);
+  std::string temporary = name + ".tmp";
+  {
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(spirv.data()), std::streamsize(spirv.size() * sizeof(uint32_t)));
+    if(!out)
+      return;
+  }
+  std::filesystem::rename(temporary, name, error);
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+//--------------------------------------------------------------------------------------------------
+// Content addressed cache of compiled SPIR-V
+//
+// - The key hashes everything the output depends on: the preprocessed source (which contains
+//   the whole include closure), the compile options, the target environment, the shader stage
+//   and the entry point. Editing an included file changes the key, nothing has to be invalidated.
+// - Looked up in memory, then in <directory>/<key>.spv. The files are plain SPIR-V modules, they
+//   are only checked for the SPIR-V magic and a whole number of words.
+// - Thread safe, pipelines are created from several threads
+//
+// No Vulkan or shaderc dependency: the caller preprocesses and compiles.
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+// Bumped when the key or the file layout changes
+static constexpr uint32_t kSpirvCacheVersion = 1;
+
+struct SpirvKey
+{
+  uint64_t a{0};
+  uint64_t b{0};
+
+  bool        operator==(const SpirvKey& other) const { return a == other.a && b == other.b; }
+  std::string hex() const;
+};
+
+// The compile options the output depends on, as the shaderc enum values. The caller applies them
+// to its compiler and keys with signature(), the two cannot drift apart.
+struct SpirvCompileOptions
+{
+  uint32_t targetSpirv{0};               // shaderc_spirv_version
+  uint32_t targetEnvironment{0};         // shaderc_target_env
+  uint32_t targetEnvironmentVersion{0};  // shaderc_env_version
+  uint32_t optimizationLevel{0};         // shaderc_optimization_level
+  bool     generateDebugInfo{false};
+  std::vector<std::pair<std::string, std::string>> macros;  // Name, value
+
+  std::string signature() const;
+};
+
+// `options` describes the compile options and target environment, `stage` is the shader kind
+SpirvKey makeSpirvKey(const std::string& preprocessedSource, const std::string& options, uint32_t stage, const std::string& entryPoint);
+
+class SpirvCache
+{
+public:
+  // Empty directory: memory only
+  void setDirectory(const std::string& directory);
+
+  // False when the key is in neither the memory nor the disk cache
+  bool find(const SpirvKey& key, std::vector<uint32_t>& spirv);
+  void store(const SpirvKey& key, const std::vector<uint32_t>& spirv);
+
+  uint32_t numHits() const { return m_hits; }
+  uint32_t numDiskHits() const { return m_diskHits; }
+  uint32_t numMisses() const { return m_misses; }
+
+private:
+  struct KeyHash
+  {
+    size_t operator()(const SpirvKey& key) const { return size_t(key.a ^ (key.b * 0x9e3779b97f4a7c15ull)); }
+  };
+
+  std::string filename(const SpirvKey& key) const { return m_directory + "/" + key.hex() + ".spv"; }
+
+  std::mutex                                                  m_mutex;
+  std::string                                                 m_directory;
+  std::unordered_map<SpirvKey, std::vector<uint32_t>, KeyHash> m_memory;
+  uint32_t                                                    m_hits{0};
+  uint32_t                                                    m_diskHits{0};
+  uint32_t                                                    m_misses{0};
+};
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+//--------------------------------------------------------------------------------------------------
+// Lock-free ring of one producer and one consumer thread
+//
+// - Fixed capacity, a power of two. push() fails when the ring is full instead of waiting.
+// - The producer only writes m_head, the consumer only m_tail, each on its own cache line. The
+//   release store of one index publishes the slots before it to the other thread.
+// - `T` is copied in and out, trivially copyable types are the intended use
+//
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+template <class T>
+class SpscRing
+{
+public:
+  explicit SpscRing(size_t capacity = 1024)
+  {
+    size_t size = 1;
+    while(size < capacity)
+      size <<= 1;
+    m_slots.resize(size);
+    m_mask = size - 1;
+  }
+  SpscRing(const SpscRing&) = delete;
+  SpscRing& operator=(const SpscRing&) = delete;
+
+  size_t capacity() const { return m_slots.size(); }
+
+  // Producer thread
+  bool push(const T& value)
+  {
+    size_t head = m_head.load(std::memory_order_relaxed);
+    if(head - m_tail.load(std::memory_order_acquire) == m_slots.size())
+      return false;
+    m_slots[head & m_mask] = value;
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer thread, appends at most `maxCount` values to `out`, returns how many
+  size_t popAll(std::vector<T>& out, size_t maxCount = ~size_t(0))
+  {
+    size_t tail  = m_tail.load(std::memory_order_relaxed);
+    size_t count = m_head.load(std::memory_order_acquire) - tail;
+    if(count > maxCount)
+      count = maxCount;
+    for(size_t i = 0; i < count; i++)
+      out.push_back(m_slots[(tail + i) & m_mask]);
+    m_tail.store(tail + count, std::memory_order_release);
+    return count;
+  }
+
+  // Either thread, a snapshot
+  size_t size() const { return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire); }
+
+private:
+  std::vector<T> m_slots;
+  size_t         m_mask{0};
+
+  alignas(64) std::atomic<size_t> m_head{0};
+  alignas(64) std::atomic<size_t> m_tail{0};
+};
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#pragma once
+
+//--------------------------------------------------------------------------------------------------
+// GPU time per ray tracing dispatch, the objective of the tuner
+//
+// - A TimingSource hands out the dispatches whose time is known, some frames after they were
+//   recorded. collect() never waits for the GPU.
+// - Each dispatch carries the tag it was recorded with (SampleExample: tuner context and arm),
+//   a result is attributed to what was really traced even when the pipeline or the camera
+//   changed while it was in flight
+// - DispatchWindow collects the dispatches of one tag over a measurement window, the ones of
+//   other tags (recorded before a switch) are dropped. After a pipeline switch the first ones
+//   are discarded as warm-up (residency of the new pipeline, instruction and data caches), the
+//   steady state estimate of the rest leaves out the hitches (frame_stats.hpp).
+// - GpuDispatchTimer (gpu_dispatch_timer.hpp) is the Vulkan source, MockTimingSource replays
+//   given times with the latency of the frames in flight (tools/bandit_tuner_sim.cpp)
+//
+// No Vulkan dependency.
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "frame_stats.hpp"
+
+
+struct TimingSample
+{
+  uint64_t tag{0};
+  uint64_t gpuNs{0};
+};
+
+class TimingSource
+{
+public:
+  virtual ~TimingSource() = default;
+
+  // Appends the dispatches completed since the last call, in recording order
+  virtual void collect(std::vector<TimingSample>& samples) = 0;
+};
+
+class DispatchWindow
+{
+public:
+  // The first `warmup` dispatches of `tag` are discarded
+  void begin(uint64_t tag, uint32_t warmup = 0)
+  {
+    m_tag    = tag;
+    m_warmup = warmup;
+    m_timesMs.clear();
+  }
+
+  void add(const std::vector<TimingSample>& samples)
+  {
+    for(const TimingSample& s : samples)
+    {
+      if(s.tag != m_tag)
+      {
+        m_dropped++;
+        continue;
+      }
+      if(m_warmup > 0)
+      {
+        m_warmup--;
+        m_discarded++;
+        continue;
+      }
+      m_timesMs.push_back(double(s.gpuNs) * 1e-6);
+    }
+  }
+
+  uint64_t tag() const { return m_tag; }
+  uint32_t count() const { return uint32_t(m_timesMs.size()); }
+  double   sumMs() const
+  {
+    double sum = 0.0;
+    for(double t : m_timesMs)
+      sum += t;
+    return sum;
+  }
+  double meanMs() const { return m_timesMs.empty() ? 0.0 : sumMs() / double(m_timesMs.size()); }
+  const std::vector<double>& timesMs() const { return m_timesMs; }
+
+  SteadyStateEstimate estimate(const SteadyStateSettings& settings)
+  {
+    return estimateSteadyState(m_timesMs, settings, m_scratch);
+  }
+
+  // Over all windows
+  uint64_t dropped() const { return m_dropped; }
+  uint64_t discarded() const { return m_discarded; }
+
+private:
+  uint64_t            m_tag{0};
+  uint32_t            m_warmup{0};
+  uint64_t            m_dropped{0};
+  uint64_t            m_discarded{0};
+  std::vector<double> m_timesMs;
+  std::vector<double> m_scratch;
+};
+
+// The times given to record() come out of collect() `latency` endFrame() later
+class MockTimingSource : public TimingSource
+{
+public:
+  explicit MockTimingSource(uint32_t latency = 2)
+      : m_latency(latency)
+  {
+  }
+
+  void record(uint64_t tag, uint64_t gpuNs) { m_pending.push_back({{tag, gpuNs}, m_frame}); }
+  void endFrame() { m_frame++; }
+
+  void collect(std::vector<TimingSample>& samples) override
+  {
+    while(!m_pending.empty() && m_pending.front().frame + m_latency <= m_frame)
+    {
+      samples.push_back(m_pending.front().sample);
+      m_pending.pop_front();
+    }
+  }
+
+private:
+  struct Pending
+  {
+    TimingSample sample;
+    uint64_t     frame{0};
+  };
+
+  uint32_t            m_latency{2};
+  uint64_t            m_frame{0};
+  std::deque<Pending> m_pending;
+};
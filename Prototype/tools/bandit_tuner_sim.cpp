@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+//--------------------------------------------------------------------------------------------------
+// Runs the bandit tuner against synthetic timings and compares it to the epsilon-greedy search
+// it replaced. Each run is one context of the sorting grid, an observation is one measurement
+// window of the application (200 ms). "UCB1 dispatch" feeds the tuner like the application does:
+// the GPU time of each frame comes through a TimingSource (MockTimingSource, 2 frames late) and
+// a DispatchWindow keeps the frames of the measured arm, the ones in flight at a switch are
+// dropped. The first kSwitchFrames of a new arm are slower (residency, caches), the window
+// discards its warm-up and estimates the steady state like the application.
+//
+// Usage: bandit_tuner_sim [runs] [arms] [relative noise]
+//
+// "good" counts the runs that end on an arm within the tolerance of the fastest one (2%). Fails
+// when a bandit policy does it in less than 90% of the runs.
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "bandit_tuner.hpp"
+#include "sorting_configs.hpp"
+#include "timing_source.hpp"
+
+
+static const double   kWindowSeconds   = 0.2;
+static const uint32_t kFramesPerWindow = 25;  // 200 ms at the base frame time
+static const uint32_t kFramesInFlight  = 2;
+static const uint32_t kSwitchFrames    = 3;  // Slower after a switch
+static const double   kSwitchSlowdown  = 1.5;
+
+struct RunResult
+{
+  uint32_t windows{0};
+  bool     correct{false};  // Ends on the fastest arm
+  bool     good{false};     // Ends on an arm within the tolerance of the fastest
+  bool     converged{false};
+  double   regret{0.0};  // Sum over the windows of the relative slowdown to the fastest arm
+};
+
+static RunResult runBandit(BanditPolicy policy, uint32_t numArms, uint64_t seed, const SyntheticTimingSettings& timing)
+{
+  BanditSettings settings;
+  settings.policy = policy;
+  settings.seed   = seed;
+  BanditTuner          tuner(numArms, 1, settings);
+  SyntheticTimingModel model(numArms, seed, timing);
+
+  RunResult result;
+  while(!tuner.finished(0))
+  {
+    int arm = tuner.select(0);
+    tuner.observe(0, arm, model.sample(arm));
+    result.regret += model.meanOf(arm) / model.meanOf(model.fastestArm()) - 1.0;
+    result.windows++;
+  }
+  result.converged = tuner.converged(0);
+  int best         = tuner.best(0);
+  result.correct   = best == model.fastestArm();
+  result.good      = model.meanOf(best) <= model.meanOf(model.fastestArm()) * (1.0 + settings.tolerance);
+  return result;
+}
+
+// Same tuner, one sample per frame through the timing source instead of one per window
+static RunResult runBanditPerDispatch(BanditPolicy policy, uint32_t numArms, uint64_t seed, const SyntheticTimingSettings& timing,
+                                      uint64_t& dropped, uint64_t& discarded)
+{
+  BanditSettings settings;
+  settings.policy = policy;
+  settings.seed   = seed;
+  BanditTuner               tuner(numArms, 1, settings);
+  SyntheticTimingModel      model(numArms, seed, timing);
+  MockTimingSource          source(kFramesInFlight);
+  DispatchWindow            window;
+  SteadyStateSettings       steady;
+  std::vector<TimingSample> samples;
+
+  RunResult result;
+  int       previous = -1;
+  while(!tuner.finished(0))
+  {
+    int  arm      = tuner.select(0);
+    bool switched = arm != previous;
+    previous      = arm;
+    window.begin(uint64_t(arm), switched ? steady.warmupFrames : 0);
+    for(uint32_t frame = 0; frame < kFramesPerWindow; frame++)
+    {
+      double slowdown = switched && frame < kSwitchFrames ? kSwitchSlowdown : 1.0;
+      source.record(uint64_t(arm), uint64_t(model.sample(arm) * slowdown * 1e6));
+      source.endFrame();
+      samples.clear();
+      source.collect(samples);
+      window.add(samples);
+    }
+    if(window.count() > 0)
+      tuner.observe(0, arm, window.estimate(steady).ms);
+    result.regret += model.meanOf(arm) / model.meanOf(model.fastestArm()) - 1.0;
+    result.windows++;
+  }
+  dropped += window.dropped();
+  discarded += window.discarded();
+  result.converged = tuner.converged(0);
+  int best         = tuner.best(0);
+  result.correct   = best == model.fastestArm();
+  result.good      = model.meanOf(best) <= model.meanOf(model.fastestArm()) * (1.0 + settings.tolerance);
+  return result;
+}
+
+// The previous search: a random arm with probability epsilon, the best mean otherwise. It never
+// stops, it gets the same number of windows as the bandit would at most.
+static RunResult runEpsilonGreedy(float epsilon, uint32_t numArms, uint64_t seed, uint32_t windows, const SyntheticTimingSettings& timing)
+{
+  SyntheticTimingModel                   model(numArms, seed, timing);
+  std::mt19937_64                        rng(seed);
+  std::uniform_real_distribution<float>  unit(0.0f, 1.0f);
+  std::uniform_int_distribution<uint32_t> anyArm(0, numArms - 1);
+  std::vector<ArmStats>                  arms(numArms);
+
+  RunResult result;
+  int       best = -1;
+  for(uint32_t w = 0; w < windows; w++)
+  {
+    int arm = best < 0 || unit(rng) < epsilon ? int(anyArm(rng)) : best;
+    arms[arm].add(model.sample(arm));
+    if(best < 0 || arms[arm].mean < arms[best].mean || arm == best)
+    {
+      best = arm;
+      for(uint32_t a = 0; a < numArms; a++)
+      {
+        if(arms[a].count > 0 && arms[a].mean < arms[best].mean)
+          best = int(a);
+      }
+    }
+    result.regret += model.meanOf(arm) / model.meanOf(model.fastestArm()) - 1.0;
+    result.windows++;
+  }
+  result.correct = best == model.fastestArm();
+  result.good    = model.meanOf(best) <= model.meanOf(model.fastestArm()) * (1.0 + BanditSettings().tolerance);
+  return result;
+}
+
+static void report(const char* name, std::vector<RunResult>& runs)
+{
+  std::vector<uint32_t> windows;
+  double                correct = 0, good = 0, converged = 0, regret = 0;
+  for(const RunResult& r : runs)
+  {
+    windows.push_back(r.windows);
+    correct += r.correct;
+    good += r.good;
+    converged += r.converged;
+    regret += r.regret;
+  }
+  std::sort(windows.begin(), windows.end());
+  double n = double(runs.size());
+  printf("%-16s %10u %10.1f %9.1f%% %9.1f%% %9.1f%% %10.2f\n", name, windows[windows.size() / 2],
+         windows[windows.size() / 2] * kWindowSeconds, 100.0 * converged / n, 100.0 * correct / n, 100.0 * good / n, regret / n);
+}
+
+int main(int argc, char** argv)
+{
+  uint32_t numRuns = argc > 1 ? uint32_t(std::strtoul(argv[1], nullptr, 10)) : 200;
+  // The arms of the application: every entry of kSortingConfigs (allSortingParameters)
+  uint32_t                numArms = argc > 2 ? uint32_t(std::strtoul(argv[2], nullptr, 10)) : kNumSortingConfigs;
+  SyntheticTimingSettings timing;
+  if(argc > 3)
+    timing.relativeNoise = std::atof(argv[3]);
+  if(numRuns == 0 || numArms < 2)
+  {
+    printf("Usage: %s [runs > 0] [arms > 1] [relative noise]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  printf("%u runs, %u arms, noise %.1f%%, spikes %.1f%% x%.1f\n", numRuns, numArms, timing.relativeNoise * 100.0,
+         timing.spikeProbability * 100.0, timing.spikeFactor);
+  printf("%-16s %10s %10s %10s %10s %10s %10s\n", "Policy", "windows", "GPU s", "converged", "fastest", "good", "regret");
+
+  std::vector<RunResult> ucb, thompson, greedy, dispatch;
+  uint64_t               dropped = 0, discarded = 0;
+  for(uint32_t r = 0; r < numRuns; r++)
+  {
+    uint64_t seed = 1000 + r;
+    ucb.push_back(runBandit(eBanditUcb1, numArms, seed, timing));
+    dispatch.push_back(runBanditPerDispatch(eBanditUcb1, numArms, seed, timing, dropped, discarded));
+    thompson.push_back(runBandit(eBanditThompson, numArms, seed, timing));
+    // Same budget as the UCB1 run on this context
+    greedy.push_back(runEpsilonGreedy(0.2f, numArms, seed, ucb.back().windows, timing));
+  }
+
+  report("UCB1", ucb);
+  report("Thompson", thompson);
+  report("epsilon 0.2", greedy);
+  report("UCB1 dispatch", dispatch);
+  // The frames in flight at each switch, never attributed to the next arm, and the warm-up after it
+  uint64_t windows = 0;
+  for(const RunResult& r : dispatch)
+    windows += r.windows;
+  printf("UCB1 dispatch: %llu frames dropped, %llu warm-up frames discarded in %llu windows\n", (unsigned long long)dropped,
+         (unsigned long long)discarded, (unsigned long long)windows);
+
+  auto accuracy = [&](const std::vector<RunResult>& runs) {
+    return double(std::count_if(runs.begin(), runs.end(), [](const RunResult& r) { return r.good; })) / double(runs.size());
+  };
+  return accuracy(ucb) >= 0.9 && accuracy(thompson) >= 0.9 && accuracy(dispatch) >= 0.9 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+//--------------------------------------------------------------------------------------------------
+// Runs the GridBlender on a synthetic sorting grid and counts the configuration switches of a
+// camera jittering across a cell boundary. Config 0 is 2% faster for x < 2, config 1 for x >= 2,
+// config 2 is slow everywhere, the cells at x = 3 were never measured. The camera stands on the
+// boundary at x = 2 and moves by a normal jitter every frame, like a hand held camera.
+//
+// Usage: grid_blend_sim [frames] [jitter in cells]
+//
+// Fails when the hysteresis does not reduce the switches, when the weights do not sum to 1 or
+// when the choice away from the boundary is wrong.
+//
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "grid_blend.hpp"
+
+
+static const glm::ivec3 kDimensions(4, 4, 4);
+
+static SortingGridTable syntheticTable()
+{
+  SortingGridTable table;
+  table.reset(uint32_t(kDimensions.x * kDimensions.y * kDimensions.z), 3);
+  for(int z = 0; z < kDimensions.z; z++)
+    for(int y = 0; y < kDimensions.y; y++)
+      for(int x = 0; x < kDimensions.x - 1; x++)
+      {
+        uint32_t cell = uint32_t((z * kDimensions.y + y) * kDimensions.x + x);
+        for(uint32_t side = 0; side < kGridNumSides; side++)
+        {
+          table.record(cell, side, 0, 100, x < 2 ? 100.0f : 102.0f);
+          table.record(cell, side, 1, 100, x < 2 ? 102.0f : 100.0f);
+          table.record(cell, side, 2, 100, 150.0f);
+        }
+      }
+  return table;
+}
+
+// Switches of the chosen configuration over `frames` jittered positions around the boundary
+static uint32_t countSwitches(const SortingGridTable& table, float hysteresis, uint32_t frames, float jitter, int& last)
+{
+  GridBlender blender;
+  blender.settings.hysteresis = hysteresis;
+  std::mt19937                    rng(1);
+  std::normal_distribution<float> offset(0.0f, jitter);
+
+  uint32_t switches = 0;
+  int      previous = -1;
+  for(uint32_t i = 0; i < frames; i++)
+  {
+    GridBlendResult result = blender.select(table, glm::vec3(2.0f + offset(rng), 2.0f, 2.0f), kDimensions, glm::vec3(1, 0, 0));
+    if(result.config != previous && previous >= 0)
+      switches++;
+    previous = result.config;
+  }
+  last = previous;
+  return switches;
+}
+
+int main(int argc, char** argv)
+{
+  uint32_t frames = argc > 1 ? uint32_t(std::strtoul(argv[1], nullptr, 10)) : 1000;
+  float    jitter = argc > 2 ? float(std::atof(argv[2])) : 0.05f;
+  if(frames == 0 || !(jitter > 0.0f))
+  {
+    printf("Usage: %s [frames > 0] [jitter in cells > 0]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  bool ok = true;
+
+  GridBlendWeight weights[24];
+  uint32_t        numWeights = gridBlendWeights(glm::vec3(1.7f, 2.0f, 2.2f), kDimensions, glm::vec3(0.3f, -0.5f, 0.8f), weights);
+  float           sum        = 0.0f;
+  for(uint32_t i = 0; i < numWeights; i++)
+    sum += weights[i].weight;
+  printf("%u weights, sum %.4f\n", numWeights, sum);
+  ok &= std::abs(sum - 1.0f) < 1e-4f;
+
+  SortingGridTable table = syntheticTable();
+  GridBlendSettings defaults;
+  int               lastWithout = -1, lastWith = -1;
+  uint32_t          without = countSwitches(table, 0.0f, frames, jitter, lastWithout);
+  uint32_t          with    = countSwitches(table, defaults.hysteresis, frames, jitter, lastWith);
+  printf("%u frames, jitter %.3f cells\n", frames, jitter);
+  printf("hysteresis 0:    %5u switches, last config %d\n", without, lastWithout);
+  printf("hysteresis %.2f: %5u switches, last config %d\n", defaults.hysteresis, with, lastWith);
+  ok &= with < without || without == 0;
+
+  // Away from the boundary the faster config. Between a measured cell and one that was not, the
+  // measured one decides, at the center of an unmeasured cell nothing is chosen.
+  GridBlender blender;
+  int         left = blender.select(table, glm::vec3(0.5f, 2.0f, 2.0f), kDimensions, glm::vec3(0, 0, 1)).config;
+  blender.reset();
+  GridBlendResult between = blender.select(table, glm::vec3(3.2f, 2.0f, 2.0f), kDimensions, glm::vec3(0, 0, 1));
+  blender.reset();
+  GridBlendResult unmeasured = blender.select(table, glm::vec3(3.5f, 2.0f, 2.0f), kDimensions, glm::vec3(0, 0, 1));
+  printf("x = 0.5: config %d, x = 3.2: config %d from %u measured (cell, side), x = 3.5 (not measured): config %d\n", left,
+         between.config, between.measured, unmeasured.config);
+  ok &= left == 0 && between.config == 1 && unmeasured.config == -1;
+
+  SortingGridTable empty;
+  empty.reset(uint32_t(kDimensions.x * kDimensions.y * kDimensions.z), 3);
+  blender.reset();
+  int none = blender.select(empty, glm::vec3(1.0f), kDimensions, glm::vec3(0, 0, 1)).config;
+  printf("empty grid: config %d\n", none);
+  ok &= none == -1;
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
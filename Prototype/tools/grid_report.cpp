@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+//--------------------------------------------------------------------------------------------------
+// Offline report of the sorting grids saved by the application (Sorting_Grid_Results/*.json and
+// *.kgrid). Loads the runs on all cores, merges them per grid dimensions, cell, cube side and
+// configuration and prints for each source of samples (ConfigId version and time, legacy and
+// GPU-timed runs are never mixed), see grid_analysis.hpp:
+// - per cube side the best configuration with the 95% confidence interval over the runs (n/a
+//   for a single run), and the runner-up
+// - the configurations of least regret against the best of each cube side, of those measured on
+//   at least a quarter of them
+// - the importance of each bit of the ConfigId
+//
+// Usage: grid_report [-threads n] [-window ms] [-top n] [-csv file] <file or directory>...
+//
+// A directory adds its .json and .kgrid files. -window is the measurement window the rates of the
+// JSON files count as (200 ms in the application). -csv writes the cube sides of all the sources.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "grid_analysis.hpp"
+#include "grid_json.hpp"
+
+
+// Legacy keys are the decimal sorting flags, as in the JSON files
+static std::string configName(ConfigId id)
+{
+  return (id >> 56) == 0 ? "flags " + std::to_string(id & 0xff) : configIdString(id);
+}
+
+static std::vector<std::string> expandInputs(const std::vector<std::string>& inputs)
+{
+  namespace fs = std::filesystem;
+  std::vector<std::string> files;
+  for(const std::string& input : inputs)
+  {
+    std::error_code code;
+    if(!fs::is_directory(input, code))
+    {
+      files.push_back(input);
+      continue;
+    }
+    std::vector<std::string> found;
+    for(const fs::directory_entry& entry : fs::directory_iterator(input, code))
+    {
+      std::string extension = entry.path().extension().string();
+      if(entry.is_regular_file() && (extension == ".json" || extension == ".kgrid"))
+        found.push_back(entry.path().string());
+    }
+    std::sort(found.begin(), found.end());
+    files.insert(files.end(), found.begin(), found.end());
+  }
+  return files;
+}
+
+static bool writeCsv(const std::string& filename, const std::vector<GridSideSummary>& sides)
+{
+  FILE* file = fopen(filename.c_str(), "w");
+  if(file == nullptr)
+    return false;
+  fprintf(file, "configIdVersion,gpuTimed,gridX,gridY,gridZ,x,y,z,side,configs,best,runs,meanMs,ciLowMs,ciHighMs,runnerUp,runnerUpRuns,runnerUpMeanMs,separated\n");
+  for(const GridSideSummary& s : sides)
+  {
+    // No interval of a single run
+    std::string ci = s.best.runs > 1 ? std::to_string(s.best.ciLowMs) + "," + std::to_string(s.best.ciHighMs) : ",";
+    fprintf(file, "%u,%d,%d,%d,%d,%d,%d,%d,%s,%u,%s,%u,%.6f,%s,%s,%u,%.6f,%d\n", s.key.source.configIdVersion,
+            int(s.key.source.gpuTimed), s.key.dimensions.x, s.key.dimensions.y, s.key.dimensions.z, s.key.cell.x, s.key.cell.y, s.key.cell.z, kCubeSideNames[s.key.side], s.numConfigs,
+            configName(s.best.config).c_str(), s.best.runs, s.best.meanMs, ci.c_str(),
+            s.runnerUp.runs > 0 ? configName(s.runnerUp.config).c_str() : "", s.runnerUp.runs, s.runnerUp.meanMs, int(s.separated));
+  }
+  fclose(file);
+  return true;
+}
+
+// The three tables of one source, returns its cube sides
+static std::vector<GridSideSummary> printSource(const GridAnalysis& analysis, const GridSource& source, size_t top)
+{
+  printf("== %s, %zu cube sides ==\n\n", gridSourceName(source).c_str(), analysis.numSides(source));
+
+  // Best per cube side, "*" when its interval is below the runner-up's
+  std::vector<GridSideSummary> sides = summarizeGridSides(analysis, source);
+  printf("%-7s %-10s %-6s %7s | %-16s %4s %9s %22s | %-16s %4s %9s %7s\n", "grid", "cell", "side", "configs", "best",
+         "runs", "ms", "95% CI", "runner-up", "runs", "ms", "margin");
+  uint32_t separated = 0;
+  for(const GridSideSummary& s : sides)
+  {
+    char grid[32], cell[32], ci[48];
+    snprintf(grid, sizeof(grid), "%dx%dx%d", s.key.dimensions.x, s.key.dimensions.y, s.key.dimensions.z);
+    snprintf(cell, sizeof(cell), "(%d,%d,%d)", s.key.cell.x, s.key.cell.y, s.key.cell.z);
+    // A single run has no interval
+    if(s.best.runs > 1)
+      snprintf(ci, sizeof(ci), "[%9.4f, %9.4f]", s.best.ciLowMs, s.best.ciHighMs);
+    else
+      snprintf(ci, sizeof(ci), "n/a");
+    printf("%-7s %-10s %-6s %7u | %-16s %4u %9.4f %22s |", grid, cell, kCubeSideNames[s.key.side], s.numConfigs,
+           configName(s.best.config).c_str(), s.best.runs, s.best.meanMs, ci);
+    if(s.runnerUp.runs > 0)
+      printf(" %-16s %4u %9.4f %6.1f%%%s\n", configName(s.runnerUp.config).c_str(), s.runnerUp.runs, s.runnerUp.meanMs,
+             100.0 * (s.runnerUp.meanMs / s.best.meanMs - 1.0), s.separated ? " *" : "");
+    else
+      printf(" %-16s\n", "-");
+    separated += s.separated;
+  }
+  printf("%u of %zu cube sides with a best configuration separated from the runner-up (*)\n\n", separated, sides.size());
+
+  std::vector<GridConfigRegret> ranking = rankGridConfigs(analysis, source);
+  printf("%4s %-16s %6s %6s %11s %11s\n", "rank", "config", "sides", "best", "mean regret", "max regret");
+  for(size_t i = 0; i < std::min(top, ranking.size()); i++)
+  {
+    const GridConfigRegret& r = ranking[i];
+    printf("%4zu %-16s %6u %6u %10.1f%% %10.1f%%\n", i + 1, configName(r.config).c_str(), r.sides, r.best,
+           100.0 * r.meanRegret, 100.0 * r.maxRegret);
+  }
+  printf("\n");
+
+  // Relative change of the dispatch time with the bit set
+  printf("%4s %-18s %6s %8s %8s\n", "bit", "field", "sides", "faster", "effect");
+  for(const GridBitImportance& b : gridBitImportance(analysis, source))
+  {
+    printf("%4u %-18s %6u %7.0f%% %+7.1f%%\n", b.bit, configIdBitName(b.bit).c_str(), b.sides,
+           100.0 * double(b.faster) / double(b.sides), 100.0 * (std::exp(b.meanLogRatio) - 1.0));
+  }
+  printf("\n");
+  return sides;
+}
+
+int main(int argc, char** argv)
+{
+  uint32_t                 numThreads = std::max(1u, std::thread::hardware_concurrency());
+  float                    windowMs   = 200.0f;
+  size_t                   top        = 10;
+  std::string              csvFilename;
+  std::vector<std::string> inputs;
+  for(int i = 1; i < argc; i++)
+  {
+    if(std::strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+      numThreads = std::max(1u, uint32_t(std::strtoul(argv[++i], nullptr, 10)));
+    else if(std::strcmp(argv[i], "-window") == 0 && i + 1 < argc)
+      windowMs = float(std::atof(argv[++i]));
+    else if(std::strcmp(argv[i], "-top") == 0 && i + 1 < argc)
+      top = std::strtoull(argv[++i], nullptr, 10);
+    else if(std::strcmp(argv[i], "-csv") == 0 && i + 1 < argc)
+      csvFilename = argv[++i];
+    else
+      inputs.push_back(argv[i]);
+  }
+  std::vector<std::string> files = expandInputs(inputs);
+  if(files.empty() || !(windowMs > 0.0f))
+  {
+    printf("Usage: %s [-threads n] [-window ms] [-top n] [-csv file] <file or directory>...\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // Each loader merges its runs into its own analysis, the partial analyses are merged in loader order
+  auto start = std::chrono::high_resolution_clock::now();
+  numThreads = std::min(numThreads, uint32_t(files.size()));
+  std::vector<GridAnalysis> partial(numThreads);
+  std::vector<std::string>  errors(files.size());
+  std::atomic<size_t>       next{0};
+  std::vector<std::thread>  loaders;
+  for(uint32_t t = 0; t < numThreads; t++)
+  {
+    loaders.emplace_back([&, t]() {
+      GridStats stats;
+      for(size_t f = next++; f < files.size(); f = next++)
+      {
+        if(loadGridRun(files[f], stats, windowMs, errors[f]))
+          partial[t].addRun(stats.view());
+      }
+    });
+  }
+  for(std::thread& loader : loaders)
+    loader.join();
+  GridAnalysis analysis;
+  for(const GridAnalysis& p : partial)
+    analysis.merge(p);
+  double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+  for(const std::string& error : errors)
+  {
+    if(!error.empty())
+      printf("Skipped: %s\n", error.c_str());
+  }
+  printf("%u runs of %zu files, %zu cube sides, loaded in %.3f s on %u threads\n\n", analysis.numRuns(), files.size(),
+         analysis.sides().size(), seconds, numThreads);
+  if(analysis.numRuns() == 0)
+    return EXIT_FAILURE;
+
+  std::vector<GridSideSummary> sides;
+  for(const GridSource& source : analysis.sources())
+  {
+    std::vector<GridSideSummary> summaries = printSource(analysis, source, top);
+    sides.insert(sides.end(), summaries.begin(), summaries.end());
+  }
+
+  if(!csvFilename.empty() && !writeCsv(csvFilename, sides))
+  {
+    printf("Error: cannot write %s\n", csvFilename.c_str());
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+//--------------------------------------------------------------------------------------------------
+// Microbenchmark of the host key encoders
+// Encodes random rays with every path supported by the CPU, reports keys/s and checks that the
+// batch paths give exactly the keys of the reference (shared shader code). The legacy sorting
+// modes are followed by the composite key of a few bit budgets.
+//
+// Usage: key_encoder_bench [numRays] [repetitions]
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "key_encoder.hpp"
+#include "shaders/sorting_keys.h"
+
+
+static const char* modeName(SortingMode mode)
+{
+  switch(mode)
+  {
+    case eOrigin:
+      return "Origin";
+    case eReis:
+      return "Reis";
+    case eCosta:
+      return "Costa";
+    case eAila:
+      return "Aila";
+    case eTwoPoint:
+      return "TwoPoint";
+    case eEndPointEst:
+      return "EndPointEst";
+    case eEndEstAdaptive:
+      return "EndEstAdaptive";
+    default:
+      return "?";
+  }
+}
+
+int main(int argc, char** argv)
+{
+  size_t numRays     = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : (1 << 22);
+  int    repetitions = argc > 2 ? std::atoi(argv[2]) : 5;
+  int    maxDepth    = 10;
+
+  // Rays in a Sponza sized box, a tenth of them missing like a typical bounce
+  const glm::vec3                       sceneMin(-19.0f, -1.0f, -12.0f), sceneMax(18.0f, 15.0f, 11.0f);
+  SortingKeyBounds                      bounds = SortingKeyMakeBounds(sceneMin, sceneMax);
+  std::mt19937                          rng(1234);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+  std::uniform_int_distribution<int>    depth(0, maxDepth - 1);
+  std::vector<glm::vec3>                origins(numRays), directions(numRays);
+  std::vector<float>                    lengths(numRays);
+  std::vector<int32_t>                  depths(numRays);
+  for(size_t i = 0; i < numRays; i++)
+  {
+    origins[i]    = sceneMin + glm::vec3(unit(rng), unit(rng), unit(rng)) * (sceneMax - sceneMin);
+    directions[i] = glm::vec3(signedUnit(rng), signedUnit(rng), signedUnit(rng));
+    lengths[i]    = unit(rng) < 0.1f ? SK_INFINITY : unit(rng) * bounds.sceneExtent;
+    depths[i]     = depth(rng);
+  }
+  RayBatchView rays{origins.data(), directions.data(), lengths.data(), numRays, depths.data(), maxDepth};
+
+  std::vector<uint32_t> reference(numRays), keys(numRays);
+  const KeyEncoder::Path paths[] = {KeyEncoder::eReference, KeyEncoder::eBmi2, KeyEncoder::eAvx2Bmi2};
+
+  printf("%zu rays, %d repetitions, best path: %s\n", numRays, repetitions, KeyEncoder::pathName(KeyEncoder::eAuto));
+  printf("%-22s %-12s %14s %10s\n", "Mode", "Path", "Mkeys/s", "Parity");
+
+  bool allEqual = true;
+  auto run      = [&](const char* name, auto encode) {
+    encode(reference.data(), KeyEncoder::eReference);
+
+    for(KeyEncoder::Path path : paths)
+    {
+      if(!KeyEncoder::isSupported(path))
+      {
+        printf("%-22s %-12s %14s %10s\n", name, KeyEncoder::pathName(path), "-", "unsupported");
+        continue;
+      }
+
+      double best = 1e30;
+      for(int r = 0; r < repetitions; r++)
+      {
+        auto start = std::chrono::high_resolution_clock::now();
+        encode(keys.data(), path);
+        auto end = std::chrono::high_resolution_clock::now();
+        best     = std::min(best, std::chrono::duration<double>(end - start).count());
+      }
+
+      size_t mismatches = 0;
+      for(size_t i = 0; i < numRays; i++)
+        mismatches += keys[i] != reference[i];
+      allEqual &= mismatches == 0;
+
+      printf("%-22s %-12s %14.1f %10s", name, KeyEncoder::pathName(path), numRays / best * 1e-6, mismatches == 0 ? "ok" : "MISMATCH");
+      if(mismatches)
+        printf(" (%zu)", mismatches);
+      printf("\n");
+    }
+  };
+
+  for(int m = eOrigin; m <= eEndEstAdaptive; m++)
+  {
+    SortingMode mode = SortingMode(m);
+    run(modeName(mode), [&](uint32_t* out, KeyEncoder::Path path) { KeyEncoder::encode(mode, rays, bounds, out, path); });
+  }
+
+  // origin, direction, endpoint, finished
+  const SortingKeyBudget budgets[] = {{11, 10, 10, 1}, {16, 0, 16, 0}, {0, 32, 0, 0}, {32, 0, 0, 0}, {0, 0, 8, 1}};
+  for(const SortingKeyBudget& budget : budgets)
+  {
+    char name[32];
+    snprintf(name, sizeof(name), "Composite %u/%u/%u/%u", budget.origin, budget.direction, budget.endpoint, budget.finished);
+    run(name, [&](uint32_t* out, KeyEncoder::Path path) { KeyEncoder::encodeComposite(budget, rays, bounds, out, path); });
+  }
+
+  return allEqual ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+//--------------------------------------------------------------------------------------------------
+// Dump of a tuner observation log (.kobs, observation_log.hpp): the records per configuration,
+// fastest steady-state estimate first, and all of them as CSV. -roundtrip instead writes made up
+// records through ObservationLog (the SPSC ring and the flusher thread) in two sessions, with a
+// record cut short in between as a crash leaves it, and reads them back with ObservationLogReader.
+//
+// Usage: observation_log_dump [-top n] [-csv file] <log.kobs>
+//        observation_log_dump -roundtrip [records] [ring capacity]
+//
+// The round trip fails when the records read are not the ones written, in order, or when the
+// written and dropped counts do not add up to the records appended.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "observation_log.hpp"
+
+
+// Legacy keys are the decimal sorting flags, as in the JSON files
+static std::string configName(ConfigId id)
+{
+  return (id >> 56) == 0 ? "flags " + std::to_string(id & 0xff) : configIdString(id);
+}
+
+static int dump(const std::string& filename, size_t top, const std::string& csvFilename)
+{
+  ObservationLogReader reader;
+  if(!reader.open(filename))
+  {
+    printf("Error: %s\n", reader.error().c_str());
+    return EXIT_FAILURE;
+  }
+  const ObservationLogHeader& h       = reader.header();
+  const ObservationRecord*    records = reader.records();
+  size_t                      n       = reader.numRecords();
+  double seconds = n > 1 ? double(records[n - 1].timestampNs - records[0].timestampNs) * 1e-9 : 0.0;
+  printf("%s: version %u, ConfigId version %u, %zu records over %.1f s\n\n", filename.c_str(), h.version,
+         h.configIdVersion, n, seconds);
+
+  struct ConfigSummary
+  {
+    ConfigId config{0};
+    uint32_t windows{0};
+    uint64_t frames{0};
+    uint64_t outliers{0};
+    double   gpuMs{0.0};
+    double   estimateMs{0.0};  // Sum over the windows
+  };
+  std::map<ConfigId, ConfigSummary> configs;
+  for(size_t i = 0; i < n; i++)
+  {
+    const ObservationRecord& r = records[i];
+    ConfigSummary&           s = configs[r.config];
+    s.config                   = r.config;
+    s.windows++;
+    s.frames += r.frames;
+    s.outliers += r.outliers;
+    s.gpuMs += double(r.gpuNs) * 1e-6;
+    s.estimateMs += double(r.estimateNs) * 1e-6;
+  }
+  std::vector<ConfigSummary> sorted;
+  for(const auto& [config, s] : configs)
+    sorted.push_back(s);
+  std::sort(sorted.begin(), sorted.end(), [](const ConfigSummary& a, const ConfigSummary& b) {
+    return a.estimateMs / double(a.windows) < b.estimateMs / double(b.windows);
+  });
+
+  // The estimate is what the tuner observed, the GPU time includes the outliers
+  printf("%4s %-16s %8s %10s %9s %12s %12s\n", "rank", "config", "windows", "frames", "outliers", "estimate ms", "gpu ms");
+  for(size_t i = 0; i < std::min(top, sorted.size()); i++)
+  {
+    const ConfigSummary& s = sorted[i];
+    printf("%4zu %-16s %8u %10llu %9llu %12.4f %12.4f\n", i + 1, configName(s.config).c_str(), s.windows,
+           (unsigned long long)s.frames, (unsigned long long)s.outliers, s.estimateMs / double(s.windows),
+           s.frames > 0 ? s.gpuMs / double(s.frames) : 0.0);
+  }
+  printf("%zu configurations\n", sorted.size());
+
+  if(csvFilename.empty())
+    return EXIT_SUCCESS;
+  FILE* file = fopen(csvFilename.c_str(), "w");
+  if(file == nullptr)
+  {
+    printf("Error: cannot write %s\n", csvFilename.c_str());
+    return EXIT_FAILURE;
+  }
+  fprintf(file, "timestampNs,config,cell,side,frames,outliers,gpuMs,estimateMs,eyeX,eyeY,eyeZ,centerX,centerY,centerZ,upX,upY,upZ,fov\n");
+  for(size_t i = 0; i < n; i++)
+  {
+    const ObservationRecord& r = records[i];
+    fprintf(file, "%llu,%s,%u,%u,%u,%u,%.6f,%.6f,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g\n", (unsigned long long)r.timestampNs,
+            configIdString(r.config).c_str(), r.cell, r.side, r.frames, r.outliers, double(r.gpuNs) * 1e-6,
+            double(r.estimateNs) * 1e-6, r.eye.x, r.eye.y, r.eye.z, r.center.x, r.center.y, r.center.z, r.up.x, r.up.y,
+            r.up.z, r.fov);
+  }
+  fclose(file);
+  return EXIT_SUCCESS;
+}
+
+// Every field depends on the sequence number, the timestamp holds it
+static constexpr uint64_t kRoundTripEpochNs = 1700000000000000000ull;
+
+static ObservationRecord roundTripRecord(uint64_t sequence)
+{
+  PipelineConfig config;
+  config.parameters = kSortingConfigs[sequence % kNumSortingConfigs].parameters();
+
+  ObservationRecord r;
+  r.timestampNs = kRoundTripEpochNs + sequence * 1000;
+  r.config      = encodeConfigId(config);
+  r.frames      = 8 + uint32_t(sequence % 7);
+  r.outliers    = uint32_t(sequence % 3);
+  r.estimateNs  = 1000000 + sequence % 997 * 1000;
+  r.gpuNs       = r.estimateNs * r.frames + r.outliers * 250000;
+  r.cell        = uint32_t(sequence % 64);
+  r.side        = uint32_t(sequence % 6);
+  r.eye         = glm::vec3(float(sequence % 13), float(sequence % 17), float(sequence % 19));
+  r.center      = r.eye + glm::vec3(0.0f, 0.0f, -1.0f);
+  r.up          = glm::vec3(0.0f, 1.0f, 0.0f);
+  r.fov         = 30.0f + float(sequence % 40);
+  return r;
+}
+
+// Appends `count` records from `first` like the render thread: never waits on the ring, a burst
+// per frame
+static void appendRecords(ObservationLog& log, uint64_t first, uint64_t count)
+{
+  for(uint64_t i = 0; i < count; i++)
+  {
+    log.append(roundTripRecord(first + i));
+    if(i % 256 == 255)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+static int roundTrip(uint64_t numRecords, size_t capacity)
+{
+  namespace fs         = std::filesystem;
+  std::string filename = (fs::temp_directory_path() / "observation_log_dump_roundtrip.kobs").string();
+  std::error_code code;
+  fs::remove(filename, code);
+
+  bool           ok   = true;
+  uint64_t       half = numRecords / 2;
+  ObservationLog log(capacity);
+  auto           start = std::chrono::high_resolution_clock::now();
+  for(int session = 0; session < 2; session++)
+  {
+    if(!log.open(filename))
+    {
+      printf("Error: %s\n", log.error().c_str());
+      return EXIT_FAILURE;
+    }
+    // The counters run over the sessions of the log
+    uint64_t first   = session == 0 ? 0 : half;
+    uint64_t count   = session == 0 ? half : numRecords - half;
+    uint64_t written = log.written();
+    uint64_t dropped = log.dropped();
+    appendRecords(log, first, count);
+    log.close();
+    written = log.written() - written;
+    dropped = log.dropped() - dropped;
+    printf("session %d: %llu appended, %llu written, %llu dropped\n", session, (unsigned long long)count,
+           (unsigned long long)written, (unsigned long long)dropped);
+    ok &= written + dropped == count;
+
+    // Half a record, as a crash in the middle of a write leaves it: the next session cuts it
+    if(session == 0)
+    {
+      ObservationRecord torn = roundTripRecord(numRecords);
+      std::ofstream     out(filename, std::ios::binary | std::ios::app);
+      out.write(reinterpret_cast<const char*>(&torn), sizeof(torn) / 2);
+    }
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+  ObservationLogReader reader;
+  if(!reader.open(filename))
+  {
+    printf("Error: %s\n", reader.error().c_str());
+    return EXIT_FAILURE;
+  }
+  size_t   n        = reader.numRecords();
+  uint64_t previous = 0;
+  size_t   mismatch = 0;
+  for(size_t i = 0; i < n; i++)
+  {
+    const ObservationRecord& r        = reader.records()[i];
+    uint64_t                 sequence = (r.timestampNs - kRoundTripEpochNs) / 1000;
+    ObservationRecord        expected = roundTripRecord(sequence);
+    // In order, a dropped record leaves a gap but never comes later
+    if(r.timestampNs < kRoundTripEpochNs || sequence >= numRecords || (i > 0 && sequence <= previous)
+       || std::memcmp(&r, &expected, sizeof(r)) != 0)
+      mismatch++;
+    previous = sequence;
+  }
+  // The torn record was cut: the file is whole records, all of them written
+  uint64_t size = fs::file_size(filename, code);
+  printf("%zu records read, %zu not as written, %llu bytes, written in %.1f ms\n", n, mismatch, (unsigned long long)size,
+         seconds * 1000.0);
+  ok &= mismatch == 0 && n == log.written() && reader.header().configIdVersion == kConfigIdVersion;
+  ok &= size == sizeof(ObservationLogHeader) + n * sizeof(ObservationRecord);
+  reader.close();
+  fs::remove(filename, code);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char** argv)
+{
+  if(argc > 1 && std::strcmp(argv[1], "-roundtrip") == 0)
+  {
+    uint64_t numRecords = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100000;
+    size_t   capacity   = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 4096;
+    if(numRecords < 2 || capacity == 0)
+    {
+      printf("Usage: %s -roundtrip [records > 1] [ring capacity > 0]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+    return roundTrip(numRecords, capacity);
+  }
+
+  size_t      top = 20;
+  std::string csvFilename;
+  std::string filename;
+  for(int i = 1; i < argc; i++)
+  {
+    if(std::strcmp(argv[i], "-top") == 0 && i + 1 < argc)
+      top = std::strtoull(argv[++i], nullptr, 10);
+    else if(std::strcmp(argv[i], "-csv") == 0 && i + 1 < argc)
+      csvFilename = argv[++i];
+    else
+      filename = argv[i];
+  }
+  if(filename.empty())
+  {
+    printf("Usage: %s [-top n] [-csv file] <log.kobs>\n", argv[0]);
+    printf("       %s -roundtrip [records] [ring capacity]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  return dump(filename, top, csvFilename);
+}
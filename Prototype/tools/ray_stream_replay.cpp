@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+//--------------------------------------------------------------------------------------------------
+// Offline replay of a ray stream captured by the application
+// Streams the chunks of the capture through the SER simulator, one batch per chunk and bounce,
+// and ranks the sorting parameters by warp divergence.
+//
+// Usage: ray_stream_replay <capture.krs> [top N]
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "ray_stream.hpp"
+#include "ser_simulator.hpp"
+#include "shaders/sorting_keys.h"
+#include "sorting_configs.hpp"
+
+
+static std::vector<SortingParameters> legalCandidates()
+{
+  std::vector<SortingParameters> result;
+  for(const SortingConfig& config : kSortingConfigs)
+    result.push_back(config.parameters());
+  return result;
+}
+
+static bool sameParameters(const SortingParameters& a, const SortingParameters& b)
+{
+  return a.numCoherenceBitsTotal == b.numCoherenceBitsTotal && a.sortAfterASTraversal == b.sortAfterASTraversal
+         && a.noSort == b.noSort && a.hitObject == b.hitObject && a.rayOrigin == b.rayOrigin && a.rayDirection == b.rayDirection
+         && a.estimatedEndpoint == b.estimatedEndpoint && a.realEndpoint == b.realEndpoint && a.isFinished == b.isFinished;
+}
+
+// Splits the records of a chunk per bounce, the paths are complete within a chunk
+static void gatherBounces(const RayStreamChunkView& chunk, std::vector<SerRayBatch>& bounces)
+{
+  for(auto& b : bounces)
+    b.resize(0);
+
+  for(uint32_t i = 0; i < chunk.numRecords; i++)
+  {
+    const RayRecord& r = chunk.records[i];
+    if(r.depth < 0)
+      continue;
+    if(size_t(r.depth) >= bounces.size())
+      bounces.resize(r.depth + 1);
+
+    bool        hasPrevious = i > 0 && chunk.records[i - 1].pixel == r.pixel && chunk.records[i - 1].depth == r.depth - 1;
+    SerRayBatch& b          = bounces[r.depth];
+    b.origins.push_back(r.origin);
+    b.directions.push_back(r.direction);
+    b.hitT.push_back(r.hitT);
+    b.prevHitT.push_back(hasPrevious ? chunk.records[i - 1].hitT : SK_INFINITY);
+    b.instanceCustomIndex.push_back(r.instanceCustomIndex);
+    b.depth.push_back(r.depth);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  if(argc < 2)
+  {
+    printf("Usage: %s <capture.krs> [top N]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  size_t top = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20;
+
+  RayStreamReader reader;
+  if(!reader.open(argv[1]))
+  {
+    printf("Error: %s\n", reader.error().c_str());
+    return EXIT_FAILURE;
+  }
+
+  const RayStreamHeader& h = reader.header();
+  printf("%s: %llu rays in %llu chunks, %ux%u frame, stride %u, max depth %d\n", argv[1],
+         (unsigned long long)h.numRecords, (unsigned long long)h.numChunks, h.width, h.height, h.captureStride,
+         h.state.maxDepth);
+
+  SerSettings settings;
+  settings.bounds   = SortingKeyMakeBounds(h.sceneMin, h.sceneMax);
+  settings.maxDepth = h.state.maxDepth;
+  SerSimulator simulator(settings);
+
+  std::vector<SortingParameters> candidates = legalCandidates();
+  std::vector<SerReport>         totals(candidates.size());
+  for(size_t c = 0; c < candidates.size(); c++)
+    totals[c].parameters = candidates[c];
+
+  auto                     start = std::chrono::high_resolution_clock::now();
+  std::vector<SerRayBatch> bounces;
+  for(size_t c = 0; c < reader.numChunks(); c++)
+  {
+    gatherBounces(reader.chunk(c), bounces);
+    for(const SerRayBatch& batch : bounces)
+    {
+      if(batch.size() == 0)
+        continue;
+      for(const SerReport& r : simulator.rank(batch, candidates))
+      {
+        for(SerReport& t : totals)
+        {
+          if(!sameParameters(t.parameters, r.parameters))
+            continue;
+          // Weighted by the number of warps
+          double w = double(r.numWarps);
+          t.meanInstances += r.meanInstances * w;
+          t.meanMaterials += r.meanMaterials * w;
+          t.mixedHitMissRatio += r.mixedHitMissRatio * w;
+          t.score += r.score * w;
+          t.numWarps += r.numWarps;
+          break;
+        }
+      }
+    }
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+  for(SerReport& t : totals)
+  {
+    double w = t.numWarps > 0 ? 1.0 / double(t.numWarps) : 0.0;
+    t.meanInstances *= w;
+    t.meanMaterials *= w;
+    t.mixedHitMissRatio *= w;
+    t.score *= w;
+  }
+  std::stable_sort(totals.begin(), totals.end(), [](const SerReport& a, const SerReport& b) { return a.score < b.score; });
+
+  printf("%zu parameter sets simulated in %.2f s\n\n", candidates.size(), seconds);
+  printf("%4s %5s %5s %6s %6s %6s %6s %6s %6s | %8s %8s %8s %8s\n", "rank", "bits", "after", "noSort", "hitObj", "origin",
+         "dir", "estEnd", "real", "score", "inst", "mat", "hit/miss");
+  for(size_t i = 0; i < std::min(top, totals.size()); i++)
+  {
+    const SerReport&         t = totals[i];
+    const SortingParameters& p = t.parameters;
+    printf("%4zu %5u %5d %6d %6d %6d %6d %6d %6d | %8.3f %8.3f %8.3f %8.3f%s\n", i + 1, p.numCoherenceBitsTotal,
+           p.sortAfterASTraversal, p.noSort, p.hitObject, p.rayOrigin, p.rayDirection, p.estimatedEndpoint,
+           p.realEndpoint, t.score, t.meanInstances, t.meanMaterials, t.mixedHitMissRatio, p.isFinished ? " finished" : "");
+  }
+  return EXIT_SUCCESS;
+}